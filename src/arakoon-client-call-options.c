@@ -58,6 +58,22 @@ ArakoonClientCallOptions * arakoon_client_call_options_new(void) {
         return options;
 }
 
+ArakoonClientCallOptions * _arakoon_client_call_options_copy(
+    const ArakoonClientCallOptions * const options) {
+        ArakoonClientCallOptions *copy = NULL;
+
+        FUNCTION_ENTER(_arakoon_client_call_options_copy);
+
+        READ_OPTIONS;
+
+        copy = arakoon_mem_new(1, ArakoonClientCallOptions);
+        RETURN_NULL_IF_NULL(copy);
+
+        memcpy(copy, options_, sizeof(ArakoonClientCallOptions));
+
+        return copy;
+}
+
 void arakoon_client_call_options_free(ArakoonClientCallOptions *options) {
         FUNCTION_ENTER(arakoon_client_call_options_free);
 
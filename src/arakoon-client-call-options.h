@@ -29,6 +29,12 @@
 ARAKOON_BEGIN_DECLS
 
 const ArakoonClientCallOptions * _arakoon_client_call_options_get_default(void);
+/* Copy 'options', or the defaults if NULL, e.g. for use by a background
+ * thread. The copy should be released using arakoon_client_call_options_free.
+ */
+ArakoonClientCallOptions * _arakoon_client_call_options_copy(
+    const ArakoonClientCallOptions * const options)
+    ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
 
 #define READ_OPTIONS                                                   \
         const ArakoonClientCallOptions *options_ =                     \
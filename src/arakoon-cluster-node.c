@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "arakoon.h"
 #include "arakoon-protocol.h"
@@ -32,13 +33,23 @@
 #include "arakoon-cluster-node.h"
 #include "arakoon-assert.h"
 #include "arakoon-networking.h"
+#include "arakoon-cluster.h"
+#include "arakoon-mux.h"
+#include "arakoon-command.h"
+#include "arakoon-resolver.h"
 
 struct ArakoonClusterNode {
         char * name;
         const ArakoonCluster * cluster;
         struct addrinfo * address;
+        arakoon_bool address_borrowed;
         int fd;
 
+        /* Only used when the cluster is multiplexed. The connection owns
+         * the socket, fd is kept for reference. */
+        pthread_mutex_t mux_lock;
+        ArakoonMux * mux;
+
         ArakoonClusterNode * next;
 };
 
@@ -63,9 +74,13 @@ ArakoonClusterNode * arakoon_cluster_node_new(const char * name) {
 
         ret->cluster = NULL;
         ret->address = NULL;
+        ret->address_borrowed = ARAKOON_BOOL_FALSE;
         ret->fd = -1;
+        ret->mux = NULL;
         ret->next = NULL;
 
+        pthread_mutex_init(&ret->mux_lock, NULL);
+
         return ret;
 
 nomem:
@@ -90,24 +105,47 @@ void arakoon_cluster_node_free(ArakoonClusterNode *node) {
                 _arakoon_cluster_node_disconnect(node);
         }
 
+        pthread_mutex_destroy(&node->mux_lock);
+
         arakoon_mem_free(node->name);
-        freeaddrinfo(node->address);
+        if(!node->address_borrowed) {
+                freeaddrinfo(node->address);
+        }
         arakoon_mem_free(node);
 }
 
+ArakoonClusterNode * _arakoon_cluster_node_clone(
+    const ArakoonClusterNode * const node) {
+        ArakoonClusterNode *ret = NULL;
+
+        FUNCTION_ENTER(_arakoon_cluster_node_clone);
+
+        ret = arakoon_cluster_node_new(node->name);
+        RETURN_NULL_IF_NULL(ret);
+
+        /* The clone refers to the address list of the original node, which
+         * should outlive it */
+        ret->address = node->address;
+        ret->address_borrowed = ARAKOON_BOOL_TRUE;
+
+        return ret;
+}
+
 arakoon_rc _arakoon_cluster_node_connect(ArakoonClusterNode *node,
     int *timeout) {
         size_t n = 0, len = 0;
         char *prologue = NULL, *p = NULL;
         arakoon_rc rc = 0;
         const char *name = NULL;
+        ArakoonMux *mux = NULL;
+        int fd = -1;
 
         FUNCTION_ENTER(_arakoon_cluster_node_connect);
 
         _arakoon_log_info("arakoon-cluster-node: connecting to %s",
                 node->name);
 
-        if(node->fd >= 0) {
+        if(_arakoon_cluster_node_get_fd(node) >= 0) {
                 _arakoon_log_warning(
                         "arakoon-cluster-node: arakoon_cluster_node_connect "
                         "called, but FD >= 0");
@@ -115,11 +153,9 @@ arakoon_rc _arakoon_cluster_node_connect(ArakoonClusterNode *node,
                 return ARAKOON_RC_SUCCESS;
         }
 
-        rc = _arakoon_networking_connect(node->address, &(node->fd), timeout);
+        rc = _arakoon_networking_connect(node->address, &fd, timeout);
 
         if(rc != ARAKOON_RC_SUCCESS) {
-                node->fd = -1;
-
                 _arakoon_log_error(
                         "arakoon-cluster-node: unable to connect to node %s",
                         node->name);
@@ -128,7 +164,7 @@ arakoon_rc _arakoon_cluster_node_connect(ArakoonClusterNode *node,
         }
 
         _arakoon_log_info("arakoon-cluster-node: connected to node %s, fd %d",
-                node->name, node->fd);
+                node->name, fd);
 
         /* Send prologue */
         name = arakoon_cluster_get_name(node->cluster);
@@ -137,7 +173,10 @@ arakoon_rc _arakoon_cluster_node_connect(ArakoonClusterNode *node,
                 + ARAKOON_PROTOCOL_STRING_LEN(n);
 
         prologue = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(prologue);
+        if(prologue == NULL) {
+                _arakoon_networking_close_wrapper(fd);
+                return -ENOMEM;
+        }
 
         p = prologue;
 
@@ -145,16 +184,74 @@ arakoon_rc _arakoon_cluster_node_connect(ArakoonClusterNode *node,
         ARAKOON_PROTOCOL_WRITE_INT32(p, ARAKOON_PROTOCOL_VERSION);
         ARAKOON_PROTOCOL_WRITE_STRING(p, name, n);
 
-        WRITE_BYTES(node, prologue, len, rc, timeout);
+        /* The prologue is never multiplexed */
+        rc = _arakoon_networking_poll_write(fd, prologue, len, timeout);
 
         arakoon_mem_free(prologue);
 
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_networking_shutdown_wrapper(fd, SHUT_RDWR);
+                _arakoon_networking_close_wrapper(fd);
+                return rc;
+        }
+
+        if(!_arakoon_cluster_is_multiplexed(node->cluster)) {
+                node->fd = fd;
+                return rc;
+        }
+
+        mux = _arakoon_mux_new(fd);
+        if(mux == NULL) {
+                _arakoon_networking_close_wrapper(fd);
+                return -ENOMEM;
+        }
+
+        /* Other threads can pick up the node as soon as the descriptor is
+         * set, so the connection needs to be in place by then */
+        pthread_mutex_lock(&node->mux_lock);
+        node->mux = mux;
+        __atomic_store_n(&node->fd, fd, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&node->mux_lock);
+
         return rc;
 }
 
+static void _arakoon_cluster_node_disconnect_mux(ArakoonClusterNode *node) {
+        ArakoonMux *current = NULL, *mux = NULL;
+
+        current = _arakoon_mux_current(node);
+
+        pthread_mutex_lock(&node->mux_lock);
+        if(current == NULL || current == node->mux) {
+                mux = node->mux;
+                node->mux = NULL;
+                __atomic_store_n(&node->fd, -1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&node->mux_lock);
+
+        if(mux != NULL) {
+                _arakoon_log_info(
+                        "arakoon-cluster-node: disconnecting from node %s, "
+                        "fd %d", node->name, _arakoon_mux_get_fd(mux));
+                _arakoon_mux_break(mux);
+                _arakoon_mux_unref(mux);
+        }
+        else if(current != NULL) {
+                /* The node reconnected meanwhile, only the connection used
+                 * by the calling thread is affected */
+                _arakoon_mux_break(current);
+        }
+}
+
 void _arakoon_cluster_node_disconnect(ArakoonClusterNode *node) {
         FUNCTION_ENTER(_arakoon_internal_cluster_node_disconnect);
 
+        if(node->cluster != NULL &&
+            _arakoon_cluster_is_multiplexed(node->cluster)) {
+                _arakoon_cluster_node_disconnect_mux(node);
+                return;
+        }
+
         if(node->fd >= 0) {
                 _arakoon_log_info(
                         "arakoon-cluster-node: disconnecting from node %s, fd %d",
@@ -166,58 +263,111 @@ void _arakoon_cluster_node_disconnect(ArakoonClusterNode *node) {
         node->fd = -1;
 }
 
-arakoon_rc _arakoon_cluster_node_who_master(ArakoonClusterNode *node,
-    int *timeout, char ** const master) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
-        arakoon_rc rc = 0;
-        void *result_data = NULL;
-        size_t result_size = 0;
+void _arakoon_cluster_node_detach(ArakoonClusterNode *node) {
+        ArakoonMux *mux = NULL;
 
-        FUNCTION_ENTER(arakoon_cluster_node_who_master);
+        FUNCTION_ENTER(_arakoon_cluster_node_detach);
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN;
+        if(node->cluster == NULL ||
+            !_arakoon_cluster_is_multiplexed(node->cluster)) {
+                _arakoon_cluster_node_disconnect(node);
+                return;
+        }
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        pthread_mutex_lock(&node->mux_lock);
+        mux = node->mux;
+        node->mux = NULL;
+        __atomic_store_n(&node->fd, -1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&node->mux_lock);
 
-        c = command;
+        if(mux != NULL) {
+                _arakoon_log_info(
+                        "arakoon-cluster-node: detaching from node %s, fd %d",
+                        node->name, _arakoon_mux_get_fd(mux));
+                /* Requests still in flight hold a reference of their own,
+                 * the socket is closed once the last one is released */
+                _arakoon_mux_unref(mux);
+        }
+}
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x02, 0x00);
+arakoon_rc _arakoon_cluster_node_who_master(ArakoonClusterNode *node,
+    int *timeout, char ** const master) {
+        ArakoonCommandResult result;
+        arakoon_rc rc = 0;
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        FUNCTION_ENTER(arakoon_cluster_node_who_master);
 
-        WRITE_BYTES(node, command, len, rc, timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        *master = NULL;
 
-        ARAKOON_PROTOCOL_READ_RC(node, rc, timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_command_node_send(node, NULL, timeout,
+                ARAKOON_COMMAND_WHO_MASTER);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
 
-        ARAKOON_PROTOCOL_READ_STRING_OPTION(node, result_data, result_size,
-                rc, timeout);
+        rc = _arakoon_command_node_read_rc(node, NULL, timeout);
         if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *master = NULL;
-                return rc;
+                goto out;
         }
 
-        if(result_data == NULL) {
-                *master = NULL;
+        rc = _arakoon_command_node_read_result(node,
+                ARAKOON_COMMAND_RESULT_STRING_OPTION, timeout, &result);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
         }
-        else {
-                *master = arakoon_utils_make_string(result_data, result_size);
-                RETURN_ENOMEM_IF_NULL(*master);
+
+        if(result.data != NULL) {
+                *master = arakoon_utils_make_string(result.data, result.size);
+                if(*master == NULL) {
+                        rc = -ENOMEM;
+                }
         }
 
+out:
+        /* This releases the request when called as part of a master lookup.
+         * A failure might have left part of the response on the socket, so
+         * the real result code is passed on. */
+        _arakoon_mux_end_call(rc);
+
         return rc;
 }
 
+void _arakoon_cluster_node_abandon(ArakoonClusterNode *node) {
+        FUNCTION_ENTER(_arakoon_cluster_node_abandon);
+
+        if(node->fd >= 0) {
+                _arakoon_log_info(
+                        "arakoon-cluster-node: dropping connection to node "
+                        "%s, fd %d, inherited from parent process",
+                        node->name, node->fd);
+
+                /* The socket is still used by the parent process, so it's
+                 * closed without shutdown */
+                _arakoon_networking_close_wrapper(node->fd);
+        }
+
+        /* Even without a connection, these might have been in use while
+         * forking. A multiplexed connection is leaked on purpose: its locks
+         * might have been held by threads which don't exist in this
+         * process. */
+        pthread_mutex_destroy(&node->mux_lock);
+        pthread_mutex_init(&node->mux_lock, NULL);
+        node->mux = NULL;
+        node->fd = -1;
+}
+
 const char * _arakoon_cluster_node_get_name(const ArakoonClusterNode * const node) {
         return node->name;
 }
 
+const struct addrinfo * _arakoon_cluster_node_get_address(
+    const ArakoonClusterNode * const node) {
+        return node->address;
+}
+
 int _arakoon_cluster_node_get_fd(const ArakoonClusterNode * const node) {
-        return node->fd;
+        /* Other threads may (dis)connect a multiplexed node meanwhile */
+        return __atomic_load_n(&node->fd, __ATOMIC_ACQUIRE);
 }
 
 ArakoonClusterNode * _arakoon_cluster_node_get_next(
@@ -232,7 +382,38 @@ void _arakoon_cluster_node_set_next(ArakoonClusterNode *node,
 
 arakoon_rc _arakoon_cluster_node_write_bytes(ArakoonClusterNode *node,
     size_t len, void *data, int *timeout) {
-        return _arakoon_networking_poll_write(node->fd, data, len, timeout);
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        if(!_arakoon_cluster_is_multiplexed(node->cluster)) {
+                return _arakoon_networking_poll_write(node->fd, data, len,
+                        timeout);
+        }
+
+        pthread_mutex_lock(&node->mux_lock);
+        if(node->mux == NULL) {
+                rc = ARAKOON_RC_CLIENT_NOT_CONNECTED;
+        }
+        else {
+                rc = _arakoon_mux_begin(node->mux, node);
+        }
+        pthread_mutex_unlock(&node->mux_lock);
+
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        return _arakoon_mux_submit(data, len, timeout);
+}
+
+arakoon_rc _arakoon_cluster_node_read_bytes(ArakoonClusterNode *node,
+    size_t len, void *data, int *timeout) {
+        const ArakoonMux *mux = NULL;
+
+        mux = _arakoon_mux_current(node);
+        if(mux != NULL) {
+                return _arakoon_networking_poll_read(_arakoon_mux_get_fd(mux),
+                        data, len, timeout);
+        }
+
+        return _arakoon_networking_poll_read(node->fd, data, len, timeout);
 }
 
 arakoon_rc arakoon_cluster_node_add_address(ArakoonClusterNode *node,
@@ -244,6 +425,13 @@ arakoon_rc arakoon_cluster_node_add_address(ArakoonClusterNode *node,
         ASSERT_NON_NULL_RC(node);
         ASSERT_NON_NULL_RC(address);
 
+        if(node->address_borrowed) {
+                _arakoon_log_error(
+                        "arakoon-cluster-node: can't add an address to a "
+                        "cloned node");
+                return -EINVAL;
+        }
+
         if(node->address == NULL) {
                 node->address = address;
         }
@@ -262,9 +450,8 @@ arakoon_rc arakoon_cluster_node_add_address(ArakoonClusterNode *node,
 
 arakoon_rc arakoon_cluster_node_add_address_tcp(ArakoonClusterNode *node,
     const char * const host, const char * const service) {
-        struct addrinfo hints;
-        struct addrinfo *result;
-        int rc = 0;
+        ArakoonResolverQuery query;
+        arakoon_rc rc = 0;
 
         FUNCTION_ENTER(arakoon_cluster_node_add_address_tcp);
 
@@ -275,23 +462,17 @@ arakoon_rc arakoon_cluster_node_add_address_tcp(ArakoonClusterNode *node,
         _arakoon_log_debug("arakoon-cluster-node: looking up node %s at %s:%s",
                 _arakoon_cluster_node_get_name(node), host, service);
 
-        memset(&hints, 0, sizeof(struct addrinfo));
-        hints.ai_family = AF_UNSPEC; /* IPv4 and IPv6, whatever */
-        hints.ai_socktype = SOCK_STREAM;
-        hints.ai_flags = 0;
-        hints.ai_protocol = 0; /* Any protocol */
+        query.host = host;
+        query.service = service;
 
-        rc = getaddrinfo(host, service, &hints, &result);
+        rc = _arakoon_resolver_resolve(NULL, &query, 1);
+        RETURN_IF_NOT_SUCCESS(rc);
 
-        if(rc != 0) {
-                _arakoon_log_error(
-                        "arakoon-cluster-node: address lookup failed: %s",
-                        gai_strerror(rc));
-                return ARAKOON_RC_CLIENT_NETWORK_ERROR;
+        rc = arakoon_cluster_node_add_address(node, query.result);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                freeaddrinfo(query.result);
         }
 
-        rc = arakoon_cluster_node_add_address(node, result);
-
         return rc;
 }
 
@@ -28,11 +28,23 @@
 
 ARAKOON_BEGIN_DECLS
 
+ArakoonClusterNode * _arakoon_cluster_node_clone(
+    const ArakoonClusterNode * const node)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
 arakoon_rc _arakoon_cluster_node_connect(ArakoonClusterNode *node,
     int *timeout)
     ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 void _arakoon_cluster_node_disconnect(ArakoonClusterNode *node)
     ARAKOON_GNUC_NONNULL;
+/* Stop sending new requests to the node. Unlike
+ * _arakoon_cluster_node_disconnect, calls already sent over a multiplexed
+ * connection can still read their response. */
+void _arakoon_cluster_node_detach(ArakoonClusterNode *node)
+    ARAKOON_GNUC_NONNULL;
+/* Drop a connection inherited from the parent process after fork(2) */
+void _arakoon_cluster_node_abandon(ArakoonClusterNode *node)
+    ARAKOON_GNUC_NONNULL;
 
 arakoon_rc _arakoon_cluster_node_who_master(ArakoonClusterNode *node,
     int *timeout, char ** const master)
@@ -41,12 +53,18 @@ arakoon_rc _arakoon_cluster_node_who_master(ArakoonClusterNode *node,
 arakoon_rc _arakoon_cluster_node_write_bytes(ArakoonClusterNode *node,
     size_t len, void *data, int *timeout)
     ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+arakoon_rc _arakoon_cluster_node_read_bytes(ArakoonClusterNode *node,
+    size_t len, void *data, int *timeout)
+    ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 
 int _arakoon_cluster_node_get_fd(const ArakoonClusterNode * const node)
     ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
 const char * _arakoon_cluster_node_get_name(
     const ArakoonClusterNode * const node)
     ARAKOON_GNUC_NONNULL ARAKOON_GNUC_PURE;
+const struct addrinfo * _arakoon_cluster_node_get_address(
+    const ArakoonClusterNode * const node)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_PURE;
 ArakoonClusterNode * _arakoon_cluster_node_get_next(
     const ArakoonClusterNode * const node)
     ARAKOON_GNUC_NONNULL;
@@ -23,8 +23,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "arakoon-cluster.h"
+#include "arakoon-client-call-options.h"
 #include "arakoon-utils.h"
 #include "arakoon-assert.h"
 
@@ -39,8 +42,182 @@ struct ArakoonCluster {
 
         ArakoonClusterNode * nodes;
         ArakoonClusterNode * master;
+
+        arakoon_bool multiplexed;
+        pthread_mutex_t connect_lock;
+
+        /* Value of fork_generation when the connections were made */
+        unsigned int generation;
+
+        /* Master node reported by a watcher, switched to on next use */
+        ArakoonClusterNode * master_hint;
+
+        /* Coalescing of 'get' calls, only used when multiplexed */
+        ArakoonReadCoalescer * read_coalescer;
+
+        /* Cache of 'allow_dirty' reads */
+        ArakoonReadCache * read_cache;
+
+        /* Orders the nodes asked for the master, if set */
+        ArakoonHealthChecker * health_checker;
 };
 
+/* Incremented in the child process on every fork(2). Connections made
+ * before a fork are shared with the parent process, and can't be used. */
+static unsigned int fork_generation = 0;
+static pthread_once_t fork_handler_once = PTHREAD_ONCE_INIT;
+/* Serializes dropping inherited connections and reconnecting the master, so
+ * only a single thread of the child process does so. It's held across
+ * fork(2) by the handlers below, so it's never inherited locked. */
+static pthread_mutex_t fork_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void _arakoon_cluster_fork_prepare(void) {
+        pthread_mutex_lock(&fork_lock);
+}
+
+static void _arakoon_cluster_fork_parent(void) {
+        pthread_mutex_unlock(&fork_lock);
+}
+
+static void _arakoon_cluster_fork_child(void) {
+        __atomic_add_fetch(&fork_generation, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&fork_lock);
+}
+
+static void _arakoon_cluster_init_fork_handler(void) {
+        if(pthread_atfork(_arakoon_cluster_fork_prepare,
+            _arakoon_cluster_fork_parent, _arakoon_cluster_fork_child) != 0) {
+                _arakoon_log_warning(
+                        "arakoon-cluster: unable to install fork handler");
+        }
+}
+
+/* Connect to the master node known by the parent process, which saves a
+ * full master lookup in every child. If this fails, the cluster remains
+ * disconnected until arakoon_cluster_connect_master is called. */
+static void _arakoon_cluster_reconnect_after_fork(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options) {
+        const char *name = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        name = _arakoon_cluster_get_master_name(cluster);
+        if(name == NULL) {
+                return;
+        }
+
+        READ_OPTIONS;
+        timeout = arakoon_client_call_options_get_timeout(options_);
+
+        rc = _arakoon_cluster_connect_master_by_name(cluster, name, &timeout);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_log_info("arakoon-cluster: unable to reconnect to "
+                        "master node %s after fork: %s", name,
+                        arakoon_strerror(rc));
+                __atomic_store_n(&cluster->master, NULL, __ATOMIC_RELEASE);
+        }
+}
+
+/* Drop all connections inherited from a parent process, once per fork. The
+ * master node is remembered, so when 'reconnect' is set it's reconnected
+ * right away, using 'options'. Other threads wait until this is done. */
+static void _arakoon_cluster_check_fork(ArakoonCluster *cluster,
+    const arakoon_bool reconnect,
+    const ArakoonClientCallOptions * const options) {
+        ArakoonClusterNode *node = NULL;
+        unsigned int generation = 0;
+
+        generation = __atomic_load_n(&fork_generation, __ATOMIC_ACQUIRE);
+        if(ARAKOON_GNUC_LIKELY(__atomic_load_n(&cluster->generation,
+            __ATOMIC_ACQUIRE) == generation)) {
+                return;
+        }
+
+        pthread_mutex_lock(&fork_lock);
+
+        /* Another thread might have been first */
+        if(cluster->generation == generation) {
+                pthread_mutex_unlock(&fork_lock);
+                return;
+        }
+
+        _arakoon_log_info("arakoon-cluster: process forked, dropping "
+                "inherited connections of cluster %s", cluster->name);
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                _arakoon_cluster_node_abandon(node);
+        }
+
+        /* The lock might have been held by a thread which doesn't exist in
+         * this process */
+        pthread_mutex_destroy(&cluster->connect_lock);
+        pthread_mutex_init(&cluster->connect_lock, NULL);
+
+        if(reconnect) {
+                _arakoon_cluster_reconnect_after_fork(cluster, options);
+        }
+
+        __atomic_store_n(&cluster->generation, generation, __ATOMIC_RELEASE);
+
+        pthread_mutex_unlock(&fork_lock);
+}
+
+/* When a cluster is multiplexed, the last error is kept per thread */
+typedef struct {
+        const ArakoonCluster *cluster;
+        size_t len;
+        void *data;
+} ArakoonClusterLastError;
+
+static pthread_key_t last_error_key;
+static pthread_once_t last_error_key_once = PTHREAD_ONCE_INIT;
+
+static void _arakoon_cluster_last_error_free(void *data) {
+        ArakoonClusterLastError *error = (ArakoonClusterLastError *) data;
+
+        RETURN_IF_NULL(error);
+
+        arakoon_mem_free(error->data);
+        arakoon_mem_free(error);
+}
+
+static void _arakoon_cluster_init_last_error_key(void) {
+        if(pthread_key_create(&last_error_key,
+            _arakoon_cluster_last_error_free) != 0) {
+                _arakoon_log_fatal("arakoon-cluster: unable to create key");
+                abort();
+        }
+}
+
+static ArakoonClusterLastError * _arakoon_cluster_get_thread_last_error(
+    arakoon_bool create) {
+        ArakoonClusterLastError *error = NULL;
+
+        pthread_once(&last_error_key_once,
+                _arakoon_cluster_init_last_error_key);
+
+        error = (ArakoonClusterLastError *) pthread_getspecific(
+                last_error_key);
+        if(error != NULL || !create) {
+                return error;
+        }
+
+        error = arakoon_mem_new(1, ArakoonClusterLastError);
+        RETURN_NULL_IF_NULL(error);
+
+        error->cluster = NULL;
+        error->len = 0;
+        error->data = NULL;
+
+        if(pthread_setspecific(last_error_key, error) != 0) {
+                arakoon_mem_free(error);
+                return NULL;
+        }
+
+        return error;
+}
+
 ArakoonCluster * arakoon_cluster_new(ArakoonProtocolVersion version,
     const char * const name) {
         ArakoonCluster *ret = NULL;
@@ -75,6 +252,17 @@ ArakoonCluster * arakoon_cluster_new(ArakoonProtocolVersion version,
         ret->nodes = NULL;
         ret->master = NULL;
         ret->version = version;
+        ret->multiplexed = ARAKOON_BOOL_FALSE;
+        ret->master_hint = NULL;
+        ret->read_coalescer = NULL;
+        ret->read_cache = NULL;
+        ret->health_checker = NULL;
+
+        pthread_mutex_init(&ret->connect_lock, NULL);
+
+        pthread_once(&fork_handler_once, _arakoon_cluster_init_fork_handler);
+        ret->generation = __atomic_load_n(&fork_generation,
+                __ATOMIC_RELAXED);
 
         return ret;
 
@@ -96,6 +284,9 @@ void arakoon_cluster_free(ArakoonCluster *cluster) {
 
         RETURN_IF_NULL(cluster);
 
+        /* Inherited connections must not be shut down */
+        _arakoon_cluster_check_fork(cluster, ARAKOON_BOOL_FALSE, NULL);
+
         arakoon_mem_free(cluster->name);
         arakoon_mem_free(cluster->last_error.data);
 
@@ -107,36 +298,264 @@ void arakoon_cluster_free(ArakoonCluster *cluster) {
                 node = next_node;
         }
 
+        pthread_mutex_destroy(&cluster->connect_lock);
+
+        _arakoon_read_coalescer_free(cluster->read_coalescer);
+        _arakoon_read_cache_free(cluster->read_cache);
+
         arakoon_mem_free(cluster);
 }
 
 arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
     const ArakoonClientCallOptions * const options) {
-        ArakoonClusterNode *node = NULL;
-        arakoon_rc rc = 0;
-        char *master = NULL;
         int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
 
         FUNCTION_ENTER(arakoon_cluster_connect_master);
 
         ASSERT_NON_NULL_RC(cluster);
 
-        _arakoon_log_debug("Looking up master node");
-
         timeout = options != NULL ?
                 arakoon_client_call_options_get_timeout(options) :
                 ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
+        if(!cluster->multiplexed) {
+                return _arakoon_cluster_connect_master(cluster, &timeout);
+        }
+
+        /* Threads sharing a multiplexed cluster might all notice a broken
+         * connection at once. Nodes which are still connected are reused. */
+        pthread_mutex_lock(&cluster->connect_lock);
+        rc = _arakoon_cluster_connect_master(cluster, &timeout);
+        pthread_mutex_unlock(&cluster->connect_lock);
+
+        return rc;
+}
+
+arakoon_rc arakoon_cluster_set_multiplexed(ArakoonCluster * const cluster,
+    arakoon_bool multiplexed) {
+        ArakoonClusterNode *node = NULL;
+
+        FUNCTION_ENTER(arakoon_cluster_set_multiplexed);
+
+        ASSERT_NON_NULL_RC(cluster);
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                if(_arakoon_cluster_node_get_fd(node) >= 0) {
+                        _arakoon_log_error(
+                                "arakoon-cluster: can't change multiplexing "
+                                "of a connected cluster");
+                        return -EINVAL;
+                }
+        }
+
+        cluster->multiplexed = multiplexed;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_bool _arakoon_cluster_is_multiplexed(
+    const ArakoonCluster * const cluster) {
+        return cluster->multiplexed;
+}
+
+arakoon_rc arakoon_cluster_set_read_coalescing(
+    ArakoonCluster * const cluster, arakoon_bool coalesce,
+    const unsigned int window_usec) {
+        ArakoonClusterNode *node = NULL;
+        ArakoonReadCoalescer *coalescer = NULL;
+
+        FUNCTION_ENTER(arakoon_cluster_set_read_coalescing);
+
+        ASSERT_NON_NULL_RC(cluster);
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                if(_arakoon_cluster_node_get_fd(node) >= 0) {
+                        _arakoon_log_error(
+                                "arakoon-cluster: can't change read "
+                                "coalescing of a connected cluster");
+                        return -EINVAL;
+                }
+        }
+
+        if(coalesce) {
+                coalescer = _arakoon_read_coalescer_new(window_usec);
+                RETURN_ENOMEM_IF_NULL(coalescer);
+        }
+
+        _arakoon_read_coalescer_free(cluster->read_coalescer);
+        cluster->read_coalescer = coalescer;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_rc arakoon_cluster_set_health_checker(
+    ArakoonCluster * const cluster, ArakoonHealthChecker * const checker) {
+        FUNCTION_ENTER(arakoon_cluster_set_health_checker);
+
+        ASSERT_NON_NULL_RC(cluster);
+
+        __atomic_store_n(&cluster->health_checker, checker,
+                __ATOMIC_RELEASE);
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+ArakoonReadCoalescer * _arakoon_cluster_get_read_coalescer(
+    const ArakoonCluster * const cluster) {
+        if(!cluster->multiplexed) {
+                return NULL;
+        }
+
+        return cluster->read_coalescer;
+}
+
+arakoon_rc arakoon_cluster_set_read_cache(ArakoonCluster * const cluster,
+    const size_t max_bytes, const unsigned int ttl_msec) {
+        ArakoonClusterNode *node = NULL;
+        ArakoonReadCache *cache = NULL;
+
+        FUNCTION_ENTER(arakoon_cluster_set_read_cache);
+
+        ASSERT_NON_NULL_RC(cluster);
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                if(_arakoon_cluster_node_get_fd(node) >= 0) {
+                        _arakoon_log_error(
+                                "arakoon-cluster: can't change read "
+                                "cache of a connected cluster");
+                        return -EINVAL;
+                }
+        }
+
+        if(max_bytes != 0) {
+                cache = _arakoon_read_cache_new(max_bytes, ttl_msec);
+                RETURN_ENOMEM_IF_NULL(cache);
+        }
+
+        _arakoon_read_cache_free(cluster->read_cache);
+        cluster->read_cache = cache;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_rc arakoon_cluster_get_read_cache_stats(
+    const ArakoonCluster * const cluster,
+    ArakoonReadCacheStats * const stats) {
+        FUNCTION_ENTER(arakoon_cluster_get_read_cache_stats);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(stats);
+
+        if(cluster->read_cache == NULL) {
+                memset(stats, 0, sizeof(ArakoonReadCacheStats));
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        _arakoon_read_cache_get_stats(cluster->read_cache, stats);
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+ArakoonReadCache * _arakoon_cluster_get_read_cache(
+    const ArakoonCluster * const cluster) {
+        return cluster->read_cache;
+}
+
+/* All nodes of the cluster, NULL-terminated, healthiest first according to
+ * the attached health checker. Nodes the checker doesn't know come last.
+ * Returns NULL without a checker, or when out of memory. */
+static ArakoonClusterNode ** _arakoon_cluster_get_health_order(
+    const ArakoonCluster * const cluster) {
+        ArakoonHealthChecker *checker = NULL;
+        ArakoonNodeHealth *health = NULL;
+        ArakoonClusterNode **order = NULL, *node = NULL;
+        size_t count = 0, filled = 0, i = 0, j = 0;
+
+        checker = __atomic_load_n(&cluster->health_checker,
+                __ATOMIC_ACQUIRE);
+        if(checker == NULL) {
+                return NULL;
+        }
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                count++;
+        }
+
+        health = arakoon_mem_new(count + 1, ArakoonNodeHealth);
+        RETURN_NULL_IF_NULL(health);
+
+        order = arakoon_mem_new(count + 1, ArakoonClusterNode *);
+        if(order == NULL) {
+                arakoon_mem_free(health);
+                return NULL;
+        }
+
+        filled = arakoon_health_checker_get_health(checker, health, count);
+        if(filled > count) {
+                filled = count;
+        }
+
+        /* Names of the health entries belong to the checker, so they're
+         * matched before it's used any further */
+        for(i = 0; i < filled; i++) {
+                for(node = cluster->nodes; node != NULL;
+                    node = _arakoon_cluster_node_get_next(node)) {
+                        if(strcmp(_arakoon_cluster_node_get_name(node),
+                            health[i].name) == 0) {
+                                order[j++] = node;
+                                break;
+                        }
+                }
+        }
+
+        arakoon_mem_free(health);
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                for(i = 0; i < j && order[i] != node; i++);
+
+                if(i == j) {
+                        order[j++] = node;
+                }
+        }
+
+        order[j] = NULL;
+
+        return order;
+}
+
+arakoon_rc _arakoon_cluster_connect_master(ArakoonCluster * const cluster,
+    int *timeout) {
+        ArakoonClusterNode *node = NULL, **order = NULL;
+        arakoon_rc rc = 0;
+        char *master = NULL;
+        size_t i = 0;
+
+        FUNCTION_ENTER(_arakoon_cluster_connect_master);
+
+        _arakoon_cluster_check_fork(cluster, ARAKOON_BOOL_FALSE, NULL);
+
+        _arakoon_log_debug("Looking up master node");
+
+        /* Ask the healthiest nodes first, so a node which is down doesn't
+         * cost a full timeout on every lookup */
+        order = _arakoon_cluster_get_health_order(cluster);
+
         /* Find a node to which we can connect */
-        node = cluster->nodes;
+        node = (order != NULL) ? order[0] : cluster->nodes;
         while(node != NULL) {
-                rc = _arakoon_cluster_node_connect(node, &timeout);
+                rc = _arakoon_cluster_node_connect(node, timeout);
 
                 if(ARAKOON_RC_IS_SUCCESS(rc)) {
                         _arakoon_log_debug("Connected to node %s",
                                 _arakoon_cluster_node_get_name(node));
 
-                        rc = _arakoon_cluster_node_who_master(node, &timeout,
+                        rc = _arakoon_cluster_node_who_master(node, timeout,
                                 &master);
 
                         if(ARAKOON_RC_IS_SUCCESS(rc) && master != NULL) {
@@ -155,9 +574,13 @@ arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
                         }
                 }
 
-                node = _arakoon_cluster_node_get_next(node);
+                i++;
+                node = (order != NULL) ? order[i] :
+                        _arakoon_cluster_node_get_next(node);
         }
 
+        arakoon_mem_free(order);
+
         if(node == NULL) {
                 _arakoon_log_warning("Unable to connect to any node");
                 return ARAKOON_RC_CLIENT_NETWORK_ERROR;
@@ -165,7 +588,7 @@ arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
 
         if(strcmp(_arakoon_cluster_node_get_name(node), master) == 0) {
                 /* The node is master */
-                cluster->master = node;
+                __atomic_store_n(&cluster->master, node, __ATOMIC_RELEASE);
                 arakoon_mem_free(master);
 
                 _arakoon_log_info("Found master node %s",
@@ -174,30 +597,46 @@ arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
                 return ARAKOON_RC_SUCCESS;
         }
 
+        rc = _arakoon_cluster_connect_master_by_name(cluster, master,
+                timeout);
+
+        arakoon_mem_free(master);
+
+        return rc;
+}
+
+arakoon_rc _arakoon_cluster_connect_master_by_name(
+    ArakoonCluster * const cluster, const char * const name, int *timeout) {
+        ArakoonClusterNode *node = NULL;
+        arakoon_rc rc = 0;
+        char *master = NULL;
+
+        FUNCTION_ENTER(_arakoon_cluster_connect_master_by_name);
+
         /* Find master node */
         node = cluster->nodes;
         while(node) {
-                if(strcmp(_arakoon_cluster_node_get_name(node), master) == 0) {
+                if(strcmp(_arakoon_cluster_node_get_name(node), name) == 0) {
                         break;
                 }
                 node = _arakoon_cluster_node_get_next(node);
         }
 
-        arakoon_mem_free(master);
-
         if(node == NULL) {
                 return ARAKOON_RC_CLIENT_UNKNOWN_NODE;
         }
 
         _arakoon_log_debug("Connecting to master node %s", _arakoon_cluster_node_get_name(node));
 
-        rc = _arakoon_cluster_node_connect(node, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+        if(_arakoon_cluster_node_get_fd(node) < 0) {
+                rc = _arakoon_cluster_node_connect(node, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+        }
 
         /* Check whether master thinks it's master */
         _arakoon_log_debug("Validating master node");
 
-        rc = _arakoon_cluster_node_who_master(node, &timeout, &master);
+        rc = _arakoon_cluster_node_who_master(node, timeout, &master);
         RETURN_IF_NOT_SUCCESS(rc);
 
         if(master == NULL ||
@@ -208,7 +647,7 @@ arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
         }
         else {
                 rc = ARAKOON_RC_SUCCESS;
-                cluster->master = node;
+                __atomic_store_n(&cluster->master, node, __ATOMIC_RELEASE);
 
                 _arakoon_log_debug("Found master node %s",
                         _arakoon_cluster_node_get_name(node));
@@ -219,6 +658,70 @@ arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
         return rc;
 }
 
+ArakoonCluster * _arakoon_cluster_clone(const ArakoonCluster * const cluster) {
+        ArakoonCluster *ret = NULL;
+        ArakoonClusterNode *node = NULL, *clone = NULL, *last = NULL;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_cluster_clone);
+
+        ret = arakoon_cluster_new(cluster->version, cluster->name);
+        RETURN_NULL_IF_NULL(ret);
+
+        /* Keep the node order of the original cluster, so master lookup
+         * behaves the same on the clone */
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                clone = _arakoon_cluster_node_clone(node);
+                if(clone == NULL) {
+                        arakoon_cluster_free(ret);
+                        return NULL;
+                }
+
+                rc = _arakoon_cluster_node_set_cluster(clone, ret);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        arakoon_cluster_node_free(clone);
+                        arakoon_cluster_free(ret);
+                        return NULL;
+                }
+
+                if(last == NULL) {
+                        ret->nodes = clone;
+                }
+                else {
+                        _arakoon_cluster_node_set_next(last, clone);
+                }
+
+                last = clone;
+        }
+
+        return ret;
+}
+
+const char * _arakoon_cluster_get_master_name(
+    const ArakoonCluster * const cluster) {
+        FUNCTION_ENTER(_arakoon_cluster_get_master_name);
+
+        if(cluster->master == NULL) {
+                return NULL;
+        }
+
+        return _arakoon_cluster_node_get_name(cluster->master);
+}
+
+void _arakoon_cluster_disconnect_non_master(ArakoonCluster * const cluster) {
+        ArakoonClusterNode *node = NULL;
+
+        FUNCTION_ENTER(_arakoon_cluster_disconnect_non_master);
+
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                if(node != cluster->master) {
+                        _arakoon_cluster_node_disconnect(node);
+                }
+        }
+}
+
 const char * arakoon_cluster_get_name(const ArakoonCluster * const cluster) {
         FUNCTION_ENTER(arakoon_cluster_get_name);
 
@@ -229,12 +732,30 @@ const char * arakoon_cluster_get_name(const ArakoonCluster * const cluster) {
 
 arakoon_rc arakoon_cluster_get_last_error(
     const ArakoonCluster * const cluster, size_t *len, const void **data) {
+        ArakoonClusterLastError *error = NULL;
+
         FUNCTION_ENTER(arakoon_cluster_get_last_error);
 
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(len);
         ASSERT_NON_NULL_RC(data);
 
+        if(cluster->multiplexed) {
+                error = _arakoon_cluster_get_thread_last_error(
+                        ARAKOON_BOOL_FALSE);
+
+                if(error != NULL && error->cluster == cluster) {
+                        *len = error->len;
+                        *data = error->data;
+                }
+                else {
+                        *len = 0;
+                        *data = NULL;
+                }
+
+                return ARAKOON_RC_SUCCESS;
+        }
+
         *len = cluster->last_error.len;
         *data = cluster->last_error.data;
 
@@ -243,8 +764,26 @@ arakoon_rc arakoon_cluster_get_last_error(
 
 void _arakoon_cluster_set_last_error(ArakoonCluster * const cluster,
     size_t len, void *data) {
+        ArakoonClusterLastError *error = NULL;
+
         FUNCTION_ENTER(_arakoon_cluster_set_last_error);
 
+        if(cluster->multiplexed) {
+                error = _arakoon_cluster_get_thread_last_error(
+                        ARAKOON_BOOL_TRUE);
+                if(error == NULL) {
+                        arakoon_mem_free(data);
+                        return;
+                }
+
+                arakoon_mem_free(error->data);
+                error->cluster = cluster;
+                error->len = len;
+                error->data = data;
+
+                return;
+        }
+
         cluster->last_error.len = len;
         cluster->last_error.data = data;
 }
@@ -272,23 +811,132 @@ arakoon_rc arakoon_cluster_add_node(ArakoonCluster *cluster,
         return ARAKOON_RC_SUCCESS;
 }
 
-ArakoonClusterNode * _arakoon_cluster_get_master(
+void _arakoon_cluster_set_master_hint(ArakoonCluster * const cluster,
+    const char * const name) {
+        ArakoonClusterNode *node = NULL;
+
+        FUNCTION_ENTER(_arakoon_cluster_set_master_hint);
+
+        /* The node list doesn't change once the cluster is in use */
+        for(node = cluster->nodes; node != NULL;
+            node = _arakoon_cluster_node_get_next(node)) {
+                if(strcmp(_arakoon_cluster_node_get_name(node), name) == 0) {
+                        break;
+                }
+        }
+
+        if(node == NULL ||
+            node == __atomic_load_n(&cluster->master, __ATOMIC_ACQUIRE)) {
+                return;
+        }
+
+        __atomic_store_n(&cluster->master_hint, node, __ATOMIC_RELEASE);
+}
+
+/* Switch to the master node reported by a watcher, connecting to it using
+ * the options of the call. Only a single thread takes the hint, others
+ * continue using the current master meanwhile. */
+static void _arakoon_cluster_apply_master_hint(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options) {
+        ArakoonClusterNode *node = NULL, *previous = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        node = __atomic_exchange_n(&cluster->master_hint, NULL,
+                __ATOMIC_ACQ_REL);
+        previous = __atomic_load_n(&cluster->master, __ATOMIC_ACQUIRE);
+        if(node == NULL || node == previous) {
+                return;
+        }
+
+        _arakoon_log_info("arakoon-cluster: switching to master node %s",
+                _arakoon_cluster_node_get_name(node));
+
+        if(cluster->multiplexed) {
+                pthread_mutex_lock(&cluster->connect_lock);
+        }
+
+        if(_arakoon_cluster_node_get_fd(node) < 0) {
+                READ_OPTIONS;
+                timeout = arakoon_client_call_options_get_timeout(options_);
+
+                rc = _arakoon_cluster_node_connect(node, &timeout);
+        }
+
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                __atomic_store_n(&cluster->master, node, __ATOMIC_RELEASE);
+
+                /* The former master would only answer ARAKOON_RC_NOT_MASTER
+                 * from now on. Other threads might still be waiting for a
+                 * response of it though, so those calls can finish. */
+                if(previous != NULL) {
+                        _arakoon_cluster_node_detach(previous);
+                }
+        }
+        else {
+                _arakoon_log_info("arakoon-cluster: unable to connect to "
+                        "master node %s: %s",
+                        _arakoon_cluster_node_get_name(node),
+                        arakoon_strerror(rc));
+        }
+
+        if(cluster->multiplexed) {
+                pthread_mutex_unlock(&cluster->connect_lock);
+        }
+}
+
+ArakoonClusterNode * _arakoon_cluster_get_first_node(
     const ArakoonCluster * const cluster) {
+        return cluster->nodes;
+}
+
+ArakoonClusterNode * _arakoon_cluster_get_master(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options) {
+        ArakoonClusterNode *master = NULL;
+
         ASSERT_NON_NULL(cluster);
 
-        if(cluster->master == NULL) {
+        _arakoon_cluster_check_fork((ArakoonCluster *) cluster,
+                ARAKOON_BOOL_TRUE, options);
+
+        if(ARAKOON_GNUC_UNLIKELY(__atomic_load_n(&cluster->master_hint,
+            __ATOMIC_RELAXED) != NULL)) {
+                _arakoon_cluster_apply_master_hint((ArakoonCluster *) cluster,
+                        options);
+        }
+
+        /* Might be updated by another thread when multiplexed */
+        master = __atomic_load_n(&cluster->master, __ATOMIC_ACQUIRE);
+
+        if(master == NULL) {
                 return NULL;
         }
-        if(_arakoon_cluster_node_get_fd(cluster->master) < 0) {
+        if(_arakoon_cluster_node_get_fd(master) < 0) {
                 return NULL;
         }
 
-        return cluster->master;
+        return master;
 }
 
 void _arakoon_cluster_reset_last_error(ArakoonCluster * const cluster) {
+        ArakoonClusterLastError *error = NULL;
+
         FUNCTION_ENTER(_arakoon_cluster_reset_error);
 
+        if(cluster->multiplexed) {
+                error = _arakoon_cluster_get_thread_last_error(
+                        ARAKOON_BOOL_FALSE);
+                if(error != NULL) {
+                        arakoon_mem_free(error->data);
+                        error->cluster = NULL;
+                        error->len = 0;
+                        error->data = NULL;
+                }
+
+                return;
+        }
+
         cluster->last_error.len = 0;
 
         arakoon_mem_free(cluster->last_error.data);
@@ -28,22 +28,53 @@
 
 #include "arakoon.h"
 #include "arakoon-cluster-node.h"
+#include "arakoon-read-coalescer.h"
+#include "arakoon-read-cache.h"
 
 ARAKOON_BEGIN_DECLS
 
+/* The connected master node, or NULL. 'options' apply to reconnecting the
+ * master after fork(2), or to connecting a master set as hint. */
 ArakoonClusterNode * _arakoon_cluster_get_master(
-    const ArakoonCluster * const cluster);
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options);
 ArakoonProtocolVersion _arakoon_cluster_get_protocol_version(
     const ArakoonCluster * const cluster) ARAKOON_GNUC_NONNULL;
 
-#define ARAKOON_CLUSTER_GET_MASTER(c, m)                \
+#define ARAKOON_CLUSTER_GET_MASTER(c, o, m)             \
         STMT_START                                      \
-        m = _arakoon_cluster_get_master(c);             \
+        m = _arakoon_cluster_get_master(c, o);          \
         if(m == NULL) {                                 \
                 return ARAKOON_RC_CLIENT_NOT_CONNECTED; \
         }                                               \
         STMT_END
 
+arakoon_rc _arakoon_cluster_connect_master(ArakoonCluster * const cluster,
+    int *timeout) ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+arakoon_rc _arakoon_cluster_connect_master_by_name(
+    ArakoonCluster * const cluster, const char * const name, int *timeout)
+    ARAKOON_GNUC_NONNULL2(1, 2) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+ArakoonCluster * _arakoon_cluster_clone(const ArakoonCluster * const cluster)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+const char * _arakoon_cluster_get_master_name(
+    const ArakoonCluster * const cluster) ARAKOON_GNUC_NONNULL;
+void _arakoon_cluster_disconnect_non_master(ArakoonCluster * const cluster)
+    ARAKOON_GNUC_NONNULL;
+ArakoonClusterNode * _arakoon_cluster_get_first_node(
+    const ArakoonCluster * const cluster) ARAKOON_GNUC_NONNULL;
+/* Make the cluster switch to the given master node on its next operation.
+ * Can be called from any thread. */
+void _arakoon_cluster_set_master_hint(ArakoonCluster * const cluster,
+    const char * const name) ARAKOON_GNUC_NONNULL;
+arakoon_bool _arakoon_cluster_is_multiplexed(
+    const ArakoonCluster * const cluster) ARAKOON_GNUC_NONNULL;
+/* The read coalescer 'get' calls should go through, or NULL */
+ArakoonReadCoalescer * _arakoon_cluster_get_read_coalescer(
+    const ArakoonCluster * const cluster) ARAKOON_GNUC_NONNULL;
+/* The cache of 'allow_dirty' reads, or NULL */
+ArakoonReadCache * _arakoon_cluster_get_read_cache(
+    const ArakoonCluster * const cluster) ARAKOON_GNUC_NONNULL;
+
 void _arakoon_cluster_reset_last_error(ArakoonCluster * const cluster);
 void _arakoon_cluster_set_last_error(
     ArakoonCluster * const cluster, size_t len, void * const message);
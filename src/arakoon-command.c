@@ -0,0 +1,510 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-protocol.h"
+#include "arakoon-command.h"
+#include "arakoon-cluster.h"
+#include "arakoon-cluster-node.h"
+#include "arakoon-client-call-options.h"
+#include "arakoon-value-list.h"
+#include "arakoon-key-value-list.h"
+
+static const ArakoonCommandDescriptor descriptors[] = {
+#define X(name, code, arguments, result) \
+        { #name, code, arguments, ARAKOON_COMMAND_RESULT_##result },
+        ARAKOON_COMMANDS(X)
+#undef X
+};
+
+const ArakoonCommandDescriptor * _arakoon_command_get_descriptor(
+    ArakoonCommand command) {
+        if((unsigned int) command >= ARAKOON_COMMAND_COUNT) {
+                _arakoon_log_fatal("arakoon-command: invalid command %d",
+                        command);
+                abort();
+        }
+
+        return &descriptors[command];
+}
+
+/* Both functions below walk the same argument layout, so they need to be
+ * kept in sync */
+static size_t _arakoon_command_get_length(
+    const ArakoonCommandDescriptor * const descriptor, va_list args) {
+        const char *a = NULL;
+        size_t len = ARAKOON_PROTOCOL_COMMAND_LEN, size = 0, value_size = 0;
+        size_t count = 0, i = 0;
+        const void *data = NULL, *value = NULL;
+        const ArakoonValueList *list = NULL;
+
+        for(a = descriptor->arguments; *a != '\0'; a++) {
+                switch(*a) {
+                        case 'd': {
+                                len += ARAKOON_PROTOCOL_BOOL_LEN;
+                        }; break;
+                        case 'b': {
+                                (void) va_arg(args, int);
+                                len += ARAKOON_PROTOCOL_BOOL_LEN;
+                        }; break;
+                        case 'i': {
+                                (void) va_arg(args, int);
+                                len += ARAKOON_PROTOCOL_INT32_LEN;
+                        }; break;
+                        case 's': {
+                                size = va_arg(args, size_t);
+                                (void) va_arg(args, const void *);
+                                len += ARAKOON_PROTOCOL_STRING_LEN(size);
+                        }; break;
+                        case 'o': {
+                                size = va_arg(args, size_t);
+                                data = va_arg(args, const void *);
+                                len += ARAKOON_PROTOCOL_STRING_OPTION_LEN(
+                                        data, size);
+                        }; break;
+                        case 'l': {
+                                list = va_arg(args, const ArakoonValueList *);
+                                len += ARAKOON_PROTOCOL_UINT32_LEN;
+
+                                count = arakoon_value_list_size(list);
+                                for(i = 0; i < count; i++) {
+                                        (void) arakoon_value_list_get(list, i,
+                                                &value_size, &value);
+                                        len += ARAKOON_PROTOCOL_STRING_LEN(
+                                                value_size);
+                                }
+                        }; break;
+                        case 'q': {
+                                len += _arakoon_sequence_get_encoded_size(
+                                        va_arg(args, const ArakoonSequence *));
+                        }; break;
+                        default: {
+                                _arakoon_log_fatal(
+                                        "arakoon-command: invalid argument "
+                                        "type '%c' for %s", *a,
+                                        descriptor->name);
+                                abort();
+                        }; break;
+                }
+        }
+
+        return len;
+}
+
+static char * _arakoon_command_write(char *c,
+    const ArakoonCommandDescriptor * const descriptor,
+    const ArakoonClientCallOptions * const options, va_list args) {
+        const char *a = NULL;
+        size_t size = 0, value_size = 0, count = 0, i = 0;
+        const void *data = NULL, *value = NULL;
+        const ArakoonValueList *list = NULL;
+
+        ARAKOON_PROTOCOL_WRITE_COMMAND(c, descriptor->code, 0x00);
+
+        for(a = descriptor->arguments; *a != '\0'; a++) {
+                switch(*a) {
+                        case 'd': {
+                                ARAKOON_PROTOCOL_WRITE_BOOL(c,
+                                        arakoon_client_call_options_get_allow_dirty(
+                                                options));
+                        }; break;
+                        case 'b': {
+                                ARAKOON_PROTOCOL_WRITE_BOOL(c,
+                                        va_arg(args, int));
+                        }; break;
+                        case 'i': {
+                                ARAKOON_PROTOCOL_WRITE_INT32(c,
+                                        (int32_t) va_arg(args, int));
+                        }; break;
+                        case 's': {
+                                size = va_arg(args, size_t);
+                                data = va_arg(args, const void *);
+                                ARAKOON_PROTOCOL_WRITE_STRING(c, data, size);
+                        }; break;
+                        case 'o': {
+                                size = va_arg(args, size_t);
+                                data = va_arg(args, const void *);
+                                ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, data,
+                                        size);
+                        }; break;
+                        case 'l': {
+                                list = va_arg(args, const ArakoonValueList *);
+                                count = arakoon_value_list_size(list);
+                                ARAKOON_PROTOCOL_WRITE_UINT32(c, count);
+
+                                for(i = 0; i < count; i++) {
+                                        (void) arakoon_value_list_get(list, i,
+                                                &value_size, &value);
+                                        ARAKOON_PROTOCOL_WRITE_STRING(c,
+                                                value, value_size);
+                                }
+                        }; break;
+                        case 'q': {
+                                c = _arakoon_sequence_encode(
+                                        va_arg(args, const ArakoonSequence *),
+                                        c);
+                        }; break;
+                        default: {
+                                _arakoon_log_fatal(
+                                        "arakoon-command: invalid argument "
+                                        "type '%c' for %s", *a,
+                                        descriptor->name);
+                                abort();
+                        }; break;
+                }
+        }
+
+        return c;
+}
+
+arakoon_rc _arakoon_command_node_vsend(ArakoonClusterNode *node,
+    const ArakoonClientCallOptions * const options, int *timeout,
+    ArakoonCommand command, va_list args) {
+        const ArakoonCommandDescriptor *descriptor = NULL;
+        size_t len = 0;
+        char *buffer = NULL, *c = NULL;
+        va_list args_;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_command_node_vsend);
+
+        ASSERT_NON_NULL_RC(node);
+
+        READ_OPTIONS;
+
+        descriptor = _arakoon_command_get_descriptor(command);
+
+        va_copy(args_, args);
+        len = _arakoon_command_get_length(descriptor, args_);
+        va_end(args_);
+
+        buffer = _arakoon_scratch_acquire(len);
+        RETURN_ENOMEM_IF_NULL(buffer);
+
+        va_copy(args_, args);
+        c = _arakoon_command_write(buffer, descriptor, options_, args_);
+        va_end(args_);
+
+        ASSERT_ALL_WRITTEN(buffer, c, len);
+
+        WRITE_BYTES(node, buffer, len, rc, timeout);
+        _arakoon_scratch_release(buffer);
+
+        return rc;
+}
+
+arakoon_rc _arakoon_command_node_send(ArakoonClusterNode *node,
+    const ArakoonClientCallOptions * const options, int *timeout,
+    ArakoonCommand command, ...) {
+        va_list args;
+        arakoon_rc rc = 0;
+
+        va_start(args, command);
+        rc = _arakoon_command_node_vsend(node, options, timeout, command,
+                args);
+        va_end(args);
+
+        return rc;
+}
+
+arakoon_rc _arakoon_command_node_read_rc(ArakoonClusterNode *node,
+    ArakoonCluster *cluster, int *timeout) {
+        arakoon_rc rc = 0, err_rc = 0;
+        void *err_msg = NULL;
+        size_t err_len = 0;
+
+        FUNCTION_ENTER(_arakoon_command_node_read_rc);
+
+        ARAKOON_PROTOCOL_READ_RC(node, rc, timeout);
+        /* Client-side failures, e.g. a timeout reading the code, come with
+         * no message from the server */
+        if(rc == ARAKOON_RC_SUCCESS || rc < 0 ||
+            ARAKOON_RC_AS_ARAKOONRETURNCODE(rc) >=
+            ARAKOON_RC_CLIENT_NETWORK_ERROR) {
+                return rc;
+        }
+
+        _arakoon_log_trace("Non-zero return, reading message");
+        ARAKOON_PROTOCOL_READ_STRING(node, err_msg, err_len, err_rc,
+                timeout);
+        if(err_rc != ARAKOON_RC_SUCCESS) {
+                _arakoon_log_fatal("Failed to read error message: %s",
+                        arakoon_strerror(err_rc));
+                return rc;
+        }
+
+        _arakoon_log_client_error(rc, err_len, err_msg);
+        if(cluster != NULL) {
+                _arakoon_cluster_set_last_error(cluster, err_len, err_msg);
+        }
+        else {
+                arakoon_mem_maybe_free(err_len, err_msg);
+        }
+
+        return rc;
+}
+
+/* Lists are sent last-to-first. Their data is read straight into the list,
+ * if that fails the rest of the response can't be skipped, so the connection
+ * is dropped. */
+static void * _arakoon_command_check_claim(ArakoonClusterNode *node,
+    void *data) {
+        if(data == NULL) {
+                _arakoon_cluster_node_disconnect(node);
+        }
+
+        return data;
+}
+
+/* Option lists hold None entries for missing values */
+static arakoon_rc _arakoon_command_read_value_list(ArakoonClusterNode *node,
+    int *timeout, arakoon_bool options, ArakoonValueList *list) {
+        uint32_t count = 0, i = 0, size = 0;
+        arakoon_bool some = ARAKOON_BOOL_TRUE;
+        void *data = NULL;
+        arakoon_rc rc = 0;
+
+        ARAKOON_PROTOCOL_READ_UINT32(node, count, rc, timeout);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = _arakoon_value_list_resize(list, count);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_cluster_node_disconnect(node);
+                return rc;
+        }
+
+        for(i = count; i > 0; i--) {
+                if(options) {
+                        ARAKOON_PROTOCOL_READ_BOOL(node, some, rc, timeout);
+                        RETURN_IF_NOT_SUCCESS(rc);
+
+                        if(!some) {
+                                _arakoon_value_list_set_none(list, i - 1);
+                                continue;
+                        }
+                }
+
+                ARAKOON_PROTOCOL_READ_UINT32(node, size, rc, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                data = _arakoon_command_check_claim(node,
+                        _arakoon_value_list_set(list, i - 1, size));
+                RETURN_ENOMEM_IF_NULL(data);
+
+                if(size != 0) {
+                        READ_BYTES(node, data, size, rc, timeout);
+                        RETURN_IF_NOT_SUCCESS(rc);
+                }
+        }
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_command_read_key_value_list(
+    ArakoonClusterNode *node, int *timeout, ArakoonKeyValueList *list) {
+        uint32_t count = 0, i = 0, size = 0;
+        void *data = NULL;
+        arakoon_rc rc = 0;
+
+        ARAKOON_PROTOCOL_READ_UINT32(node, count, rc, timeout);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = _arakoon_key_value_list_resize(list, count);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_cluster_node_disconnect(node);
+                return rc;
+        }
+
+        for(i = count; i > 0; i--) {
+                ARAKOON_PROTOCOL_READ_UINT32(node, size, rc, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                data = _arakoon_command_check_claim(node,
+                        _arakoon_key_value_list_set_key(list, i - 1, size));
+                RETURN_ENOMEM_IF_NULL(data);
+
+                if(size != 0) {
+                        READ_BYTES(node, data, size, rc, timeout);
+                        RETURN_IF_NOT_SUCCESS(rc);
+                }
+
+                ARAKOON_PROTOCOL_READ_UINT32(node, size, rc, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                data = _arakoon_command_check_claim(node,
+                        _arakoon_key_value_list_set_value(list, i - 1, size));
+                RETURN_ENOMEM_IF_NULL(data);
+
+                if(size != 0) {
+                        READ_BYTES(node, data, size, rc, timeout);
+                        RETURN_IF_NOT_SUCCESS(rc);
+                }
+        }
+
+        return rc;
+}
+
+arakoon_rc _arakoon_command_node_read_result(ArakoonClusterNode *node,
+    ArakoonCommandResultType type, int *timeout,
+    ArakoonCommandResult *result) {
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        FUNCTION_ENTER(_arakoon_command_node_read_result);
+
+        ASSERT_NON_NULL_RC(result);
+
+        memset(result, 0, sizeof(ArakoonCommandResult));
+
+        switch(type) {
+                case ARAKOON_COMMAND_RESULT_NONE:
+                case ARAKOON_COMMAND_RESULT_CUSTOM: {
+                }; break;
+                case ARAKOON_COMMAND_RESULT_BOOL: {
+                        ARAKOON_PROTOCOL_READ_BOOL(node, result->bool_, rc,
+                                timeout);
+                }; break;
+                case ARAKOON_COMMAND_RESULT_UINT32: {
+                        ARAKOON_PROTOCOL_READ_UINT32(node, result->uint32, rc,
+                                timeout);
+                }; break;
+                case ARAKOON_COMMAND_RESULT_UINT64: {
+                        ARAKOON_PROTOCOL_READ_UINT64(node, result->uint64, rc,
+                                timeout);
+                }; break;
+                case ARAKOON_COMMAND_RESULT_STRING: {
+                        ARAKOON_PROTOCOL_READ_STRING(node, result->data,
+                                result->size, rc, timeout);
+                }; break;
+                case ARAKOON_COMMAND_RESULT_STRING_OPTION: {
+                        ARAKOON_PROTOCOL_READ_STRING_OPTION(node,
+                                result->data, result->size, rc, timeout);
+                }; break;
+                case ARAKOON_COMMAND_RESULT_STRING_LIST:
+                case ARAKOON_COMMAND_RESULT_STRING_OPTION_LIST: {
+                        result->value_list = arakoon_value_list_new();
+                        RETURN_ENOMEM_IF_NULL(result->value_list);
+
+                        rc = _arakoon_command_read_value_list(node, timeout,
+                                type == ARAKOON_COMMAND_RESULT_STRING_OPTION_LIST,
+                                result->value_list);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                arakoon_value_list_free(result->value_list);
+                                result->value_list = NULL;
+                        }
+                }; break;
+                case ARAKOON_COMMAND_RESULT_STRING_STRING_LIST: {
+                        result->key_value_list =
+                                _arakoon_key_value_list_new();
+                        RETURN_ENOMEM_IF_NULL(result->key_value_list);
+
+                        rc = _arakoon_command_read_key_value_list(node,
+                                timeout, result->key_value_list);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                arakoon_key_value_list_free(
+                                        result->key_value_list);
+                                result->key_value_list = NULL;
+                        }
+                }; break;
+                default: {
+                        _arakoon_log_fatal(
+                                "arakoon-command: invalid result type %d",
+                                type);
+                        abort();
+                }; break;
+        }
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_command_vrequest(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonClusterNode **master, int *timeout, ArakoonCommand command,
+    va_list args) {
+        arakoon_rc rc = 0;
+
+        _arakoon_cluster_reset_last_error(cluster);
+
+        READ_OPTIONS;
+        *timeout = arakoon_client_call_options_get_timeout(options_);
+
+        ARAKOON_CLUSTER_GET_MASTER(cluster, options_, *master);
+
+        rc = _arakoon_command_node_vsend(*master, options_, timeout, command,
+                args);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        return _arakoon_command_node_read_rc(*master, cluster, timeout);
+}
+
+arakoon_rc _arakoon_command_request(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonClusterNode **master, int *timeout, ArakoonCommand command, ...) {
+        va_list args;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_command_request);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(master);
+        ASSERT_NON_NULL_RC(timeout);
+
+        va_start(args, command);
+        rc = _arakoon_command_vrequest(cluster, options, master, timeout,
+                command, args);
+        va_end(args);
+
+        return rc;
+}
+
+arakoon_rc _arakoon_command_call(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonCommandResult *result, ArakoonCommand command, ...) {
+        va_list args;
+        ArakoonClusterNode *master = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_command_call);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(result);
+
+        memset(result, 0, sizeof(ArakoonCommandResult));
+
+        va_start(args, command);
+        rc = _arakoon_command_vrequest(cluster, options, &master, &timeout,
+                command, args);
+        va_end(args);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        return _arakoon_command_node_read_result(master,
+                _arakoon_command_get_descriptor(command)->result, &timeout,
+                result);
+}
@@ -0,0 +1,168 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ARAKOON_COMMAND_H__
+#define __ARAKOON_COMMAND_H__
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "arakoon.h"
+
+ARAKOON_BEGIN_DECLS
+
+/* Command table
+ *
+ * Every command is described by its code, the layout of its arguments and
+ * the type of its result. A single generic encoder and decoder, driven by
+ * this table, is used for all of them.
+ *
+ * The argument layout is a string with one character per field following
+ * the command code on the wire. Callers pass the values for every field,
+ * in order, using exactly these types:
+ *
+ *   d  allow_dirty flag, taken from the call options (takes no value)
+ *   b  boolean (arakoon_bool)
+ *   i  32-bit integer (int32_t)
+ *   s  string (size_t, const void *)
+ *   o  string option (size_t, const void *), NULL encodes None
+ *   l  string list (const ArakoonValueList *)
+ *   q  sequence (const ArakoonSequence *)
+ */
+#define ARAKOON_COMMANDS(X)                                                 \
+        X(HELLO,                    0x01, "ss",     STRING)                 \
+        X(WHO_MASTER,               0x02, "",       STRING_OPTION)          \
+        X(EXISTS,                   0x07, "ds",     BOOL)                   \
+        X(GET,                      0x08, "ds",     STRING)                 \
+        X(SET,                      0x09, "ss",     NONE)                   \
+        X(DELETE,                   0x0a, "s",      NONE)                   \
+        X(RANGE,                    0x0b, "dobobi", STRING_LIST)            \
+        X(PREFIX,                   0x0c, "dsi",    STRING_LIST)            \
+        X(TEST_AND_SET,             0x0d, "soo",    STRING_OPTION)          \
+        X(RANGE_ENTRIES,            0x0f, "dobobi", STRING_STRING_LIST)     \
+        X(SEQUENCE,                 0x10, "q",      NONE)                   \
+        X(MULTI_GET,                0x11, "dl",     STRING_LIST)            \
+        X(EXPECT_PROGRESS_POSSIBLE, 0x12, "",       BOOL)                   \
+        X(STATISTICS,               0x13, "",       STRING)                 \
+        X(COLLAPSE_TLOGS,           0x14, "i",      CUSTOM)                 \
+        X(USER_FUNCTION,            0x15, "so",     STRING_OPTION)          \
+        X(ASSERT,                   0x16, "dso",    NONE)                   \
+        X(GET_KEY_COUNT,            0x1a, "",       UINT64)                 \
+        X(CONFIRM,                  0x1c, "ss",     NONE)                   \
+        X(NURSERY_CONFIG,           0x20, "",       STRING)                 \
+        X(REV_RANGE_ENTRIES,        0x23, "dobobi", STRING_STRING_LIST)     \
+        X(SYNCED_SEQUENCE,          0x24, "q",      NONE)                   \
+        X(OPTIMIZE_DB,              0x25, "",       NONE)                   \
+        X(DEFRAG_DB,                0x26, "",       NONE)                   \
+        X(DELETE_PREFIX,            0x27, "s",      UINT32)                 \
+        X(VERSION,                  0x28, "",       CUSTOM)                 \
+        X(ASSERT_EXISTS,            0x29, "ds",     NONE)                   \
+        X(DROP_MASTER,              0x30, "",       NONE)                   \
+        X(MULTI_GET_OPTION,         0x31, "dl",     STRING_OPTION_LIST)     \
+        X(REPLACE,                  0x33, "so",     STRING_OPTION)
+
+typedef enum {
+#define X(name, code, arguments, result) ARAKOON_COMMAND_##name,
+        ARAKOON_COMMANDS(X)
+#undef X
+        ARAKOON_COMMAND_COUNT
+} ArakoonCommand;
+
+typedef enum {
+        ARAKOON_COMMAND_RESULT_NONE,
+        ARAKOON_COMMAND_RESULT_BOOL,
+        ARAKOON_COMMAND_RESULT_UINT32,
+        ARAKOON_COMMAND_RESULT_UINT64,
+        ARAKOON_COMMAND_RESULT_STRING,
+        ARAKOON_COMMAND_RESULT_STRING_OPTION,
+        ARAKOON_COMMAND_RESULT_STRING_LIST,
+        ARAKOON_COMMAND_RESULT_STRING_OPTION_LIST,
+        ARAKOON_COMMAND_RESULT_STRING_STRING_LIST,
+        /* Decoded by the caller */
+        ARAKOON_COMMAND_RESULT_CUSTOM
+} ArakoonCommandResultType;
+
+typedef struct {
+        const char *name;
+        char code;
+        const char *arguments;
+        ArakoonCommandResultType result;
+} ArakoonCommandDescriptor;
+
+/* Only the field matching the result type of the command is set. Strings
+ * are owned by the caller, a None option has data NULL. */
+typedef struct {
+        arakoon_bool bool_;
+        uint32_t uint32;
+        uint64_t uint64;
+        size_t size;
+        void *data;
+        ArakoonValueList *value_list;
+        ArakoonKeyValueList *key_value_list;
+} ArakoonCommandResult;
+
+const ArakoonCommandDescriptor * _arakoon_command_get_descriptor(
+    ArakoonCommand command) ARAKOON_GNUC_PURE;
+
+/* Sequences are encoded by arakoon.c, as a single string */
+size_t _arakoon_sequence_get_encoded_size(
+    const ArakoonSequence * const sequence) ARAKOON_GNUC_NONNULL;
+char * _arakoon_sequence_encode(const ArakoonSequence * const sequence,
+    char *c) ARAKOON_GNUC_NONNULL;
+
+/* Encode a request and write it to a node */
+arakoon_rc _arakoon_command_node_send(ArakoonClusterNode *node,
+    const ArakoonClientCallOptions * const options, int *timeout,
+    ArakoonCommand command, ...) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+arakoon_rc _arakoon_command_node_vsend(ArakoonClusterNode *node,
+    const ArakoonClientCallOptions * const options, int *timeout,
+    ArakoonCommand command, va_list args) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/* Read the return code of a response. The error message following a
+ * non-success code is logged, and stored as last error of cluster unless it's
+ * NULL. */
+arakoon_rc _arakoon_command_node_read_rc(ArakoonClusterNode *node,
+    ArakoonCluster *cluster, int *timeout) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+arakoon_rc _arakoon_command_node_read_result(ArakoonClusterNode *node,
+    ArakoonCommandResultType type, int *timeout,
+    ArakoonCommandResult *result) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/* Send a request to the master of a cluster and read the return code.
+ * On success, master and timeout are left for the caller to read the rest of
+ * the response. */
+arakoon_rc _arakoon_command_request(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonClusterNode **master, int *timeout, ArakoonCommand command, ...)
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/* Send a request to the master of a cluster and decode the complete
+ * response */
+arakoon_rc _arakoon_command_call(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonCommandResult *result, ArakoonCommand command, ...)
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+ARAKOON_END_DECLS
+
+#endif /* ifndef __ARAKOON_COMMAND_H__ */
@@ -0,0 +1,414 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-resolver.h"
+
+/* Loader for Arakoon cluster configuration files
+ *
+ * Only the settings relevant to clients are used:
+ *
+ *   [global]
+ *   cluster_id = arakoon
+ *   cluster = arakoon_0, arakoon_1
+ *
+ *   [arakoon_0]
+ *   ip = 192.168.0.1, 10.0.0.1
+ *   client_port = 4000
+ *   ...
+ */
+
+#define ARAKOON_CONFIG_GLOBAL "global"
+#define ARAKOON_CONFIG_SEPARATORS ", \t"
+
+typedef struct {
+        const char *section;
+        const char *key;
+        const char *value;
+} ArakoonConfigEntry;
+
+typedef struct {
+        char *data;
+
+        ArakoonConfigEntry *entries;
+        size_t entries_count;
+} ArakoonConfig;
+
+static void _arakoon_config_free(ArakoonConfig *config) {
+        arakoon_mem_free(config->entries);
+        arakoon_mem_free(config->data);
+}
+
+static char * _arakoon_config_strip(char *s) {
+        char *e = NULL;
+
+        while(isspace((unsigned char) *s)) {
+                s++;
+        }
+
+        e = s + strlen(s);
+        while(e > s && isspace((unsigned char) *(e - 1))) {
+                e--;
+        }
+        *e = 0;
+
+        return s;
+}
+
+static arakoon_rc _arakoon_config_read(const char * const path,
+    ArakoonConfig *config) {
+        FILE *f = NULL;
+        struct stat st;
+        size_t len = 0;
+
+        f = fopen(path, "r");
+        if(f == NULL) {
+                _arakoon_log_error("arakoon-config: unable to open %s: %s",
+                        path, strerror(errno));
+                return -errno;
+        }
+
+        if(fstat(fileno(f), &st) != 0) {
+                fclose(f);
+                return -errno;
+        }
+
+        len = st.st_size;
+
+        config->data = arakoon_mem_new(len + 1, char);
+        if(config->data == NULL) {
+                fclose(f);
+                return -ENOMEM;
+        }
+
+        if(fread(config->data, 1, len, f) != len) {
+                _arakoon_log_error("arakoon-config: unable to read %s",
+                        path);
+                fclose(f);
+                return -EIO;
+        }
+
+        config->data[len] = 0;
+
+        fclose(f);
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* Split the file into entries. All strings point into the file data. */
+static arakoon_rc _arakoon_config_parse(ArakoonConfig *config) {
+        char *line = NULL, *next = NULL, *eq = NULL, *p = NULL;
+        const char *section = NULL;
+        size_t lines = 1, lineno = 0;
+
+        for(p = config->data; *p != 0; p++) {
+                if(*p == '\n') {
+                        lines++;
+                }
+        }
+
+        config->entries = arakoon_mem_new(lines, ArakoonConfigEntry);
+        RETURN_ENOMEM_IF_NULL(config->entries);
+
+        config->entries_count = 0;
+
+        for(line = config->data; line != NULL; line = next) {
+                lineno++;
+
+                next = strchr(line, '\n');
+                if(next != NULL) {
+                        *next = 0;
+                        next++;
+                }
+
+                line = _arakoon_config_strip(line);
+
+                if(*line == 0 || *line == '#' || *line == ';') {
+                        continue;
+                }
+
+                if(*line == '[') {
+                        p = strchr(line, ']');
+                        if(p == NULL) {
+                                goto invalid;
+                        }
+
+                        *p = 0;
+                        section = _arakoon_config_strip(line + 1);
+
+                        continue;
+                }
+
+                eq = strchr(line, '=');
+                if(eq == NULL || section == NULL) {
+                        goto invalid;
+                }
+
+                *eq = 0;
+
+                config->entries[config->entries_count].section = section;
+                config->entries[config->entries_count].key =
+                        _arakoon_config_strip(line);
+                config->entries[config->entries_count].value =
+                        _arakoon_config_strip(eq + 1);
+                config->entries_count++;
+        }
+
+        return ARAKOON_RC_SUCCESS;
+
+invalid:
+        _arakoon_log_error("arakoon-config: parse error on line %zu",
+                lineno);
+
+        return -EINVAL;
+}
+
+static char * _arakoon_config_lookup(const ArakoonConfig *config,
+    const char * const section, const char * const key) {
+        size_t i = 0;
+
+        /* Later entries override earlier ones */
+        for(i = config->entries_count; i > 0; i--) {
+                if(strcmp(config->entries[i - 1].section, section) == 0 &&
+                    strcmp(config->entries[i - 1].key, key) == 0) {
+                        return (char *) config->entries[i - 1].value;
+                }
+        }
+
+        _arakoon_log_error("arakoon-config: no %s setting in section %s",
+                key, section);
+
+        return NULL;
+}
+
+/* Count the items in a comma-separated list */
+static size_t _arakoon_config_list_size(const char * const list) {
+        size_t n = 0;
+        const char *p = list;
+
+        while(*p != 0) {
+                p += strspn(p, ARAKOON_CONFIG_SEPARATORS);
+                if(*p == 0) {
+                        break;
+                }
+
+                n++;
+                p += strcspn(p, ARAKOON_CONFIG_SEPARATORS);
+        }
+
+        return n;
+}
+
+/* Take the next item from a comma-separated list, terminating it in place */
+static char * _arakoon_config_list_next(char **list) {
+        char *item = NULL;
+
+        item = *list + strspn(*list, ARAKOON_CONFIG_SEPARATORS);
+        if(*item == 0) {
+                return NULL;
+        }
+
+        *list = item + strcspn(item, ARAKOON_CONFIG_SEPARATORS);
+        if(**list != 0) {
+                **list = 0;
+                (*list)++;
+        }
+
+        return item;
+}
+
+arakoon_rc arakoon_cluster_new_from_config(const char * const path,
+    ArakoonCluster ** const cluster) {
+        ArakoonConfig config = {NULL, NULL, 0};
+        ArakoonResolverQuery *queries = NULL;
+        ArakoonClusterNode *node = NULL;
+        const char **names = NULL;
+        char *cluster_id = NULL, *nodes = NULL, *ips = NULL, *ip = NULL;
+        char *port = NULL, *name = NULL;
+        size_t *first = NULL;
+        size_t nodes_count = 0, queries_count = 0, i = 0, j = 0;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        FUNCTION_ENTER(arakoon_cluster_new_from_config);
+
+        ASSERT_NON_NULL_RC(path);
+        ASSERT_NON_NULL_RC(cluster);
+
+        *cluster = NULL;
+
+        rc = _arakoon_config_read(path, &config);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        rc = _arakoon_config_parse(&config);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        cluster_id = _arakoon_config_lookup(&config, ARAKOON_CONFIG_GLOBAL,
+                "cluster_id");
+        nodes = _arakoon_config_lookup(&config, ARAKOON_CONFIG_GLOBAL,
+                "cluster");
+        if(cluster_id == NULL || nodes == NULL) {
+                rc = -EINVAL;
+                goto out;
+        }
+
+        nodes_count = _arakoon_config_list_size(nodes);
+        if(nodes_count == 0) {
+                _arakoon_log_error("arakoon-config: no nodes defined");
+                rc = -EINVAL;
+                goto out;
+        }
+
+        names = arakoon_mem_new(nodes_count, const char *);
+        /* Index of the first query of every node, plus an end marker */
+        first = arakoon_mem_new(nodes_count + 1, size_t);
+        if(names == NULL || first == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
+
+        /* Collect node names, and count addresses */
+        for(i = 0; i < nodes_count; i++) {
+                names[i] = _arakoon_config_list_next(&nodes);
+
+                ips = _arakoon_config_lookup(&config, names[i], "ip");
+                if(ips == NULL ||
+                    _arakoon_config_lookup(&config, names[i],
+                        "client_port") == NULL) {
+                        rc = -EINVAL;
+                        goto out;
+                }
+
+                if(_arakoon_config_list_size(ips) == 0) {
+                        _arakoon_log_error(
+                                "arakoon-config: no addresses for node %s",
+                                names[i]);
+                        rc = -EINVAL;
+                        goto out;
+                }
+
+                first[i] = queries_count;
+                queries_count += _arakoon_config_list_size(ips);
+        }
+        first[nodes_count] = queries_count;
+
+        queries = arakoon_mem_new(queries_count, ArakoonResolverQuery);
+        if(queries == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
+
+        memset(queries, 0, queries_count * sizeof(ArakoonResolverQuery));
+
+        for(i = 0; i < nodes_count; i++) {
+                ips = _arakoon_config_lookup(&config, names[i], "ip");
+                port = _arakoon_config_lookup(&config, names[i],
+                        "client_port");
+
+                for(j = first[i]; j < first[i + 1]; j++) {
+                        ip = _arakoon_config_list_next(&ips);
+
+                        queries[j].host = ip;
+                        queries[j].service = port;
+                }
+        }
+
+        /* All nodes are looked up at once, instead of one after the other
+         * as arakoon_cluster_node_add_address_tcp would */
+        rc = _arakoon_resolver_resolve(NULL, queries,
+                queries_count);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        *cluster = arakoon_cluster_new(ARAKOON_PROTOCOL_VERSION_1,
+                cluster_id);
+        if(*cluster == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
+
+        /* Nodes are prepended by arakoon_cluster_add_node. Add them in
+         * reverse, so they're tried in the order of the configuration. */
+        for(i = nodes_count; i > 0; i--) {
+                name = (char *) names[i - 1];
+
+                node = arakoon_cluster_node_new(name);
+                if(node == NULL) {
+                        rc = -ENOMEM;
+                        goto out;
+                }
+
+                for(j = first[i - 1]; j < first[i]; j++) {
+                        rc = arakoon_cluster_node_add_address(node,
+                                queries[j].result);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                arakoon_cluster_node_free(node);
+                                goto out;
+                        }
+
+                        queries[j].result = NULL;
+                }
+
+                rc = arakoon_cluster_add_node(*cluster, node);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        arakoon_cluster_node_free(node);
+                        goto out;
+                }
+        }
+
+        rc = ARAKOON_RC_SUCCESS;
+
+out:
+        if(queries != NULL) {
+                for(i = 0; i < queries_count; i++) {
+                        if(queries[i].result != NULL) {
+                                freeaddrinfo(queries[i].result);
+                        }
+                }
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc) && *cluster != NULL) {
+                arakoon_cluster_free(*cluster);
+                *cluster = NULL;
+        }
+
+        arakoon_mem_free(queries);
+        arakoon_mem_free(first);
+        arakoon_mem_free(names);
+        _arakoon_config_free(&config);
+
+        return rc;
+}
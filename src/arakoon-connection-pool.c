@@ -0,0 +1,459 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-cluster.h"
+#include "arakoon-networking.h"
+
+typedef struct {
+        ArakoonCluster *connection;
+        uint64_t idle_since;
+} ArakoonConnectionPoolEntry;
+
+struct ArakoonConnectionPool {
+        const ArakoonCluster *cluster;
+        char *master;
+
+        unsigned int max_connections;
+        int idle_timeout;
+
+        pthread_mutex_t lock;
+        pthread_cond_t available;
+
+        /* Idle connections, ordered by the time they were returned. New
+         * checkouts take the most recently used one, so older connections
+         * age out and get reaped. */
+        ArakoonConnectionPoolEntry *idle;
+        unsigned int idle_count;
+
+        /* Connections checked out, or being set up on behalf of a checkout */
+        unsigned int in_use;
+
+        ArakoonConnectionPoolStats stats;
+};
+
+ArakoonConnectionPool * arakoon_connection_pool_new(
+    const ArakoonCluster * const cluster, unsigned int max_connections,
+    int idle_timeout) {
+        ArakoonConnectionPool *pool = NULL;
+        const char *master = NULL;
+        size_t len = 0;
+
+        FUNCTION_ENTER(arakoon_connection_pool_new);
+
+        ASSERT_NON_NULL(cluster);
+
+        if(max_connections == 0) {
+                _arakoon_log_error("Connection pool needs at least 1 connection");
+
+                errno = EINVAL;
+                return NULL;
+        }
+
+        pool = arakoon_mem_new(1, ArakoonConnectionPool);
+        RETURN_NULL_IF_NULL(pool);
+
+        memset(pool, 0, sizeof(ArakoonConnectionPool));
+
+        pool->idle = arakoon_mem_new(max_connections,
+                ArakoonConnectionPoolEntry);
+        if(pool->idle == NULL) {
+                goto nomem;
+        }
+
+        master = _arakoon_cluster_get_master_name(cluster);
+        if(master != NULL) {
+                len = strlen(master) + 1;
+                pool->master = arakoon_mem_new(len, char);
+                if(pool->master == NULL) {
+                        goto nomem;
+                }
+
+                strncpy(pool->master, master, len);
+        }
+
+        pool->cluster = cluster;
+        pool->max_connections = max_connections;
+        pool->idle_timeout = idle_timeout;
+        pool->idle_count = 0;
+        pool->in_use = 0;
+
+        pthread_mutex_init(&pool->lock, NULL);
+
+        /* Checkout timeouts are relative, don't let wall-clock jumps
+         * influence them */
+        _arakoon_cond_init_monotonic(&pool->available);
+
+        return pool;
+
+nomem:
+        arakoon_mem_free(pool->idle);
+        arakoon_mem_free(pool->master);
+        arakoon_mem_free(pool);
+
+        return NULL;
+}
+
+void arakoon_connection_pool_free(ArakoonConnectionPool *pool) {
+        unsigned int i = 0;
+
+        FUNCTION_ENTER(arakoon_connection_pool_free);
+
+        RETURN_IF_NULL(pool);
+
+        if(pool->in_use != 0) {
+                _arakoon_log_warning(
+                        "arakoon-connection-pool: freeing a pool with %u "
+                        "connections still checked out", pool->in_use);
+        }
+
+        for(i = 0; i < pool->idle_count; i++) {
+                arakoon_cluster_free(pool->idle[i].connection);
+        }
+
+        pthread_cond_destroy(&pool->available);
+        pthread_mutex_destroy(&pool->lock);
+
+        arakoon_mem_free(pool->idle);
+        arakoon_mem_free(pool->master);
+        arakoon_mem_free(pool);
+}
+
+/* Take the oldest idle connection out of the pool if it wasn't used during
+ * the idle timeout. Must be called with the pool lock held, the caller should
+ * close the returned connection after releasing the lock. */
+static ArakoonCluster * _arakoon_connection_pool_take_expired(
+    ArakoonConnectionPool * const pool, uint64_t now) {
+        ArakoonCluster *conn = NULL;
+        unsigned int i = 0;
+
+        if(pool->idle_timeout < 0 || pool->idle_count == 0) {
+                return NULL;
+        }
+
+        /* The array is sorted by idle_since, oldest first */
+        if(now - pool->idle[0].idle_since <
+            (uint64_t) pool->idle_timeout * US_PER_MS) {
+                return NULL;
+        }
+
+        conn = pool->idle[0].connection;
+
+        for(i = 1; i < pool->idle_count; i++) {
+                pool->idle[i - 1] = pool->idle[i];
+        }
+
+        pool->idle_count--;
+        pool->stats.reaped++;
+
+        return conn;
+}
+
+static arakoon_bool _arakoon_connection_pool_usable(
+    const ArakoonCluster * const connection) {
+        ArakoonClusterNode *master = NULL;
+
+        master = _arakoon_cluster_get_master(connection, NULL);
+        if(master == NULL) {
+                return ARAKOON_BOOL_FALSE;
+        }
+
+        /* Anything readable on an idle connection (EOF, a reset, stray
+         * data,...) means it's no longer in sync with the server */
+        return _arakoon_networking_is_idle(
+                _arakoon_cluster_node_get_fd(master));
+}
+
+arakoon_rc arakoon_connection_pool_reap(ArakoonConnectionPool * const pool) {
+        ArakoonCluster *conn = NULL;
+
+        FUNCTION_ENTER(arakoon_connection_pool_reap);
+
+        ASSERT_NON_NULL_RC(pool);
+
+        do {
+                pthread_mutex_lock(&pool->lock);
+                conn = _arakoon_connection_pool_take_expired(pool,
+                        _arakoon_networking_monotonic_usec());
+                pthread_mutex_unlock(&pool->lock);
+
+                arakoon_cluster_free(conn);
+        } while(conn != NULL);
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_connection_pool_connect(
+    ArakoonConnectionPool * const pool, int *timeout,
+    ArakoonCluster ** const connection) {
+        ArakoonCluster *conn = NULL;
+        arakoon_rc rc = ARAKOON_RC_CLIENT_MASTER_NOT_FOUND;
+        char *master = NULL;
+        const char *name = NULL;
+        size_t len = 0;
+
+        conn = _arakoon_cluster_clone(pool->cluster);
+        RETURN_ENOMEM_IF_NULL(conn);
+
+        /* Try the last known master first, this saves a round-trip to every
+         * other node in the common case */
+        pthread_mutex_lock(&pool->lock);
+        if(pool->master != NULL) {
+                len = strlen(pool->master) + 1;
+                master = arakoon_mem_new(len, char);
+                if(master != NULL) {
+                        strncpy(master, pool->master, len);
+                }
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if(master != NULL) {
+                rc = _arakoon_cluster_connect_master_by_name(conn, master,
+                        timeout);
+                arakoon_mem_free(master);
+                master = NULL;
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc) && rc != ARAKOON_RC_CLIENT_TIMEOUT) {
+                _arakoon_log_debug(
+                        "arakoon-connection-pool: known master unusable, "
+                        "looking up master node");
+                rc = _arakoon_cluster_connect_master(conn, timeout);
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                arakoon_cluster_free(conn);
+                return rc;
+        }
+
+        /* A pooled connection only talks to the master */
+        _arakoon_cluster_disconnect_non_master(conn);
+
+        name = _arakoon_cluster_get_master_name(conn);
+        len = strlen(name) + 1;
+        master = arakoon_mem_new(len, char);
+        if(master != NULL) {
+                strncpy(master, name, len);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if(master != NULL) {
+                arakoon_mem_free(pool->master);
+                pool->master = master;
+        }
+        pool->stats.connects++;
+        pthread_mutex_unlock(&pool->lock);
+
+        *connection = conn;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_rc arakoon_connection_pool_checkout(ArakoonConnectionPool * const pool,
+    const ArakoonClientCallOptions * const options,
+    ArakoonCluster ** const connection) {
+        ArakoonCluster *conn = NULL, *expired = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT, ret = 0;
+        uint64_t start = 0, waited = 0;
+        struct timespec deadline = {0, 0};
+        arakoon_bool create = ARAKOON_BOOL_FALSE;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        FUNCTION_ENTER(arakoon_connection_pool_checkout);
+
+        ASSERT_NON_NULL_RC(pool);
+        ASSERT_NON_NULL_RC(connection);
+
+        *connection = NULL;
+
+        timeout = options != NULL ?
+                arakoon_client_call_options_get_timeout(options) :
+                ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+
+        start = _arakoon_networking_monotonic_usec();
+
+        pthread_mutex_lock(&pool->lock);
+
+        expired = _arakoon_connection_pool_take_expired(pool, start);
+
+        while(conn == NULL && create == ARAKOON_BOOL_FALSE) {
+                if(pool->idle_count > 0) {
+                        pool->idle_count--;
+                        conn = pool->idle[pool->idle_count].connection;
+
+                        if(!_arakoon_connection_pool_usable(conn)) {
+                                pool->stats.evictions++;
+
+                                pthread_mutex_unlock(&pool->lock);
+                                _arakoon_log_debug("arakoon-connection-pool: "
+                                        "evicting broken idle connection");
+                                arakoon_cluster_free(conn);
+                                conn = NULL;
+                                pthread_mutex_lock(&pool->lock);
+
+                                continue;
+                        }
+
+                        pool->in_use++;
+                }
+                else if(pool->in_use < pool->max_connections) {
+                        /* Reserve a slot, connect outside of the lock */
+                        pool->in_use++;
+                        create = ARAKOON_BOOL_TRUE;
+                }
+                else if(timeout == ARAKOON_CLIENT_CALL_OPTIONS_INFINITE_TIMEOUT) {
+                        pthread_cond_wait(&pool->available, &pool->lock);
+                }
+                else {
+                        if(deadline.tv_sec == 0 && deadline.tv_nsec == 0) {
+                                _arakoon_deadline_after(&deadline,
+                                        (uint64_t) timeout * US_PER_MS);
+                        }
+
+                        ret = pthread_cond_timedwait(&pool->available,
+                                &pool->lock, &deadline);
+                        if(ret == ETIMEDOUT) {
+                                pool->stats.timeouts++;
+                                rc = ARAKOON_RC_CLIENT_TIMEOUT;
+                                break;
+                        }
+                }
+        }
+
+        waited = _arakoon_networking_monotonic_usec() - start;
+
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                pool->stats.wait_total_usec += waited;
+                if(waited > pool->stats.wait_max_usec) {
+                        pool->stats.wait_max_usec = waited;
+                }
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+
+        arakoon_cluster_free(expired);
+
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        if(create) {
+                if(timeout != ARAKOON_CLIENT_CALL_OPTIONS_INFINITE_TIMEOUT) {
+                        timeout -= (int) (waited / US_PER_MS);
+                        if(timeout <= 0) {
+                                timeout = 0;
+                        }
+                }
+
+                rc = _arakoon_connection_pool_connect(pool, &timeout, &conn);
+
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        pthread_mutex_lock(&pool->lock);
+                        pool->in_use--;
+                        pthread_cond_signal(&pool->available);
+                        pthread_mutex_unlock(&pool->lock);
+
+                        return rc;
+                }
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->stats.checkouts++;
+        pthread_mutex_unlock(&pool->lock);
+
+        *connection = conn;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+void arakoon_connection_pool_return(ArakoonConnectionPool * const pool,
+    ArakoonCluster * const connection) {
+        ArakoonCluster *expired = NULL;
+        arakoon_bool evict = ARAKOON_BOOL_FALSE;
+        uint64_t now = 0;
+
+        FUNCTION_ENTER(arakoon_connection_pool_return);
+
+        RETURN_IF_NULL(pool);
+        RETURN_IF_NULL(connection);
+
+        /* Any network error during a call disconnects the master node
+         * (see READ_BYTES and WRITE_BYTES), such connection can't be reused */
+        evict = (_arakoon_cluster_get_master(connection, NULL) == NULL);
+
+        _arakoon_cluster_reset_last_error(connection);
+
+        now = _arakoon_networking_monotonic_usec();
+
+        pthread_mutex_lock(&pool->lock);
+
+        pool->in_use--;
+
+        if(evict) {
+                pool->stats.evictions++;
+        }
+        else {
+                pool->idle[pool->idle_count].connection = connection;
+                pool->idle[pool->idle_count].idle_since = now;
+                pool->idle_count++;
+        }
+
+        expired = _arakoon_connection_pool_take_expired(pool, now);
+
+        pthread_cond_signal(&pool->available);
+
+        pthread_mutex_unlock(&pool->lock);
+
+        if(evict) {
+                _arakoon_log_debug(
+                        "arakoon-connection-pool: evicting broken connection");
+                arakoon_cluster_free(connection);
+        }
+
+        arakoon_cluster_free(expired);
+}
+
+arakoon_rc arakoon_connection_pool_get_stats(
+    ArakoonConnectionPool * const pool,
+    ArakoonConnectionPoolStats * const stats) {
+        FUNCTION_ENTER(arakoon_connection_pool_get_stats);
+
+        ASSERT_NON_NULL_RC(pool);
+        ASSERT_NON_NULL_RC(stats);
+
+        pthread_mutex_lock(&pool->lock);
+
+        memcpy(stats, &pool->stats, sizeof(ArakoonConnectionPoolStats));
+        stats->idle = pool->idle_count;
+        stats->in_use = pool->in_use;
+
+        pthread_mutex_unlock(&pool->lock);
+
+        return ARAKOON_RC_SUCCESS;
+}
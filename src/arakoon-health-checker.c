@@ -0,0 +1,334 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-cluster.h"
+#include "arakoon-cluster-node.h"
+#include "arakoon-client-call-options.h"
+#include "arakoon-command.h"
+#include "arakoon-networking.h"
+
+/* Weight of a new sample in the smoothed round-trip time, as in TCP */
+#define ARAKOON_HEALTH_CHECKER_SRTT_SHIFT (3)
+
+typedef struct {
+        ArakoonClusterNode *node;
+        ArakoonNodeHealth health;
+} ArakoonHealthCheckerEntry;
+
+struct ArakoonHealthChecker {
+        /* Private connections to all nodes */
+        ArakoonCluster *probe;
+
+        /* One entry per node, health is protected by lock */
+        ArakoonHealthCheckerEntry *entries;
+        size_t count;
+
+        pthread_mutex_t lock;
+
+        ArakoonWorker worker;
+};
+
+static arakoon_rc _arakoon_health_checker_step(void *data,
+    const ArakoonClientCallOptions * const options) {
+        return arakoon_health_checker_step((ArakoonHealthChecker *) data,
+                options);
+}
+
+ArakoonHealthChecker * arakoon_health_checker_new(
+    const ArakoonCluster * const cluster) {
+        ArakoonHealthChecker *checker = NULL;
+        ArakoonClusterNode *node = NULL;
+        size_t i = 0;
+
+        FUNCTION_ENTER(arakoon_health_checker_new);
+
+        ASSERT_NON_NULL(cluster);
+
+        checker = arakoon_mem_new(1, ArakoonHealthChecker);
+        RETURN_NULL_IF_NULL(checker);
+
+        memset(checker, 0, sizeof(ArakoonHealthChecker));
+
+        checker->probe = _arakoon_cluster_clone(cluster);
+        if(checker->probe == NULL) {
+                arakoon_mem_free(checker);
+                return NULL;
+        }
+
+        for(node = _arakoon_cluster_get_first_node(checker->probe);
+            node != NULL; node = _arakoon_cluster_node_get_next(node)) {
+                checker->count++;
+        }
+
+        if(checker->count > 0) {
+                checker->entries = arakoon_mem_new(checker->count,
+                        ArakoonHealthCheckerEntry);
+                if(checker->entries == NULL) {
+                        arakoon_cluster_free(checker->probe);
+                        arakoon_mem_free(checker);
+                        return NULL;
+                }
+
+                memset(checker->entries, 0,
+                        checker->count * sizeof(ArakoonHealthCheckerEntry));
+        }
+
+        for(node = _arakoon_cluster_get_first_node(checker->probe), i = 0;
+            node != NULL; node = _arakoon_cluster_node_get_next(node), i++) {
+                checker->entries[i].node = node;
+                checker->entries[i].health.name =
+                        _arakoon_cluster_node_get_name(node);
+                checker->entries[i].health.last_rc = ARAKOON_RC_SUCCESS;
+                checker->entries[i].health.progress_possible =
+                        ARAKOON_BOOL_FALSE;
+        }
+
+        pthread_mutex_init(&checker->lock, NULL);
+
+        _arakoon_worker_init(&checker->worker, "arakoon-health-checker",
+                _arakoon_health_checker_step, checker);
+
+        return checker;
+}
+
+void arakoon_health_checker_free(ArakoonHealthChecker *checker) {
+        FUNCTION_ENTER(arakoon_health_checker_free);
+
+        RETURN_IF_NULL(checker);
+
+        _arakoon_worker_destroy(&checker->worker);
+
+        pthread_mutex_destroy(&checker->lock);
+
+        if(checker->entries != NULL) {
+                arakoon_mem_free(checker->entries);
+        }
+        arakoon_cluster_free(checker->probe);
+        arakoon_mem_free(checker);
+}
+
+/* Send a single ping, and record its outcome */
+static arakoon_rc _arakoon_health_checker_ping_entry(
+    ArakoonHealthChecker * const checker,
+    ArakoonHealthCheckerEntry * const entry, int timeout,
+    uint64_t * const rtt_usec) {
+        ArakoonNodeHealth *health = &entry->health;
+        ArakoonCommandResult result;
+        uint64_t start = 0, rtt = 0;
+        arakoon_rc rc = 0;
+
+        memset(&result, 0, sizeof(ArakoonCommandResult));
+
+        if(_arakoon_cluster_node_get_fd(entry->node) < 0) {
+                rc = _arakoon_cluster_node_connect(entry->node, &timeout);
+        }
+
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                start = _arakoon_networking_monotonic_usec();
+
+                rc = _arakoon_command_node_send(entry->node, NULL, &timeout,
+                        ARAKOON_COMMAND_EXPECT_PROGRESS_POSSIBLE);
+        }
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = _arakoon_command_node_read_rc(entry->node, NULL,
+                        &timeout);
+        }
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = _arakoon_command_node_read_result(entry->node,
+                        ARAKOON_COMMAND_RESULT_BOOL, &timeout, &result);
+        }
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rtt = _arakoon_networking_monotonic_usec() - start;
+        }
+
+        pthread_mutex_lock(&checker->lock);
+
+        health->pings++;
+        health->last_rc = rc;
+
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                health->failures = 0;
+                health->progress_possible = result.bool_;
+                health->rtt_usec = rtt;
+                if(health->srtt_usec == 0) {
+                        health->srtt_usec = rtt;
+                }
+                else {
+                        health->srtt_usec = health->srtt_usec -
+                                (health->srtt_usec >>
+                                 ARAKOON_HEALTH_CHECKER_SRTT_SHIFT) +
+                                (rtt >> ARAKOON_HEALTH_CHECKER_SRTT_SHIFT);
+                }
+        }
+        else {
+                health->failures++;
+        }
+
+        pthread_mutex_unlock(&checker->lock);
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_log_debug(
+                        "arakoon-health-checker: ping of node %s failed: %s",
+                        health->name, arakoon_strerror(rc));
+        }
+
+        if(rtt_usec != NULL) {
+                *rtt_usec = rtt;
+        }
+
+        return rc;
+}
+
+arakoon_rc arakoon_health_checker_ping(ArakoonHealthChecker * const checker,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name, uint64_t * const rtt_usec) {
+        size_t i = 0;
+
+        FUNCTION_ENTER(arakoon_health_checker_ping);
+
+        ASSERT_NON_NULL_RC(checker);
+        ASSERT_NON_NULL_RC(node_name);
+
+        READ_OPTIONS;
+
+        for(i = 0; i < checker->count; i++) {
+                if(strcmp(checker->entries[i].health.name, node_name) == 0) {
+                        return _arakoon_health_checker_ping_entry(checker,
+                                &checker->entries[i],
+                                arakoon_client_call_options_get_timeout(
+                                        options_),
+                                rtt_usec);
+                }
+        }
+
+        return ARAKOON_RC_CLIENT_UNKNOWN_NODE;
+}
+
+arakoon_rc arakoon_health_checker_step(ArakoonHealthChecker * const checker,
+    const ArakoonClientCallOptions * const options) {
+        size_t i = 0;
+
+        FUNCTION_ENTER(arakoon_health_checker_step);
+
+        ASSERT_NON_NULL_RC(checker);
+
+        READ_OPTIONS;
+
+        /* Failures are recorded in the node health */
+        for(i = 0; i < checker->count; i++) {
+                _arakoon_health_checker_ping_entry(checker,
+                        &checker->entries[i],
+                        arakoon_client_call_options_get_timeout(options_),
+                        NULL);
+        }
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* Lower is better, see arakoon_health_checker_get_health */
+static int _arakoon_node_health_class(const ArakoonNodeHealth * const health) {
+        if(health->pings == 0) {
+                return 2;
+        }
+        if(!ARAKOON_RC_IS_SUCCESS(health->last_rc)) {
+                return 3;
+        }
+
+        return health->progress_possible ? 0 : 1;
+}
+
+static arakoon_bool _arakoon_node_health_is_better(
+    const ArakoonNodeHealth * const a, const ArakoonNodeHealth * const b) {
+        int ca = _arakoon_node_health_class(a);
+        int cb = _arakoon_node_health_class(b);
+
+        if(ca != cb) {
+                return ca < cb;
+        }
+        if(a->failures != b->failures) {
+                return a->failures < b->failures;
+        }
+
+        return a->srtt_usec < b->srtt_usec;
+}
+
+size_t arakoon_health_checker_get_health(
+    ArakoonHealthChecker * const checker,
+    ArakoonNodeHealth * const health, size_t count) {
+        size_t i = 0, j = 0, filled = 0;
+        const ArakoonNodeHealth *entry = NULL;
+
+        FUNCTION_ENTER(arakoon_health_checker_get_health);
+
+        if(health == NULL) {
+                count = 0;
+        }
+
+        pthread_mutex_lock(&checker->lock);
+
+        /* Insertion sort, keeping only the best 'count' nodes. Nodes which
+         * are equally healthy keep the order of the cluster. */
+        for(i = 0; i < checker->count; i++) {
+                entry = &checker->entries[i].health;
+
+                j = filled;
+                while(j > 0 && _arakoon_node_health_is_better(entry,
+                    &health[j - 1])) {
+                        j--;
+                }
+
+                if(j >= count) {
+                        continue;
+                }
+
+                if(filled == count) {
+                        filled--;
+                }
+
+                memmove(&health[j + 1], &health[j],
+                        (filled - j) * sizeof(ArakoonNodeHealth));
+                health[j] = *entry;
+                filled++;
+        }
+
+        pthread_mutex_unlock(&checker->lock);
+
+        return checker->count;
+}
+
+arakoon_rc arakoon_health_checker_start(ArakoonHealthChecker * const checker,
+    int interval) {
+        FUNCTION_ENTER(arakoon_health_checker_start);
+
+        ASSERT_NON_NULL_RC(checker);
+
+        return _arakoon_worker_start(&checker->worker, interval);
+}
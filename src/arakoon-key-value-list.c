@@ -28,83 +28,133 @@
 #include "arakoon-utils.h"
 #include "arakoon-assert.h"
 
-typedef struct ArakoonKeyValueListItem ArakoonKeyValueListItem;
-struct ArakoonKeyValueListItem {
-        ArakoonKeyValueListItem *next;
-
+/* Like value lists, all keys and values share a single slab */
+typedef struct {
+        size_t key_offset;
         size_t key_size;
-        void * key;
+        size_t value_offset;
         size_t value_size;
-        void * value;
-};
+} ArakoonKeyValueListEntry;
 
 struct ArakoonKeyValueList {
-        ssize_t size;
-        ArakoonKeyValueListItem *first;
+        size_t size;
+        ArakoonKeyValueListEntry *entries;
+        ArakoonSlab slab;
 };
 
 struct ArakoonKeyValueListIter {
         const ArakoonKeyValueList *list;
-        ArakoonKeyValueListItem *current;
+        size_t current;
 };
 
 ArakoonKeyValueList * _arakoon_key_value_list_new(void) {
         ArakoonKeyValueList *list = NULL;
+        const ArakoonSlab slab = ARAKOON_SLAB_INIT;
 
         list = arakoon_mem_new(1, ArakoonKeyValueList);
         RETURN_NULL_IF_NULL(list);
 
         list->size = 0;
-        list->first = NULL;
+        list->entries = NULL;
+        list->slab = slab;
 
         return list;
 }
 
-arakoon_rc _arakoon_key_value_list_prepend(ArakoonKeyValueList *list,
-    const size_t key_size, const void * const key,
-    const size_t value_size, const void * const value) {
-        ArakoonKeyValueListItem *item = NULL;
+arakoon_rc _arakoon_key_value_list_resize(ArakoonKeyValueList *list,
+    size_t size) {
+        ArakoonKeyValueListEntry *entries = NULL;
 
-        item = arakoon_mem_new(1, ArakoonKeyValueListItem);
-        RETURN_ENOMEM_IF_NULL(item);
+        FUNCTION_ENTER(_arakoon_key_value_list_resize);
 
-        if(key_size == 0) {
-                item->key = ARAKOON_ZERO_LENGTH_DATA_PTR;
+        if(size == 0) {
+                return ARAKOON_RC_SUCCESS;
         }
-        else {
-                item->key = arakoon_mem_malloc(key_size);
-                if(item->key == NULL) {
-                        arakoon_mem_free(item);
-                        return -ENOMEM;
-                }
+
+        entries = arakoon_mem_new(size, ArakoonKeyValueListEntry);
+        RETURN_ENOMEM_IF_NULL(entries);
+
+        memset(entries, 0, size * sizeof(ArakoonKeyValueListEntry));
+
+        if(list->entries != NULL) {
+                memcpy(entries, list->entries,
+                        (list->size < size ? list->size : size)
+                                * sizeof(ArakoonKeyValueListEntry));
+                arakoon_mem_free(list->entries);
         }
 
-        if(value_size == 0) {
-                item->value = ARAKOON_ZERO_LENGTH_DATA_PTR;
+        list->entries = entries;
+        list->size = size;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static void * _arakoon_key_value_list_claim(ArakoonKeyValueList *list,
+    size_t size, size_t *offset) {
+        ssize_t offset_ = 0;
+
+        *offset = 0;
+
+        if(size == 0) {
+                return ARAKOON_ZERO_LENGTH_DATA_PTR;
         }
-        else {
-                item->value = arakoon_mem_malloc(value_size);
-                if(item->value == NULL) {
-                        arakoon_mem_free(item->key);
-                        arakoon_mem_free(item);
-                        return -ENOMEM;
-                }
+
+        offset_ = _arakoon_slab_claim(&list->slab, size);
+        if(offset_ < 0) {
+                return NULL;
         }
 
-        item->next = list->first;
-        item->key_size = key_size;
-        if(key_size != 0) {
-                memcpy(item->key, key, key_size);
+        *offset = offset_;
+
+        return ARAKOON_SLAB_AT(&list->slab, offset_);
+}
+
+void * _arakoon_key_value_list_set_key(ArakoonKeyValueList *list,
+    size_t index, size_t key_size) {
+        ArakoonKeyValueListEntry *entry = NULL;
+        void *data = NULL;
+
+        FUNCTION_ENTER(_arakoon_key_value_list_set_key);
+
+        ASSERT_NON_NULL(list);
+
+        if(index >= list->size) {
+                _arakoon_log_fatal(
+                        "arakoon-key-value-list: index out of range");
+                abort();
         }
-        item->value_size = value_size;
-        if(value_size != 0) {
-                memcpy(item->value, value, value_size);
+
+        entry = &list->entries[index];
+
+        data = _arakoon_key_value_list_claim(list, key_size,
+                &entry->key_offset);
+        entry->key_size = (data == NULL ? 0 : key_size);
+
+        return data;
+}
+
+void * _arakoon_key_value_list_set_value(ArakoonKeyValueList *list,
+    size_t index, size_t value_size) {
+        ArakoonKeyValueListEntry *entry = NULL;
+        void *data = NULL;
+
+        FUNCTION_ENTER(_arakoon_key_value_list_set_value);
+
+        ASSERT_NON_NULL(list);
+
+        if(index >= list->size) {
+                _arakoon_log_fatal(
+                        "arakoon-key-value-list: index out of range");
+                abort();
         }
 
-        list->first = item;
-        list->size = list->size + 1;
+        entry = &list->entries[index];
 
-        return ARAKOON_RC_SUCCESS;
+        data = _arakoon_key_value_list_claim(list, value_size,
+                &entry->value_offset);
+        entry->value_size = (data == NULL ? 0 : value_size);
+
+        return data;
 }
 
 ssize_t arakoon_key_value_list_size(const ArakoonKeyValueList * const list) {
@@ -115,37 +165,129 @@ ssize_t arakoon_key_value_list_size(const ArakoonKeyValueList * const list) {
         return list->size;
 }
 
-static void arakoon_key_value_list_item_free(
-    ArakoonKeyValueListItem * const item) {
-        FUNCTION_ENTER(arakoon_key_value_list_item_free);
+static const void * _arakoon_key_value_list_key_at(
+    const ArakoonKeyValueList * const list, size_t index,
+    size_t * const key_size) {
+        const ArakoonKeyValueListEntry *entry = &list->entries[index];
+
+        *key_size = entry->key_size;
+
+        return (entry->key_size == 0 ?
+                ARAKOON_ZERO_LENGTH_DATA_PTR :
+                ARAKOON_SLAB_AT(&list->slab, entry->key_offset));
+}
 
-        RETURN_IF_NULL(item);
+/* Bytewise comparison, as used by the server to order keys: a key which is
+ * a prefix of another one sorts first */
+static int _arakoon_key_value_list_compare(size_t l0, const void * const k0,
+    size_t l1, const void * const k1) {
+        int r = 0;
 
-        arakoon_mem_maybe_free(item->key_size, item->key);
-        item->key_size = 0;
-        arakoon_mem_maybe_free(item->value_size, item->value);
-        item->value_size = 0;
+        if(l0 != 0 && l1 != 0) {
+                r = memcmp(k0, k1, l0 < l1 ? l0 : l1);
+        }
 
-        arakoon_mem_free(item);
+        if(r != 0) {
+                return r;
+        }
+
+        return (l0 < l1 ? -1 : (l0 > l1 ? 1 : 0));
 }
 
-void arakoon_key_value_list_free(ArakoonKeyValueList * const list) {
-        ArakoonKeyValueListItem *item = NULL, *olditem = NULL;
+arakoon_rc arakoon_key_value_list_get(const ArakoonKeyValueList * const list,
+    const size_t index, size_t * const key_size, const void ** const key,
+    size_t * const value_size, const void ** const value) {
+        const ArakoonKeyValueListEntry *entry = NULL;
 
-        FUNCTION_ENTER(arakoon_key_value_list_free);
+        FUNCTION_ENTER(arakoon_key_value_list_get);
 
-        RETURN_IF_NULL(list);
+        ASSERT_NON_NULL_RC(list);
+        ASSERT_NON_NULL_RC(key_size);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(value_size);
+        ASSERT_NON_NULL_RC(value);
 
-        list->size = 0;
-        item = list->first;
-        list->first = NULL;
+        if(index >= list->size) {
+                *key_size = 0;
+                *key = NULL;
+                *value_size = 0;
+                *value = NULL;
+
+                return -ERANGE;
+        }
+
+        entry = &list->entries[index];
+
+        *key = _arakoon_key_value_list_key_at(list, index, key_size);
+        *value_size = entry->value_size;
+        *value = (entry->value_size == 0 ?
+                ARAKOON_ZERO_LENGTH_DATA_PTR :
+                ARAKOON_SLAB_AT(&list->slab, entry->value_offset));
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_rc arakoon_key_value_list_find(const ArakoonKeyValueList * const list,
+    const size_t key_size, const void * const key, size_t * const index) {
+        size_t lo = 0, hi = 0, mid = 0;
+        size_t l0 = 0, l1 = 0;
+        const void *k0 = NULL, *k1 = NULL;
+        int direction = 1, r = 0;
+
+        FUNCTION_ENTER(arakoon_key_value_list_find);
+
+        ASSERT_NON_NULL_RC(list);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(index);
 
-        while(item != NULL) {
-                olditem = item;
-                item = olditem->next;
+        if(list->size == 0) {
+                return ARAKOON_RC_NOT_FOUND;
+        }
+
+        /* rev_range_entries yields keys in descending order */
+        k0 = _arakoon_key_value_list_key_at(list, 0, &l0);
+        k1 = _arakoon_key_value_list_key_at(list, list->size - 1, &l1);
+        if(_arakoon_key_value_list_compare(l0, k0, l1, k1) > 0) {
+                direction = -1;
+        }
+
+        lo = 0;
+        hi = list->size;
+
+        while(lo < hi) {
+                mid = lo + (hi - lo) / 2;
+
+                k0 = _arakoon_key_value_list_key_at(list, mid, &l0);
+                r = direction *
+                        _arakoon_key_value_list_compare(l0, k0, key_size, key);
+
+                if(r == 0) {
+                        *index = mid;
+                        return ARAKOON_RC_SUCCESS;
+                }
+                else if(r < 0) {
+                        lo = mid + 1;
+                }
+                else {
+                        hi = mid;
+                }
+        }
 
-                arakoon_key_value_list_item_free(olditem);
+        return ARAKOON_RC_NOT_FOUND;
+}
+
+void arakoon_key_value_list_free(ArakoonKeyValueList * const list) {
+        FUNCTION_ENTER(arakoon_key_value_list_free);
+
+        RETURN_IF_NULL(list);
+
+        if(list->entries != NULL) {
+                arakoon_mem_free(list->entries);
         }
+        _arakoon_slab_clear(&list->slab);
+
+        list->size = 0;
+        list->entries = NULL;
 
         arakoon_mem_free(list);
 }
@@ -162,7 +304,7 @@ ArakoonKeyValueListIter * arakoon_key_value_list_create_iter(
         RETURN_NULL_IF_NULL(iter);
 
         iter->list = list;
-        iter->current = list->first;
+        iter->current = 0;
 
         return iter;
 }
@@ -173,7 +315,7 @@ void arakoon_key_value_list_iter_free(ArakoonKeyValueListIter * const iter) {
         RETURN_IF_NULL(iter);
 
         iter->list = NULL;
-        iter->current = NULL;
+        iter->current = 0;
 
         arakoon_mem_free(iter);
 }
@@ -181,6 +323,9 @@ void arakoon_key_value_list_iter_free(ArakoonKeyValueListIter * const iter) {
 arakoon_rc arakoon_key_value_list_iter_next(ArakoonKeyValueListIter * const iter,
     size_t * const key_size, const void ** const key,
     size_t * const value_size, const void ** const value) {
+        const ArakoonKeyValueListEntry *entry = NULL;
+        const ArakoonSlab *slab = NULL;
+
         FUNCTION_ENTER(arakoon_key_value_list_iter_next);
 
         ASSERT_NON_NULL_RC(iter);
@@ -189,13 +334,20 @@ arakoon_rc arakoon_key_value_list_iter_next(ArakoonKeyValueListIter * const iter
         ASSERT_NON_NULL_RC(value_size);
         ASSERT_NON_NULL_RC(value);
 
-        if(iter->current != NULL) {
-                *key_size = iter->current->key_size;
-                *key = iter->current->key;
-                *value_size = iter->current->value_size;
-                *value = iter->current->value;
+        if(iter->current < iter->list->size) {
+                entry = &iter->list->entries[iter->current];
+                slab = &iter->list->slab;
+
+                *key_size = entry->key_size;
+                *key = (entry->key_size == 0 ?
+                        ARAKOON_ZERO_LENGTH_DATA_PTR :
+                        ARAKOON_SLAB_AT(slab, entry->key_offset));
+                *value_size = entry->value_size;
+                *value = (entry->value_size == 0 ?
+                        ARAKOON_ZERO_LENGTH_DATA_PTR :
+                        ARAKOON_SLAB_AT(slab, entry->value_offset));
 
-                iter->current = iter->current->next;
+                iter->current++;
         }
         else {
                 *key_size = 0;
@@ -213,7 +365,7 @@ arakoon_rc arakoon_key_value_list_iter_reset(
 
         ASSERT_NON_NULL_RC(iter);
 
-        iter->current = iter->list->first;
+        iter->current = 0;
 
         return ARAKOON_RC_SUCCESS;
 }
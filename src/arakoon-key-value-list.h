@@ -31,10 +31,18 @@ ARAKOON_BEGIN_DECLS
 ArakoonKeyValueList * _arakoon_key_value_list_new(void)
     ARAKOON_GNUC_WARN_UNUSED_RESULT ARAKOON_GNUC_MALLOC;
 
-arakoon_rc _arakoon_key_value_list_prepend(ArakoonKeyValueList *list,
-    const size_t key_size, const void * const key,
-    const size_t value_size, const void * const value)
-    ARAKOON_GNUC_WARN_UNUSED_RESULT ARAKOON_GNUC_NONNULL3(1, 3, 5);
+/* Set the number of entries in the list. New entries are empty. */
+arakoon_rc _arakoon_key_value_list_resize(ArakoonKeyValueList *list,
+    size_t size) ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Allocate room for the key or value of the entry at index, returning the
+ * buffer to fill in, or NULL on allocation failure. The buffer is only valid
+ * until the list is changed again. */
+void * _arakoon_key_value_list_set_key(ArakoonKeyValueList *list,
+    size_t index, size_t key_size)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+void * _arakoon_key_value_list_set_value(ArakoonKeyValueList *list,
+    size_t index, size_t value_size)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
 
 ARAKOON_END_DECLS
 
@@ -0,0 +1,243 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-cluster.h"
+#include "arakoon-cluster-node.h"
+#include "arakoon-client-call-options.h"
+
+struct ArakoonMasterWatcher {
+        ArakoonCluster *cluster;
+        /* Private connections to all nodes */
+        ArakoonCluster *probe;
+
+        ArakoonWorker worker;
+};
+
+static arakoon_rc _arakoon_master_watcher_step(void *data,
+    const ArakoonClientCallOptions * const options) {
+        return arakoon_master_watcher_step((ArakoonMasterWatcher *) data,
+                options);
+}
+
+ArakoonMasterWatcher * arakoon_master_watcher_new(
+    ArakoonCluster * const cluster) {
+        ArakoonMasterWatcher *watcher = NULL;
+
+        FUNCTION_ENTER(arakoon_master_watcher_new);
+
+        ASSERT_NON_NULL(cluster);
+
+        watcher = arakoon_mem_new(1, ArakoonMasterWatcher);
+        RETURN_NULL_IF_NULL(watcher);
+
+        memset(watcher, 0, sizeof(ArakoonMasterWatcher));
+
+        watcher->probe = _arakoon_cluster_clone(cluster);
+        if(watcher->probe == NULL) {
+                arakoon_mem_free(watcher);
+                return NULL;
+        }
+
+        watcher->cluster = cluster;
+
+        _arakoon_worker_init(&watcher->worker, "arakoon-master-watcher",
+                _arakoon_master_watcher_step, watcher);
+
+        return watcher;
+}
+
+void arakoon_master_watcher_free(ArakoonMasterWatcher *watcher) {
+        FUNCTION_ENTER(arakoon_master_watcher_free);
+
+        RETURN_IF_NULL(watcher);
+
+        _arakoon_worker_destroy(&watcher->worker);
+
+        arakoon_cluster_free(watcher->probe);
+        arakoon_mem_free(watcher);
+}
+
+/* Question to a single node, asked from a thread of its own */
+typedef struct {
+        ArakoonClusterNode *node;
+        int timeout;
+        char *master;
+        arakoon_rc rc;
+
+        arakoon_bool started;
+        pthread_t thread;
+} ArakoonMasterWatcherQuery;
+
+/* Ask a single node which node is master */
+static arakoon_rc _arakoon_master_watcher_ask(ArakoonClusterNode *node,
+    int *timeout, char ** const master) {
+        arakoon_rc rc = 0;
+
+        *master = NULL;
+
+        if(_arakoon_cluster_node_get_fd(node) < 0) {
+                rc = _arakoon_cluster_node_connect(node, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+        }
+
+        return _arakoon_cluster_node_who_master(node, timeout, master);
+}
+
+static void * _arakoon_master_watcher_run_query(void *data) {
+        ArakoonMasterWatcherQuery *query = (ArakoonMasterWatcherQuery *) data;
+
+        query->rc = _arakoon_master_watcher_ask(query->node, &query->timeout,
+                &query->master);
+
+        return NULL;
+}
+
+arakoon_rc arakoon_master_watcher_step(ArakoonMasterWatcher * const watcher,
+    const ArakoonClientCallOptions * const options) {
+        ArakoonClusterNode *node = NULL;
+        ArakoonMasterWatcherQuery *queries = NULL;
+        const char *master = NULL;
+        size_t count = 0, i = 0, j = 0, votes = 0, best = 0;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_bool progress = ARAKOON_BOOL_FALSE;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_master_watcher_step);
+
+        ASSERT_NON_NULL_RC(watcher);
+
+        READ_OPTIONS;
+
+        for(node = _arakoon_cluster_get_first_node(watcher->probe);
+            node != NULL; node = _arakoon_cluster_node_get_next(node)) {
+                count++;
+        }
+
+        queries = arakoon_mem_new(count, ArakoonMasterWatcherQuery);
+        RETURN_ENOMEM_IF_NULL(queries);
+
+        memset(queries, 0, count * sizeof(ArakoonMasterWatcherQuery));
+
+        /* All nodes are asked at once, each using the full timeout, so a
+         * single unreachable node can't delay the others. Every probe node
+         * has a connection of its own. A node which can't get a thread is
+         * asked by the calling thread instead. */
+        for(node = _arakoon_cluster_get_first_node(watcher->probe), i = 0;
+            node != NULL; node = _arakoon_cluster_node_get_next(node), i++) {
+                queries[i].node = node;
+                queries[i].timeout =
+                        arakoon_client_call_options_get_timeout(options_);
+
+                queries[i].started = (pthread_create(&queries[i].thread,
+                        NULL, _arakoon_master_watcher_run_query,
+                        &queries[i]) == 0);
+        }
+
+        for(i = 0; i < count; i++) {
+                if(queries[i].started) {
+                        pthread_join(queries[i].thread, NULL);
+                }
+                else {
+                        _arakoon_master_watcher_run_query(&queries[i]);
+                }
+
+                /* Failing nodes simply don't vote */
+                if(!ARAKOON_RC_IS_SUCCESS(queries[i].rc)) {
+                        _arakoon_log_debug(
+                                "arakoon-master-watcher: unable to reach "
+                                "node %s: %s",
+                                _arakoon_cluster_node_get_name(
+                                        queries[i].node),
+                                arakoon_strerror(queries[i].rc));
+                }
+        }
+
+        for(i = 0; i < count; i++) {
+                if(queries[i].master == NULL) {
+                        continue;
+                }
+
+                votes = 0;
+                for(j = i; j < count; j++) {
+                        if(queries[j].master != NULL &&
+                            strcmp(queries[i].master,
+                                queries[j].master) == 0) {
+                                votes++;
+                        }
+                }
+
+                if(votes > best) {
+                        best = votes;
+                        master = queries[i].master;
+                }
+        }
+
+        /* Only follow a strict majority of the configured nodes, a
+         * partitioned minority could still point at a former master */
+        if(master == NULL || best <= count / 2) {
+                rc = ARAKOON_RC_CLIENT_MASTER_NOT_FOUND;
+                goto out;
+        }
+
+        /* Make sure the master isn't stuck, e.g. lost its quorum */
+        timeout = arakoon_client_call_options_get_timeout(options_);
+        rc = _arakoon_cluster_connect_master_by_name(watcher->probe, master,
+                &timeout);
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = arakoon_expect_progress_possible(watcher->probe,
+                        options, &progress);
+        }
+        if(ARAKOON_RC_IS_SUCCESS(rc) && !progress) {
+                rc = ARAKOON_RC_CLIENT_MASTER_NOT_FOUND;
+        }
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        _arakoon_cluster_set_master_hint(watcher->cluster, master);
+
+out:
+        for(i = 0; i < count; i++) {
+                arakoon_mem_free(queries[i].master);
+        }
+        arakoon_mem_free(queries);
+
+        return rc;
+}
+
+arakoon_rc arakoon_master_watcher_start(ArakoonMasterWatcher * const watcher,
+    int interval) {
+        FUNCTION_ENTER(arakoon_master_watcher_start);
+
+        ASSERT_NON_NULL_RC(watcher);
+
+        return _arakoon_worker_start(&watcher->worker, interval);
+}
@@ -0,0 +1,536 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "arakoon.h"
+#include "arakoon-mux.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-networking.h"
+
+/* Maximum number of requests written using a single writev(2) call */
+#define ARAKOON_MUX_MAX_BATCH (64)
+
+typedef struct ArakoonMuxRequest ArakoonMuxRequest;
+struct ArakoonMuxRequest {
+        ArakoonMux *mux;
+        const void *owner;
+
+        const void *data;
+        size_t len;
+
+        /* Link in the queue of requests waiting for their response */
+        ArakoonMuxRequest *next;
+
+        arakoon_bool queued;
+        arakoon_bool written;
+        arakoon_bool turn;
+        arakoon_rc rc;
+
+        pthread_cond_t cond;
+};
+
+struct ArakoonMux {
+        int fd;
+
+        /* Protects everything below */
+        pthread_mutex_t lock;
+
+        /* Submitted requests, in write order. The head is the request whose
+         * response can be read once it's written. */
+        ArakoonMuxRequest *head;
+        ArakoonMuxRequest *tail;
+
+        /* The first request which isn't completely written yet, and the
+         * number of its bytes which were */
+        ArakoonMuxRequest *unwritten;
+        size_t offset;
+        /* Whether a thread is writing. The lock isn't held while writing,
+         * so responses can be read at the same time. */
+        arakoon_bool writing;
+
+        unsigned int refs;
+        arakoon_bool broken;
+};
+
+static pthread_key_t request_key;
+static pthread_once_t request_key_once = PTHREAD_ONCE_INIT;
+
+static void _arakoon_mux_request_release(ArakoonMuxRequest *request,
+    arakoon_rc rc);
+
+static void _arakoon_mux_request_free(void *data) {
+        ArakoonMuxRequest *request = (ArakoonMuxRequest *) data;
+
+        RETURN_IF_NULL(request);
+
+        if(request->mux != NULL) {
+                _arakoon_mux_request_release(request,
+                        ARAKOON_RC_CLIENT_NETWORK_ERROR);
+        }
+
+        pthread_cond_destroy(&request->cond);
+        arakoon_mem_free(request);
+}
+
+static void _arakoon_mux_init_key(void) {
+        if(pthread_key_create(&request_key, _arakoon_mux_request_free) != 0) {
+                _arakoon_log_fatal("arakoon-mux: unable to create key");
+                abort();
+        }
+}
+
+static ArakoonMuxRequest * _arakoon_mux_get_request(arakoon_bool create) {
+        ArakoonMuxRequest *request = NULL;
+
+        pthread_once(&request_key_once, _arakoon_mux_init_key);
+
+        request = (ArakoonMuxRequest *) pthread_getspecific(request_key);
+        if(request != NULL || !create) {
+                return request;
+        }
+
+        request = arakoon_mem_new(1, ArakoonMuxRequest);
+        RETURN_NULL_IF_NULL(request);
+
+        memset(request, 0, sizeof(ArakoonMuxRequest));
+
+        _arakoon_cond_init_monotonic(&request->cond);
+
+        if(pthread_setspecific(request_key, request) != 0) {
+                pthread_cond_destroy(&request->cond);
+                arakoon_mem_free(request);
+                return NULL;
+        }
+
+        return request;
+}
+
+ArakoonMux * _arakoon_mux_new(int fd) {
+        ArakoonMux *mux = NULL;
+
+        FUNCTION_ENTER(_arakoon_mux_new);
+
+        mux = arakoon_mem_new(1, ArakoonMux);
+        RETURN_NULL_IF_NULL(mux);
+
+        memset(mux, 0, sizeof(ArakoonMux));
+
+        mux->fd = fd;
+        mux->head = NULL;
+        mux->tail = NULL;
+        mux->unwritten = NULL;
+        mux->offset = 0;
+        mux->writing = ARAKOON_BOOL_FALSE;
+        mux->refs = 1;
+        mux->broken = ARAKOON_BOOL_FALSE;
+
+        pthread_mutex_init(&mux->lock, NULL);
+
+        return mux;
+}
+
+static void _arakoon_mux_free(ArakoonMux *mux) {
+        _arakoon_log_debug("arakoon-mux: releasing connection, fd %d",
+                mux->fd);
+
+        if(mux->fd >= 0) {
+                _arakoon_networking_close_wrapper(mux->fd);
+        }
+
+        pthread_mutex_destroy(&mux->lock);
+
+        arakoon_mem_free(mux);
+}
+
+int _arakoon_mux_get_fd(const ArakoonMux * const mux) {
+        return mux->fd;
+}
+
+/* Must be called with mux->lock held */
+static void _arakoon_mux_break_locked(ArakoonMux * const mux) {
+        ArakoonMuxRequest *request = NULL;
+
+        if(mux->broken) {
+                return;
+        }
+
+        _arakoon_log_info("arakoon-mux: breaking connection, fd %d", mux->fd);
+
+        mux->broken = ARAKOON_BOOL_TRUE;
+
+        /* Any blocked read or write returns right away. The descriptor
+         * itself remains valid until all requests are released. */
+        _arakoon_networking_shutdown_wrapper(mux->fd, SHUT_RDWR);
+
+        for(request = mux->head; request != NULL; request = request->next) {
+                pthread_cond_signal(&request->cond);
+        }
+}
+
+void _arakoon_mux_break(ArakoonMux * const mux) {
+        FUNCTION_ENTER(_arakoon_mux_break);
+
+        pthread_mutex_lock(&mux->lock);
+        _arakoon_mux_break_locked(mux);
+        pthread_mutex_unlock(&mux->lock);
+}
+
+void _arakoon_mux_unref(ArakoonMux * const mux) {
+        arakoon_bool release = ARAKOON_BOOL_FALSE;
+
+        FUNCTION_ENTER(_arakoon_mux_unref);
+
+        pthread_mutex_lock(&mux->lock);
+        mux->refs--;
+        release = (mux->refs == 0);
+        pthread_mutex_unlock(&mux->lock);
+
+        if(release) {
+                _arakoon_mux_free(mux);
+        }
+}
+
+arakoon_rc _arakoon_mux_begin(ArakoonMux * const mux,
+    const void * const owner) {
+        ArakoonMuxRequest *request = NULL;
+
+        FUNCTION_ENTER(_arakoon_mux_begin);
+
+        request = _arakoon_mux_get_request(ARAKOON_BOOL_TRUE);
+        RETURN_ENOMEM_IF_NULL(request);
+
+        if(request->mux != NULL) {
+                /* The previous call of this thread was never released, so
+                 * there's no telling whether its response was read. Nothing
+                 * after it can be trusted on that connection. */
+                _arakoon_log_warning(
+                        "arakoon-mux: previous call was not released");
+                _arakoon_mux_break(request->mux);
+                _arakoon_mux_request_release(request,
+                        ARAKOON_RC_CLIENT_NETWORK_ERROR);
+        }
+
+        pthread_mutex_lock(&mux->lock);
+        mux->refs++;
+        pthread_mutex_unlock(&mux->lock);
+
+        request->mux = mux;
+        request->owner = owner;
+        request->data = NULL;
+        request->len = 0;
+        request->next = NULL;
+        request->queued = ARAKOON_BOOL_FALSE;
+        request->written = ARAKOON_BOOL_FALSE;
+        request->turn = ARAKOON_BOOL_FALSE;
+        request->rc = ARAKOON_RC_SUCCESS;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+ArakoonMux * _arakoon_mux_current(const void * const owner) {
+        ArakoonMuxRequest *request = NULL;
+
+        request = _arakoon_mux_get_request(ARAKOON_BOOL_FALSE);
+        if(request == NULL || request->owner != owner) {
+                return NULL;
+        }
+
+        return request->mux;
+}
+
+/* Mark 'len' more bytes as written. Must be called with mux->lock held. */
+static void _arakoon_mux_advance(ArakoonMux * const mux, size_t len) {
+        ArakoonMuxRequest *request = NULL;
+
+        while(len > 0 && mux->unwritten != NULL) {
+                request = mux->unwritten;
+
+                if(len < request->len - mux->offset) {
+                        mux->offset += len;
+                        return;
+                }
+
+                len -= request->len - mux->offset;
+
+                /* Its response can be read while later requests are still
+                 * being written */
+                request->written = ARAKOON_BOOL_TRUE;
+                pthread_cond_signal(&request->cond);
+
+                mux->unwritten = request->next;
+                mux->offset = 0;
+        }
+}
+
+/* Write queued requests until the one of the calling thread is written. Must
+ * be called with mux->lock held, which is released while writing.
+ *
+ * Writing stops as soon as the own request is written: the thread has to
+ * read its response once it's its turn, and must not block on a socket the
+ * server stops reading from until earlier responses are read. Threads of
+ * requests which aren't written yet take over. */
+static arakoon_rc _arakoon_mux_write(ArakoonMux * const mux,
+    ArakoonMuxRequest * const own, int *timeout) {
+        ArakoonMuxRequest *request = NULL;
+        struct iovec iov[ARAKOON_MUX_MAX_BATCH];
+        size_t offset = 0, written = 0;
+        int cnt = 0;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        mux->writing = ARAKOON_BOOL_TRUE;
+
+        while(!own->written && !mux->broken) {
+                cnt = 0;
+                offset = mux->offset;
+
+                for(request = mux->unwritten;
+                    request != NULL && cnt < ARAKOON_MUX_MAX_BATCH;
+                    request = request->next) {
+                        iov[cnt].iov_base = (char *) request->data + offset;
+                        iov[cnt].iov_len = request->len - offset;
+                        offset = 0;
+                        cnt++;
+                }
+
+                pthread_mutex_unlock(&mux->lock);
+                rc = _arakoon_networking_poll_writev(mux->fd, iov, cnt,
+                        &written, timeout);
+                pthread_mutex_lock(&mux->lock);
+
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        _arakoon_mux_break_locked(mux);
+                        break;
+                }
+
+                _arakoon_mux_advance(mux, written);
+        }
+
+        mux->writing = ARAKOON_BOOL_FALSE;
+
+        /* Hand over to the threads waiting to write their requests */
+        for(request = mux->unwritten; request != NULL;
+            request = request->next) {
+                pthread_cond_signal(&request->cond);
+        }
+
+        return rc;
+}
+
+/* Wait for the condition of 'request', until 'deadline' if it's set */
+static int _arakoon_mux_wait(ArakoonMux * const mux,
+    ArakoonMuxRequest * const request, const struct timespec * const deadline) {
+        if(deadline == NULL) {
+                return pthread_cond_wait(&request->cond, &mux->lock);
+        }
+
+        return pthread_cond_timedwait(&request->cond, &mux->lock, deadline);
+}
+
+arakoon_rc _arakoon_mux_submit(const void * const data, size_t len,
+    int *timeout) {
+        ArakoonMuxRequest *request = NULL;
+        ArakoonMux *mux = NULL;
+        arakoon_bool with_timeout = (timeout != NULL &&
+                *timeout != ARAKOON_CLIENT_CALL_OPTIONS_INFINITE_TIMEOUT);
+        struct timespec deadline = {0, 0};
+        uint64_t start = 0, waited = 0;
+        int left = ARAKOON_CLIENT_CALL_OPTIONS_INFINITE_TIMEOUT;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+        int ret = 0;
+
+        FUNCTION_ENTER(_arakoon_mux_submit);
+
+        request = _arakoon_mux_get_request(ARAKOON_BOOL_FALSE);
+        if(request == NULL || request->mux == NULL) {
+                _arakoon_log_fatal("arakoon-mux: submit without request");
+                abort();
+        }
+
+        mux = request->mux;
+
+        request->data = data;
+        request->len = len;
+
+        start = _arakoon_networking_monotonic_usec();
+
+        if(with_timeout) {
+                _arakoon_deadline_after(&deadline,
+                        (uint64_t) *timeout * US_PER_MS);
+        }
+
+        pthread_mutex_lock(&mux->lock);
+
+        if(mux->broken) {
+                pthread_mutex_unlock(&mux->lock);
+                return ARAKOON_RC_CLIENT_NETWORK_ERROR;
+        }
+
+        /* Responses are queued in write order */
+        request->queued = ARAKOON_BOOL_TRUE;
+        request->next = NULL;
+
+        if(mux->tail == NULL) {
+                mux->head = request;
+                request->turn = ARAKOON_BOOL_TRUE;
+        }
+        else {
+                mux->tail->next = request;
+        }
+        mux->tail = request;
+
+        if(mux->unwritten == NULL) {
+                mux->unwritten = request;
+                mux->offset = 0;
+        }
+
+        while(ARAKOON_RC_IS_SUCCESS(rc) && !mux->broken &&
+            !(request->written && request->turn)) {
+                if(!request->written && !mux->writing) {
+                        if(with_timeout) {
+                                waited = (_arakoon_networking_monotonic_usec()
+                                        - start) / US_PER_MS;
+                                left = (waited >= (uint64_t) *timeout) ?
+                                        0 : *timeout - (int) waited;
+                        }
+
+                        rc = _arakoon_mux_write(mux, request, &left);
+                        continue;
+                }
+
+                ret = _arakoon_mux_wait(mux, request,
+                        with_timeout ? &deadline : NULL);
+                if(ret == ETIMEDOUT &&
+                    !(request->written && request->turn)) {
+                        /* Nobody will read our response, so all later
+                         * ones can't be read either */
+                        _arakoon_mux_break_locked(mux);
+                        rc = ARAKOON_RC_CLIENT_TIMEOUT;
+                }
+        }
+
+        /* The data of the request can't go away while it's being written */
+        while(!request->written && mux->writing) {
+                pthread_cond_wait(&request->cond, &mux->lock);
+        }
+
+        if(ARAKOON_RC_IS_SUCCESS(rc) && mux->broken) {
+                rc = ARAKOON_RC_CLIENT_NETWORK_ERROR;
+        }
+
+        pthread_mutex_unlock(&mux->lock);
+
+        if(with_timeout) {
+                waited = (_arakoon_networking_monotonic_usec() - start)
+                        / US_PER_MS;
+                *timeout = (waited >= (uint64_t) *timeout) ?
+                        0 : *timeout - (int) waited;
+        }
+
+        return rc;
+}
+
+static void _arakoon_mux_request_release(ArakoonMuxRequest *request,
+    arakoon_rc rc) {
+        ArakoonMux *mux = request->mux;
+        ArakoonMuxRequest *r = NULL, *prev = NULL;
+        arakoon_bool release = ARAKOON_BOOL_FALSE;
+
+        pthread_mutex_lock(&mux->lock);
+
+        /* Errors returned by the server are complete responses, anything
+         * else might have left unread data on the socket */
+        if(request->turn && (ARAKOON_RC_IS_ERRNO(rc) ||
+            ARAKOON_RC_AS_ARAKOONRETURNCODE(rc) >=
+                ARAKOON_RC_CLIENT_NETWORK_ERROR)) {
+                _arakoon_mux_break_locked(mux);
+        }
+
+        /* Part of the request may have been written */
+        if(request->queued && !request->written) {
+                _arakoon_mux_break_locked(mux);
+        }
+
+        if(request->queued) {
+                if(mux->unwritten == request) {
+                        mux->unwritten = request->next;
+                        mux->offset = 0;
+                }
+
+                for(r = mux->head; r != NULL && r != request; r = r->next) {
+                        prev = r;
+                }
+
+                if(r != NULL) {
+                        if(prev == NULL) {
+                                mux->head = r->next;
+                        }
+                        else {
+                                prev->next = r->next;
+                        }
+
+                        if(mux->tail == r) {
+                                mux->tail = prev;
+                        }
+                }
+
+                if(prev == NULL && mux->head != NULL) {
+                        /* Hand the socket to the next waiting thread */
+                        mux->head->turn = ARAKOON_BOOL_TRUE;
+                        pthread_cond_signal(&mux->head->cond);
+                }
+        }
+
+        mux->refs--;
+        release = (mux->refs == 0);
+
+        pthread_mutex_unlock(&mux->lock);
+
+        request->mux = NULL;
+        request->owner = NULL;
+        request->queued = ARAKOON_BOOL_FALSE;
+        request->turn = ARAKOON_BOOL_FALSE;
+
+        if(release) {
+                _arakoon_mux_free(mux);
+        }
+}
+
+void _arakoon_mux_end_call(arakoon_rc rc) {
+        ArakoonMuxRequest *request = NULL;
+
+        request = _arakoon_mux_get_request(ARAKOON_BOOL_FALSE);
+        if(request == NULL || request->mux == NULL) {
+                return;
+        }
+
+        _arakoon_mux_request_release(request, rc);
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ARAKOON_MUX_H__
+#define __ARAKOON_MUX_H__
+
+#include "arakoon.h"
+
+ARAKOON_BEGIN_DECLS
+
+/* A multiplexed connection, shared by several threads
+ *
+ * Arakoon handles requests on a connection in order, so any number of
+ * threads can share a single socket as long as responses are read in the
+ * order requests were written. Callers submit encoded requests, which are
+ * written in batches by whichever thread gets to write first, until its own
+ * request is written. Afterwards every caller waits until it's its turn to
+ * read its own response from the socket, using the usual protocol helpers.
+ * Responses are read while other threads are still writing, so a server
+ * which stops reading requests until its responses are read can't block the
+ * connection.
+ *
+ * Every thread has at most a single request in flight. It's bound to the
+ * thread from _arakoon_mux_begin until _arakoon_mux_end_call.
+ *
+ * Requests are queued under the connection lock rather than pushed onto a
+ * lock-free stack. The lock is never held while writing or reading, only to
+ * link a request and hand over turns, and the writer has to take it anyway
+ * to tell which requests are written. A lock-free stack would also have to
+ * be reversed into write order by the writer.
+ *
+ * A caller which gives up waiting for its turn, e.g. on a timeout, breaks
+ * the connection: nobody would read its response, so no later response
+ * could be matched to its request. All other requests in flight fail too.
+ *
+ * The connection is reference counted: the creator (i.e. the node) holds a
+ * reference, as does every request bound to it. The socket is closed when
+ * the last reference is dropped.
+ */
+typedef struct ArakoonMux ArakoonMux;
+
+ArakoonMux * _arakoon_mux_new(int fd)
+    ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+int _arakoon_mux_get_fd(const ArakoonMux * const mux) ARAKOON_GNUC_NONNULL;
+
+/* Bind a new request of the calling thread to the connection. 'owner'
+ * identifies the node the request is sent to. */
+arakoon_rc _arakoon_mux_begin(ArakoonMux * const mux, const void * const owner)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Write the request bound to the calling thread, and wait until its response
+ * can be read */
+arakoon_rc _arakoon_mux_submit(const void * const data, size_t len,
+    int *timeout) ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* The connection of the request bound to the calling thread, if it's sent to
+ * 'owner' */
+ArakoonMux * _arakoon_mux_current(const void * const owner)
+    ARAKOON_GNUC_NONNULL;
+/* Release the request bound to the calling thread, passing the result of the
+ * call. Any failure other than a server-side error leaves the connection in
+ * an unknown state, which breaks it. */
+void _arakoon_mux_end_call(arakoon_rc rc);
+/* Shut down the connection and fail all pending requests */
+void _arakoon_mux_break(ArakoonMux * const mux) ARAKOON_GNUC_NONNULL;
+/* Drop the reference taken by _arakoon_mux_new */
+void _arakoon_mux_unref(ArakoonMux * const mux) ARAKOON_GNUC_NONNULL;
+
+ARAKOON_END_DECLS
+
+#endif /* ifndef __ARAKOON_MUX_H__ */
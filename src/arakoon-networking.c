@@ -32,16 +32,13 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 
 #include "arakoon.h"
 #include "arakoon-utils.h"
 #include "arakoon-networking.h"
 
-#define NS_PER_MS (1000000)
-#define MS_PER_S (1000)
-#define NS_PER_S (MS_PER_S * NS_PER_MS)
-
 #ifdef CLOCK_MONOTONIC_RAW
 # define CLOCK_SOURCE CLOCK_MONOTONIC_RAW
 #elif defined CLOCK_MONOTONIC
@@ -57,14 +54,10 @@ static int _arakoon_networking_connect_wrapper(int sockfd,
 
 static long time_delta(const struct timespec * const start,
     const struct timespec * const end) {
-        long nd = 0;
-
-        if(start->tv_sec == end->tv_sec) {
-                return ((end->tv_nsec - start->tv_nsec) / NS_PER_MS);
-        }
-
-        nd = (NS_PER_S - start->tv_nsec) + end->tv_nsec;
-        return (nd / NS_PER_MS) + ((end->tv_sec - start->tv_sec) * MS_PER_S);
+        /* The nanoseconds difference is negative when a second boundary
+         * was crossed */
+        return ((end->tv_sec - start->tv_sec) * MS_PER_S) +
+                ((end->tv_nsec - start->tv_nsec) / NS_PER_MS);
 }
 
 typedef ssize_t (*NetworkActionProto) (int fd, void *buf, size_t count);
@@ -249,6 +242,107 @@ arakoon_rc _arakoon_networking_poll_read(int fd, void *buf, size_t count,
                 fd, buf, count, timeout);
 }
 
+arakoon_rc _arakoon_networking_poll_writev(int fd, const struct iovec *iov,
+    int iovcnt, size_t *written, int *timeout) {
+        ssize_t cnt = 0;
+        int rc = 0;
+        struct timespec start = {0, 0}, now = {0, 0};
+        arakoon_bool with_timeout = (timeout != NULL &&
+                *timeout != ARAKOON_CLIENT_CALL_OPTIONS_INFINITE_TIMEOUT);
+        int timeout_ = 0, time_left = -1;
+        struct pollfd ev;
+        struct msghdr msg;
+
+        if(fd < 0) {
+                return ARAKOON_RC_CLIENT_NOT_CONNECTED;
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.fd = fd;
+        ev.events = POLLOUT;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (struct iovec *) iov;
+        msg.msg_iovlen = iovcnt;
+
+        if(with_timeout) {
+                timeout_ = *timeout;
+
+                if(timeout_ <= 0) {
+                        return ARAKOON_RC_CLIENT_TIMEOUT;
+                }
+
+                rc = clock_gettime(CLOCK_SOURCE, &start);
+                if(rc != 0) {
+                        return -errno;
+                }
+        }
+
+        while(1) {
+                errno = 0;
+
+                if(with_timeout) {
+                        rc = clock_gettime(CLOCK_SOURCE, &now);
+                        if(rc != 0) {
+                                return -errno;
+                        }
+
+                        time_left = timeout_ - time_delta(&start, &now);
+
+                        if(time_left <= 0) {
+                                *timeout = 0;
+                                return ARAKOON_RC_CLIENT_TIMEOUT;
+                        }
+                }
+
+                rc = poll(&ev, 1, time_left);
+
+                if(rc < 0) {
+                        if(errno == EINTR) {
+                                continue;
+                        }
+
+                        return -errno;
+                }
+
+                if(rc == 0) {
+                        *timeout = 0;
+                        return ARAKOON_RC_CLIENT_TIMEOUT;
+                }
+
+                if(ev.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                        return ARAKOON_RC_CLIENT_NETWORK_ERROR;
+                }
+
+                /* Never block once some data was written, so the caller
+                 * can act on partial progress */
+                cnt = sendmsg(fd, &msg, MSG_DONTWAIT);
+
+                if(cnt < 0) {
+                        if(errno == EINTR || errno == EAGAIN ||
+                            errno == EWOULDBLOCK) {
+                                continue;
+                        }
+
+                        return -errno;
+                }
+
+                break;
+        }
+
+        *written = cnt;
+
+        if(with_timeout) {
+                rc = clock_gettime(CLOCK_SOURCE, &now);
+                if(rc != 0) {
+                        return -errno;
+                }
+
+                *timeout = timeout_ - time_delta(&start, &now);
+        }
+
+        return ARAKOON_RC_SUCCESS;
+}
 
 arakoon_rc _arakoon_networking_connect(const struct addrinfo *addr, int *fd,
     int *timeout) {
@@ -606,6 +700,38 @@ static int _arakoon_networking_connect_wrapper(int sockfd,
         return rc;
 }
 
+uint64_t _arakoon_networking_monotonic_usec(void) {
+        struct timespec now = {0, 0};
+
+        if(clock_gettime(CLOCK_SOURCE, &now) != 0) {
+                return 0;
+        }
+
+        return ((uint64_t) now.tv_sec * US_PER_S) + (now.tv_nsec / NS_PER_US);
+}
+
+arakoon_bool _arakoon_networking_is_idle(int fd) {
+        struct pollfd ev;
+        int rc = 0;
+
+        if(fd < 0) {
+                return ARAKOON_BOOL_FALSE;
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.fd = fd;
+        ev.events = POLLIN | POLLRDHUP;
+
+        do {
+                rc = poll(&ev, 1, 0);
+        } while(rc < 0 && errno == EINTR);
+
+        /* An idle connection has nothing to read: any pending data (or EOF,
+         * or an error condition) means the stream is no longer in sync with
+         * the server, so the connection can't be reused */
+        return (rc == 0 ? ARAKOON_BOOL_TRUE : ARAKOON_BOOL_FALSE);
+}
+
 int _arakoon_networking_close_wrapper(int fd) {
         int rc = close(fd);
 
@@ -24,7 +24,9 @@
 #ifndef __ARAKOON_NETWORKING_H__
 #define __ARAKOON_NETWORKING_H__
 
+#include <stdint.h>
 #include <netdb.h>
+#include <sys/uio.h>
 
 #include "arakoon.h"
 
@@ -33,12 +35,20 @@ ARAKOON_BEGIN_DECLS
 arakoon_rc _arakoon_networking_poll_write(int fd, const void *data,
     size_t count, int *timeout) ARAKOON_GNUC_NONNULL2(2, 4);
 
+/* Wait until 'fd' is writable, then write as much of 'iov' as possible
+ * without blocking. The number of bytes written is stored in 'written'. */
+arakoon_rc _arakoon_networking_poll_writev(int fd, const struct iovec *iov,
+    int iovcnt, size_t *written, int *timeout) ARAKOON_GNUC_NONNULL2(2, 4);
+
 arakoon_rc _arakoon_networking_poll_read(int fd, void *buf, size_t count,
     int *timeout) ARAKOON_GNUC_NONNULL2(2, 4);
 
 arakoon_rc _arakoon_networking_connect(const struct addrinfo *addr, int *fd,
     int *timeout) ARAKOON_GNUC_NONNULL2(1, 2);
 
+uint64_t _arakoon_networking_monotonic_usec(void);
+arakoon_bool _arakoon_networking_is_idle(int fd);
+
 int _arakoon_networking_close_wrapper(int fd);
 int _arakoon_networking_shutdown_wrapper(int sockfd, int how);
 
@@ -27,6 +27,7 @@
 #include "arakoon.h"
 #include "arakoon-nursery-routing.h"
 #include "arakoon-utils.h"
+#include "arakoon-resolver.h"
 
 typedef struct ArakoonNurseryRoutingNode ArakoonNurseryRoutingNode;
 struct ArakoonNurseryRouting {
@@ -71,8 +72,8 @@ static void arakoon_nursery_routing_node_free(ArakoonNurseryRoutingNode *node);
 static ArakoonNurseryRoutingNode * arakoon_nursery_routing_parse_node(
     const void **data);
 static arakoon_rc arakoon_nursery_routing_parse_clusters(
-    ArakoonProtocolVersion version, const void **data,
-    ArakoonCluster ***result);
+    ArakoonProtocolVersion version, ArakoonResolverCache *cache,
+    const void **data, ArakoonCluster ***result);
 
 void _arakoon_nursery_routing_free(ArakoonNurseryRouting *routing) {
         int i = 0;
@@ -90,8 +91,9 @@ void _arakoon_nursery_routing_free(ArakoonNurseryRouting *routing) {
 }
 
 arakoon_rc _arakoon_nursery_routing_parse(
-    ArakoonProtocolVersion version, size_t length ARAKOON_GNUC_UNUSED,
-    const void *data, ArakoonNurseryRouting **routing) {
+    ArakoonProtocolVersion version, ArakoonResolverCache *cache,
+    size_t length ARAKOON_GNUC_UNUSED, const void *data,
+    ArakoonNurseryRouting **routing) {
         arakoon_rc rc = 0;
         ArakoonNurseryRouting *ret = NULL;
         ArakoonNurseryRoutingNode *root = NULL;
@@ -108,15 +110,10 @@ arakoon_rc _arakoon_nursery_routing_parse(
                 return ARAKOON_RC_CLIENT_NURSERY_INVALID_ROUTING;
         }
 
-        rc = arakoon_nursery_routing_parse_clusters(version, &iter, &clusters);
+        rc = arakoon_nursery_routing_parse_clusters(version, cache, &iter,
+                &clusters);
         if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                if(clusters != NULL && *clusters == NULL) {
-                        for(i = 0; clusters[i] != NULL; i++) {
-                                arakoon_cluster_free(clusters[i]);
-                        }
-                        arakoon_mem_free(clusters);
-                }
-
+                arakoon_nursery_routing_node_free(root);
                 return rc;
         }
         if(clusters == NULL) {
@@ -254,79 +251,154 @@ static ArakoonNurseryRoutingNode * arakoon_nursery_routing_parse_node(
         return node;
 }
 
+static void _skip_string(const void **data) {
+        uint32_t length = 0;
+
+        length = _read_uint32(data);
+        *(char **)data += length;
+}
+
 #define UINT32_MAX_LENGTH (10)
+typedef char ArakoonNurseryRoutingService[UINT32_MAX_LENGTH + 1];
+
 static arakoon_rc arakoon_nursery_routing_parse_clusters(
-    ArakoonProtocolVersion version, const void **data,
-    ArakoonCluster *** result) {
+    ArakoonProtocolVersion version, ArakoonResolverCache *cache,
+    const void **data, ArakoonCluster *** result) {
         uint32_t count = 0;
         ArakoonCluster **ret = NULL;
         ArakoonClusterNode *node = NULL;
         char *cluster_id = NULL;
         uint32_t cluster_size = 0;
-        char *node_id = NULL, *ip = NULL;
-        char service[UINT32_MAX_LENGTH + 1];
-        uint32_t port = 0;
+        char *node_id = NULL;
+        ArakoonNurseryRoutingService *services = NULL;
+        ArakoonResolverQuery *queries = NULL;
+        size_t nodes_count = 0, n = 0;
+        const void *iter = NULL;
         ArakoonCluster *cluster = NULL;
         uint32_t i = 0, j = 0;
         arakoon_rc rc = 0;
 
-        count = _read_uint32(data);
+        *result = NULL;
+
+        /* Look up the addresses of all nodes in a single batch before
+         * building any cluster, so a slow resolver is only waited for
+         * once */
+        iter = *data;
+        count = _read_uint32(&iter);
+        for(i = 0; i < count; i++) {
+                _skip_string(&iter);
+                nodes_count += _read_uint32(&iter);
+
+                for(; n < nodes_count; n++) {
+                        _skip_string(&iter);
+                        _skip_string(&iter);
+                        _read_uint32(&iter);
+                }
+        }
 
         ret = arakoon_mem_new(count + 1, ArakoonCluster *);
-        ret[count] = NULL;
+        services = arakoon_mem_new(nodes_count, ArakoonNurseryRoutingService);
+        queries = arakoon_mem_new(nodes_count, ArakoonResolverQuery);
+        if(ret == NULL || services == NULL || queries == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
+
+        memset(ret, 0, (count + 1) * sizeof(ArakoonCluster *));
+        memset(queries, 0, nodes_count * sizeof(ArakoonResolverQuery));
 
+        iter = *data;
+        _read_uint32(&iter);
+        n = 0;
+        for(i = 0; i < count; i++) {
+                _skip_string(&iter);
+                cluster_size = _read_uint32(&iter);
+
+                for(j = 0; j < cluster_size; j++, n++) {
+                        _skip_string(&iter);
+                        queries[n].host = _read_string(&iter);
+                        snprintf(services[n], sizeof(services[n]), "%u",
+                                _read_uint32(&iter));
+                        queries[n].service = services[n];
+
+                        if(queries[n].host == NULL) {
+                                rc = -ENOMEM;
+                                goto out;
+                        }
+                }
+        }
+
+        rc = _arakoon_resolver_resolve(cache, queries, nodes_count);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        _read_uint32(data);
+        n = 0;
         for(i = 0; i < count; i++) {
                 cluster_id = _read_string(data);
                 cluster_size = _read_uint32(data);
 
                 cluster = arakoon_cluster_new(version, cluster_id);
                 arakoon_mem_free(cluster_id);
+                if(cluster == NULL) {
+                        rc = -ENOMEM;
+                        goto out;
+                }
 
                 ret[i] = cluster;
 
-                for(j = 0; j < cluster_size; j++) {
+                for(j = 0; j < cluster_size; j++, n++) {
                         node_id = _read_string(data);
-                        ip = _read_string(data);
-                        port = _read_uint32(data);
-
-                        snprintf(service, sizeof(service), "%u", port);
+                        _skip_string(data);
+                        _read_uint32(data);
 
                         node = arakoon_cluster_node_new(node_id);
+                        arakoon_mem_free(node_id);
                         if(node == NULL) {
-                                goto failure;
+                                rc = -ENOMEM;
+                                goto out;
                         }
 
-                        rc = arakoon_cluster_node_add_address_tcp(node, ip,
-                                service);
-
-                        arakoon_mem_free(node_id);
-                        arakoon_mem_free(ip);
-
+                        rc = arakoon_cluster_node_add_address(node,
+                                queries[n].result);
                         if(!ARAKOON_RC_IS_SUCCESS(rc)) {
                                 arakoon_cluster_node_free(node);
-                                goto failure;
+                                goto out;
                         }
 
-                        rc = arakoon_cluster_add_node(cluster, node);
+                        queries[n].result = NULL;
 
+                        rc = arakoon_cluster_add_node(cluster, node);
                         if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                                goto failure;
+                                arakoon_cluster_node_free(node);
+                                goto out;
                         }
                 }
         }
 
         *result = ret;
+        ret = NULL;
+
+out:
+        if(queries != NULL) {
+                for(n = 0; n < nodes_count; n++) {
+                        arakoon_mem_free((char *) queries[n].host);
+                        if(queries[n].result != NULL) {
+                                freeaddrinfo(queries[n].result);
+                        }
+                }
+        }
 
-        return rc;
-
-failure:
-        for(i = 0; ret[i] != NULL; i++) {
-                arakoon_cluster_free(ret[i]);
+        if(ret != NULL) {
+                for(i = 0; ret[i] != NULL; i++) {
+                        arakoon_cluster_free(ret[i]);
+                }
         }
 
         arakoon_mem_free(ret);
-
-        *ret = NULL;
+        arakoon_mem_free(services);
+        arakoon_mem_free(queries);
 
         return rc;
 }
@@ -340,7 +412,16 @@ static const char * _arakoon_nursery_routing_node_lookup(
 
                 case ARAKOON_NURSERY_ROUTING_NODE_INTERNAL:
                         {
-                                if(memcmp(key, node->node.internal.boundary, key_size) < 0) {
+                                /* Keys sort bytewise, a prefix first */
+                                const char *boundary =
+                                        node->node.internal.boundary;
+                                const size_t boundary_size = strlen(boundary);
+                                int r = memcmp(key, boundary,
+                                        key_size < boundary_size ?
+                                                key_size : boundary_size);
+
+                                if(r < 0 ||
+                                    (r == 0 && key_size < boundary_size)) {
                                         return _arakoon_nursery_routing_node_lookup(
                                                 node->node.internal.left, key_size, key);
                                 }
@@ -25,15 +25,17 @@
 #define __ARAKOON_NURSERY_ROUTING_H__
 
 #include "arakoon.h"
+#include "arakoon-resolver.h"
 
 ARAKOON_BEGIN_DECLS
 
 typedef struct ArakoonNurseryRouting ArakoonNurseryRouting;
 
+/* 'cache' keeps name lookups across routing updates, and can be NULL */
 arakoon_rc _arakoon_nursery_routing_parse(
-    ArakoonProtocolVersion version,
+    ArakoonProtocolVersion version, ArakoonResolverCache *cache,
     size_t length, const void *data, ArakoonNurseryRouting **routing)
-    ARAKOON_GNUC_WARN_UNUSED_RESULT ARAKOON_GNUC_NONNULL2(3, 4);
+    ARAKOON_GNUC_WARN_UNUSED_RESULT ARAKOON_GNUC_NONNULL2(4, 5);
 
 void _arakoon_nursery_routing_free(ArakoonNurseryRouting *routing);
 
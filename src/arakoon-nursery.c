@@ -32,11 +32,15 @@
 #include "arakoon-cluster-node.h"
 #include "arakoon-client-call-options.h"
 #include "arakoon-nursery-routing.h"
+#include "arakoon-value-list.h"
 #include "arakoon-assert.h"
+#include "arakoon-mux.h"
+#include "arakoon-command.h"
 
 struct ArakoonNursery {
         const ArakoonCluster *keeper;
         ArakoonNurseryRouting *routing;
+        ArakoonResolverCache *resolver_cache;
 };
 
 ArakoonNursery * arakoon_nursery_new(const ArakoonCluster * const keeper) {
@@ -54,6 +58,13 @@ ArakoonNursery * arakoon_nursery_new(const ArakoonCluster * const keeper) {
         ret->keeper = keeper;
         ret->routing = NULL;
 
+        /* Node addresses rarely change between routing updates */
+        ret->resolver_cache = _arakoon_resolver_cache_new();
+        if(ret->resolver_cache == NULL) {
+                arakoon_mem_free(ret);
+                return NULL;
+        }
+
         return ret;
 }
 
@@ -61,24 +72,17 @@ void arakoon_nursery_free(ArakoonNursery *nursery) {
         RETURN_IF_NULL(nursery);
 
         _arakoon_nursery_routing_free(nursery->routing);
+        _arakoon_resolver_cache_free(nursery->resolver_cache);
         arakoon_mem_free(nursery);
 }
 
 arakoon_rc arakoon_nursery_update_routing(ArakoonNursery *nursery,
     const ArakoonClientCallOptions * const options) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-        void *routing_data = NULL;
-        size_t routing_length = 0;
         ArakoonNurseryRouting *routing = NULL;
         ArakoonProtocolVersion version;
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
-
         FUNCTION_ENTER(arakoon_nursery_update_routing);
 
         ASSERT_NON_NULL_RC(nursery);
@@ -90,40 +94,18 @@ arakoon_rc arakoon_nursery_update_routing(ArakoonNursery *nursery,
                 nursery->routing = NULL;
         }
 
-        ARAKOON_CLUSTER_GET_MASTER(nursery->keeper, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN;
-
-        /* TODO Use stack value? */
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x20, 0x00);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
-
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
+        /* The keeper is only touched to record the last error */
+        rc = _arakoon_command_call((ArakoonCluster *) nursery->keeper,
+                options, &result,
+                ARAKOON_COMMAND_NURSERY_CONFIG);
+        _arakoon_mux_end_call(rc);
         RETURN_IF_NOT_SUCCESS(rc);
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+        rc = _arakoon_nursery_routing_parse(version, nursery->resolver_cache,
+                result.size, result.data, &routing);
+        arakoon_mem_maybe_free(result.size, result.data);
         RETURN_IF_NOT_SUCCESS(rc);
 
-        ARAKOON_PROTOCOL_READ_STRING(master, routing_data, routing_length, rc,
-                &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                arakoon_mem_free(routing);
-                return rc;
-        }
-
-        rc = _arakoon_nursery_routing_parse(version, routing_length,
-                routing_data, &routing);
-        RETURN_IF_NOT_SUCCESS(rc);
-
-        arakoon_mem_free(routing_data);
-
         nursery->routing = routing;
 
         return rc;
@@ -170,6 +152,27 @@ arakoon_rc arakoon_nursery_set(ArakoonNursery *nursery,
         return arakoon_set(cluster, options, key_size, key, value_size, value);
 }
 
+arakoon_rc arakoon_nursery_confirm(ArakoonNursery *nursery,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonCluster *cluster = NULL;
+
+        FUNCTION_ENTER(arakoon_nursery_confirm);
+
+        ASSERT_NON_NULL_RC(nursery);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(value);
+
+        cluster = _arakoon_nursery_routing_lookup(nursery->routing, key_size, key);
+        if(cluster == NULL) {
+                return ARAKOON_RC_CLIENT_NURSERY_INVALID_CONFIG;
+        }
+
+        return arakoon_confirm(cluster, options, key_size, key, value_size,
+                value);
+}
+
 arakoon_rc arakoon_nursery_delete(ArakoonNursery *nursery,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key) {
@@ -188,6 +191,29 @@ arakoon_rc arakoon_nursery_delete(ArakoonNursery *nursery,
         return arakoon_delete(cluster, options, key_size, key);
 }
 
+arakoon_rc arakoon_nursery_replace(ArakoonNursery *nursery,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value,
+    size_t *result_size, void **result) {
+        ArakoonCluster *cluster = NULL;
+
+        FUNCTION_ENTER(arakoon_nursery_replace);
+
+        ASSERT_NON_NULL_RC(nursery);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(result_size);
+        ASSERT_NON_NULL_RC(result);
+
+        cluster = _arakoon_nursery_routing_lookup(nursery->routing, key_size, key);
+        if(cluster == NULL) {
+                return ARAKOON_RC_CLIENT_NURSERY_INVALID_CONFIG;
+        }
+
+        return arakoon_replace(cluster, options, key_size, key, value_size,
+                value, result_size, result);
+}
+
 arakoon_rc arakoon_nursery_reconnect_master(const ArakoonNursery *nursery,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key) {
@@ -205,3 +231,160 @@ arakoon_rc arakoon_nursery_reconnect_master(const ArakoonNursery *nursery,
 
         return arakoon_cluster_connect_master(cluster, options);
 }
+
+/* Send the keys at indices start..size which are served by clusters[start]
+ * as a single call, and fill in their results. Handled keys are marked by
+ * clearing their cluster. */
+static arakoon_rc _arakoon_nursery_multi_get_option_cluster(
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonCluster **clusters,
+    size_t start, size_t size, ArakoonValueList *result) {
+        ArakoonCluster *cluster = clusters[start];
+        ArakoonValueList *keys_ = NULL, *result_ = NULL;
+        const void *value = NULL;
+        size_t i = 0, j = 0, value_size = 0;
+        void *data = NULL;
+        arakoon_rc rc = 0;
+
+        keys_ = arakoon_value_list_new();
+        RETURN_ENOMEM_IF_NULL(keys_);
+
+        for(i = start; i < size; i++) {
+                if(clusters[i] != cluster) {
+                        continue;
+                }
+
+                rc = arakoon_value_list_get(keys, i, &value_size, &value);
+                if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                        rc = arakoon_value_list_add(keys_, value_size, value);
+                }
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+        }
+
+        rc = arakoon_multi_get_option(cluster, options, keys_, &result_);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        for(i = start, j = 0; i < size; i++) {
+                if(clusters[i] != cluster) {
+                        continue;
+                }
+
+                clusters[i] = NULL;
+
+                rc = arakoon_value_list_get(result_, j++, &value_size, &value);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+
+                if(value == NULL) {
+                        _arakoon_value_list_set_none(result, i);
+                        continue;
+                }
+
+                data = _arakoon_value_list_set(result, i, value_size);
+                if(data == NULL) {
+                        rc = -ENOMEM;
+                        goto out;
+                }
+                if(value_size != 0) {
+                        memcpy(data, value, value_size);
+                }
+        }
+
+out:
+        arakoon_value_list_free(keys_);
+        arakoon_value_list_free(result_);
+
+        return rc;
+}
+
+arakoon_rc arakoon_nursery_multi_get_option(ArakoonNursery *nursery,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonValueList **result) {
+        ArakoonCluster **clusters = NULL;
+        ArakoonValueList *result_ = NULL;
+        arakoon_bool single = ARAKOON_BOOL_TRUE;
+        const void *key = NULL;
+        size_t i = 0, size = 0, key_size = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_nursery_multi_get_option);
+
+        ASSERT_NON_NULL_RC(nursery);
+        ASSERT_NON_NULL_RC(keys);
+        ASSERT_NON_NULL_RC(result);
+
+        *result = NULL;
+
+        size = arakoon_value_list_size(keys);
+        if(size == 0) {
+                *result = arakoon_value_list_new();
+                RETURN_ENOMEM_IF_NULL(*result);
+
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        clusters = arakoon_mem_new(size, ArakoonCluster *);
+        RETURN_ENOMEM_IF_NULL(clusters);
+
+        for(i = 0; i < size; i++) {
+                rc = arakoon_value_list_get(keys, i, &key_size, &key);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+
+                clusters[i] = _arakoon_nursery_routing_lookup(
+                        nursery->routing, key_size, key);
+                if(clusters[i] == NULL) {
+                        rc = ARAKOON_RC_CLIENT_NURSERY_INVALID_CONFIG;
+                        goto out;
+                }
+
+                if(clusters[i] != clusters[0]) {
+                        single = ARAKOON_BOOL_FALSE;
+                }
+        }
+
+        /* Most batches are served by a single cluster */
+        if(single) {
+                rc = arakoon_multi_get_option(clusters[0], options, keys,
+                        result);
+                goto out;
+        }
+
+        result_ = arakoon_value_list_new();
+        if(result_ == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
+
+        rc = _arakoon_value_list_resize(result_, size);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        for(i = 0; i < size; i++) {
+                if(clusters[i] == NULL) {
+                        continue;
+                }
+
+                rc = _arakoon_nursery_multi_get_option_cluster(options, keys,
+                        clusters, i, size, result_);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+        }
+
+        *result = result_;
+        result_ = NULL;
+
+out:
+        arakoon_value_list_free(result_);
+        arakoon_mem_free(clusters);
+
+        return rc;
+}
@@ -69,17 +69,42 @@ arakoon_rc arakoon_nursery_get(ArakoonNursery *nursery,
     const size_t key_size, const void * const key,
     size_t *result_size, void **result)
     ARAKOON_GNUC_NONNULL4(1, 4, 5, 6) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'multi_get_option' call to the nursery
+ *
+ * Keys are grouped per cluster, and a single call is sent to every cluster
+ * involved. See arakoon_multi_get_option for the layout of the result.
+ */
+arakoon_rc arakoon_nursery_multi_get_option(ArakoonNursery *nursery,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonValueList **result)
+    ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /* Send a 'set' call to the nursery */
 arakoon_rc arakoon_nursery_set(ArakoonNursery *nursery,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key,
     const size_t value_size, const void * const value)
     ARAKOON_GNUC_NONNULL3(1, 4, 6) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'confirm' call to the nursery */
+arakoon_rc arakoon_nursery_confirm(ArakoonNursery *nursery,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL3(1, 4, 6) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /* Send a 'delete' call to the nursery */
 arakoon_rc arakoon_nursery_delete(ArakoonNursery *nursery,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key)
     ARAKOON_GNUC_NONNULL2(1, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'replace' call to the nursery
+ *
+ * See arakoon_replace for the handling of 'value' and 'result'.
+ */
+arakoon_rc arakoon_nursery_replace(ArakoonNursery *nursery,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value,
+    size_t *result_size, void **result)
+    ARAKOON_GNUC_NONNULL4(1, 4, 7, 8) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 
 ARAKOON_END_DECLS
 
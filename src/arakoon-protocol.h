@@ -38,6 +38,7 @@ ARAKOON_BEGIN_DECLS
 #define ARAKOON_PROTOCOL_MAGIC_MASK1 (0xb1)
 #define ARAKOON_PROTOCOL_INT32_LEN (sizeof(int32_t))
 #define ARAKOON_PROTOCOL_UINT32_LEN (sizeof(uint32_t))
+#define ARAKOON_PROTOCOL_UINT64_LEN (sizeof(uint64_t))
 #define ARAKOON_PROTOCOL_STRING_LEN(n) \
         (ARAKOON_PROTOCOL_UINT32_LEN + n)
 #define ARAKOON_PROTOCOL_BOOL_LEN (sizeof(char))
@@ -92,20 +93,20 @@ ARAKOON_BEGIN_DECLS
         a += ARAKOON_PROTOCOL_BOOL_LEN;                                                     \
         STMT_END
 
-#define WRITE_BYTES(f, a, n, r, t)                                                    \
-        STMT_START                                                                    \
-        r = _arakoon_networking_poll_write(_arakoon_cluster_node_get_fd(f), a, n, t); \
-        if(!ARAKOON_RC_IS_SUCCESS(r)) {                                               \
-                _arakoon_cluster_node_disconnect(f);                                  \
-        }                                                                             \
+#define WRITE_BYTES(f, a, n, r, t)                             \
+        STMT_START                                             \
+        r = _arakoon_cluster_node_write_bytes(f, n, a, t);     \
+        if(!ARAKOON_RC_IS_SUCCESS(r)) {                        \
+                _arakoon_cluster_node_disconnect(f);           \
+        }                                                      \
         STMT_END
 
-#define READ_BYTES(f, a, n, r, t)                                                    \
-        STMT_START                                                                   \
-        r = _arakoon_networking_poll_read(_arakoon_cluster_node_get_fd(f), a, n, t); \
-        if(!ARAKOON_RC_IS_SUCCESS(r)) {                                              \
-                _arakoon_cluster_node_disconnect(f);                                 \
-        }                                                                            \
+#define READ_BYTES(f, a, n, r, t)                              \
+        STMT_START                                             \
+        r = _arakoon_cluster_node_read_bytes(f, n, a, t);      \
+        if(!ARAKOON_RC_IS_SUCCESS(r)) {                        \
+                _arakoon_cluster_node_disconnect(f);           \
+        }                                                      \
         STMT_END
 
 #define ARAKOON_PROTOCOL_READ_UINT32(fd, r, rc, t)    \
@@ -124,6 +125,14 @@ ARAKOON_BEGIN_DECLS
                 r = _d;                              \
         }                                            \
         STMT_END
+#define ARAKOON_PROTOCOL_READ_UINT64(fd, r, rc, t)    \
+        STMT_START                                    \
+        uint64_t _d = 0;                              \
+        READ_BYTES(fd, &_d, sizeof(uint64_t), rc, t); \
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {               \
+                r = _d;                               \
+        }                                             \
+        STMT_END
 #define ARAKOON_PROTOCOL_READ_RC(fd, rc, t)           \
         STMT_START                                    \
         arakoon_rc _rc = 0;                           \
@@ -203,88 +212,6 @@ ARAKOON_BEGIN_DECLS
         }                                                           \
         STMT_END
 
-#define ARAKOON_PROTOCOL_READ_STRING_LIST(fd, a, rc, t)                     \
-        STMT_START                                                          \
-        uint32_t _rsl_cnt = 0, _rsl_i = 0;                                  \
-        arakoon_rc _rsl_rc = 0;                                             \
-        void *_rsl_s = NULL;                                                \
-        size_t _rsl_l = 0;                                                  \
-                                                                            \
-        ARAKOON_PROTOCOL_READ_UINT32(fd, _rsl_cnt, _rsl_rc, t);             \
-        if(ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {                                \
-                for(_rsl_i = 0; _rsl_i < _rsl_cnt; _rsl_i++) {              \
-                        _rsl_l = 0;                                         \
-                        _rsl_s = NULL;                                      \
-                        ARAKOON_PROTOCOL_READ_STRING(fd, _rsl_s, _rsl_l,    \
-                                _rsl_rc, t);                                \
-                                                                            \
-                        if(!ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {               \
-                                break;                                      \
-                        }                                                   \
-                        else {                                              \
-                                /* TODO This introduces a useless memcpy */ \
-                                _rsl_rc = _arakoon_value_list_prepend(a,    \
-                                        _rsl_l, _rsl_s);                    \
-                                arakoon_mem_maybe_free(_rsl_l, _rsl_s);     \
-                                                                            \
-                                if(!ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {       \
-                                        break;                              \
-                                }                                           \
-                        }                                                   \
-                }                                                           \
-        }                                                                   \
-                                                                            \
-        rc = _rsl_rc;                                                       \
-        STMT_END
-
-#define ARAKOON_PROTOCOL_READ_STRING_STRING_LIST(fd, a, rc, t)                     \
-        STMT_START                                                                 \
-        uint32_t _rsl_cnt = 0, _rsl_i = 0;                                         \
-        arakoon_rc _rsl_rc = 0;                                                    \
-        void *_rsl_s0 = NULL, *_rsl_s1 = NULL;                                     \
-        size_t _rsl_l0 = 0, _rsl_l1 = 0;                                           \
-                                                                                   \
-        ARAKOON_PROTOCOL_READ_UINT32(fd, _rsl_cnt, _rsl_rc, t);                    \
-        if(ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {                                       \
-                for(_rsl_i = 0; _rsl_i < _rsl_cnt; _rsl_i++) {                     \
-                        _rsl_l0 = 0;                                               \
-                        _rsl_s0 = NULL;                                            \
-                        _rsl_l1 = 0;                                               \
-                        _rsl_s1 = NULL;                                            \
-                                                                                   \
-                        ARAKOON_PROTOCOL_READ_STRING(fd, _rsl_s0, _rsl_l0,         \
-                                _rsl_rc, t);                                       \
-                                                                                   \
-                        if(!ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {                      \
-                                break;                                             \
-                        }                                                          \
-                        else {                                                     \
-                                ARAKOON_PROTOCOL_READ_STRING(fd, _rsl_s1,          \
-                                        _rsl_l1, _rsl_rc, t);                      \
-                                if(!ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {              \
-                                        arakoon_mem_maybe_free(_rsl_l0, _rsl_s0);  \
-                                        break;                                     \
-                                }                                                  \
-                                else {                                             \
-                                        /* TODO This introduces a useless
-                                         * memcpy */                               \
-                                        _rsl_rc = _arakoon_key_value_list_prepend( \
-                                                a, _rsl_l0, _rsl_s0, _rsl_l1,      \
-                                                _rsl_s1);                          \
-                                        arakoon_mem_maybe_free(_rsl_l0, _rsl_s0);  \
-                                        arakoon_mem_maybe_free(_rsl_l1, _rsl_s1);  \
-                                                                                   \
-                                        if(!ARAKOON_RC_IS_SUCCESS(_rsl_rc)) {      \
-                                                break;                             \
-                                        }                                          \
-                                }                                                  \
-                        }                                                          \
-                }                                                                  \
-        }                                                                          \
-                                                                                   \
-        rc = _rsl_rc;                                                              \
-        STMT_END
-
 ARAKOON_END_DECLS
 
 #endif /* ifndef __ARAKOON_PROTOCOL_H__ */
@@ -0,0 +1,513 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-cluster.h"
+#include "arakoon-client-call-options.h"
+
+/* Pages are sized to yield responses of about this many bytes */
+#define ARAKOON_RANGE_CURSOR_PAGE_BYTES (1024 * 1024)
+/* Bytes accounted per entry on top of its key and value */
+#define ARAKOON_RANGE_CURSOR_ENTRY_OVERHEAD (8)
+#define ARAKOON_RANGE_CURSOR_FIRST_PAGE_SIZE (256)
+#define ARAKOON_RANGE_CURSOR_MIN_PAGE_SIZE (16)
+#define ARAKOON_RANGE_CURSOR_MAX_PAGE_SIZE (10000)
+
+struct ArakoonRangeCursor {
+        /* Private connection, only used by the prefetch thread */
+        ArakoonCluster *probe;
+        /* Master of the original cluster when the cursor was created */
+        char *master;
+        ArakoonClientCallOptions *options;
+        arakoon_bool reverse;
+
+        /* Bounds of the next page, owned by the prefetch thread. After the
+         * first page, the begin key is the last key fetched. */
+        size_t begin_key_size;
+        void *begin_key;
+        arakoon_bool begin_key_included;
+        size_t end_key_size;
+        void *end_key;
+        arakoon_bool end_key_included;
+        int32_t page_size;
+
+        /* Page being consumed, owned by the caller */
+        ArakoonKeyValueList *current;
+        ssize_t position;
+        arakoon_bool finished;
+        arakoon_rc finished_rc;
+
+        /* Page handed over by the prefetch thread, protected by lock */
+        arakoon_bool available;
+        ArakoonKeyValueList *ready;
+        arakoon_rc ready_rc;
+        arakoon_bool ready_last;
+        arakoon_bool stop;
+
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t wakeup;
+};
+
+static arakoon_rc _arakoon_range_cursor_set_key(size_t *key_size,
+    void **key, const size_t size, const void * const data) {
+        void *k = NULL;
+
+        if(data == NULL) {
+                k = NULL;
+        }
+        else {
+                k = arakoon_mem_new(size == 0 ? 1 : size, char);
+                RETURN_ENOMEM_IF_NULL(k);
+
+                if(size != 0) {
+                        memcpy(k, data, size);
+                }
+        }
+
+        if(*key != NULL) {
+                arakoon_mem_free(*key);
+        }
+
+        *key_size = size;
+        *key = k;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_range_cursor_connect(
+    ArakoonRangeCursor * const cursor, int *timeout) {
+        arakoon_rc rc = ARAKOON_RC_CLIENT_MASTER_NOT_FOUND;
+
+        /* Try the master known when the cursor was created first, this saves
+         * a round-trip to every other node in the common case */
+        if(cursor->master != NULL) {
+                rc = _arakoon_cluster_connect_master_by_name(cursor->probe,
+                        cursor->master, timeout);
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc) && rc != ARAKOON_RC_CLIENT_TIMEOUT) {
+                rc = _arakoon_cluster_connect_master(cursor->probe, timeout);
+        }
+
+        return rc;
+}
+
+/* Pick the size of the next page from the number of bytes per entry in the
+ * page just fetched */
+static void _arakoon_range_cursor_adapt(ArakoonRangeCursor * const cursor,
+    const ArakoonKeyValueList * const page) {
+        const void *key = NULL, *value = NULL;
+        size_t key_size = 0, value_size = 0, bytes = 0, size = 0;
+        ssize_t count = 0, i = 0;
+        arakoon_rc rc = 0;
+
+        count = arakoon_key_value_list_size(page);
+        if(count <= 0) {
+                return;
+        }
+
+        for(i = 0; i < count; i++) {
+                rc = arakoon_key_value_list_get(page, i, &key_size, &key,
+                        &value_size, &value);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        return;
+                }
+
+                bytes += key_size + value_size +
+                        ARAKOON_RANGE_CURSOR_ENTRY_OVERHEAD;
+        }
+
+        size = ARAKOON_RANGE_CURSOR_PAGE_BYTES / (bytes / count);
+
+        if(size < ARAKOON_RANGE_CURSOR_MIN_PAGE_SIZE) {
+                size = ARAKOON_RANGE_CURSOR_MIN_PAGE_SIZE;
+        }
+        if(size > ARAKOON_RANGE_CURSOR_MAX_PAGE_SIZE) {
+                size = ARAKOON_RANGE_CURSOR_MAX_PAGE_SIZE;
+        }
+
+        cursor->page_size = (int32_t) size;
+}
+
+/* Fetch the next page, and move the begin key past it. 'last' is set if
+ * the range holds no more entries. */
+static arakoon_rc _arakoon_range_cursor_fetch(
+    ArakoonRangeCursor * const cursor, ArakoonKeyValueList **page,
+    arakoon_bool *last) {
+        const void *key = NULL, *value = NULL;
+        size_t key_size = 0, value_size = 0;
+        int32_t page_size = cursor->page_size;
+        ssize_t count = 0;
+        arakoon_rc rc = 0;
+
+        *page = NULL;
+        *last = ARAKOON_BOOL_TRUE;
+
+        if(cursor->reverse) {
+                rc = arakoon_rev_range_entries(cursor->probe,
+                        cursor->options,
+                        cursor->begin_key_size, cursor->begin_key,
+                        cursor->begin_key_included,
+                        cursor->end_key_size, cursor->end_key,
+                        cursor->end_key_included,
+                        page_size, page);
+        }
+        else {
+                rc = arakoon_range_entries(cursor->probe, cursor->options,
+                        cursor->begin_key_size, cursor->begin_key,
+                        cursor->begin_key_included,
+                        cursor->end_key_size, cursor->end_key,
+                        cursor->end_key_included,
+                        page_size, page);
+        }
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        count = arakoon_key_value_list_size(*page);
+        if(count < page_size) {
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        /* A full page: continue right after its last key */
+        rc = arakoon_key_value_list_get(*page, count - 1, &key_size, &key,
+                &value_size, &value);
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = _arakoon_range_cursor_set_key(&cursor->begin_key_size,
+                        &cursor->begin_key, key_size, key);
+        }
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                arakoon_key_value_list_free(*page);
+                *page = NULL;
+                return rc;
+        }
+
+        cursor->begin_key_included = ARAKOON_BOOL_FALSE;
+        _arakoon_range_cursor_adapt(cursor, *page);
+
+        *last = ARAKOON_BOOL_FALSE;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* Prefetch thread: keeps a single page ready, so the next page is requested
+ * while the caller consumes the current one */
+static void * _arakoon_range_cursor_run(void *data) {
+        ArakoonRangeCursor *cursor = (ArakoonRangeCursor *) data;
+        ArakoonKeyValueList *page = NULL;
+        arakoon_bool last = ARAKOON_BOOL_FALSE;
+        int timeout = 0;
+        arakoon_rc rc = 0;
+
+        timeout = arakoon_client_call_options_get_timeout(cursor->options);
+        rc = _arakoon_range_cursor_connect(cursor, &timeout);
+
+        pthread_mutex_lock(&cursor->lock);
+
+        while(!cursor->stop) {
+                if(cursor->available) {
+                        pthread_cond_wait(&cursor->wakeup, &cursor->lock);
+                        continue;
+                }
+
+                pthread_mutex_unlock(&cursor->lock);
+
+                if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                        rc = _arakoon_range_cursor_fetch(cursor, &page,
+                                &last);
+                }
+
+                pthread_mutex_lock(&cursor->lock);
+
+                cursor->available = ARAKOON_BOOL_TRUE;
+                cursor->ready = page;
+                cursor->ready_rc = rc;
+                cursor->ready_last = last;
+                pthread_cond_signal(&cursor->wakeup);
+
+                page = NULL;
+
+                if(last || !ARAKOON_RC_IS_SUCCESS(rc)) {
+                        break;
+                }
+        }
+
+        pthread_mutex_unlock(&cursor->lock);
+
+        return NULL;
+}
+
+ArakoonRangeCursor * arakoon_range_cursor_new(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const arakoon_bool reverse) {
+        ArakoonRangeCursor *cursor = NULL;
+        const char *master = NULL;
+        size_t len = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_range_cursor_new);
+
+        ASSERT_NON_NULL(cluster);
+
+        cursor = arakoon_mem_new(1, ArakoonRangeCursor);
+        RETURN_NULL_IF_NULL(cursor);
+
+        memset(cursor, 0, sizeof(ArakoonRangeCursor));
+
+        cursor->probe = _arakoon_cluster_clone(cluster);
+        if(cursor->probe == NULL) {
+                goto nomem;
+        }
+
+        master = _arakoon_cluster_get_master_name(cluster);
+        if(master != NULL) {
+                len = strlen(master) + 1;
+                cursor->master = arakoon_mem_new(len, char);
+                if(cursor->master == NULL) {
+                        goto nomem;
+                }
+                strncpy(cursor->master, master, len);
+        }
+
+        /* The caller's options may be changed or released while the cursor
+         * is in use */
+        cursor->options = _arakoon_client_call_options_copy(options);
+        if(cursor->options == NULL) {
+                goto nomem;
+        }
+
+        rc = _arakoon_range_cursor_set_key(&cursor->begin_key_size,
+                &cursor->begin_key, begin_key_size, begin_key);
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = _arakoon_range_cursor_set_key(&cursor->end_key_size,
+                        &cursor->end_key, end_key_size, end_key);
+        }
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto nomem;
+        }
+
+        cursor->begin_key_included = begin_key_included;
+        cursor->end_key_included = end_key_included;
+        cursor->reverse = reverse;
+        cursor->page_size = ARAKOON_RANGE_CURSOR_FIRST_PAGE_SIZE;
+
+        cursor->current = NULL;
+        cursor->position = 0;
+        cursor->finished = ARAKOON_BOOL_FALSE;
+        cursor->finished_rc = ARAKOON_RC_SUCCESS;
+
+        cursor->available = ARAKOON_BOOL_FALSE;
+        cursor->ready = NULL;
+        cursor->stop = ARAKOON_BOOL_FALSE;
+
+        pthread_mutex_init(&cursor->lock, NULL);
+        pthread_cond_init(&cursor->wakeup, NULL);
+
+        rc = pthread_create(&cursor->thread, NULL, _arakoon_range_cursor_run,
+                cursor);
+        if(rc != 0) {
+                _arakoon_log_error(
+                        "arakoon-range-cursor: unable to start thread: %s",
+                        strerror(rc));
+
+                pthread_cond_destroy(&cursor->wakeup);
+                pthread_mutex_destroy(&cursor->lock);
+
+                goto nomem;
+        }
+
+        return cursor;
+
+nomem:
+        if(cursor->begin_key != NULL) {
+                arakoon_mem_free(cursor->begin_key);
+        }
+        if(cursor->end_key != NULL) {
+                arakoon_mem_free(cursor->end_key);
+        }
+        if(cursor->options != NULL) {
+                arakoon_client_call_options_free(cursor->options);
+        }
+        if(cursor->master != NULL) {
+                arakoon_mem_free(cursor->master);
+        }
+        if(cursor->probe != NULL) {
+                arakoon_cluster_free(cursor->probe);
+        }
+        arakoon_mem_free(cursor);
+
+        return NULL;
+}
+
+ArakoonRangeCursor * arakoon_range_cursor_new_prefix(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t prefix_size, const void * const prefix,
+    const arakoon_bool reverse) {
+        ArakoonRangeCursor *cursor = NULL;
+        void *end = NULL;
+        size_t end_size = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_range_cursor_new_prefix);
+
+        ASSERT_NON_NULL(cluster);
+        ASSERT_NON_NULL(prefix);
+
+        rc = _arakoon_prefix_end(prefix_size, prefix, &end_size, &end);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                return NULL;
+        }
+
+        /* A reverse range starts at its upper bound */
+        if(reverse) {
+                cursor = arakoon_range_cursor_new(cluster, options,
+                        end_size, end, ARAKOON_BOOL_FALSE,
+                        prefix_size, prefix, ARAKOON_BOOL_TRUE,
+                        ARAKOON_BOOL_TRUE);
+        }
+        else {
+                cursor = arakoon_range_cursor_new(cluster, options,
+                        prefix_size, prefix, ARAKOON_BOOL_TRUE,
+                        end_size, end, ARAKOON_BOOL_FALSE,
+                        ARAKOON_BOOL_FALSE);
+        }
+
+        if(end != NULL) {
+                arakoon_mem_free(end);
+        }
+
+        return cursor;
+}
+
+void arakoon_range_cursor_free(ArakoonRangeCursor *cursor) {
+        FUNCTION_ENTER(arakoon_range_cursor_free);
+
+        RETURN_IF_NULL(cursor);
+
+        pthread_mutex_lock(&cursor->lock);
+        cursor->stop = ARAKOON_BOOL_TRUE;
+        pthread_cond_signal(&cursor->wakeup);
+        pthread_mutex_unlock(&cursor->lock);
+
+        pthread_join(cursor->thread, NULL);
+
+        pthread_cond_destroy(&cursor->wakeup);
+        pthread_mutex_destroy(&cursor->lock);
+
+        if(cursor->ready != NULL) {
+                arakoon_key_value_list_free(cursor->ready);
+        }
+        if(cursor->current != NULL) {
+                arakoon_key_value_list_free(cursor->current);
+        }
+        if(cursor->begin_key != NULL) {
+                arakoon_mem_free(cursor->begin_key);
+        }
+        if(cursor->end_key != NULL) {
+                arakoon_mem_free(cursor->end_key);
+        }
+        if(cursor->master != NULL) {
+                arakoon_mem_free(cursor->master);
+        }
+
+        arakoon_client_call_options_free(cursor->options);
+        arakoon_cluster_free(cursor->probe);
+        arakoon_mem_free(cursor);
+}
+
+arakoon_rc arakoon_range_cursor_next(ArakoonRangeCursor * const cursor,
+    size_t * const key_size, const void ** const key,
+    size_t * const value_size, const void ** const value) {
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_range_cursor_next);
+
+        ASSERT_NON_NULL_RC(cursor);
+        ASSERT_NON_NULL_RC(key_size);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(value_size);
+        ASSERT_NON_NULL_RC(value);
+
+        *key_size = 0;
+        *key = NULL;
+        *value_size = 0;
+        *value = NULL;
+
+        while(1) {
+                if(cursor->current != NULL &&
+                    cursor->position <
+                    arakoon_key_value_list_size(cursor->current)) {
+                        rc = arakoon_key_value_list_get(cursor->current,
+                                cursor->position, key_size, key, value_size,
+                                value);
+                        RETURN_IF_NOT_SUCCESS(rc);
+
+                        cursor->position++;
+
+                        return ARAKOON_RC_SUCCESS;
+                }
+
+                if(cursor->current != NULL) {
+                        arakoon_key_value_list_free(cursor->current);
+                        cursor->current = NULL;
+                }
+
+                if(cursor->finished) {
+                        return cursor->finished_rc;
+                }
+
+                /* Take the prefetched page, which lets the thread request
+                 * the one after it */
+                pthread_mutex_lock(&cursor->lock);
+                while(!cursor->available) {
+                        pthread_cond_wait(&cursor->wakeup, &cursor->lock);
+                }
+
+                cursor->current = cursor->ready;
+                cursor->position = 0;
+                cursor->finished = cursor->ready_last;
+                cursor->finished_rc = cursor->ready_rc;
+
+                cursor->available = ARAKOON_BOOL_FALSE;
+                cursor->ready = NULL;
+                pthread_cond_signal(&cursor->wakeup);
+                pthread_mutex_unlock(&cursor->lock);
+
+                if(!ARAKOON_RC_IS_SUCCESS(cursor->finished_rc)) {
+                        cursor->finished = ARAKOON_BOOL_TRUE;
+                        return cursor->finished_rc;
+                }
+        }
+}
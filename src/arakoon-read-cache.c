@@ -0,0 +1,522 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-networking.h"
+#include "arakoon-read-cache.h"
+
+/* Must be a power of 2 */
+#define ARAKOON_READ_CACHE_SHARDS (16)
+#define ARAKOON_READ_CACHE_MIN_BUCKETS (64)
+
+typedef struct ArakoonReadCacheEntry ArakoonReadCacheEntry;
+struct ArakoonReadCacheEntry {
+        /* Next entry in the same hash bucket */
+        ArakoonReadCacheEntry *next;
+        /* LRU list, most recently used first */
+        ArakoonReadCacheEntry *lru_prev;
+        ArakoonReadCacheEntry *lru_next;
+
+        uint32_t hash;
+        /* Monotonic time after which the entry is stale, 0 if never */
+        uint64_t expires_usec;
+
+        arakoon_bool exists;
+        size_t key_size;
+        size_t value_size;
+        /* The key and the value follow the entry, in the same allocation */
+};
+
+#define ARAKOON_READ_CACHE_ENTRY_KEY(e) ((char *) ((e) + 1))
+#define ARAKOON_READ_CACHE_ENTRY_VALUE(e) \
+        (ARAKOON_READ_CACHE_ENTRY_KEY(e) + (e)->key_size)
+
+typedef struct {
+        pthread_mutex_t lock;
+        uint64_t generation;
+
+        ArakoonReadCacheEntry **buckets;
+        size_t bucket_count;
+
+        ArakoonReadCacheEntry *lru_head;
+        ArakoonReadCacheEntry *lru_tail;
+
+        size_t entries;
+        size_t bytes;
+
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t expirations;
+} ArakoonReadCacheShard;
+
+struct ArakoonReadCache {
+        /* Memory budget of every shard, including entry overhead */
+        size_t shard_bytes;
+        uint64_t ttl_usec;
+
+        ArakoonReadCacheShard shards[ARAKOON_READ_CACHE_SHARDS];
+};
+
+ArakoonReadCache * _arakoon_read_cache_new(const size_t max_bytes,
+    const unsigned int ttl_msec) {
+        ArakoonReadCache *cache = NULL;
+        ArakoonReadCacheShard *shard = NULL;
+        size_t i = 0;
+
+        FUNCTION_ENTER(_arakoon_read_cache_new);
+
+        cache = arakoon_mem_new(1, ArakoonReadCache);
+        RETURN_NULL_IF_NULL(cache);
+
+        memset(cache, 0, sizeof(ArakoonReadCache));
+
+        cache->shard_bytes = max_bytes / ARAKOON_READ_CACHE_SHARDS;
+        cache->ttl_usec = (uint64_t) ttl_msec * US_PER_MS;
+
+        for(i = 0; i < ARAKOON_READ_CACHE_SHARDS; i++) {
+                shard = &cache->shards[i];
+
+                shard->buckets = arakoon_mem_new(
+                        ARAKOON_READ_CACHE_MIN_BUCKETS,
+                        ArakoonReadCacheEntry *);
+                if(shard->buckets == NULL) {
+                        goto nomem;
+                }
+                memset(shard->buckets, 0, ARAKOON_READ_CACHE_MIN_BUCKETS *
+                        sizeof(ArakoonReadCacheEntry *));
+                shard->bucket_count = ARAKOON_READ_CACHE_MIN_BUCKETS;
+        }
+
+        for(i = 0; i < ARAKOON_READ_CACHE_SHARDS; i++) {
+                pthread_mutex_init(&cache->shards[i].lock, NULL);
+        }
+
+        return cache;
+
+nomem:
+        for(i = 0; i < ARAKOON_READ_CACHE_SHARDS; i++) {
+                if(cache->shards[i].buckets != NULL) {
+                        arakoon_mem_free(cache->shards[i].buckets);
+                }
+        }
+        arakoon_mem_free(cache);
+
+        errno = ENOMEM;
+        return NULL;
+}
+
+void _arakoon_read_cache_free(ArakoonReadCache *cache) {
+        ArakoonReadCacheShard *shard = NULL;
+        ArakoonReadCacheEntry *entry = NULL, *next = NULL;
+        size_t i = 0;
+
+        FUNCTION_ENTER(_arakoon_read_cache_free);
+
+        RETURN_IF_NULL(cache);
+
+        for(i = 0; i < ARAKOON_READ_CACHE_SHARDS; i++) {
+                shard = &cache->shards[i];
+
+                for(entry = shard->lru_head; entry != NULL; entry = next) {
+                        next = entry->lru_next;
+                        arakoon_mem_free(entry);
+                }
+
+                arakoon_mem_free(shard->buckets);
+                pthread_mutex_destroy(&shard->lock);
+        }
+
+        arakoon_mem_free(cache);
+}
+
+/* The top bits select the shard, the bottom bits the bucket in it */
+static ArakoonReadCacheShard * _arakoon_read_cache_get_shard(
+    ArakoonReadCache * const cache, const uint32_t hash) {
+        return &cache->shards[(hash >> 28) & (ARAKOON_READ_CACHE_SHARDS - 1)];
+}
+
+static ArakoonReadCacheEntry * _arakoon_read_cache_find(
+    const ArakoonReadCacheShard * const shard, const uint32_t hash,
+    const size_t key_size, const void * const key) {
+        ArakoonReadCacheEntry *entry = NULL;
+
+        for(entry = shard->buckets[hash & (shard->bucket_count - 1)];
+            entry != NULL; entry = entry->next) {
+                if(entry->hash == hash && entry->key_size == key_size &&
+                    memcmp(ARAKOON_READ_CACHE_ENTRY_KEY(entry), key,
+                        key_size) == 0) {
+                        return entry;
+                }
+        }
+
+        return NULL;
+}
+
+static void _arakoon_read_cache_lru_unlink(ArakoonReadCacheShard * const shard,
+    ArakoonReadCacheEntry * const entry) {
+        if(entry->lru_prev == NULL) {
+                shard->lru_head = entry->lru_next;
+        }
+        else {
+                entry->lru_prev->lru_next = entry->lru_next;
+        }
+
+        if(entry->lru_next == NULL) {
+                shard->lru_tail = entry->lru_prev;
+        }
+        else {
+                entry->lru_next->lru_prev = entry->lru_prev;
+        }
+
+        entry->lru_prev = NULL;
+        entry->lru_next = NULL;
+}
+
+static void _arakoon_read_cache_lru_push(ArakoonReadCacheShard * const shard,
+    ArakoonReadCacheEntry * const entry) {
+        entry->lru_prev = NULL;
+        entry->lru_next = shard->lru_head;
+
+        if(shard->lru_head == NULL) {
+                shard->lru_tail = entry;
+        }
+        else {
+                shard->lru_head->lru_prev = entry;
+        }
+        shard->lru_head = entry;
+}
+
+static size_t _arakoon_read_cache_entry_bytes(
+    const ArakoonReadCacheEntry * const entry) {
+        return sizeof(ArakoonReadCacheEntry) + entry->key_size +
+                entry->value_size;
+}
+
+static void _arakoon_read_cache_remove(ArakoonReadCacheShard * const shard,
+    ArakoonReadCacheEntry * const entry) {
+        ArakoonReadCacheEntry **link = NULL;
+
+        link = &shard->buckets[entry->hash & (shard->bucket_count - 1)];
+        while(*link != entry) {
+                link = &(*link)->next;
+        }
+        *link = entry->next;
+
+        _arakoon_read_cache_lru_unlink(shard, entry);
+
+        shard->entries--;
+        shard->bytes -= _arakoon_read_cache_entry_bytes(entry);
+
+        arakoon_mem_free(entry);
+}
+
+/* Double the number of buckets once there are more entries than buckets.
+ * If that fails, the chains just get longer. */
+static void _arakoon_read_cache_maybe_grow(
+    ArakoonReadCacheShard * const shard) {
+        ArakoonReadCacheEntry **buckets = NULL;
+        ArakoonReadCacheEntry *entry = NULL, *next = NULL;
+        size_t count = 0, i = 0, bucket = 0;
+
+        if(shard->entries <= shard->bucket_count) {
+                return;
+        }
+
+        count = 2 * shard->bucket_count;
+        buckets = arakoon_mem_new(count, ArakoonReadCacheEntry *);
+        if(buckets == NULL) {
+                return;
+        }
+        memset(buckets, 0, count * sizeof(ArakoonReadCacheEntry *));
+
+        for(i = 0; i < shard->bucket_count; i++) {
+                for(entry = shard->buckets[i]; entry != NULL; entry = next) {
+                        next = entry->next;
+
+                        bucket = entry->hash & (count - 1);
+                        entry->next = buckets[bucket];
+                        buckets[bucket] = entry;
+                }
+        }
+
+        arakoon_mem_free(shard->buckets);
+        shard->buckets = buckets;
+        shard->bucket_count = count;
+}
+
+/* Replace the entry of a key, evicting the least recently used entries to
+ * stay within the budget of the shard. Entries which don't fit in the
+ * budget at all aren't stored. */
+static void _arakoon_read_cache_store(const ArakoonReadCache * const cache,
+    ArakoonReadCacheShard * const shard, const uint32_t hash,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonReadCacheEntry *entry = NULL;
+        size_t bucket = 0, size = 0;
+
+        entry = _arakoon_read_cache_find(shard, hash, key_size, key);
+        if(entry != NULL) {
+                _arakoon_read_cache_remove(shard, entry);
+        }
+
+        size = sizeof(ArakoonReadCacheEntry) + key_size +
+                (value == NULL ? 0 : value_size);
+        if(size > cache->shard_bytes) {
+                return;
+        }
+
+        while(shard->bytes + size > cache->shard_bytes) {
+                _arakoon_read_cache_remove(shard, shard->lru_tail);
+                shard->evictions++;
+        }
+
+        entry = (ArakoonReadCacheEntry *) arakoon_mem_new(size, char);
+        if(entry == NULL) {
+                return;
+        }
+
+        entry->hash = hash;
+        entry->expires_usec = cache->ttl_usec == 0 ? 0 :
+                _arakoon_networking_monotonic_usec() + cache->ttl_usec;
+        entry->exists = value == NULL ? ARAKOON_BOOL_FALSE : ARAKOON_BOOL_TRUE;
+        entry->key_size = key_size;
+        entry->value_size = value == NULL ? 0 : value_size;
+
+        memcpy(ARAKOON_READ_CACHE_ENTRY_KEY(entry), key, key_size);
+        if(entry->value_size != 0) {
+                memcpy(ARAKOON_READ_CACHE_ENTRY_VALUE(entry), value,
+                        value_size);
+        }
+
+        bucket = hash & (shard->bucket_count - 1);
+        entry->next = shard->buckets[bucket];
+        shard->buckets[bucket] = entry;
+
+        _arakoon_read_cache_lru_push(shard, entry);
+
+        shard->entries++;
+        shard->bytes += size;
+
+        _arakoon_read_cache_maybe_grow(shard);
+}
+
+arakoon_rc _arakoon_read_cache_get(ArakoonReadCache * const cache,
+    const size_t key_size, const void * const key, uint64_t *ticket,
+    ArakoonReadCacheAlloc alloc, void *data) {
+        ArakoonReadCacheShard *shard = NULL;
+        ArakoonReadCacheEntry *entry = NULL;
+        void *value = NULL;
+        uint32_t hash = 0;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        FUNCTION_ENTER(_arakoon_read_cache_get);
+
+        hash = _arakoon_hash(key_size, key);
+        shard = _arakoon_read_cache_get_shard(cache, hash);
+
+        pthread_mutex_lock(&shard->lock);
+
+        entry = _arakoon_read_cache_find(shard, hash, key_size, key);
+        if(entry != NULL && entry->expires_usec != 0 &&
+            _arakoon_networking_monotonic_usec() > entry->expires_usec) {
+                _arakoon_read_cache_remove(shard, entry);
+                shard->expirations++;
+                entry = NULL;
+        }
+
+        if(entry == NULL) {
+                shard->misses++;
+                *ticket = shard->generation;
+
+                pthread_mutex_unlock(&shard->lock);
+
+                return -ENOENT;
+        }
+
+        shard->hits++;
+
+        if(entry != shard->lru_head) {
+                _arakoon_read_cache_lru_unlink(shard, entry);
+                _arakoon_read_cache_lru_push(shard, entry);
+        }
+
+        if(!entry->exists) {
+                rc = ARAKOON_RC_NOT_FOUND;
+        }
+        else if(alloc != NULL) {
+                value = alloc(entry->value_size, data);
+                if(value == NULL) {
+                        rc = -ENOMEM;
+                }
+                else if(entry->value_size != 0) {
+                        memcpy(value, ARAKOON_READ_CACHE_ENTRY_VALUE(entry),
+                                entry->value_size);
+                }
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        return rc;
+}
+
+uint64_t _arakoon_read_cache_ticket(ArakoonReadCache * const cache,
+    const size_t key_size, const void * const key) {
+        ArakoonReadCacheShard *shard = NULL;
+        uint64_t ticket = 0;
+
+        shard = _arakoon_read_cache_get_shard(cache,
+                _arakoon_hash(key_size, key));
+
+        pthread_mutex_lock(&shard->lock);
+        ticket = shard->generation;
+        pthread_mutex_unlock(&shard->lock);
+
+        return ticket;
+}
+
+void _arakoon_read_cache_fill(ArakoonReadCache * const cache,
+    const uint64_t ticket, const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonReadCacheShard *shard = NULL;
+        uint32_t hash = 0;
+
+        hash = _arakoon_hash(key_size, key);
+        shard = _arakoon_read_cache_get_shard(cache, hash);
+
+        pthread_mutex_lock(&shard->lock);
+
+        if(shard->generation == ticket) {
+                _arakoon_read_cache_store(cache, shard, hash, key_size, key,
+                        value_size, value);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+}
+
+void _arakoon_read_cache_update(ArakoonReadCache * const cache,
+    const uint64_t ticket, const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonReadCacheShard *shard = NULL;
+        ArakoonReadCacheEntry *entry = NULL;
+        uint32_t hash = 0;
+
+        hash = _arakoon_hash(key_size, key);
+        shard = _arakoon_read_cache_get_shard(cache, hash);
+
+        pthread_mutex_lock(&shard->lock);
+
+        if(shard->generation == ticket) {
+                _arakoon_read_cache_store(cache, shard, hash, key_size, key,
+                        value_size, value);
+        }
+        else {
+                entry = _arakoon_read_cache_find(shard, hash, key_size, key);
+                if(entry != NULL) {
+                        _arakoon_read_cache_remove(shard, entry);
+                }
+        }
+
+        /* Reads sent before the write completed may return the old value */
+        shard->generation++;
+
+        pthread_mutex_unlock(&shard->lock);
+}
+
+void _arakoon_read_cache_invalidate(ArakoonReadCache * const cache,
+    const size_t key_size, const void * const key) {
+        ArakoonReadCacheShard *shard = NULL;
+        ArakoonReadCacheEntry *entry = NULL;
+        uint32_t hash = 0;
+
+        hash = _arakoon_hash(key_size, key);
+        shard = _arakoon_read_cache_get_shard(cache, hash);
+
+        pthread_mutex_lock(&shard->lock);
+
+        entry = _arakoon_read_cache_find(shard, hash, key_size, key);
+        if(entry != NULL) {
+                _arakoon_read_cache_remove(shard, entry);
+        }
+
+        shard->generation++;
+
+        pthread_mutex_unlock(&shard->lock);
+}
+
+void _arakoon_read_cache_invalidate_prefix(ArakoonReadCache * const cache,
+    const size_t prefix_size, const void * const prefix) {
+        ArakoonReadCacheShard *shard = NULL;
+        ArakoonReadCacheEntry *entry = NULL, *next = NULL;
+        size_t i = 0;
+
+        for(i = 0; i < ARAKOON_READ_CACHE_SHARDS; i++) {
+                shard = &cache->shards[i];
+
+                pthread_mutex_lock(&shard->lock);
+
+                for(entry = shard->lru_head; entry != NULL; entry = next) {
+                        next = entry->lru_next;
+
+                        if(prefix_size == 0 ||
+                            (entry->key_size >= prefix_size &&
+                             memcmp(ARAKOON_READ_CACHE_ENTRY_KEY(entry),
+                                prefix, prefix_size) == 0)) {
+                                _arakoon_read_cache_remove(shard, entry);
+                        }
+                }
+
+                shard->generation++;
+
+                pthread_mutex_unlock(&shard->lock);
+        }
+}
+
+void _arakoon_read_cache_get_stats(ArakoonReadCache * const cache,
+    ArakoonReadCacheStats * const stats) {
+        ArakoonReadCacheShard *shard = NULL;
+        size_t i = 0;
+
+        memset(stats, 0, sizeof(ArakoonReadCacheStats));
+
+        for(i = 0; i < ARAKOON_READ_CACHE_SHARDS; i++) {
+                shard = &cache->shards[i];
+
+                pthread_mutex_lock(&shard->lock);
+
+                stats->hits += shard->hits;
+                stats->misses += shard->misses;
+                stats->evictions += shard->evictions;
+                stats->expirations += shard->expirations;
+                stats->entries += shard->entries;
+                stats->bytes += shard->bytes;
+
+                pthread_mutex_unlock(&shard->lock);
+        }
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __ARAKOON_READ_CACHE_H__
+#define __ARAKOON_READ_CACHE_H__
+
+#include <stdint.h>
+
+#include "arakoon.h"
+
+ARAKOON_BEGIN_DECLS
+
+/* Cache of values read using 'allow_dirty' calls
+ *
+ * Entries are spread over a fixed number of shards, each holding its own
+ * lock, hash table and LRU list, and each limited to an equal part of the
+ * memory budget. Entries either hold the value of a key, or record that the
+ * key doesn't exist.
+ *
+ * Every shard keeps a generation, bumped whenever a write is made through
+ * the cluster. A read takes a ticket, the current generation, before it is
+ * sent, and its result is only stored if no write happened in between, so
+ * a slow read can't overwrite the result of a write.
+ */
+typedef struct ArakoonReadCache ArakoonReadCache;
+
+ArakoonReadCache * _arakoon_read_cache_new(const size_t max_bytes,
+    const unsigned int ttl_msec)
+    ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+void _arakoon_read_cache_free(ArakoonReadCache *cache);
+
+/* Return a buffer of 'size' bytes to copy a cached value into, or NULL on
+ * allocation failure */
+typedef void * (*ArakoonReadCacheAlloc)(const size_t size, void *data);
+
+/* Look up a key
+ *
+ * Returns -ENOENT on a miss, storing the ticket to pass to
+ * _arakoon_read_cache_fill in 'ticket'. Returns ARAKOON_RC_NOT_FOUND if the
+ * key is known not to exist. Otherwise, the value is copied into the buffer
+ * returned by 'alloc', unless 'alloc' is NULL. */
+arakoon_rc _arakoon_read_cache_get(ArakoonReadCache * const cache,
+    const size_t key_size, const void * const key, uint64_t *ticket,
+    ArakoonReadCacheAlloc alloc, void *data)
+    ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* The ticket of a key, to be taken before sending a write to it */
+uint64_t _arakoon_read_cache_ticket(ArakoonReadCache * const cache,
+    const size_t key_size, const void * const key)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/* Store the value read for a key, or record that it doesn't exist when
+ * 'value' is NULL, unless a write happened since 'ticket' was taken */
+void _arakoon_read_cache_fill(ArakoonReadCache * const cache,
+    const uint64_t ticket, const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL2(1, 4);
+/* Store the value written to a key, or record that it doesn't exist when
+ * 'value' is NULL. The entry is dropped instead if another write happened
+ * since 'ticket' was taken, since their order isn't known. */
+void _arakoon_read_cache_update(ArakoonReadCache * const cache,
+    const uint64_t ticket, const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL2(1, 4);
+/* Drop the entry of a key after a write of which the outcome isn't known */
+void _arakoon_read_cache_invalidate(ArakoonReadCache * const cache,
+    const size_t key_size, const void * const key) ARAKOON_GNUC_NONNULL;
+/* Drop all entries of which the key starts with 'prefix'. Use an empty
+ * prefix to drop everything. */
+void _arakoon_read_cache_invalidate_prefix(ArakoonReadCache * const cache,
+    const size_t prefix_size, const void * const prefix)
+    ARAKOON_GNUC_NONNULL1(1);
+
+void _arakoon_read_cache_get_stats(ArakoonReadCache * const cache,
+    ArakoonReadCacheStats * const stats) ARAKOON_GNUC_NONNULL;
+
+ARAKOON_END_DECLS
+
+#endif /* ifndef __ARAKOON_READ_CACHE_H__ */
@@ -0,0 +1,373 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-client-call-options.h"
+#include "arakoon-read-coalescer.h"
+
+/* A batch is sent right away once it holds this many keys */
+#define ARAKOON_READ_COALESCER_MAX_KEYS (256)
+
+/* A single 'get', on the stack of the caller waiting for it. The first
+ * request for a key in a batch holds the key, later requests for the same
+ * key are queued on it as followers. */
+typedef struct ArakoonReadCoalescerRequest ArakoonReadCoalescerRequest;
+struct ArakoonReadCoalescerRequest {
+        ArakoonReadCoalescerRequest *next_key;
+        ArakoonReadCoalescerRequest *followers;
+        ArakoonReadCoalescerRequest *next_follower;
+
+        uint32_t hash;
+        size_t key_size;
+        const void *key;
+
+        arakoon_bool done;
+        arakoon_rc rc;
+        size_t value_size;
+        void *value;
+};
+
+/* The keys fetched by a single call, on the stack of the caller sending it */
+typedef struct ArakoonReadCoalescerBatch ArakoonReadCoalescerBatch;
+struct ArakoonReadCoalescerBatch {
+        ArakoonReadCoalescerBatch *next;
+
+        /* Only callers using the same options share a batch */
+        arakoon_bool allow_dirty;
+        int timeout;
+        /* Whether keys can still be added */
+        arakoon_bool open;
+
+        ArakoonReadCoalescerRequest *keys;
+        ArakoonReadCoalescerRequest *last;
+        size_t count;
+};
+
+struct ArakoonReadCoalescer {
+        unsigned int window_usec;
+
+        /* Batches which are open or in flight, protected by lock */
+        ArakoonReadCoalescerBatch *batches;
+
+        pthread_mutex_t lock;
+        /* Signalled when an open batch is full */
+        pthread_cond_t full;
+        /* Signalled when a batch completes */
+        pthread_cond_t done;
+};
+
+ArakoonReadCoalescer * _arakoon_read_coalescer_new(
+    const unsigned int window_usec) {
+        ArakoonReadCoalescer *coalescer = NULL;
+
+        FUNCTION_ENTER(_arakoon_read_coalescer_new);
+
+        coalescer = arakoon_mem_new(1, ArakoonReadCoalescer);
+        RETURN_NULL_IF_NULL(coalescer);
+
+        memset(coalescer, 0, sizeof(ArakoonReadCoalescer));
+
+        coalescer->window_usec = window_usec;
+        coalescer->batches = NULL;
+
+        pthread_mutex_init(&coalescer->lock, NULL);
+        _arakoon_cond_init_monotonic(&coalescer->full);
+        pthread_cond_init(&coalescer->done, NULL);
+
+        return coalescer;
+}
+
+void _arakoon_read_coalescer_free(ArakoonReadCoalescer *coalescer) {
+        FUNCTION_ENTER(_arakoon_read_coalescer_free);
+
+        RETURN_IF_NULL(coalescer);
+
+        pthread_cond_destroy(&coalescer->done);
+        pthread_cond_destroy(&coalescer->full);
+        pthread_mutex_destroy(&coalescer->lock);
+
+        arakoon_mem_free(coalescer);
+}
+
+static arakoon_bool _arakoon_read_coalescer_batch_matches(
+    const ArakoonReadCoalescerBatch * const batch,
+    const arakoon_bool allow_dirty, const int timeout) {
+        return (batch->allow_dirty == allow_dirty &&
+                batch->timeout == timeout);
+}
+
+/* Find the request holding the key of 'request' in a batch the caller can
+ * join. A batch which is in flight may have been sent before a write which
+ * completed already, so only dirty reads can wait for one, consistent reads
+ * only join a batch which is still open. */
+static ArakoonReadCoalescerRequest * _arakoon_read_coalescer_find(
+    const ArakoonReadCoalescer * const coalescer,
+    const arakoon_bool allow_dirty, const int timeout,
+    const ArakoonReadCoalescerRequest * const request) {
+        ArakoonReadCoalescerBatch *batch = NULL;
+        ArakoonReadCoalescerRequest *r = NULL;
+
+        for(batch = coalescer->batches; batch != NULL; batch = batch->next) {
+                if(!_arakoon_read_coalescer_batch_matches(batch, allow_dirty,
+                    timeout)) {
+                        continue;
+                }
+
+                if(!allow_dirty && !batch->open) {
+                        continue;
+                }
+
+                for(r = batch->keys; r != NULL; r = r->next_key) {
+                        if(r->hash == request->hash &&
+                            r->key_size == request->key_size &&
+                            memcmp(r->key, request->key,
+                                request->key_size) == 0) {
+                                return r;
+                        }
+                }
+        }
+
+        return NULL;
+}
+
+static void _arakoon_read_coalescer_add_key(
+    ArakoonReadCoalescerBatch * const batch,
+    ArakoonReadCoalescerRequest * const request) {
+        if(batch->last == NULL) {
+                batch->keys = request;
+        }
+        else {
+                batch->last->next_key = request;
+        }
+        batch->last = request;
+        batch->count++;
+}
+
+/* Store the outcome of a fetch in a request */
+static void _arakoon_read_coalescer_set_result(
+    ArakoonReadCoalescerRequest * const request, arakoon_rc rc,
+    const size_t value_size, const void * const value) {
+        request->rc = rc;
+        request->value_size = 0;
+        request->value = NULL;
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                return;
+        }
+
+        if(value == NULL) {
+                request->rc = ARAKOON_RC_NOT_FOUND;
+                return;
+        }
+
+        /* Every caller owns its result, like with a plain 'get' */
+        if(value_size == 0) {
+                request->value = ARAKOON_ZERO_LENGTH_DATA_PTR;
+                return;
+        }
+
+        request->value = arakoon_mem_new(value_size, char);
+        if(request->value == NULL) {
+                request->rc = -ENOMEM;
+                return;
+        }
+
+        memcpy(request->value, value, value_size);
+        request->value_size = value_size;
+}
+
+/* Send the call for a closed batch, and complete all of its requests */
+static void _arakoon_read_coalescer_send(
+    ArakoonReadCoalescer * const coalescer,
+    ArakoonReadCoalescerBatch * const batch,
+    ArakoonCluster *cluster, const ArakoonClientCallOptions * const options) {
+        ArakoonReadCoalescerBatch **b = NULL;
+        ArakoonReadCoalescerRequest *r = NULL, *f = NULL;
+        ArakoonValueList *keys = NULL, *values = NULL;
+        const void *value = NULL;
+        size_t value_size = 0, i = 0;
+        arakoon_rc rc = 0, value_rc = 0;
+
+        /* No keys are added once a batch is closed, only followers */
+        keys = arakoon_value_list_new();
+        if(keys == NULL) {
+                rc = -ENOMEM;
+        }
+
+        for(r = batch->keys; ARAKOON_RC_IS_SUCCESS(rc) && r != NULL;
+            r = r->next_key) {
+                rc = arakoon_value_list_add(keys, r->key_size, r->key);
+        }
+
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = arakoon_multi_get_option(cluster, options, keys,
+                        &values);
+        }
+
+        if(keys != NULL) {
+                arakoon_value_list_free(keys);
+        }
+
+        /* Unlink the batch, so no more followers join it */
+        pthread_mutex_lock(&coalescer->lock);
+        for(b = &coalescer->batches; *b != batch; b = &(*b)->next) {
+        }
+        *b = batch->next;
+        pthread_mutex_unlock(&coalescer->lock);
+
+        for(r = batch->keys, i = 0; r != NULL; r = r->next_key, i++) {
+                value_rc = rc;
+                value_size = 0;
+                value = NULL;
+
+                if(ARAKOON_RC_IS_SUCCESS(value_rc)) {
+                        value_rc = arakoon_value_list_get(values, i,
+                                &value_size, &value);
+                }
+
+                _arakoon_read_coalescer_set_result(r, value_rc, value_size,
+                        value);
+                for(f = r->followers; f != NULL; f = f->next_follower) {
+                        _arakoon_read_coalescer_set_result(f, value_rc,
+                                value_size, value);
+                }
+        }
+
+        if(values != NULL) {
+                arakoon_value_list_free(values);
+        }
+
+        pthread_mutex_lock(&coalescer->lock);
+        for(r = batch->keys; r != NULL; r = r->next_key) {
+                r->done = ARAKOON_BOOL_TRUE;
+                for(f = r->followers; f != NULL; f = f->next_follower) {
+                        f->done = ARAKOON_BOOL_TRUE;
+                }
+        }
+        pthread_cond_broadcast(&coalescer->done);
+        pthread_mutex_unlock(&coalescer->lock);
+}
+
+arakoon_rc _arakoon_read_coalescer_get(ArakoonReadCoalescer * const coalescer,
+    ArakoonCluster *cluster, const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    size_t *result_size, void **result) {
+        ArakoonReadCoalescerRequest request;
+        ArakoonReadCoalescerRequest *owner = NULL;
+        ArakoonReadCoalescerBatch batch;
+        ArakoonReadCoalescerBatch *open = NULL;
+        struct timespec deadline = {0, 0};
+        arakoon_bool allow_dirty = ARAKOON_BOOL_FALSE;
+        int timeout = 0;
+
+        FUNCTION_ENTER(_arakoon_read_coalescer_get);
+
+        READ_OPTIONS;
+        allow_dirty = arakoon_client_call_options_get_allow_dirty(options_);
+        timeout = arakoon_client_call_options_get_timeout(options_);
+
+        memset(&request, 0, sizeof(ArakoonReadCoalescerRequest));
+        request.hash = _arakoon_hash(key_size, key);
+        request.key_size = key_size;
+        request.key = key;
+        request.done = ARAKOON_BOOL_FALSE;
+
+        pthread_mutex_lock(&coalescer->lock);
+
+        owner = _arakoon_read_coalescer_find(coalescer, allow_dirty, timeout,
+                &request);
+        if(owner != NULL) {
+                request.next_follower = owner->followers;
+                owner->followers = &request;
+        }
+        else {
+                for(open = coalescer->batches; open != NULL;
+                    open = open->next) {
+                        if(open->open &&
+                            _arakoon_read_coalescer_batch_matches(open,
+                                allow_dirty, timeout)) {
+                                break;
+                        }
+                }
+
+                if(open != NULL) {
+                        _arakoon_read_coalescer_add_key(open, &request);
+                        if(open->count >= ARAKOON_READ_COALESCER_MAX_KEYS) {
+                                open->open = ARAKOON_BOOL_FALSE;
+                                pthread_cond_broadcast(&coalescer->full);
+                        }
+                }
+        }
+
+        if(owner != NULL || open != NULL) {
+                while(!request.done) {
+                        pthread_cond_wait(&coalescer->done,
+                                &coalescer->lock);
+                }
+
+                pthread_mutex_unlock(&coalescer->lock);
+
+                *result_size = request.value_size;
+                *result = request.value;
+
+                return request.rc;
+        }
+
+        /* Open a new batch, and give other callers some time to join it */
+        memset(&batch, 0, sizeof(ArakoonReadCoalescerBatch));
+        batch.allow_dirty = allow_dirty;
+        batch.timeout = timeout;
+        batch.open = ARAKOON_BOOL_TRUE;
+        _arakoon_read_coalescer_add_key(&batch, &request);
+
+        batch.next = coalescer->batches;
+        coalescer->batches = &batch;
+
+        _arakoon_deadline_after(&deadline, coalescer->window_usec);
+
+        while(batch.open) {
+                if(pthread_cond_timedwait(&coalescer->full, &coalescer->lock,
+                    &deadline) == ETIMEDOUT) {
+                        break;
+                }
+        }
+
+        batch.open = ARAKOON_BOOL_FALSE;
+
+        pthread_mutex_unlock(&coalescer->lock);
+
+        _arakoon_read_coalescer_send(coalescer, &batch, cluster, options);
+
+        *result_size = request.value_size;
+        *result = request.value;
+
+        return request.rc;
+}
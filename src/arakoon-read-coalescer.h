@@ -0,0 +1,59 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __ARAKOON_READ_COALESCER_H__
+#define __ARAKOON_READ_COALESCER_H__
+
+#include "arakoon.h"
+
+ARAKOON_BEGIN_DECLS
+
+/* Coalescing of concurrent 'get' calls on a multiplexed cluster
+ *
+ * A 'get' for a key which is already being fetched waits for that fetch
+ * instead of sending its own call, unless the fetch was sent before the
+ * 'get' started and the 'get' doesn't allow dirty reads. Other keys asked
+ * for at about the same time are combined into a single 'multi_get_option'
+ * call: the first caller opens a batch, waits for a short window while
+ * other callers add their keys, then sends the call and hands every caller
+ * its result.
+ */
+typedef struct ArakoonReadCoalescer ArakoonReadCoalescer;
+
+ArakoonReadCoalescer * _arakoon_read_coalescer_new(
+    const unsigned int window_usec)
+    ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+void _arakoon_read_coalescer_free(ArakoonReadCoalescer *coalescer);
+
+/* Like arakoon_get. The call is sent over 'cluster', which must be
+ * multiplexed. */
+arakoon_rc _arakoon_read_coalescer_get(ArakoonReadCoalescer * const coalescer,
+    ArakoonCluster *cluster, const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    size_t *result_size, void **result)
+    ARAKOON_GNUC_NONNULL5(1, 2, 5, 6, 7) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+ARAKOON_END_DECLS
+
+#endif /* ifndef __ARAKOON_READ_COALESCER_H__ */
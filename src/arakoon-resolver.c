@@ -0,0 +1,386 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "arakoon.h"
+#include "arakoon-resolver.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-networking.h"
+
+/* Upper bound on the number of threads used by a single batch */
+#define ARAKOON_RESOLVER_MAX_THREADS (16)
+
+typedef struct ArakoonResolverCacheEntry ArakoonResolverCacheEntry;
+struct ArakoonResolverCacheEntry {
+        char *host;
+        char *service;
+
+        /* Numeric representation of all addresses found */
+        char **addresses;
+        size_t addresses_count;
+
+        uint64_t expires;
+
+        ArakoonResolverCacheEntry *next;
+};
+
+struct ArakoonResolverCache {
+        ArakoonResolverCacheEntry *entries;
+};
+
+typedef struct {
+        ArakoonResolverQuery *queries;
+        /* Queries which need an actual lookup */
+        arakoon_bool *pending;
+        size_t count;
+        size_t next;
+} ArakoonResolverBatch;
+
+static void _arakoon_resolver_hints(struct addrinfo *hints, int flags) {
+        memset(hints, 0, sizeof(struct addrinfo));
+        hints->ai_family = AF_UNSPEC; /* IPv4 and IPv6, whatever */
+        hints->ai_socktype = SOCK_STREAM;
+        hints->ai_flags = flags;
+        hints->ai_protocol = 0; /* Any protocol */
+}
+
+/* Convert a numeric address, which never blocks */
+static int _arakoon_resolver_numeric(const char * const host,
+    const char * const service, struct addrinfo **result) {
+        struct addrinfo hints;
+
+        _arakoon_resolver_hints(&hints, AI_NUMERICHOST | AI_NUMERICSERV);
+
+        return getaddrinfo(host, service, &hints, result);
+}
+
+static void _arakoon_resolver_lookup(ArakoonResolverQuery *query) {
+        struct addrinfo hints;
+
+        _arakoon_resolver_hints(&hints, 0);
+
+        _arakoon_log_debug("arakoon-resolver: looking up %s:%s",
+                query->host, query->service);
+
+        query->result = NULL;
+        query->error = getaddrinfo(query->host, query->service, &hints,
+                &(query->result));
+
+        if(query->error != 0) {
+                query->result = NULL;
+
+                _arakoon_log_error(
+                        "arakoon-resolver: address lookup of %s failed: %s",
+                        query->host, gai_strerror(query->error));
+        }
+}
+
+static void * _arakoon_resolver_worker(void *data) {
+        ArakoonResolverBatch *batch = (ArakoonResolverBatch *) data;
+        size_t i = 0;
+
+        /* Take queries until none are left */
+        while(1) {
+                i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+                if(i >= batch->count) {
+                        break;
+                }
+
+                if(batch->pending[i]) {
+                        _arakoon_resolver_lookup(&(batch->queries[i]));
+                }
+        }
+
+        return NULL;
+}
+
+ArakoonResolverCache * _arakoon_resolver_cache_new(void) {
+        ArakoonResolverCache *ret = NULL;
+
+        FUNCTION_ENTER(_arakoon_resolver_cache_new);
+
+        ret = arakoon_mem_new(1, ArakoonResolverCache);
+        RETURN_NULL_IF_NULL(ret);
+
+        ret->entries = NULL;
+
+        return ret;
+}
+
+static void _arakoon_resolver_cache_entry_free(
+    ArakoonResolverCacheEntry *entry) {
+        size_t i = 0;
+
+        if(entry->addresses != NULL) {
+                for(i = 0; i < entry->addresses_count; i++) {
+                        arakoon_mem_free(entry->addresses[i]);
+                }
+        }
+
+        arakoon_mem_free(entry->addresses);
+        arakoon_mem_free(entry->service);
+        arakoon_mem_free(entry->host);
+        arakoon_mem_free(entry);
+}
+
+void _arakoon_resolver_cache_free(ArakoonResolverCache *cache) {
+        ArakoonResolverCacheEntry *entry = NULL, *next = NULL;
+
+        FUNCTION_ENTER(_arakoon_resolver_cache_free);
+
+        RETURN_IF_NULL(cache);
+
+        for(entry = cache->entries; entry != NULL; entry = next) {
+                next = entry->next;
+                _arakoon_resolver_cache_entry_free(entry);
+        }
+
+        arakoon_mem_free(cache);
+}
+
+static void _arakoon_resolver_cache_expire(ArakoonResolverCache *cache,
+    uint64_t now) {
+        ArakoonResolverCacheEntry **entry = NULL, *expired = NULL;
+
+        entry = &(cache->entries);
+        while(*entry != NULL) {
+                if((*entry)->expires > now) {
+                        entry = &((*entry)->next);
+                        continue;
+                }
+
+                expired = *entry;
+                *entry = expired->next;
+
+                _arakoon_resolver_cache_entry_free(expired);
+        }
+}
+
+static const ArakoonResolverCacheEntry * _arakoon_resolver_cache_lookup(
+    const ArakoonResolverCache *cache, const char * const host,
+    const char * const service) {
+        const ArakoonResolverCacheEntry *entry = NULL;
+
+        for(entry = cache->entries; entry != NULL; entry = entry->next) {
+                if(strcmp(entry->host, host) == 0 &&
+                    strcmp(entry->service, service) == 0) {
+                        return entry;
+                }
+        }
+
+        return NULL;
+}
+
+/* Rebuild the result of a cached lookup, without touching the network */
+static int _arakoon_resolver_cache_get(
+    const ArakoonResolverCacheEntry *entry, struct addrinfo **result) {
+        struct addrinfo *head = NULL, *tail = NULL, *ai = NULL;
+        size_t i = 0;
+        int rc = 0;
+
+        for(i = 0; i < entry->addresses_count; i++) {
+                rc = _arakoon_resolver_numeric(entry->addresses[i],
+                        entry->service, &ai);
+                if(rc != 0) {
+                        if(head != NULL) {
+                                freeaddrinfo(head);
+                        }
+
+                        return rc;
+                }
+
+                if(head == NULL) {
+                        head = ai;
+                }
+                else {
+                        tail->ai_next = ai;
+                }
+
+                for(tail = ai; tail->ai_next != NULL; tail = tail->ai_next);
+        }
+
+        *result = head;
+
+        return 0;
+}
+
+static char * _arakoon_resolver_strdup(const char * const s) {
+        char *ret = NULL;
+        size_t len = strlen(s) + 1;
+
+        ret = arakoon_mem_new(len, char);
+        RETURN_NULL_IF_NULL(ret);
+
+        memcpy(ret, s, len);
+
+        return ret;
+}
+
+static void _arakoon_resolver_cache_add(ArakoonResolverCache *cache,
+    const ArakoonResolverQuery *query, uint64_t now) {
+        ArakoonResolverCacheEntry *entry = NULL;
+        const struct addrinfo *ai = NULL;
+        char address[NI_MAXHOST];
+        size_t count = 0;
+
+        for(ai = query->result; ai != NULL; ai = ai->ai_next) {
+                count++;
+        }
+
+        entry = arakoon_mem_new(1, ArakoonResolverCacheEntry);
+        RETURN_IF_NULL(entry);
+
+        memset(entry, 0, sizeof(ArakoonResolverCacheEntry));
+
+        entry->host = _arakoon_resolver_strdup(query->host);
+        entry->service = _arakoon_resolver_strdup(query->service);
+        entry->addresses = arakoon_mem_new(count, char *);
+        if(entry->host == NULL || entry->service == NULL ||
+            entry->addresses == NULL) {
+                goto failure;
+        }
+
+        for(ai = query->result; ai != NULL; ai = ai->ai_next) {
+                if(getnameinfo(ai->ai_addr, ai->ai_addrlen,
+                    address, sizeof(address), NULL, 0,
+                    NI_NUMERICHOST) != 0) {
+                        goto failure;
+                }
+
+                entry->addresses[entry->addresses_count] =
+                        _arakoon_resolver_strdup(address);
+                if(entry->addresses[entry->addresses_count] == NULL) {
+                        goto failure;
+                }
+
+                entry->addresses_count++;
+        }
+
+        entry->expires = now + (uint64_t) ARAKOON_RESOLVER_CACHE_TTL
+                * US_PER_S;
+        entry->next = cache->entries;
+        cache->entries = entry;
+
+        return;
+
+failure:
+        /* Not caching is harmless */
+        _arakoon_resolver_cache_entry_free(entry);
+}
+
+arakoon_rc _arakoon_resolver_resolve(ArakoonResolverCache *cache,
+    ArakoonResolverQuery *queries, size_t count) {
+        ArakoonResolverBatch batch;
+        const ArakoonResolverCacheEntry *entry = NULL;
+        pthread_t threads[ARAKOON_RESOLVER_MAX_THREADS];
+        size_t n = 0, pending = 0, started = 0, i = 0;
+        uint64_t now = 0;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        FUNCTION_ENTER(_arakoon_resolver_resolve);
+
+        if(count == 0) {
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        batch.pending = arakoon_mem_new(count, arakoon_bool);
+        RETURN_ENOMEM_IF_NULL(batch.pending);
+
+        batch.queries = queries;
+        batch.count = count;
+        batch.next = 0;
+
+        if(cache != NULL) {
+                now = _arakoon_networking_monotonic_usec();
+                _arakoon_resolver_cache_expire(cache, now);
+        }
+
+        /* Handle everything which doesn't need a name lookup first */
+        for(i = 0; i < count; i++) {
+                queries[i].result = NULL;
+                queries[i].error = _arakoon_resolver_numeric(queries[i].host,
+                        queries[i].service, &(queries[i].result));
+
+                if(queries[i].error != 0 && cache != NULL) {
+                        entry = _arakoon_resolver_cache_lookup(cache,
+                                queries[i].host, queries[i].service);
+                        if(entry != NULL) {
+                                queries[i].error = _arakoon_resolver_cache_get(
+                                        entry, &(queries[i].result));
+                        }
+                }
+
+                batch.pending[i] = (queries[i].error != 0);
+                if(batch.pending[i]) {
+                        queries[i].result = NULL;
+                        pending++;
+                }
+        }
+
+        if(pending > 0) {
+                /* The calling thread takes part in the lookups as well */
+                n = pending - 1;
+                if(n > ARAKOON_RESOLVER_MAX_THREADS) {
+                        n = ARAKOON_RESOLVER_MAX_THREADS;
+                }
+
+                for(started = 0; started < n; started++) {
+                        if(pthread_create(&threads[started], NULL,
+                            _arakoon_resolver_worker, &batch) != 0) {
+                                _arakoon_log_warning(
+                                        "arakoon-resolver: unable to start "
+                                        "resolver thread, continuing with "
+                                        "%zu threads", started + 1);
+                                break;
+                        }
+                }
+
+                _arakoon_resolver_worker(&batch);
+
+                for(i = 0; i < started; i++) {
+                        pthread_join(threads[i], NULL);
+                }
+        }
+
+        for(i = 0; i < count; i++) {
+                if(queries[i].error != 0) {
+                        rc = ARAKOON_RC_CLIENT_NETWORK_ERROR;
+                }
+                else if(batch.pending[i] && cache != NULL &&
+                    _arakoon_resolver_cache_lookup(cache, queries[i].host,
+                        queries[i].service) == NULL) {
+                        _arakoon_resolver_cache_add(cache, &(queries[i]),
+                                now);
+                }
+        }
+
+        arakoon_mem_free(batch.pending);
+
+        return rc;
+}
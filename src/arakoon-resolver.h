@@ -0,0 +1,75 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ARAKOON_RESOLVER_H__
+#define __ARAKOON_RESOLVER_H__
+
+#include <netdb.h>
+
+#include "arakoon.h"
+
+ARAKOON_BEGIN_DECLS
+
+/* A single address lookup, as passed to _arakoon_resolver_resolve
+ *
+ * On success, 'result' should be released using freeaddrinfo (or handed
+ * over to arakoon_cluster_node_add_address). Otherwise 'error' is set to
+ * the getaddrinfo return value.
+ */
+typedef struct {
+        const char *host;
+        const char *service;
+
+        struct addrinfo *result;
+        int error;
+} ArakoonResolverQuery;
+
+/* Cache of name lookups, to be reused by subsequent batches
+ *
+ * Entries expire after ARAKOON_RESOLVER_CACHE_TTL seconds. A cache can't be
+ * used by several threads at once.
+ */
+typedef struct ArakoonResolverCache ArakoonResolverCache;
+
+#define ARAKOON_RESOLVER_CACHE_TTL (300)
+
+ArakoonResolverCache * _arakoon_resolver_cache_new(void)
+    ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+void _arakoon_resolver_cache_free(ArakoonResolverCache *cache);
+
+/* Resolve a batch of addresses
+ *
+ * Numeric addresses are converted right away, and names found in the cache
+ * (if any) aren't looked up again. Remaining lookups are spread over a
+ * number of threads, so the total time taken is about the time of the
+ * slowest lookup, not the sum of them. Returns
+ * ARAKOON_RC_CLIENT_NETWORK_ERROR if any of the lookups failed, in which
+ * case the caller should check every query.
+ */
+arakoon_rc _arakoon_resolver_resolve(ArakoonResolverCache *cache,
+    ArakoonResolverQuery *queries, size_t count)
+    ARAKOON_GNUC_NONNULL1(2) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+ARAKOON_END_DECLS
+
+#endif /* ifndef __ARAKOON_RESOLVER_H__ */
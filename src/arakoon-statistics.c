@@ -0,0 +1,425 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-cluster.h"
+#include "arakoon-cluster-node.h"
+#include "arakoon-client-call-options.h"
+#include "arakoon-command.h"
+#include "arakoon-mux.h"
+#include "arakoon-statistics.h"
+
+/* Lists nested deeper than this are rejected */
+#define ARAKOON_STATISTICS_MAX_DEPTH (16)
+/* Type, name length and the smallest value (a 32-bit integer or length) */
+#define ARAKOON_STATISTICS_MIN_FIELD_LEN (3 * sizeof(uint32_t))
+
+struct ArakoonStatistics {
+        /* The root field is the first one, the fields of every list are
+         * stored next to each other */
+        ArakoonStatisticsField *fields;
+        /* Names and string values */
+        char *strings;
+};
+
+/* The encoded statistics are parsed twice: first to validate them and
+ * count the space needed (fields is NULL), then to fill in the result */
+typedef struct {
+        const char *data;
+        size_t size;
+
+        ArakoonStatisticsField *fields;
+        size_t fields_used;
+        char *strings;
+        size_t strings_used;
+} ArakoonStatisticsParser;
+
+static arakoon_rc _arakoon_statistics_read(ArakoonStatisticsParser *parser,
+    void * const out, const size_t size) {
+        if(parser->size < size) {
+                return -EPROTO;
+        }
+
+        memcpy(out, parser->data, size);
+        parser->data += size;
+        parser->size -= size;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_statistics_read_string(
+    ArakoonStatisticsParser *parser, size_t *size, const char **data) {
+        uint32_t len = 0;
+        char *s = NULL;
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_statistics_read(parser, &len, sizeof(uint32_t));
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        if(parser->size < len) {
+                return -EPROTO;
+        }
+
+        if(parser->fields != NULL) {
+                s = parser->strings + parser->strings_used;
+                memcpy(s, parser->data, len);
+                s[len] = 0;
+
+                *size = len;
+                *data = s;
+        }
+
+        parser->data += len;
+        parser->size -= len;
+        parser->strings_used += len + 1;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_statistics_parse_field(
+    ArakoonStatisticsParser *parser, const size_t index, const int depth) {
+        ArakoonStatisticsField field;
+        int32_t type = 0, i32 = 0;
+        uint32_t count = 0, i = 0;
+        size_t first = 0, name_size = 0;
+        arakoon_rc rc = 0;
+
+        if(depth > ARAKOON_STATISTICS_MAX_DEPTH) {
+                return -EPROTO;
+        }
+
+        memset(&field, 0, sizeof(ArakoonStatisticsField));
+
+        rc = _arakoon_statistics_read(parser, &type, sizeof(int32_t));
+        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_statistics_read_string(parser, &name_size, &field.name);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        switch(type) {
+                case ARAKOON_STATISTICS_FIELD_INT32:
+                        rc = _arakoon_statistics_read(parser, &i32,
+                                sizeof(int32_t));
+                        field.value.int_ = i32;
+                        break;
+                case ARAKOON_STATISTICS_FIELD_INT64:
+                        rc = _arakoon_statistics_read(parser,
+                                &field.value.int_, sizeof(int64_t));
+                        break;
+                case ARAKOON_STATISTICS_FIELD_FLOAT:
+                        rc = _arakoon_statistics_read(parser,
+                                &field.value.float_, sizeof(double));
+                        break;
+                case ARAKOON_STATISTICS_FIELD_STRING:
+                        rc = _arakoon_statistics_read_string(parser,
+                                &field.value.string.size,
+                                &field.value.string.data);
+                        break;
+                case ARAKOON_STATISTICS_FIELD_LIST:
+                        rc = _arakoon_statistics_read(parser, &count,
+                                sizeof(uint32_t));
+                        RETURN_IF_NOT_SUCCESS(rc);
+
+                        /* Don't trust the count before reserving space */
+                        if(count > parser->size /
+                            ARAKOON_STATISTICS_MIN_FIELD_LEN) {
+                                return -EPROTO;
+                        }
+
+                        first = parser->fields_used;
+                        parser->fields_used += count;
+
+                        for(i = 0; i < count; i++) {
+                                rc = _arakoon_statistics_parse_field(parser,
+                                        first + i, depth + 1);
+                                RETURN_IF_NOT_SUCCESS(rc);
+                        }
+
+                        field.value.list.count = count;
+                        if(parser->fields != NULL) {
+                                field.value.list.fields =
+                                        parser->fields + first;
+                        }
+                        break;
+                default:
+                        _arakoon_log_error(
+                                "arakoon-statistics: unknown field type %d",
+                                type);
+                        return -EPROTO;
+        }
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        if(parser->fields != NULL) {
+                field.type = (ArakoonStatisticsFieldType) type;
+                parser->fields[index] = field;
+        }
+
+        return rc;
+}
+
+arakoon_rc _arakoon_statistics_parse(const size_t size,
+    const void * const data, ArakoonStatistics **result) {
+        ArakoonStatisticsParser parser;
+        ArakoonStatistics *statistics = NULL;
+        size_t fields = 0, strings = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_statistics_parse);
+
+        *result = NULL;
+
+        memset(&parser, 0, sizeof(ArakoonStatisticsParser));
+        parser.data = data;
+        parser.size = size;
+        parser.fields_used = 1;
+
+        rc = _arakoon_statistics_parse_field(&parser, 0, 0);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        fields = parser.fields_used;
+        strings = parser.strings_used;
+
+        statistics = arakoon_mem_new(1, ArakoonStatistics);
+        RETURN_ENOMEM_IF_NULL(statistics);
+
+        statistics->fields = arakoon_mem_new(fields, ArakoonStatisticsField);
+        statistics->strings = arakoon_mem_new(strings, char);
+        if(statistics->fields == NULL || statistics->strings == NULL) {
+                arakoon_statistics_free(statistics);
+                return -ENOMEM;
+        }
+
+        memset(&parser, 0, sizeof(ArakoonStatisticsParser));
+        parser.data = data;
+        parser.size = size;
+        parser.fields = statistics->fields;
+        parser.fields_used = 1;
+        parser.strings = statistics->strings;
+
+        /* Can't fail, the input was validated by the first pass */
+        rc = _arakoon_statistics_parse_field(&parser, 0, 0);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                arakoon_statistics_free(statistics);
+                return rc;
+        }
+
+        *result = statistics;
+
+        return rc;
+}
+
+arakoon_rc arakoon_statistics(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonStatistics **result) {
+        ArakoonCommandResult result_;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_statistics);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(result);
+
+        *result = NULL;
+
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_STATISTICS);
+        _arakoon_mux_end_call(rc);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = _arakoon_statistics_parse(result_.size, result_.data, result);
+        arakoon_mem_maybe_free(result_.size, result_.data);
+
+        return rc;
+}
+
+void arakoon_statistics_free(ArakoonStatistics *statistics) {
+        FUNCTION_ENTER(arakoon_statistics_free);
+
+        RETURN_IF_NULL(statistics);
+
+        arakoon_mem_free(statistics->fields);
+        arakoon_mem_free(statistics->strings);
+        arakoon_mem_free(statistics);
+}
+
+const ArakoonStatisticsField * arakoon_statistics_get_root(
+    const ArakoonStatistics * const statistics) {
+        FUNCTION_ENTER(arakoon_statistics_get_root);
+
+        ASSERT_NON_NULL(statistics);
+
+        return &statistics->fields[0];
+}
+
+const ArakoonStatisticsField * arakoon_statistics_field_find(
+    const ArakoonStatisticsField * const list, const char * const name) {
+        size_t i = 0;
+
+        FUNCTION_ENTER(arakoon_statistics_field_find);
+
+        ASSERT_NON_NULL(list);
+        ASSERT_NON_NULL(name);
+
+        if(list->type != ARAKOON_STATISTICS_FIELD_LIST) {
+                return NULL;
+        }
+
+        for(i = 0; i < list->value.list.count; i++) {
+                if(strcmp(list->value.list.fields[i].name, name) == 0) {
+                        return &list->value.list.fields[i];
+                }
+        }
+
+        return NULL;
+}
+
+struct ArakoonStatisticsSampler {
+        /* Private connections to all nodes */
+        ArakoonCluster *probe;
+        ArakoonStatisticsSamplerCallback callback;
+        void *data;
+
+        ArakoonWorker worker;
+};
+
+static arakoon_rc _arakoon_statistics_sampler_step(void *data,
+    const ArakoonClientCallOptions * const options) {
+        return arakoon_statistics_sampler_step(
+                (ArakoonStatisticsSampler *) data, options);
+}
+
+ArakoonStatisticsSampler * arakoon_statistics_sampler_new(
+    const ArakoonCluster * const cluster,
+    ArakoonStatisticsSamplerCallback callback, void *data) {
+        ArakoonStatisticsSampler *sampler = NULL;
+
+        FUNCTION_ENTER(arakoon_statistics_sampler_new);
+
+        ASSERT_NON_NULL(cluster);
+        ASSERT_NON_NULL(callback);
+
+        sampler = arakoon_mem_new(1, ArakoonStatisticsSampler);
+        RETURN_NULL_IF_NULL(sampler);
+
+        memset(sampler, 0, sizeof(ArakoonStatisticsSampler));
+
+        sampler->probe = _arakoon_cluster_clone(cluster);
+        if(sampler->probe == NULL) {
+                arakoon_mem_free(sampler);
+                return NULL;
+        }
+
+        sampler->callback = callback;
+        sampler->data = data;
+
+        _arakoon_worker_init(&sampler->worker, "arakoon-statistics",
+                _arakoon_statistics_sampler_step, sampler);
+
+        return sampler;
+}
+
+void arakoon_statistics_sampler_free(ArakoonStatisticsSampler *sampler) {
+        FUNCTION_ENTER(arakoon_statistics_sampler_free);
+
+        RETURN_IF_NULL(sampler);
+
+        _arakoon_worker_destroy(&sampler->worker);
+
+        arakoon_cluster_free(sampler->probe);
+        arakoon_mem_free(sampler);
+}
+
+/* Retrieve the statistics of a single node */
+static arakoon_rc _arakoon_statistics_sampler_ask(ArakoonClusterNode *node,
+    int *timeout, ArakoonStatistics **statistics) {
+        ArakoonCommandResult result;
+        arakoon_rc rc = 0;
+
+        *statistics = NULL;
+
+        if(_arakoon_cluster_node_get_fd(node) < 0) {
+                rc = _arakoon_cluster_node_connect(node, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+        }
+
+        rc = _arakoon_command_node_send(node, NULL, timeout,
+                ARAKOON_COMMAND_STATISTICS);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = _arakoon_command_node_read_rc(node, NULL, timeout);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = _arakoon_command_node_read_result(node,
+                ARAKOON_COMMAND_RESULT_STRING, timeout, &result);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = _arakoon_statistics_parse(result.size, result.data, statistics);
+        arakoon_mem_maybe_free(result.size, result.data);
+
+        return rc;
+}
+
+arakoon_rc arakoon_statistics_sampler_step(
+    ArakoonStatisticsSampler * const sampler,
+    const ArakoonClientCallOptions * const options) {
+        ArakoonClusterNode *node = NULL;
+        ArakoonStatistics *statistics = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_statistics_sampler_step);
+
+        ASSERT_NON_NULL_RC(sampler);
+
+        READ_OPTIONS;
+
+        /* Every node gets the full timeout, a node which can't be reached
+         * only fails its own sample */
+        for(node = _arakoon_cluster_get_first_node(sampler->probe);
+            node != NULL; node = _arakoon_cluster_node_get_next(node)) {
+                timeout = arakoon_client_call_options_get_timeout(options_);
+
+                rc = _arakoon_statistics_sampler_ask(node, &timeout,
+                        &statistics);
+
+                sampler->callback(_arakoon_cluster_node_get_name(node), rc,
+                        statistics, sampler->data);
+                arakoon_statistics_free(statistics);
+        }
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_rc arakoon_statistics_sampler_start(
+    ArakoonStatisticsSampler * const sampler, int interval) {
+        FUNCTION_ENTER(arakoon_statistics_sampler_start);
+
+        ASSERT_NON_NULL_RC(sampler);
+
+        return _arakoon_worker_start(&sampler->worker, interval);
+}
@@ -0,0 +1,40 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __ARAKOON_STATISTICS_H__
+#define __ARAKOON_STATISTICS_H__
+
+#include "arakoon.h"
+
+ARAKOON_BEGIN_DECLS
+
+/* Decode the statistics returned by a node. Returns -EPROTO if the encoding
+ * is truncated, nested too deeply or holds an unknown field type. */
+arakoon_rc _arakoon_statistics_parse(const size_t size,
+    const void * const data, ArakoonStatistics **result)
+    ARAKOON_GNUC_NONNULL1(3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+ARAKOON_END_DECLS
+
+#endif /* ifndef __ARAKOON_STATISTICS_H__ */
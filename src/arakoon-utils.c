@@ -26,6 +26,9 @@
 #include <string.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "arakoon.h"
 #include "arakoon-utils.h"
@@ -257,6 +260,224 @@ const ArakoonMemoryHooks * arakoon_memory_get_abort_hooks(void) {
         return &hooks;
 }
 
+/* Command encoding scratch buffers
+ *
+ * Every thread keeps one buffer around to encode requests in, so steady-state
+ * calls don't hit the allocator. Requests are written out before the call
+ * returns (even on a multiplexed connection), so the buffer is free again by
+ * the time the next request is encoded. Nested use and unusually large
+ * requests fall back to plain allocations. */
+#define ARAKOON_SCRATCH_MIN_SIZE (256)
+#define ARAKOON_SCRATCH_MAX_SIZE (64 * 1024)
+
+typedef struct {
+        char *data;
+        size_t size;
+        arakoon_bool in_use;
+        /* The hooks might change while the buffer is kept */
+        void (*data_free)(void *ptr);
+        void (*free)(void *ptr);
+} ArakoonScratch;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void _arakoon_scratch_free(void *data) {
+        ArakoonScratch *scratch = (ArakoonScratch *) data;
+
+        RETURN_IF_NULL(scratch);
+
+        if(scratch->data != NULL) {
+                scratch->data_free(scratch->data);
+        }
+        scratch->free(scratch);
+}
+
+static void _arakoon_scratch_init_key(void) {
+        if(pthread_key_create(&scratch_key, _arakoon_scratch_free) != 0) {
+                _arakoon_log_fatal("arakoon-utils: unable to create key");
+                abort();
+        }
+}
+
+static ArakoonScratch * _arakoon_scratch_get(void) {
+        ArakoonScratch *scratch = NULL;
+
+        pthread_once(&scratch_key_once, _arakoon_scratch_init_key);
+
+        scratch = (ArakoonScratch *) pthread_getspecific(scratch_key);
+        if(scratch != NULL) {
+                return scratch;
+        }
+
+        scratch = arakoon_mem_new(1, ArakoonScratch);
+        RETURN_NULL_IF_NULL(scratch);
+
+        scratch->data = NULL;
+        scratch->size = 0;
+        scratch->in_use = ARAKOON_BOOL_FALSE;
+        scratch->data_free = memory_hooks.free;
+        scratch->free = memory_hooks.free;
+
+        if(pthread_setspecific(scratch_key, scratch) != 0) {
+                arakoon_mem_free(scratch);
+                return NULL;
+        }
+
+        return scratch;
+}
+
+char * _arakoon_scratch_acquire(size_t len) {
+        ArakoonScratch *scratch = NULL;
+        size_t size = 0;
+
+        FUNCTION_ENTER(_arakoon_scratch_acquire);
+
+        if(len > ARAKOON_SCRATCH_MAX_SIZE) {
+                return arakoon_mem_new(len, char);
+        }
+
+        scratch = _arakoon_scratch_get();
+        if(scratch == NULL || scratch->in_use) {
+                return arakoon_mem_new(len, char);
+        }
+
+        if(scratch->size < len || scratch->data_free != memory_hooks.free) {
+                if(scratch->data != NULL) {
+                        scratch->data_free(scratch->data);
+                }
+
+                size = ARAKOON_SCRATCH_MIN_SIZE;
+                while(size < len) {
+                        size *= 2;
+                }
+
+                scratch->data_free = memory_hooks.free;
+                scratch->data = arakoon_mem_new(size, char);
+                scratch->size = (scratch->data == NULL ? 0 : size);
+                RETURN_NULL_IF_NULL(scratch->data);
+        }
+
+        scratch->in_use = ARAKOON_BOOL_TRUE;
+
+        return scratch->data;
+}
+
+void _arakoon_scratch_release(char *buffer) {
+        ArakoonScratch *scratch = NULL;
+
+        FUNCTION_ENTER(_arakoon_scratch_release);
+
+        RETURN_IF_NULL(buffer);
+
+        pthread_once(&scratch_key_once, _arakoon_scratch_init_key);
+
+        scratch = (ArakoonScratch *) pthread_getspecific(scratch_key);
+        if(scratch != NULL && scratch->in_use && buffer == scratch->data) {
+                scratch->in_use = ARAKOON_BOOL_FALSE;
+                return;
+        }
+
+        arakoon_mem_free(buffer);
+}
+
+/* Slabs */
+#define ARAKOON_SLAB_MIN_SIZE (256)
+
+ssize_t _arakoon_slab_claim(ArakoonSlab *slab, size_t len) {
+        size_t capacity = 0, offset = 0;
+        char *data = NULL;
+
+        FUNCTION_ENTER(_arakoon_slab_claim);
+
+        if(slab->capacity - slab->used < len) {
+                capacity = slab->capacity == 0 ?
+                        ARAKOON_SLAB_MIN_SIZE : slab->capacity;
+                while(capacity - slab->used < len) {
+                        if(capacity > SSIZE_MAX / 2) {
+                                return -1;
+                        }
+                        capacity *= 2;
+                }
+
+                data = arakoon_mem_new(capacity, char);
+                if(data == NULL) {
+                        return -1;
+                }
+
+                if(slab->data != NULL) {
+                        memcpy(data, slab->data, slab->used);
+                        arakoon_mem_free(slab->data);
+                }
+
+                slab->data = data;
+                slab->capacity = capacity;
+        }
+
+        offset = slab->used;
+        slab->used += len;
+
+        return offset;
+}
+
+void _arakoon_slab_clear(ArakoonSlab *slab) {
+        FUNCTION_ENTER(_arakoon_slab_clear);
+
+        if(slab->data != NULL) {
+                arakoon_mem_free(slab->data);
+        }
+
+        slab->data = NULL;
+        slab->used = 0;
+        slab->capacity = 0;
+}
+
+arakoon_rc _arakoon_prefix_end(const size_t prefix_size,
+    const void * const prefix, size_t *end_size, void **end) {
+        unsigned char *e = NULL;
+        size_t l = prefix_size;
+
+        FUNCTION_ENTER(_arakoon_prefix_end);
+
+        *end_size = 0;
+        *end = NULL;
+
+        /* Dropping trailing 0xff bytes and incrementing the last remaining
+         * one yields the successor of all keys matching the prefix */
+        while(l > 0 && ((const unsigned char *) prefix)[l - 1] == 0xff) {
+                l--;
+        }
+
+        if(l == 0) {
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        e = arakoon_mem_new(l, unsigned char);
+        RETURN_ENOMEM_IF_NULL(e);
+
+        memcpy(e, prefix, l);
+        e[l - 1]++;
+
+        *end_size = l;
+        *end = e;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* FNV-1a */
+uint32_t _arakoon_hash(const size_t size, const void * const data) {
+        const unsigned char *p = (const unsigned char *) data;
+        uint32_t hash = 2166136261u;
+        size_t i = 0;
+
+        for(i = 0; i < size; i++) {
+                hash ^= p[i];
+                hash *= 16777619u;
+        }
+
+        return hash;
+}
+
 /* Utils */
 char * arakoon_utils_make_string(void *data, size_t length) {
         char *s = NULL;
@@ -276,3 +497,126 @@ char * arakoon_utils_make_string(void *data, size_t length) {
 
         return s;
 }
+
+void _arakoon_cond_init_monotonic(pthread_cond_t * const cond) {
+        pthread_condattr_t attr;
+
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(cond, &attr);
+        pthread_condattr_destroy(&attr);
+}
+
+void _arakoon_deadline_after(struct timespec * const deadline,
+    const uint64_t usec) {
+        clock_gettime(CLOCK_MONOTONIC, deadline);
+
+        deadline->tv_sec += usec / US_PER_S;
+        deadline->tv_nsec += (long) (usec % US_PER_S) * NS_PER_US;
+        if(deadline->tv_nsec >= NS_PER_S) {
+                deadline->tv_sec++;
+                deadline->tv_nsec -= NS_PER_S;
+        }
+}
+
+void _arakoon_worker_init(ArakoonWorker * const worker,
+    const char * const name, ArakoonWorkerStep step, void *data) {
+        memset(worker, 0, sizeof(ArakoonWorker));
+
+        worker->name = name;
+        worker->step = step;
+        worker->data = data;
+        worker->running = ARAKOON_BOOL_FALSE;
+        worker->stop = ARAKOON_BOOL_FALSE;
+        worker->interval = 0;
+
+        pthread_mutex_init(&worker->lock, NULL);
+        _arakoon_cond_init_monotonic(&worker->wakeup);
+}
+
+static void * _arakoon_worker_run(void *data) {
+        ArakoonWorker *worker = (ArakoonWorker *) data;
+        ArakoonClientCallOptions *options = NULL;
+        struct timespec deadline = {0, 0};
+        arakoon_rc rc = 0;
+
+        options = arakoon_client_call_options_new();
+        if(options == NULL) {
+                _arakoon_log_error("%s: unable to allocate options",
+                        worker->name);
+                return NULL;
+        }
+
+        rc = arakoon_client_call_options_set_timeout(options,
+                worker->interval);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                arakoon_client_call_options_free(options);
+                return NULL;
+        }
+
+        pthread_mutex_lock(&worker->lock);
+
+        while(!worker->stop) {
+                pthread_mutex_unlock(&worker->lock);
+
+                rc = worker->step(worker->data, options);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        _arakoon_log_info("%s: step failed: %s",
+                                worker->name, arakoon_strerror(rc));
+                }
+
+                _arakoon_deadline_after(&deadline,
+                        (uint64_t) worker->interval * US_PER_MS);
+
+                pthread_mutex_lock(&worker->lock);
+
+                while(!worker->stop) {
+                        if(pthread_cond_timedwait(&worker->wakeup,
+                            &worker->lock, &deadline) == ETIMEDOUT) {
+                                break;
+                        }
+                }
+        }
+
+        pthread_mutex_unlock(&worker->lock);
+
+        arakoon_client_call_options_free(options);
+
+        return NULL;
+}
+
+arakoon_rc _arakoon_worker_start(ArakoonWorker * const worker, int interval) {
+        int rc = 0;
+
+        if(interval <= 0 || worker->running) {
+                return -EINVAL;
+        }
+
+        worker->interval = interval;
+        worker->stop = ARAKOON_BOOL_FALSE;
+
+        rc = pthread_create(&worker->thread, NULL, _arakoon_worker_run,
+                worker);
+        if(rc != 0) {
+                return -rc;
+        }
+
+        worker->running = ARAKOON_BOOL_TRUE;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+void _arakoon_worker_destroy(ArakoonWorker * const worker) {
+        if(worker->running) {
+                pthread_mutex_lock(&worker->lock);
+                worker->stop = ARAKOON_BOOL_TRUE;
+                pthread_cond_signal(&worker->wakeup);
+                pthread_mutex_unlock(&worker->lock);
+
+                pthread_join(worker->thread, NULL);
+                worker->running = ARAKOON_BOOL_FALSE;
+        }
+
+        pthread_cond_destroy(&worker->wakeup);
+        pthread_mutex_destroy(&worker->lock);
+}
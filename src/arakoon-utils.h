@@ -25,6 +25,8 @@
 #define __ARAKOON_UTILS_H__
 
 #include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "arakoon.h"
 
@@ -107,6 +109,83 @@ void _arakoon_log_fatal(const char *format, ...) ARAKOON_GNUC_PRINTF(1, 2);
 void _arakoon_log_client_error(arakoon_rc rc,
         size_t message_size, const void * message) ARAKOON_GNUC_NONNULL1(3);
 
+/* Get a buffer of at least len bytes to encode a request in. It must be
+ * handed back using _arakoon_scratch_release once the request is written. */
+char * _arakoon_scratch_acquire(size_t len) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+void _arakoon_scratch_release(char *buffer);
+
+/* A growable byte slab, holding the data of list entries back-to-back.
+ * Entries refer to their data by offset, since growing the slab moves it. */
+typedef struct {
+        char *data;
+        size_t used;
+        size_t capacity;
+} ArakoonSlab;
+
+#define ARAKOON_SLAB_INIT { NULL, 0, 0 }
+
+/* Claim len bytes at the end of the slab, returning their offset, or -1 if
+ * the slab can't grow */
+ssize_t _arakoon_slab_claim(ArakoonSlab *slab, size_t len)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+void _arakoon_slab_clear(ArakoonSlab *slab) ARAKOON_GNUC_NONNULL;
+#define ARAKOON_SLAB_AT(slab, offset) ((slab)->data + (offset))
+
+/* Compute the smallest key which sorts after all keys starting with 'prefix',
+ * to be used as an exclusive range bound. If there's no such key (the prefix
+ * is empty or consists of 0xff bytes only), 'end' is set to NULL. */
+arakoon_rc _arakoon_prefix_end(const size_t prefix_size,
+    const void * const prefix, size_t *end_size, void **end)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/* Hash of a key, not suitable for anything but hash tables */
+uint32_t _arakoon_hash(const size_t size, const void * const data)
+    ARAKOON_GNUC_PURE ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#define US_PER_MS (1000)
+#define MS_PER_S (1000)
+#define NS_PER_US (1000)
+#define NS_PER_MS (1000000)
+#define US_PER_S (1000000)
+#define NS_PER_S (1000000000)
+
+/* Condition variables are waited on with deadlines on the monotonic clock,
+ * so they're not affected by changes of the system time */
+void _arakoon_cond_init_monotonic(pthread_cond_t * const cond)
+    ARAKOON_GNUC_NONNULL;
+/* Set 'deadline' to 'usec' microseconds from now */
+void _arakoon_deadline_after(struct timespec * const deadline,
+    const uint64_t usec) ARAKOON_GNUC_NONNULL;
+
+/* A thread calling 'step' every 'interval' milliseconds until it's stopped.
+ * Every step gets call options with 'interval' as timeout. Fields are only
+ * touched by the functions below. */
+typedef arakoon_rc (*ArakoonWorkerStep)(void *data,
+    const ArakoonClientCallOptions * const options);
+
+typedef struct {
+        const char *name;
+        ArakoonWorkerStep step;
+        void *data;
+
+        arakoon_bool running;
+        arakoon_bool stop;
+        int interval;
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t wakeup;
+} ArakoonWorker;
+
+/* 'name' is used for logging, and should be a literal */
+void _arakoon_worker_init(ArakoonWorker * const worker,
+    const char * const name, ArakoonWorkerStep step, void *data)
+    ARAKOON_GNUC_NONNULL3(1, 2, 3);
+arakoon_rc _arakoon_worker_start(ArakoonWorker * const worker, int interval)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Stop the thread if it was started, and release the worker */
+void _arakoon_worker_destroy(ArakoonWorker * const worker)
+    ARAKOON_GNUC_NONNULL;
+
 #define ASSERT_ALL_WRITTEN(command, c, len)                            \
         STMT_START                                                     \
         if(c != command + len) {                                       \
@@ -28,116 +28,167 @@
 #include "arakoon-utils.h"
 #include "arakoon-assert.h"
 
-struct ArakoonValueListItem {
-        ArakoonValueListItem *next;
-
-        ssize_t value_size;
-        void * value;
-};
+/* Values are stored back-to-back in a single slab, so filling a list
+ * takes a handful of allocations, no matter how many values it holds */
+typedef struct {
+        size_t offset;
+        size_t size;
+} ArakoonValueListEntry;
 
 struct ArakoonValueList {
         size_t size;
-        ArakoonValueListItem *first;
-        ArakoonValueListItem *last;
+        size_t capacity;
+        ArakoonValueListEntry *entries;
+        ArakoonSlab slab;
 };
 
 struct ArakoonValueListIter {
         const ArakoonValueList *list;
-        ArakoonValueListItem *current;
+        size_t current;
 };
 
+#define ARAKOON_VALUE_LIST_MIN_CAPACITY (8)
+/* Offset of None entries, which have no value at all */
+#define ARAKOON_VALUE_LIST_NONE ((size_t) -1)
+
+#define ARAKOON_VALUE_LIST_ENTRY_DATA(list, entry)                    \
+        ((entry)->offset == ARAKOON_VALUE_LIST_NONE ? NULL :          \
+         ((entry)->size == 0 ? ARAKOON_ZERO_LENGTH_DATA_PTR :         \
+          (const void *) ARAKOON_SLAB_AT(&(list)->slab, (entry)->offset)))
+
 ArakoonValueList * arakoon_value_list_new(void) {
         ArakoonValueList *list = NULL;
+        const ArakoonSlab slab = ARAKOON_SLAB_INIT;
 
         list = arakoon_mem_new(1, ArakoonValueList);
         RETURN_NULL_IF_NULL(list);
 
         list->size = 0;
-        list->first = NULL;
-        list->last = NULL;
+        list->capacity = 0;
+        list->entries = NULL;
+        list->slab = slab;
 
         return list;
 }
 
-arakoon_rc _arakoon_value_list_prepend(ArakoonValueList *list,
-    const size_t value_size, const void * const value) {
-        ArakoonValueListItem *item = NULL;
-
-        item = arakoon_mem_new(1, ArakoonValueListItem);
-        RETURN_ENOMEM_IF_NULL(item);
+static arakoon_rc _arakoon_value_list_reserve(ArakoonValueList *list,
+    size_t capacity) {
+        ArakoonValueListEntry *entries = NULL;
 
-        if(value_size == 0) {
-                item->value = ARAKOON_ZERO_LENGTH_DATA_PTR;
-        }
-        else {
-                item->value = arakoon_mem_malloc(value_size);
-                if(item->value == NULL) {
-                        arakoon_mem_free(item);
-                        return -ENOMEM;
-                }
+        if(capacity <= list->capacity) {
+                return ARAKOON_RC_SUCCESS;
         }
 
-        item->next = list->first;
-        item->value_size = value_size;
-        if(value_size != 0) {
-                memcpy(item->value, value, value_size);
+        entries = arakoon_mem_new(capacity, ArakoonValueListEntry);
+        RETURN_ENOMEM_IF_NULL(entries);
+
+        if(list->entries != NULL) {
+                memcpy(entries, list->entries,
+                        list->size * sizeof(ArakoonValueListEntry));
+                arakoon_mem_free(list->entries);
         }
 
-        list->first = item;
-        list->size = list->size + 1;
+        list->entries = entries;
+        list->capacity = capacity;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+arakoon_rc _arakoon_value_list_resize(ArakoonValueList *list, size_t size) {
+        arakoon_rc rc = 0;
+        size_t i = 0;
 
-        if(list->last == NULL) {
-                list->last = item;
+        FUNCTION_ENTER(_arakoon_value_list_resize);
+
+        rc = _arakoon_value_list_reserve(list, size);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        for(i = list->size; i < size; i++) {
+                list->entries[i].offset = 0;
+                list->entries[i].size = 0;
         }
 
+        list->size = size;
+
         return ARAKOON_RC_SUCCESS;
 }
 
-static arakoon_rc arakoon_value_list_append(ArakoonValueList *list,
-    const size_t value_size, const void * const value) {
-        ArakoonValueListItem *item = NULL;
+void * _arakoon_value_list_set(ArakoonValueList *list, size_t index,
+    size_t value_size) {
+        ssize_t offset = 0;
 
-        item = arakoon_mem_new(1, ArakoonValueListItem);
-        RETURN_ENOMEM_IF_NULL(item);
+        FUNCTION_ENTER(_arakoon_value_list_set);
 
-        if(value_size == 0) {
-                item->value = ARAKOON_ZERO_LENGTH_DATA_PTR;
-        }
-        else {
-                item->value = arakoon_mem_malloc(value_size);
-                if(item->value == NULL) {
-                        arakoon_mem_free(item);
-                        return -ENOMEM;
-                }
-        }
+        ASSERT_NON_NULL(list);
 
-        item->next = NULL;
-        item->value_size = value_size;
-        if(value_size != 0) {
-                memcpy(item->value, value, value_size);
+        if(index >= list->size) {
+                _arakoon_log_fatal("arakoon-value-list: index out of range");
+                abort();
         }
 
-        if(list->last != NULL) {
-                list->last->next = item;
+        if(value_size == 0) {
+                list->entries[index].offset = 0;
+                list->entries[index].size = 0;
+
+                return ARAKOON_ZERO_LENGTH_DATA_PTR;
         }
-        list->last = item;
-        if(list->first == NULL) {
-                list->first = item;
+
+        offset = _arakoon_slab_claim(&list->slab, value_size);
+        if(offset < 0) {
+                return NULL;
         }
 
-        list->size = list->size + 1;
+        list->entries[index].offset = offset;
+        list->entries[index].size = value_size;
 
-        return ARAKOON_RC_SUCCESS;
+        return ARAKOON_SLAB_AT(&list->slab, offset);
+}
+
+void _arakoon_value_list_set_none(ArakoonValueList *list, size_t index) {
+        FUNCTION_ENTER(_arakoon_value_list_set_none);
+
+        if(index >= list->size) {
+                _arakoon_log_fatal("arakoon-value-list: index out of range");
+                abort();
+        }
+
+        list->entries[index].offset = ARAKOON_VALUE_LIST_NONE;
+        list->entries[index].size = 0;
 }
 
 arakoon_rc arakoon_value_list_add(ArakoonValueList *list,
     const size_t value_size, const void * const value) {
+        arakoon_rc rc = 0;
+        void *data = NULL;
+
         FUNCTION_ENTER(arakoon_value_list_add);
 
         ASSERT_NON_NULL_RC(list);
         ASSERT_NON_NULL_RC(value);
 
-        return arakoon_value_list_append(list, value_size, value);
+        if(list->size == list->capacity) {
+                rc = _arakoon_value_list_reserve(list,
+                        list->capacity == 0 ?
+                                ARAKOON_VALUE_LIST_MIN_CAPACITY :
+                                2 * list->capacity);
+                RETURN_IF_NOT_SUCCESS(rc);
+        }
+
+        list->entries[list->size].offset = 0;
+        list->entries[list->size].size = 0;
+        list->size++;
+
+        data = _arakoon_value_list_set(list, list->size - 1, value_size);
+        if(data == NULL) {
+                list->size--;
+                return -ENOMEM;
+        }
+
+        if(value_size != 0) {
+                memcpy(data, value, value_size);
+        }
+
+        return ARAKOON_RC_SUCCESS;
 }
 
 ssize_t arakoon_value_list_size(const ArakoonValueList * const list) {
@@ -148,34 +199,45 @@ ssize_t arakoon_value_list_size(const ArakoonValueList * const list) {
         return list->size;
 }
 
-static void arakoon_value_list_item_free(ArakoonValueListItem * const item) {
-        FUNCTION_ENTER(arakoon_value_list_item_free);
+arakoon_rc arakoon_value_list_get(const ArakoonValueList * const list,
+    const size_t index, size_t * const value_size,
+    const void ** const value) {
+        const ArakoonValueListEntry *entry = NULL;
+
+        FUNCTION_ENTER(arakoon_value_list_get);
+
+        ASSERT_NON_NULL_RC(list);
+        ASSERT_NON_NULL_RC(value_size);
+        ASSERT_NON_NULL_RC(value);
+
+        if(index >= list->size) {
+                *value_size = 0;
+                *value = NULL;
+
+                return -ERANGE;
+        }
 
-        RETURN_IF_NULL(item);
+        entry = &list->entries[index];
 
-        arakoon_mem_maybe_free(item->value_size, item->value);
-        item->value_size = 0;
+        *value_size = entry->size;
+        *value = ARAKOON_VALUE_LIST_ENTRY_DATA(list, entry);
 
-        arakoon_mem_free(item);
+        return ARAKOON_RC_SUCCESS;
 }
 
 void arakoon_value_list_free(ArakoonValueList * const list) {
-        ArakoonValueListItem *item = NULL, *olditem = NULL;
-
         FUNCTION_ENTER(arakoon_value_list_free);
 
         RETURN_IF_NULL(list);
 
-        list->size = 0;
-        item = list->first;
-        list->first = NULL;
-
-        while(item != NULL) {
-                olditem = item;
-                item = olditem->next;
-
-                arakoon_value_list_item_free(olditem);
+        if(list->entries != NULL) {
+                arakoon_mem_free(list->entries);
         }
+        _arakoon_slab_clear(&list->slab);
+
+        list->size = 0;
+        list->capacity = 0;
+        list->entries = NULL;
 
         arakoon_mem_free(list);
 }
@@ -192,7 +254,7 @@ ArakoonValueListIter * arakoon_value_list_create_iter(
         RETURN_NULL_IF_NULL(iter);
 
         iter->list = list;
-        iter->current = list->first;
+        iter->current = 0;
 
         return iter;
 }
@@ -203,24 +265,28 @@ void arakoon_value_list_iter_free(ArakoonValueListIter * const iter) {
         RETURN_IF_NULL(iter);
 
         iter->list = NULL;
-        iter->current = NULL;
+        iter->current = 0;
 
         arakoon_mem_free(iter);
 }
 
 arakoon_rc arakoon_value_list_iter_next(ArakoonValueListIter * const iter,
     size_t * const value_size, const void ** const value) {
+        const ArakoonValueListEntry *entry = NULL;
+
         FUNCTION_ENTER(arakoon_value_list_iter_next);
 
         ASSERT_NON_NULL_RC(iter);
         ASSERT_NON_NULL_RC(value_size);
         ASSERT_NON_NULL_RC(value);
 
-        if(iter->current != NULL) {
-                *value_size = iter->current->value_size;
-                *value = iter->current->value;
+        if(iter->current < iter->list->size) {
+                entry = &iter->list->entries[iter->current];
+
+                *value_size = entry->size;
+                *value = ARAKOON_VALUE_LIST_ENTRY_DATA(iter->list, entry);
 
-                iter->current = iter->current->next;
+                iter->current++;
         }
         else {
                 *value_size = 0;
@@ -235,7 +301,7 @@ arakoon_rc arakoon_value_list_iter_reset(ArakoonValueListIter * const iter) {
 
         ASSERT_NON_NULL_RC(iter);
 
-        iter->current = iter->list->first;
+        iter->current = 0;
 
         return ARAKOON_RC_SUCCESS;
 }
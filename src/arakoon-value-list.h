@@ -28,11 +28,17 @@
 
 ARAKOON_BEGIN_DECLS
 
-typedef struct ArakoonValueListItem ArakoonValueListItem;
-
-arakoon_rc _arakoon_value_list_prepend(ArakoonValueList *list,
-    const size_t value_size, const void * const value)
-    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Set the number of entries in the list. New entries are empty. */
+arakoon_rc _arakoon_value_list_resize(ArakoonValueList *list, size_t size)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Allocate value_size bytes for the entry at index, returning the buffer to
+ * fill in, or NULL on allocation failure. The buffer is only valid until the
+ * list is changed again. */
+void * _arakoon_value_list_set(ArakoonValueList *list, size_t index,
+    size_t value_size) ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Mark the entry at index as None, see arakoon_multi_get_option */
+void _arakoon_value_list_set_none(ArakoonValueList *list, size_t index)
+    ARAKOON_GNUC_NONNULL;
 
 ARAKOON_END_DECLS
 
@@ -0,0 +1,491 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010, 2012 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "arakoon.h"
+#include "arakoon-utils.h"
+#include "arakoon-assert.h"
+#include "arakoon-cluster.h"
+#include "arakoon-read-cache.h"
+#include "arakoon-client-call-options.h"
+
+/* Bytes accounted per write on top of its key and value */
+#define ARAKOON_WRITE_BATCHER_OP_OVERHEAD (16)
+
+/* A single write, on the stack of the caller waiting for it */
+typedef struct ArakoonWriteBatcherOp ArakoonWriteBatcherOp;
+struct ArakoonWriteBatcherOp {
+        ArakoonWriteBatcherOp *next;
+
+        size_t key_size;
+        const void *key;
+        /* NULL for a delete */
+        size_t value_size;
+        const void *value;
+
+        arakoon_bool done;
+        arakoon_rc rc;
+};
+
+struct ArakoonWriteBatcher {
+        /* Cluster the batcher was created for, whose read cache is kept up
+         * to date */
+        const ArakoonCluster *cluster;
+        /* Private connection, only used by the batcher thread */
+        ArakoonCluster *probe;
+        /* Master of the original cluster when the batcher was created */
+        char *master;
+        arakoon_bool connected;
+        ArakoonClientCallOptions *options;
+        ArakoonSequence *sequence;
+
+        unsigned int delay_usec;
+        size_t max_bytes;
+
+        /* Writes waiting to be sent, in arrival order, protected by lock */
+        ArakoonWriteBatcherOp *head;
+        ArakoonWriteBatcherOp *tail;
+        size_t bytes;
+        arakoon_bool stop;
+
+        pthread_t thread;
+        pthread_mutex_t lock;
+        /* Signalled when writes arrive, or the batcher is stopped */
+        pthread_cond_t wakeup;
+        /* Signalled when a batch completes */
+        pthread_cond_t done;
+};
+
+static arakoon_rc _arakoon_write_batcher_connect(
+    ArakoonWriteBatcher * const batcher) {
+        int timeout = 0;
+        arakoon_rc rc = ARAKOON_RC_CLIENT_MASTER_NOT_FOUND;
+
+        timeout = arakoon_client_call_options_get_timeout(batcher->options);
+
+        if(batcher->master != NULL) {
+                rc = _arakoon_cluster_connect_master_by_name(batcher->probe,
+                        batcher->master, &timeout);
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc) && rc != ARAKOON_RC_CLIENT_TIMEOUT) {
+                rc = _arakoon_cluster_connect_master(batcher->probe,
+                        &timeout);
+        }
+
+        return rc;
+}
+
+/* Whether a failed sequence can be caused by a single one of its writes, in
+ * which case it's worth splitting it up. Any other failure, e.g. a network
+ * error or an unknown server failure, applies to the batch as a whole. */
+static arakoon_bool _arakoon_write_batcher_is_op_error(arakoon_rc rc) {
+        return (rc == ARAKOON_RC_NOT_FOUND ||
+                rc == ARAKOON_RC_ASSERTION_FAILED);
+}
+
+static size_t _arakoon_write_batcher_op_bytes(
+    const ArakoonWriteBatcherOp * const op) {
+        return op->key_size + op->value_size +
+                ARAKOON_WRITE_BATCHER_OP_OVERHEAD;
+}
+
+/* The writes of the batcher go over a private connection, so drop them from
+ * the read cache of the original cluster. Any read which started before a
+ * write completed won't fill the cache after this. */
+static void _arakoon_write_batcher_invalidate(
+    const ArakoonWriteBatcher * const batcher,
+    const ArakoonWriteBatcherOp *first, size_t count) {
+        ArakoonReadCache *cache = NULL;
+        size_t i = 0;
+
+        cache = _arakoon_cluster_get_read_cache(batcher->cluster);
+        if(cache == NULL) {
+                return;
+        }
+
+        for(i = 0; i < count; first = first->next, i++) {
+                _arakoon_read_cache_invalidate(cache, first->key_size,
+                        first->key);
+        }
+}
+
+/* Send 'count' writes, starting at 'first', in a single call */
+static arakoon_rc _arakoon_write_batcher_send(
+    ArakoonWriteBatcher * const batcher, ArakoonWriteBatcherOp *first,
+    size_t count) {
+        ArakoonWriteBatcherOp *op = NULL;
+        size_t i = 0;
+        arakoon_rc rc = 0;
+
+        if(!batcher->connected) {
+                rc = _arakoon_write_batcher_connect(batcher);
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                batcher->connected = ARAKOON_BOOL_TRUE;
+        }
+
+        if(count == 1) {
+                if(first->value == NULL) {
+                        rc = arakoon_delete(batcher->probe, batcher->options,
+                                first->key_size, first->key);
+                }
+                else {
+                        rc = arakoon_set(batcher->probe, batcher->options,
+                                first->key_size, first->key,
+                                first->value_size, first->value);
+                }
+        }
+        else {
+                /* Callers wait for their writes to complete, so keys and
+                 * values can be borrowed */
+                rc = arakoon_sequence_reset(batcher->sequence);
+
+                for(op = first, i = 0;
+                    ARAKOON_RC_IS_SUCCESS(rc) && i < count;
+                    op = op->next, i++) {
+                        if(op->value == NULL) {
+                                rc = arakoon_sequence_add_delete_borrowed(
+                                        batcher->sequence, op->key_size,
+                                        op->key);
+                        }
+                        else {
+                                rc = arakoon_sequence_add_set_borrowed(
+                                        batcher->sequence, op->key_size,
+                                        op->key, op->value_size, op->value);
+                        }
+                }
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                rc = arakoon_sequence(batcher->probe, batcher->options,
+                        batcher->sequence);
+        }
+
+        /* Anything but a server-side error about the writes themselves
+         * leaves the connection in an unknown state, or the master moved */
+        if(!ARAKOON_RC_IS_SUCCESS(rc) &&
+            !_arakoon_write_batcher_is_op_error(rc)) {
+                batcher->connected = ARAKOON_BOOL_FALSE;
+        }
+
+        return rc;
+}
+
+/* Send 'count' writes, starting at 'first', and store the result in every
+ * one of them.
+ *
+ * A sequence is applied atomically, so if it fails because of one of its
+ * writes, none of them is applied. It's then split in halves which are sent
+ * in order, until the failing write is isolated. This yields the same
+ * result for every write as sending all of them one by one. */
+static void _arakoon_write_batcher_commit(
+    ArakoonWriteBatcher * const batcher, ArakoonWriteBatcherOp *first,
+    size_t count) {
+        ArakoonWriteBatcherOp *op = NULL;
+        size_t i = 0;
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_write_batcher_send(batcher, first, count);
+
+        _arakoon_write_batcher_invalidate(batcher, first, count);
+
+        if(count > 1 && _arakoon_write_batcher_is_op_error(rc)) {
+                for(op = first, i = 0; i < count / 2; op = op->next, i++) {
+                }
+
+                _arakoon_write_batcher_commit(batcher, first, count / 2);
+                _arakoon_write_batcher_commit(batcher, op, count - count / 2);
+
+                return;
+        }
+
+        for(op = first, i = 0; i < count; op = op->next, i++) {
+                op->rc = rc;
+        }
+}
+
+static void * _arakoon_write_batcher_run(void *data) {
+        ArakoonWriteBatcher *batcher = (ArakoonWriteBatcher *) data;
+        ArakoonWriteBatcherOp *batch = NULL, *last = NULL, *op = NULL,
+                *next = NULL;
+        struct timespec deadline = {0, 0};
+        size_t count = 0, bytes = 0;
+
+        pthread_mutex_lock(&batcher->lock);
+
+        while(1) {
+                while(batcher->head == NULL && !batcher->stop) {
+                        pthread_cond_wait(&batcher->wakeup, &batcher->lock);
+                }
+
+                if(batcher->head == NULL) {
+                        break;
+                }
+
+                /* Give other writers some time to join the batch */
+                _arakoon_deadline_after(&deadline, batcher->delay_usec);
+
+                while(batcher->bytes < batcher->max_bytes && !batcher->stop) {
+                        if(pthread_cond_timedwait(&batcher->wakeup,
+                            &batcher->lock, &deadline) == ETIMEDOUT) {
+                                break;
+                        }
+                }
+
+                /* Take writes up to 'max_bytes', but at least one, the
+                 * others are left for the next batch */
+                batch = batcher->head;
+                last = batch;
+                count = 1;
+                bytes = _arakoon_write_batcher_op_bytes(batch);
+
+                while(last->next != NULL &&
+                    bytes + _arakoon_write_batcher_op_bytes(last->next) <=
+                    batcher->max_bytes) {
+                        last = last->next;
+                        count++;
+                        bytes += _arakoon_write_batcher_op_bytes(last);
+                }
+
+                batcher->head = last->next;
+                if(batcher->head == NULL) {
+                        batcher->tail = NULL;
+                }
+                batcher->bytes -= bytes;
+                last->next = NULL;
+
+                pthread_mutex_unlock(&batcher->lock);
+
+                _arakoon_write_batcher_commit(batcher, batch, count);
+
+                pthread_mutex_lock(&batcher->lock);
+
+                for(op = batch; op != NULL; op = next) {
+                        next = op->next;
+                        op->done = ARAKOON_BOOL_TRUE;
+                }
+
+                pthread_cond_broadcast(&batcher->done);
+        }
+
+        pthread_mutex_unlock(&batcher->lock);
+
+        return NULL;
+}
+
+ArakoonWriteBatcher * arakoon_write_batcher_new(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const unsigned int delay_usec, const size_t max_bytes) {
+        ArakoonWriteBatcher *batcher = NULL;
+        const char *master = NULL;
+        size_t len = 0;
+        int rc = 0;
+
+        FUNCTION_ENTER(arakoon_write_batcher_new);
+
+        ASSERT_NON_NULL(cluster);
+
+        batcher = arakoon_mem_new(1, ArakoonWriteBatcher);
+        RETURN_NULL_IF_NULL(batcher);
+
+        memset(batcher, 0, sizeof(ArakoonWriteBatcher));
+
+        batcher->probe = _arakoon_cluster_clone(cluster);
+        if(batcher->probe == NULL) {
+                goto nomem;
+        }
+
+        master = _arakoon_cluster_get_master_name(cluster);
+        if(master != NULL) {
+                len = strlen(master) + 1;
+                batcher->master = arakoon_mem_new(len, char);
+                if(batcher->master == NULL) {
+                        goto nomem;
+                }
+                strncpy(batcher->master, master, len);
+        }
+
+        batcher->options = _arakoon_client_call_options_copy(options);
+        if(batcher->options == NULL) {
+                goto nomem;
+        }
+
+        batcher->sequence = arakoon_sequence_new();
+        if(batcher->sequence == NULL) {
+                goto nomem;
+        }
+
+        batcher->cluster = cluster;
+        batcher->connected = ARAKOON_BOOL_FALSE;
+        batcher->delay_usec = delay_usec;
+        batcher->max_bytes = max_bytes;
+        batcher->head = NULL;
+        batcher->tail = NULL;
+        batcher->bytes = 0;
+        batcher->stop = ARAKOON_BOOL_FALSE;
+
+        pthread_mutex_init(&batcher->lock, NULL);
+        _arakoon_cond_init_monotonic(&batcher->wakeup);
+        pthread_cond_init(&batcher->done, NULL);
+
+        rc = pthread_create(&batcher->thread, NULL,
+                _arakoon_write_batcher_run, batcher);
+        if(rc != 0) {
+                _arakoon_log_error(
+                        "arakoon-write-batcher: unable to start thread: %s",
+                        strerror(rc));
+
+                pthread_cond_destroy(&batcher->done);
+                pthread_cond_destroy(&batcher->wakeup);
+                pthread_mutex_destroy(&batcher->lock);
+
+                goto nomem;
+        }
+
+        return batcher;
+
+nomem:
+        if(batcher->sequence != NULL) {
+                arakoon_sequence_free(batcher->sequence);
+        }
+        if(batcher->options != NULL) {
+                arakoon_client_call_options_free(batcher->options);
+        }
+        if(batcher->master != NULL) {
+                arakoon_mem_free(batcher->master);
+        }
+        if(batcher->probe != NULL) {
+                arakoon_cluster_free(batcher->probe);
+        }
+        arakoon_mem_free(batcher);
+
+        return NULL;
+}
+
+void arakoon_write_batcher_free(ArakoonWriteBatcher *batcher) {
+        FUNCTION_ENTER(arakoon_write_batcher_free);
+
+        RETURN_IF_NULL(batcher);
+
+        pthread_mutex_lock(&batcher->lock);
+        batcher->stop = ARAKOON_BOOL_TRUE;
+        pthread_cond_signal(&batcher->wakeup);
+        pthread_mutex_unlock(&batcher->lock);
+
+        pthread_join(batcher->thread, NULL);
+
+        pthread_cond_destroy(&batcher->done);
+        pthread_cond_destroy(&batcher->wakeup);
+        pthread_mutex_destroy(&batcher->lock);
+
+        if(batcher->master != NULL) {
+                arakoon_mem_free(batcher->master);
+        }
+
+        arakoon_sequence_free(batcher->sequence);
+        arakoon_client_call_options_free(batcher->options);
+        arakoon_cluster_free(batcher->probe);
+        arakoon_mem_free(batcher);
+}
+
+/* Queue a write, and wait until the batch holding it completes */
+static arakoon_rc _arakoon_write_batcher_submit(
+    ArakoonWriteBatcher * const batcher, ArakoonWriteBatcherOp * const op) {
+        pthread_mutex_lock(&batcher->lock);
+
+        if(batcher->tail == NULL) {
+                batcher->head = op;
+        }
+        else {
+                batcher->tail->next = op;
+        }
+        batcher->tail = op;
+
+        batcher->bytes += _arakoon_write_batcher_op_bytes(op);
+
+        /* The thread only needs to know about the first write of a batch,
+         * and about the one filling it up */
+        if(batcher->head == op || batcher->bytes >= batcher->max_bytes) {
+                pthread_cond_signal(&batcher->wakeup);
+        }
+
+        while(!op->done) {
+                pthread_cond_wait(&batcher->done, &batcher->lock);
+        }
+
+        pthread_mutex_unlock(&batcher->lock);
+
+        return op->rc;
+}
+
+arakoon_rc arakoon_write_batcher_set(ArakoonWriteBatcher * const batcher,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonWriteBatcherOp op;
+
+        FUNCTION_ENTER(arakoon_write_batcher_set);
+
+        ASSERT_NON_NULL_RC(batcher);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(value);
+
+        memset(&op, 0, sizeof(ArakoonWriteBatcherOp));
+
+        op.next = NULL;
+        op.key_size = key_size;
+        op.key = key;
+        op.value_size = value_size;
+        op.value = value;
+        op.done = ARAKOON_BOOL_FALSE;
+        op.rc = ARAKOON_RC_SUCCESS;
+
+        return _arakoon_write_batcher_submit(batcher, &op);
+}
+
+arakoon_rc arakoon_write_batcher_delete(ArakoonWriteBatcher * const batcher,
+    const size_t key_size, const void * const key) {
+        ArakoonWriteBatcherOp op;
+
+        FUNCTION_ENTER(arakoon_write_batcher_delete);
+
+        ASSERT_NON_NULL_RC(batcher);
+        ASSERT_NON_NULL_RC(key);
+
+        memset(&op, 0, sizeof(ArakoonWriteBatcherOp));
+
+        op.next = NULL;
+        op.key_size = key_size;
+        op.key = key;
+        op.value_size = 0;
+        op.value = NULL;
+        op.done = ARAKOON_BOOL_FALSE;
+        op.rc = ARAKOON_RC_SUCCESS;
+
+        return _arakoon_write_batcher_submit(batcher, &op);
+}
@@ -44,311 +44,563 @@
 #include "arakoon-value-list.h"
 #include "arakoon-key-value-list.h"
 #include "arakoon-assert.h"
+#include "arakoon-mux.h"
+#include "arakoon-command.h"
 
-/* Sequences */
-typedef struct ArakoonSequenceItem ArakoonSequenceItem;
-typedef enum {
-        ARAKOON_SEQUENCE_ITEM_TYPE_SET,
-        ARAKOON_SEQUENCE_ITEM_TYPE_DELETE,
-        ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT,
-        ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS
-} ArakoonSequenceItemType;
-
-struct ArakoonSequenceItem {
-        ArakoonSequenceItemType type;
-
-        union {
-                struct {
-                        size_t key_size;
-                        void * key;
-                        size_t value_size;
-                        void * value;
-                } set;
-
-                struct {
-                        size_t key_size;
-                        void * key;
-                } delete_;
-
-                struct {
-                        size_t key_size;
-                        void * key;
-                        size_t value_size;
-                        void * value;
-                } assert;
-
-                struct {
-                        size_t key_size;
-                        void * key;
-                } assert_exists;
-
-        } data;
-
-        ArakoonSequenceItem * next;
-};
-
-static void arakoon_sequence_item_free(ArakoonSequenceItem *item) {
-        RETURN_IF_NULL(item);
-
-        switch(item->type) {
-                case ARAKOON_SEQUENCE_ITEM_TYPE_SET: {
-                        arakoon_mem_free(item->data.set.key);
-                        arakoon_mem_free(item->data.set.value);
-                }; break;
-                case ARAKOON_SEQUENCE_ITEM_TYPE_DELETE: {
-                        arakoon_mem_free(item->data.delete_.key);
-                }; break;
-                case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT: {
-                        arakoon_mem_free(item->data.assert.key);
-                        arakoon_mem_free(item->data.assert.value);
-                }; break;
-                case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS: {
-                        arakoon_mem_free(item->data.assert_exists.key);
-                }; break;
-                default: {
-                        _arakoon_log_fatal("Unknown sequence item type");
-                        abort();
-                }; break;
-        }
-
-        arakoon_mem_free(item);
-}
+/* Sequences
+ *
+ * Items are encoded in wire format as they're added, back-to-back in a single
+ * slab, in the order the server expects them. Only the sequence header, which
+ * holds the item count and the total length, is written at send time.
+ *
+ * Borrowed strings aren't copied into the slab: a reference to them is kept
+ * instead, recording the slab offset at which they belong, and they're
+ * spliced in when the sequence is encoded. */
+typedef struct {
+        size_t offset;
+        size_t size;
+        const void *data;
+} ArakoonSequenceReference;
 
 struct ArakoonSequence {
-        ArakoonSequenceItem *item;
+        ArakoonSlab slab;
+        uint32_t count;
+
+        ArakoonSequenceReference *references;
+        size_t references_size;
+        size_t references_capacity;
+        size_t borrowed_size;
 };
 
+/* Sequence item types, as known by the server */
+#define ARAKOON_SEQUENCE_ITEM_TYPE_SET (1)
+#define ARAKOON_SEQUENCE_ITEM_TYPE_DELETE (2)
+#define ARAKOON_SEQUENCE_ITEM_TYPE_SEQUENCE (5)
+#define ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT (8)
+#define ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS (15)
+
+#define ARAKOON_SEQUENCE_MIN_REFERENCES (16)
+
+typedef enum {
+        ARAKOON_SEQUENCE_VALUE_NONE,
+        ARAKOON_SEQUENCE_VALUE_STRING,
+        ARAKOON_SEQUENCE_VALUE_STRING_OPTION
+} ArakoonSequenceValueType;
+
 ArakoonSequence * arakoon_sequence_new(void) {
         ArakoonSequence * sequence = NULL;
+        const ArakoonSlab slab = ARAKOON_SLAB_INIT;
 
         FUNCTION_ENTER(arakoon_sequence_new);
 
         sequence = arakoon_mem_new(1, ArakoonSequence);
         RETURN_NULL_IF_NULL(sequence);
 
-        sequence->item = NULL;
+        sequence->slab = slab;
+        sequence->count = 0;
+        sequence->references = NULL;
+        sequence->references_size = 0;
+        sequence->references_capacity = 0;
+        sequence->borrowed_size = 0;
 
         return sequence;
 }
 
 void arakoon_sequence_free(ArakoonSequence *sequence) {
-        ArakoonSequenceItem *item = NULL, *next = NULL;
-
         FUNCTION_ENTER(arakoon_sequence_free);
 
         RETURN_IF_NULL(sequence);
 
-        next = sequence->item;
+        _arakoon_slab_clear(&sequence->slab);
+        sequence->count = 0;
 
-        while(next != NULL) {
-                item = next;
-                next = item->next;
-
-                arakoon_sequence_item_free(item);
+        if(sequence->references != NULL) {
+                arakoon_mem_free(sequence->references);
         }
+        sequence->references = NULL;
+        sequence->references_size = 0;
+        sequence->references_capacity = 0;
+        sequence->borrowed_size = 0;
 
         arakoon_mem_free(sequence);
 }
 
-#define PRELUDE(n)                        \
-        ArakoonSequenceItem *item = NULL; \
-        FUNCTION_ENTER(n)
-#define OUVERTURE(t)                                    \
-        STMT_START                                      \
-        item = arakoon_mem_new(1, ArakoonSequenceItem); \
-        RETURN_ENOMEM_IF_NULL(item);                    \
-        item->type = t;                                 \
-        STMT_END
-#define POSTLUDIUM(n)                \
-        STMT_START                   \
-        item->next = sequence->item; \
-        sequence->item = item;       \
-        return ARAKOON_RC_SUCCESS;   \
-        STMT_END
-
-#define COPY_STRING(t, n)                                 \
-        STMT_START                                        \
-        item->data.t.n##_size = n##_size;                 \
-        /* TODO This alloc could fail, handle it! */      \
-        item->data.t.n = arakoon_mem_new(n##_size, char); \
-        if(item->data.t.n == NULL) {                      \
-                abort();                                  \
-        }                                                 \
-        memcpy(item->data.t.n, n, n##_size);              \
-        STMT_END
-
-#define COPY_STRING_OPTION(t, n)           \
-        STMT_START                         \
-        item->data.t.n##_size = n##_size;  \
-        if(n == NULL) {                    \
-                if(n##_size != 0) {        \
-                        /* TODO */         \
-                        abort();           \
-                }                          \
-                                           \
-                item->data.t.n##_size = 0; \
-                item->data.t.n = NULL;     \
-        }                                  \
-        else {                             \
-                COPY_STRING(t, n);         \
-        }                                  \
-        STMT_END
+arakoon_rc arakoon_sequence_reset(ArakoonSequence *sequence) {
+        FUNCTION_ENTER(arakoon_sequence_reset);
+
+        ASSERT_NON_NULL_RC(sequence);
+
+        sequence->slab.used = 0;
+        sequence->count = 0;
+        sequence->references_size = 0;
+        sequence->borrowed_size = 0;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_sequence_write(ArakoonSequence *sequence,
+    size_t len, const void * const data) {
+        ssize_t offset = 0;
+
+        offset = _arakoon_slab_claim(&sequence->slab, len);
+        if(offset < 0) {
+                return -ENOMEM;
+        }
+
+        memcpy(ARAKOON_SLAB_AT(&sequence->slab, offset), data, len);
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_sequence_write_string(ArakoonSequence *sequence,
+    size_t size, const void * const data, arakoon_bool borrowed) {
+        ArakoonSequenceReference *references = NULL;
+        size_t capacity = 0;
+        uint32_t size_ = size;
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_sequence_write(sequence, sizeof(size_), &size_);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        if(size == 0) {
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        if(!borrowed) {
+                return _arakoon_sequence_write(sequence, size, data);
+        }
+
+        if(sequence->references_size == sequence->references_capacity) {
+                capacity = sequence->references_capacity == 0 ?
+                        ARAKOON_SEQUENCE_MIN_REFERENCES :
+                        2 * sequence->references_capacity;
+
+                references = arakoon_mem_new(capacity,
+                        ArakoonSequenceReference);
+                RETURN_ENOMEM_IF_NULL(references);
+
+                if(sequence->references != NULL) {
+                        memcpy(references, sequence->references,
+                                sequence->references_size *
+                                sizeof(ArakoonSequenceReference));
+                        arakoon_mem_free(sequence->references);
+                }
+
+                sequence->references = references;
+                sequence->references_capacity = capacity;
+        }
+
+        references = &sequence->references[sequence->references_size];
+        references->offset = sequence->slab.used;
+        references->size = size;
+        references->data = data;
+
+        sequence->references_size++;
+        sequence->borrowed_size += size;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* Append an item with a key and, depending on value_type, a value. On failure
+ * the sequence is left as it was. */
+static arakoon_rc _arakoon_sequence_add(ArakoonSequence *sequence,
+    uint32_t type, size_t key_size, const void * const key,
+    ArakoonSequenceValueType value_type, size_t value_size,
+    const void * const value, arakoon_bool borrowed) {
+        const size_t used = sequence->slab.used,
+                references_size = sequence->references_size,
+                borrowed_size = sequence->borrowed_size;
+        const char some = ARAKOON_BOOL_TRUE, none = ARAKOON_BOOL_FALSE;
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_sequence_write(sequence, sizeof(type), &type);
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = _arakoon_sequence_write_string(sequence, key_size, key,
+                        borrowed);
+        }
+
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                switch(value_type) {
+                        case ARAKOON_SEQUENCE_VALUE_NONE: {
+                        }; break;
+                        case ARAKOON_SEQUENCE_VALUE_STRING: {
+                                rc = _arakoon_sequence_write_string(sequence,
+                                        value_size, value, borrowed);
+                        }; break;
+                        case ARAKOON_SEQUENCE_VALUE_STRING_OPTION: {
+                                rc = _arakoon_sequence_write(sequence, 1,
+                                        value == NULL ? &none : &some);
+                                if(ARAKOON_RC_IS_SUCCESS(rc) && value != NULL) {
+                                        rc = _arakoon_sequence_write_string(
+                                                sequence, value_size, value,
+                                                borrowed);
+                                }
+                        }; break;
+                }
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                sequence->slab.used = used;
+                sequence->references_size = references_size;
+                sequence->borrowed_size = borrowed_size;
+
+                return rc;
+        }
+
+        sequence->count++;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_sequence_add_assert(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value, arakoon_bool borrowed) {
+        if(value == NULL && value_size != 0) {
+                _arakoon_log_error(
+                        "arakoon: assert value is NULL, but size is non-zero");
+                return -EINVAL;
+        }
+
+        return _arakoon_sequence_add(sequence,
+                ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT, key_size, key,
+                ARAKOON_SEQUENCE_VALUE_STRING_OPTION, value_size, value,
+                borrowed);
+}
 
 arakoon_rc arakoon_sequence_add_set(ArakoonSequence *sequence,
     const size_t key_size, const void * const key,
     const size_t value_size, const void * const value) {
-        PRELUDE(arakoon_sequence_add_set);
+        FUNCTION_ENTER(arakoon_sequence_add_set);
 
         ASSERT_NON_NULL_RC(sequence);
         ASSERT_NON_NULL_RC(key);
         ASSERT_NON_NULL_RC(value);
 
-        OUVERTURE(ARAKOON_SEQUENCE_ITEM_TYPE_SET);
-
-        COPY_STRING(set, key);
-        COPY_STRING(set, value);
-
-        POSTLUDIUM(arakoon_sequence_add_set);
+        return _arakoon_sequence_add(sequence, ARAKOON_SEQUENCE_ITEM_TYPE_SET,
+                key_size, key, ARAKOON_SEQUENCE_VALUE_STRING, value_size,
+                value, ARAKOON_BOOL_FALSE);
 }
 
 arakoon_rc arakoon_sequence_add_delete(ArakoonSequence *sequence,
     const size_t key_size, const void * const key) {
-        PRELUDE(arakoon_sequence_add_delete);
+        FUNCTION_ENTER(arakoon_sequence_add_delete);
 
         ASSERT_NON_NULL_RC(sequence);
         ASSERT_NON_NULL_RC(key);
 
-        OUVERTURE(ARAKOON_SEQUENCE_ITEM_TYPE_DELETE);
-
-        COPY_STRING(delete_, key);
-
-        POSTLUDIUM(arakoon_sequence_add_delete);
+        return _arakoon_sequence_add(sequence,
+                ARAKOON_SEQUENCE_ITEM_TYPE_DELETE, key_size, key,
+                ARAKOON_SEQUENCE_VALUE_NONE, 0, NULL, ARAKOON_BOOL_FALSE);
 }
 
 arakoon_rc arakoon_sequence_add_assert(ArakoonSequence *sequence,
     const size_t key_size, const void * const key,
     const size_t value_size, const void * const value) {
-        PRELUDE(arakoon_sequence_add_assert);
+        FUNCTION_ENTER(arakoon_sequence_add_assert);
 
         ASSERT_NON_NULL_RC(sequence);
         ASSERT_NON_NULL_RC(key);
 
-        OUVERTURE(ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT);
+        return _arakoon_sequence_add_assert(sequence, key_size, key,
+                value_size, value, ARAKOON_BOOL_FALSE);
+}
+
+arakoon_rc arakoon_sequence_add_assert_exists(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key) {
+        FUNCTION_ENTER(arakoon_sequence_add_assert_exists);
 
-        COPY_STRING(assert, key);
-        COPY_STRING_OPTION(assert, value);
+        ASSERT_NON_NULL_RC(sequence);
+        ASSERT_NON_NULL_RC(key);
 
-        POSTLUDIUM(arakoon_sequence_add_assert);
+        return _arakoon_sequence_add(sequence,
+                ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS, key_size, key,
+                ARAKOON_SEQUENCE_VALUE_NONE, 0, NULL, ARAKOON_BOOL_FALSE);
 }
 
-arakoon_rc arakoon_sequence_add_assert_exists(ArakoonSequence *sequence,
+arakoon_rc arakoon_sequence_add_set_borrowed(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        FUNCTION_ENTER(arakoon_sequence_add_set_borrowed);
+
+        ASSERT_NON_NULL_RC(sequence);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(value);
+
+        return _arakoon_sequence_add(sequence, ARAKOON_SEQUENCE_ITEM_TYPE_SET,
+                key_size, key, ARAKOON_SEQUENCE_VALUE_STRING, value_size,
+                value, ARAKOON_BOOL_TRUE);
+}
+
+arakoon_rc arakoon_sequence_add_delete_borrowed(ArakoonSequence *sequence,
     const size_t key_size, const void * const key) {
-        PRELUDE(arakoon_sequence_add_assert_exists);
+        FUNCTION_ENTER(arakoon_sequence_add_delete_borrowed);
 
         ASSERT_NON_NULL_RC(sequence);
         ASSERT_NON_NULL_RC(key);
 
-        OUVERTURE(ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS);
+        return _arakoon_sequence_add(sequence,
+                ARAKOON_SEQUENCE_ITEM_TYPE_DELETE, key_size, key,
+                ARAKOON_SEQUENCE_VALUE_NONE, 0, NULL, ARAKOON_BOOL_TRUE);
+}
+
+arakoon_rc arakoon_sequence_add_assert_borrowed(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        FUNCTION_ENTER(arakoon_sequence_add_assert_borrowed);
 
-        COPY_STRING(assert_exists, key);
+        ASSERT_NON_NULL_RC(sequence);
+        ASSERT_NON_NULL_RC(key);
 
-        POSTLUDIUM(arakoon_sequence_add_assert_exists);
+        return _arakoon_sequence_add_assert(sequence, key_size, key,
+                value_size, value, ARAKOON_BOOL_TRUE);
 }
 
+arakoon_rc arakoon_sequence_add_assert_exists_borrowed(
+    ArakoonSequence *sequence, const size_t key_size,
+    const void * const key) {
+        FUNCTION_ENTER(arakoon_sequence_add_assert_exists_borrowed);
 
-#undef PRELUDE
-#undef OUVERTURE
-#undef POSTLUDIUM
+        ASSERT_NON_NULL_RC(sequence);
+        ASSERT_NON_NULL_RC(key);
 
-#undef COPY_STRING
-#undef COPY_STRING_OPTION
+        return _arakoon_sequence_add(sequence,
+                ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS, key_size, key,
+                ARAKOON_SEQUENCE_VALUE_NONE, 0, NULL, ARAKOON_BOOL_TRUE);
+}
 
-#define HANDLE_ERROR(rc, master, cluster, timeout)                            \
-        STMT_START                                                            \
-        if(rc != ARAKOON_RC_SUCCESS) {                                        \
-                void *_err_msg = NULL;                                        \
-                size_t _err_len = 0;                                          \
-                arakoon_rc _err_rc = 0;                                       \
-                _arakoon_log_trace("Non-zero return, reading message");       \
-                ARAKOON_PROTOCOL_READ_STRING(                                 \
-                    master, _err_msg, _err_len, _err_rc, timeout);            \
-                if(_err_rc != ARAKOON_RC_SUCCESS) {                           \
-                        _arakoon_log_fatal(                                   \
-                            "Failed to read error message: %s",               \
-                            arakoon_strerror(_err_rc));                       \
-                        break;                                                \
-                }                                                             \
-                _arakoon_log_client_error(rc, _err_len, _err_msg);            \
-                _arakoon_cluster_set_last_error(cluster, _err_len, _err_msg); \
-        }                                                                     \
-        STMT_END
+/* Sequence encoding, used by the command codec */
+size_t _arakoon_sequence_get_encoded_size(
+    const ArakoonSequence * const sequence) {
+        return 3 * ARAKOON_PROTOCOL_UINT32_LEN + sequence->slab.used +
+                sequence->borrowed_size;
+}
 
-/* Client operations */
-arakoon_rc arakoon_hello(ArakoonCluster *cluster,
-    const ArakoonClientCallOptions * const options,
-    const char * const client_id, const char * const cluster_id,
-    char ** const result) {
-        size_t len = 0, client_id_len = 0, cluster_id_len = 0;
-        char *command = NULL, *c = NULL;
-        arakoon_rc rc = 0;
-        void *result_data = NULL;
-        size_t result_size = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+char * _arakoon_sequence_encode(const ArakoonSequence * const sequence,
+    char *c) {
+        const ArakoonSequenceReference *reference = NULL;
+        size_t offset = 0, i = 0;
 
-        FUNCTION_ENTER(arakoon_hello);
+        /* Total string size, outer sequence, number of sequence items */
+        ARAKOON_PROTOCOL_WRITE_UINT32(c,
+                _arakoon_sequence_get_encoded_size(sequence) -
+                ARAKOON_PROTOCOL_UINT32_LEN);
+        ARAKOON_PROTOCOL_WRITE_UINT32(c, ARAKOON_SEQUENCE_ITEM_TYPE_SEQUENCE);
+        ARAKOON_PROTOCOL_WRITE_UINT32(c, sequence->count);
 
-        ASSERT_NON_NULL_RC(cluster);
-        ASSERT_NON_NULL_RC(client_id);
-        ASSERT_NON_NULL_RC(cluster_id);
-        ASSERT_NON_NULL_RC(result);
+        for(i = 0; i < sequence->references_size; i++) {
+                reference = &sequence->references[i];
 
-        _arakoon_cluster_reset_last_error(cluster);
+                memcpy(c, ARAKOON_SLAB_AT(&sequence->slab, offset),
+                        reference->offset - offset);
+                c += reference->offset - offset;
+                offset = reference->offset;
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
+                memcpy(c, reference->data, reference->size);
+                c += reference->size;
+        }
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+        if(sequence->slab.used != offset) {
+                memcpy(c, ARAKOON_SLAB_AT(&sequence->slab, offset),
+                        sequence->slab.used - offset);
+                c += sequence->slab.used - offset;
+        }
 
-        client_id_len = strlen(client_id);
-        cluster_id_len = strlen(cluster_id);
+        return c;
+}
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(client_id_len)
-                + ARAKOON_PROTOCOL_STRING_LEN(cluster_id_len);
+/* Read a string item starting at 'offset', which is moved past it */
+static void _arakoon_sequence_read_string(
+    const ArakoonSequence * const sequence, size_t *offset,
+    size_t *reference, size_t *size, const void **data) {
+        const ArakoonSequenceReference *reference_ = NULL;
+        uint32_t size_ = 0;
+
+        memcpy(&size_, ARAKOON_SLAB_AT(&sequence->slab, *offset),
+                sizeof(size_));
+        *offset += sizeof(size_);
+        *size = size_;
+
+        if(*reference < sequence->references_size) {
+                reference_ = &sequence->references[*reference];
+                if(size_ != 0 && reference_->offset == *offset) {
+                        *data = reference_->data;
+                        (*reference)++;
+                        return;
+                }
+        }
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        *data = ARAKOON_SLAB_AT(&sequence->slab, *offset);
+        *offset += size_;
+}
 
-        c = command;
+/* Drop the read cache entries of all keys set or deleted by a sequence */
+static void _arakoon_sequence_invalidate(
+    const ArakoonSequence * const sequence, ArakoonReadCache * const cache) {
+        size_t offset = 0, reference = 0, key_size = 0, value_size = 0;
+        const void *key = NULL, *value = NULL;
+        uint32_t type = 0, i = 0;
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x01, 0x00);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, client_id, client_id_len);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, cluster_id, cluster_id_len);
+        for(i = 0; i < sequence->count; i++) {
+                memcpy(&type, ARAKOON_SLAB_AT(&sequence->slab, offset),
+                        sizeof(type));
+                offset += sizeof(type);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+                _arakoon_sequence_read_string(sequence, &offset, &reference,
+                        &key_size, &key);
 
-        rc = _arakoon_cluster_node_write_bytes(master, len, command, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+                switch(type) {
+                        case ARAKOON_SEQUENCE_ITEM_TYPE_SET: {
+                                _arakoon_sequence_read_string(sequence,
+                                        &offset, &reference, &value_size,
+                                        &value);
+                                _arakoon_read_cache_invalidate(cache,
+                                        key_size, key);
+                        }; break;
+                        case ARAKOON_SEQUENCE_ITEM_TYPE_DELETE: {
+                                _arakoon_read_cache_invalidate(cache,
+                                        key_size, key);
+                        }; break;
+                        case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT: {
+                                if(*ARAKOON_SLAB_AT(&sequence->slab,
+                                    offset++) != ARAKOON_BOOL_FALSE) {
+                                        _arakoon_sequence_read_string(
+                                                sequence, &offset, &reference,
+                                                &value_size, &value);
+                                }
+                        }; break;
+                        case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS: {
+                        }; break;
+                        default: {
+                                _arakoon_read_cache_invalidate_prefix(cache,
+                                        0, NULL);
+                                return;
+                        }; break;
+                }
+        }
+}
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+/* Read cache
+ *
+ * Reads only use the cache of a cluster when their options allow dirty
+ * reads, while writes always update it, see arakoon-read-cache.h. */
+static ArakoonReadCache * _arakoon_cache_for(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options) {
+        ArakoonReadCache *cache = NULL;
+        READ_OPTIONS;
 
-        ARAKOON_PROTOCOL_READ_STRING(master, result_data,
-                result_size, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result = NULL;
-                return rc;
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache == NULL ||
+            !arakoon_client_call_options_get_allow_dirty(options_)) {
+                return NULL;
+        }
+
+        return cache;
+}
+
+/* Store the outcome of a read sent after taking 'ticket' */
+static void _arakoon_cache_read_done(ArakoonReadCache * const cache,
+    const uint64_t ticket, const arakoon_rc rc,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_read_cache_fill(cache, ticket, key_size, key,
+                        value_size, value);
+        }
+        else if(rc == ARAKOON_RC_NOT_FOUND) {
+                _arakoon_read_cache_fill(cache, ticket, key_size, key, 0,
+                        NULL);
+        }
+}
+
+/* Store the outcome of a write of 'value', NULL meaning the key was
+ * deleted, sent after taking 'ticket'. A failed write may or may not have
+ * been applied. */
+static void _arakoon_cache_write_done(ArakoonReadCache * const cache,
+    const uint64_t ticket, const arakoon_rc rc,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                _arakoon_read_cache_update(cache, ticket, key_size, key,
+                        value_size, value);
         }
+        else {
+                _arakoon_read_cache_invalidate(cache, key_size, key);
+        }
+}
+
+typedef struct {
+        size_t size;
+        void *data;
+} ArakoonCacheValue;
+
+static void * _arakoon_cache_alloc_value(const size_t size, void *data) {
+        ArakoonCacheValue *value = (ArakoonCacheValue *) data;
+
+        value->size = size;
+        value->data = size == 0 ?
+                ARAKOON_ZERO_LENGTH_DATA_PTR : arakoon_mem_new(size, char);
+
+        return value->data;
+}
+
+typedef struct {
+        ArakoonValueList *list;
+        size_t index;
+} ArakoonCacheListEntry;
+
+static void * _arakoon_cache_alloc_list_entry(const size_t size,
+    void *data) {
+        const ArakoonCacheListEntry *entry = (ArakoonCacheListEntry *) data;
+
+        return _arakoon_value_list_set(entry->list, entry->index, size);
+}
+
+/* Client operations
+ *
+ * Requests are encoded and responses decoded by the command codec, see
+ * arakoon-command.h. Every public operation ends the call on a multiplexed
+ * connection once the response has been read completely. */
+static arakoon_rc _arakoon_hello(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const client_id, const char * const cluster_id,
+    char ** const result) {
+        ArakoonCommandResult result_;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_hello);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(client_id);
+        ASSERT_NON_NULL_RC(cluster_id);
+        ASSERT_NON_NULL_RC(result);
+
+        *result = NULL;
+
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_HELLO,
+                strlen(client_id), client_id,
+                strlen(cluster_id), cluster_id);
+        RETURN_IF_NOT_SUCCESS(rc);
 
-        *result = arakoon_utils_make_string(result_data, result_size);
+        *result = arakoon_utils_make_string(result_.data, result_.size);
         RETURN_ENOMEM_IF_NULL(*result);
 
         return rc;
 }
 
+arakoon_rc arakoon_hello(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const client_id, const char * const cluster_id,
+    char ** const result) {
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_hello(cluster, options, client_id, cluster_id, result);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
 arakoon_rc arakoon_who_master(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     char ** const master) {
@@ -362,56 +614,54 @@ arakoon_rc arakoon_who_master(ArakoonCluster *cluster,
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(master);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master_);
-
         READ_OPTIONS;
+
+        ARAKOON_CLUSTER_GET_MASTER(cluster, options_, master_);
+
         timeout = arakoon_client_call_options_get_timeout(options_);
 
         return _arakoon_cluster_node_who_master(master_, &timeout,
                 master);
 }
 
-arakoon_rc arakoon_expect_progress_possible(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_expect_progress_possible(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     arakoon_bool *result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
         FUNCTION_ENTER(arakoon_expect_progress_possible);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(result);
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
-
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN;
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_EXPECT_PROGRESS_POSSIBLE);
+        *result = result_.bool_;
 
-        c = command;
+        return rc;
+}
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x12, 0x00);
+arakoon_rc arakoon_expect_progress_possible(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    arakoon_bool *result) {
+        arakoon_rc rc = 0;
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        rc = _arakoon_expect_progress_possible(cluster, options, result);
+        _arakoon_mux_end_call(rc);
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        return rc;
+}
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+static arakoon_rc _arakoon_exists(ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key, arakoon_bool *result) {
+        ArakoonCommandResult result_;
+        arakoon_rc rc = 0;
 
-        ARAKOON_PROTOCOL_READ_BOOL(master, *result, rc, &timeout);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_EXISTS, key_size, key);
+        *result = result_.bool_;
 
         return rc;
 }
@@ -419,50 +669,53 @@ arakoon_rc arakoon_expect_progress_possible(ArakoonCluster *cluster,
 arakoon_rc arakoon_exists(ArakoonCluster * const cluster,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key, arakoon_bool *result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
 
         FUNCTION_ENTER(arakoon_exists);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(key);
         ASSERT_NON_NULL_RC(result);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size);
+        cache = _arakoon_cache_for(cluster, options);
+        if(cache != NULL) {
+                _arakoon_cluster_reset_last_error(cluster);
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
+                rc = _arakoon_read_cache_get(cache, key_size, key, &ticket,
+                        NULL, NULL);
+                if(rc != -ENOENT) {
+                        *result = ARAKOON_RC_IS_SUCCESS(rc) ?
+                                ARAKOON_BOOL_TRUE : ARAKOON_BOOL_FALSE;
+                        return ARAKOON_RC_SUCCESS;
+                }
+        }
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x07, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
+        rc = _arakoon_exists(cluster, options, key_size, key, result);
+        _arakoon_mux_end_call(rc);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        /* Only the absence of a key can be cached */
+        if(cache != NULL && ARAKOON_RC_IS_SUCCESS(rc) &&
+            *result == ARAKOON_BOOL_FALSE) {
+                _arakoon_read_cache_fill(cache, ticket, key_size, key, 0,
+                        NULL);
+        }
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        return rc;
+}
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+static arakoon_rc _arakoon_get(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    size_t *result_size, void **result) {
+        ArakoonCommandResult result_;
+        arakoon_rc rc = 0;
 
-        ARAKOON_PROTOCOL_READ_BOOL(master, *result, rc, &timeout);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_GET, key_size, key);
+        *result_size = result_.size;
+        *result = result_.data;
 
         return rc;
 }
@@ -471,236 +724,391 @@ arakoon_rc arakoon_get(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key,
     size_t *result_size, void **result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonReadCoalescer *coalescer = NULL;
+        ArakoonReadCache *cache = NULL;
+        ArakoonCacheValue value = {0, NULL};
+        uint64_t ticket = 0;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
 
         FUNCTION_ENTER(arakoon_get);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(key);
         ASSERT_NON_NULL_RC(result_size);
         ASSERT_NON_NULL_RC(result);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size);
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x08, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
-
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
-
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+        cache = _arakoon_cache_for(cluster, options);
+        if(cache != NULL) {
+                _arakoon_cluster_reset_last_error(cluster);
 
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+                rc = _arakoon_read_cache_get(cache, key_size, key, &ticket,
+                        _arakoon_cache_alloc_value, &value);
+                if(rc != -ENOENT) {
+                        *result_size = value.data == NULL ? 0 : value.size;
+                        *result = value.data;
+                        return rc;
+                }
+        }
 
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result_size = 0;
-                *result = NULL;
-                return rc;
+        coalescer = _arakoon_cluster_get_read_coalescer(cluster);
+        if(coalescer != NULL) {
+                rc = _arakoon_read_coalescer_get(coalescer, cluster,
+                        options, key_size, key, result_size, result);
+        }
+        else {
+                rc = _arakoon_get(cluster, options, key_size, key,
+                        result_size, result);
+                _arakoon_mux_end_call(rc);
         }
 
-        ARAKOON_PROTOCOL_READ_STRING(master, *result, *result_size, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result_size = 0;
-                *result = NULL;
+        if(cache != NULL) {
+                _arakoon_cache_read_done(cache, ticket, rc, key_size, key,
+                        *result_size, *result);
         }
 
         return rc;
 }
 
-arakoon_rc arakoon_set(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_set(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key,
     const size_t value_size, const void * const value) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
         FUNCTION_ENTER(arakoon_set);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(key);
         ASSERT_NON_NULL_RC(value);
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                ticket = _arakoon_read_cache_ticket(cache, key_size, key);
+        }
+
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_SET, key_size, key, value_size, value);
+
+        if(cache != NULL) {
+                _arakoon_cache_write_done(cache, ticket, rc, key_size, key,
+                        value_size, value);
+        }
+
+        return rc;
+}
+
+arakoon_rc arakoon_set(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        arakoon_rc rc = 0;
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+        rc = _arakoon_set(cluster, options, key_size, key, value_size, value);
+        _arakoon_mux_end_call(rc);
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size)
-                + ARAKOON_PROTOCOL_STRING_LEN(value_size);
+        return rc;
+}
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+static arakoon_rc _arakoon_confirm(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0;
+        arakoon_rc rc = 0;
 
-        c = command;
+        FUNCTION_ENTER(arakoon_confirm);
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x09, 0x00);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, value, value_size);
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(value);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                ticket = _arakoon_read_cache_ticket(cache, key_size, key);
+        }
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_CONFIRM, key_size, key, value_size, value);
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+        if(cache != NULL) {
+                _arakoon_cache_write_done(cache, ticket, rc, key_size, key,
+                        value_size, value);
+        }
+
+        return rc;
+}
+
+arakoon_rc arakoon_confirm(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        arakoon_rc rc = 0;
 
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+        rc = _arakoon_confirm(cluster, options, key_size, key, value_size,
+                value);
+        _arakoon_mux_end_call(rc);
 
         return rc;
 }
 
-arakoon_rc arakoon_multi_get(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_multi_get(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const ArakoonValueList * const keys, ArakoonValueList **result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
         arakoon_rc rc = 0;
-        ArakoonValueListIter *iter = NULL;
-        size_t value_size = 0;
-        const void *value = NULL;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
+        /* The request is written at once, so it can be pipelined on a
+         * multiplexed connection */
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_MULTI_GET, keys);
+        *result = result_.value_list;
 
-        FUNCTION_ENTER(arakoon_multi_get);
+        return rc;
+}
 
-        _arakoon_cluster_reset_last_error(cluster);
+static arakoon_rc _arakoon_multi_get_option(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonValueList **result) {
+        ArakoonCommandResult result_;
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_MULTI_GET_OPTION, keys);
+        *result = result_.value_list;
+
+        return rc;
+}
+
+/* Answer a 'multi_get' or 'multi_get_option' call from the read cache
+ * where possible, fetching all other keys using a single call */
+static arakoon_rc _arakoon_multi_get_cached(ArakoonReadCache * const cache,
+    const arakoon_bool option, ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonValueList **result) {
+        ArakoonValueList *list = NULL, *missing = NULL, *fetched = NULL;
+        ArakoonCacheListEntry entry = {NULL, 0};
+        size_t *indices = NULL;
+        uint64_t *tickets = NULL;
+        ssize_t count = 0, i = 0;
+        size_t key_size = 0, value_size = 0, missing_count = 0, j = 0;
+        const void *key = NULL, *value = NULL;
+        void *data = NULL;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_multi_get_cached);
 
-        ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(keys);
         ASSERT_NON_NULL_RC(result);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+        count = arakoon_value_list_size(keys);
 
-        *result = NULL;
+        list = arakoon_value_list_new();
+        missing = arakoon_value_list_new();
+        indices = arakoon_mem_new(count + 1, size_t);
+        tickets = arakoon_mem_new(count + 1, uint64_t);
+        if(list == NULL || missing == NULL || indices == NULL ||
+            tickets == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_UINT32_LEN;
+        rc = _arakoon_value_list_resize(list, count);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        entry.list = list;
 
-        c = command;
+        for(i = 0; i < count; i++) {
+                rc = arakoon_value_list_get(keys, i, &key_size, &key);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x11, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_UINT32(c, arakoon_value_list_size(keys));
+                entry.index = i;
+                rc = _arakoon_read_cache_get(cache, key_size, key,
+                        &tickets[missing_count],
+                        _arakoon_cache_alloc_list_entry, &entry);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+                if(rc == -ENOENT) {
+                        rc = arakoon_value_list_add(missing, key_size, key);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                goto out;
+                        }
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+                        indices[missing_count] = i;
+                        missing_count++;
+                }
+                else if(rc == ARAKOON_RC_NOT_FOUND && option) {
+                        _arakoon_value_list_set_none(list, i);
+                        rc = ARAKOON_RC_SUCCESS;
+                }
+                else if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+        }
 
-        iter = arakoon_value_list_create_iter(keys);
-        FOR_ARAKOON_VALUE_ITER(iter, &value_size, &value) {
-                /* TODO Multi syscall vs memory copies... */
-                WRITE_BYTES(master, &value_size,
-                        ARAKOON_PROTOCOL_UINT32_LEN, rc, &timeout);
-                RETURN_IF_NOT_SUCCESS(rc);
+        if(missing_count != 0) {
+                if(option) {
+                        rc = _arakoon_multi_get_option(cluster, options,
+                                missing, &fetched);
+                }
+                else {
+                        rc = _arakoon_multi_get(cluster, options, missing,
+                                &fetched);
+                }
+                _arakoon_mux_end_call(rc);
 
-                WRITE_BYTES(master, value, value_size, rc,
-                        &timeout);
-                RETURN_IF_NOT_SUCCESS(rc);
-        }
-        arakoon_value_list_iter_free(iter);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+                for(j = 0; j < missing_count; j++) {
+                        rc = arakoon_value_list_get(missing, j, &key_size,
+                                &key);
+                        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                                rc = arakoon_value_list_get(fetched, j,
+                                        &value_size, &value);
+                        }
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                goto out;
+                        }
+
+                        _arakoon_read_cache_fill(cache, tickets[j], key_size,
+                                key, value_size, value);
+
+                        if(value == NULL) {
+                                _arakoon_value_list_set_none(list, indices[j]);
+                                continue;
+                        }
+
+                        data = _arakoon_value_list_set(list, indices[j],
+                                value_size);
+                        if(data == NULL) {
+                                rc = -ENOMEM;
+                                goto out;
+                        }
+                        if(value_size != 0) {
+                                memcpy(data, value, value_size);
+                        }
+                }
+        }
 
-        *result = arakoon_value_list_new();
-        RETURN_ENOMEM_IF_NULL(*result);
+        *result = list;
+        list = NULL;
 
-        ARAKOON_PROTOCOL_READ_STRING_LIST(master, *result, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                arakoon_value_list_free(*result);
-                *result = NULL;
+out:
+        arakoon_value_list_free(list);
+        arakoon_value_list_free(missing);
+        arakoon_value_list_free(fetched);
+        if(indices != NULL) {
+                arakoon_mem_free(indices);
+        }
+        if(tickets != NULL) {
+                arakoon_mem_free(tickets);
         }
 
         return rc;
 }
 
-arakoon_rc arakoon_delete(ArakoonCluster *cluster,
+arakoon_rc arakoon_multi_get(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
-    const size_t key_size, const void * const key) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+    const ArakoonValueList * const keys, ArakoonValueList **result) {
+        ArakoonReadCache *cache = NULL;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
-        FUNCTION_ENTER(arakoon_delete);
+        FUNCTION_ENTER(arakoon_multi_get);
 
-        _arakoon_cluster_reset_last_error(cluster);
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(keys);
+        ASSERT_NON_NULL_RC(result);
+
+        cache = _arakoon_cache_for(cluster, options);
+        if(cache != NULL) {
+                _arakoon_cluster_reset_last_error(cluster);
+
+                return _arakoon_multi_get_cached(cache, ARAKOON_BOOL_FALSE,
+                        cluster, options, keys, result);
+        }
+
+        rc = _arakoon_multi_get(cluster, options, keys, result);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+arakoon_rc arakoon_multi_get_option(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonValueList **result) {
+        ArakoonReadCache *cache = NULL;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_multi_get_option);
 
         ASSERT_NON_NULL_RC(cluster);
-        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(keys);
+        ASSERT_NON_NULL_RC(result);
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
+        cache = _arakoon_cache_for(cluster, options);
+        if(cache != NULL) {
+                _arakoon_cluster_reset_last_error(cluster);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+                return _arakoon_multi_get_cached(cache, ARAKOON_BOOL_TRUE,
+                        cluster, options, keys, result);
+        }
+
+        rc = _arakoon_multi_get_option(cluster, options, keys, result);
+        _arakoon_mux_end_call(rc);
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size);
+        return rc;
+}
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+static arakoon_rc _arakoon_delete(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key) {
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0;
+        arakoon_rc rc = 0;
 
-        c = command;
+        FUNCTION_ENTER(arakoon_delete);
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x0a, 0x00);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(key);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                ticket = _arakoon_read_cache_ticket(cache, key_size, key);
+        }
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_DELETE, key_size, key);
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+        if(cache != NULL) {
+                _arakoon_cache_write_done(cache, ticket, rc, key_size, key,
+                        0, NULL);
+        }
+
+        return rc;
+}
+
+arakoon_rc arakoon_delete(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key) {
+        arakoon_rc rc = 0;
 
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+        rc = _arakoon_delete(cluster, options, key_size, key);
+        _arakoon_mux_end_call(rc);
 
         return rc;
 }
 
-arakoon_rc arakoon_range(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_range(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t begin_key_size, const void * const begin_key,
     const arakoon_bool begin_key_included,
@@ -708,72 +1116,43 @@ arakoon_rc arakoon_range(ArakoonCluster *cluster,
     const arakoon_bool end_key_included,
     const ssize_t max_elements,
     ArakoonValueList **result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
 
         FUNCTION_ENTER(arakoon_range);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(result);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(begin_key, begin_key_size)
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(end_key, end_key_size)
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_INT32_LEN;
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x0b, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, begin_key, begin_key_size);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c, begin_key_included);
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, end_key, end_key_size);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c, end_key_included);
-        ARAKOON_PROTOCOL_WRITE_INT32(c, max_elements);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
-
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_RANGE,
+                begin_key_size, begin_key, begin_key_included,
+                end_key_size, end_key, end_key_included,
+                (int32_t) max_elements);
+        *result = result_.value_list;
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result = NULL;
-                return rc;
-        }
+        return rc;
+}
 
-        *result = arakoon_value_list_new();
-        RETURN_ENOMEM_IF_NULL(*result);
+arakoon_rc arakoon_range(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonValueList **result) {
+        arakoon_rc rc = 0;
 
-        ARAKOON_PROTOCOL_READ_STRING_LIST(master, *result, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                arakoon_value_list_free(*result);
-                *result = NULL;
-        }
+        rc = _arakoon_range(cluster, options, begin_key_size, begin_key,
+                begin_key_included, end_key_size, end_key, end_key_included,
+                max_elements, result);
+        _arakoon_mux_end_call(rc);
 
         return rc;
 }
 
-static arakoon_rc _arakoon_range_helper(char cmd1, char cmd2,
+static arakoon_rc _arakoon_range_helper(ArakoonCommand command,
     ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t begin_key_size, const void * const begin_key,
@@ -782,67 +1161,19 @@ static arakoon_rc _arakoon_range_helper(char cmd1, char cmd2,
     const arakoon_bool end_key_included,
     const ssize_t max_elements,
     ArakoonKeyValueList **result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
 
         FUNCTION_ENTER(_arakoon_range_helper);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(result);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(begin_key, begin_key_size)
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(end_key, end_key_size)
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_INT32_LEN;
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, cmd1, cmd2);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, begin_key, begin_key_size);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c, begin_key_included);
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, end_key, end_key_size);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c, end_key_included);
-        ARAKOON_PROTOCOL_WRITE_INT32(c, max_elements);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
-
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
-
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result = NULL;
-                return rc;
-        }
-
-        *result = _arakoon_key_value_list_new();
-        RETURN_ENOMEM_IF_NULL(*result);
-
-        ARAKOON_PROTOCOL_READ_STRING_STRING_LIST(master, *result, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                arakoon_key_value_list_free(*result);
-                *result = NULL;
-        }
+        rc = _arakoon_command_call(cluster, options, &result_, command,
+                begin_key_size, begin_key, begin_key_included,
+                end_key_size, end_key, end_key_included,
+                (int32_t) max_elements);
+        *result = result_.key_value_list;
 
         return rc;
 }
@@ -855,303 +1186,197 @@ arakoon_rc arakoon_range_entries(ArakoonCluster *cluster,
     const arakoon_bool end_key_included,
     const ssize_t max_elements,
     ArakoonKeyValueList **result) {
+        arakoon_rc rc = 0;
+
         FUNCTION_ENTER(arakoon_range_entries);
 
-        return _arakoon_range_helper(0x0f, 0x00,
+        rc = _arakoon_range_helper(ARAKOON_COMMAND_RANGE_ENTRIES,
                 cluster, options,
                 begin_key_size, begin_key, begin_key_included,
                 end_key_size, end_key, end_key_included,
                 max_elements,
                 result);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
 }
 
 
-arakoon_rc arakoon_prefix(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_prefix(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t begin_key_size, const void * const begin_key,
     const ssize_t max_elements,
     ArakoonValueList **result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
 
         FUNCTION_ENTER(arakoon_prefix);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(begin_key);
         ASSERT_NON_NULL_RC(result);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(begin_key_size)
-                + ARAKOON_PROTOCOL_UINT32_LEN;
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x0c, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING(c, begin_key, begin_key_size);
-        ARAKOON_PROTOCOL_WRITE_INT32(c, max_elements);
-
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_PREFIX, begin_key_size, begin_key,
+                (int32_t) max_elements);
+        *result = result_.value_list;
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result = NULL;
-                return rc;
-        }
+        return rc;
+}
 
-        *result = arakoon_value_list_new();
-        RETURN_ENOMEM_IF_NULL(*result);
+arakoon_rc arakoon_prefix(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const ssize_t max_elements,
+    ArakoonValueList **result) {
+        arakoon_rc rc = 0;
 
-        ARAKOON_PROTOCOL_READ_STRING_LIST(master, *result, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                arakoon_value_list_free(*result);
-                *result = NULL;
-        }
+        rc = _arakoon_prefix(cluster, options, begin_key_size, begin_key,
+                max_elements, result);
+        _arakoon_mux_end_call(rc);
 
         return rc;
 }
 
-arakoon_rc arakoon_test_and_set(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_test_and_set(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key,
     const size_t old_value_size, const void * const old_value,
     const size_t new_value_size, const void * const new_value,
     size_t *result_size, void **result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0;
+        arakoon_bool swapped = ARAKOON_BOOL_FALSE;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
         FUNCTION_ENTER(arakoon_test_and_set);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(key);
         ASSERT_NON_NULL_RC(result_size);
         ASSERT_NON_NULL_RC(result);
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
-
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size)
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(old_value, old_value_size)
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(new_value, new_value_size);
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x0d, 0x00);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, old_value, old_value_size);
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, new_value, new_value_size);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
-
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                ticket = _arakoon_read_cache_ticket(cache, key_size, key);
+        }
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_TEST_AND_SET, key_size, key,
+                old_value_size, old_value, new_value_size, new_value);
+        *result_size = result_.size;
+        *result = result_.data;
+
+        if(cache != NULL) {
+                /* The value returned is the one found by the server, the
+                 * new value was only set if it matched the old value */
+                if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                        swapped = *result == NULL ? old_value == NULL :
+                                (old_value != NULL &&
+                                 *result_size == old_value_size &&
+                                 memcmp(*result, old_value,
+                                        old_value_size) == 0);
+                }
 
-        ARAKOON_PROTOCOL_READ_STRING_OPTION(master, *result,
-                *result_size, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result = NULL;
-                *result_size = 0;
+                if(swapped) {
+                        _arakoon_cache_write_done(cache, ticket, rc,
+                                key_size, key, new_value_size, new_value);
+                }
+                else {
+                        _arakoon_cache_write_done(cache, ticket, rc,
+                                key_size, key, *result_size, *result);
+                }
         }
 
         return rc;
 }
 
-static arakoon_rc _arakoon_sequence_impl(char code,
-    ArakoonCluster *cluster,
+arakoon_rc arakoon_test_and_set(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
-    const ArakoonSequence * const sequence) {
-        size_t len = 0, i = 0;
-        uint32_t count = 0;
-        ArakoonSequenceItem *item = NULL;
-        char *command = NULL;
+    const size_t key_size, const void * const key,
+    const size_t old_value_size, const void * const old_value,
+    const size_t new_value_size, const void * const new_value,
+    size_t *result_size, void **result) {
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        FUNCTION_ENTER(_arakoon_sequence_impl);
 
-        _arakoon_cluster_reset_last_error(cluster);
+        rc = _arakoon_test_and_set(cluster, options, key_size, key,
+                old_value_size, old_value, new_value_size, new_value,
+                result_size, result);
+        _arakoon_mux_end_call(rc);
 
-        ASSERT_NON_NULL_RC(cluster);
-        ASSERT_NON_NULL_RC(sequence);
+        return rc;
+}
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
+static arakoon_rc _arakoon_replace(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value,
+    size_t *result_size, void **result) {
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0;
+        arakoon_rc rc = 0;
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+        FUNCTION_ENTER(arakoon_replace);
 
-#define I(n) (len += n)
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(result_size);
+        ASSERT_NON_NULL_RC(result);
 
-        I(ARAKOON_PROTOCOL_COMMAND_LEN); /* Command */
-        I(ARAKOON_PROTOCOL_UINT32_LEN); /* Total string size */
-        I(ARAKOON_PROTOCOL_UINT32_LEN); /* Outer sequence */
-        I(ARAKOON_PROTOCOL_UINT32_LEN); /* Number of sequence items */
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                ticket = _arakoon_read_cache_ticket(cache, key_size, key);
+        }
 
-        for(item = sequence->item; item != NULL; item = item->next) {
-                I(ARAKOON_PROTOCOL_UINT32_LEN); /* Command type */
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_REPLACE, key_size, key, value_size, value);
+        *result_size = result_.size;
+        *result = result_.data;
 
-                switch(item->type) {
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_SET: {
-                                I(ARAKOON_PROTOCOL_STRING_LEN(item->data.set.key_size));
-                                I(ARAKOON_PROTOCOL_STRING_LEN(item->data.set.value_size));
-                        }; break;
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_DELETE: {
-                                I(ARAKOON_PROTOCOL_STRING_LEN(item->data.delete_.key_size));
-                        }; break;
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT: {
-                                I(ARAKOON_PROTOCOL_STRING_LEN(item->data.assert.key_size));
-                                I(ARAKOON_PROTOCOL_STRING_OPTION_LEN(
-                                    item->data.assert.value, item->data.assert.value_size));
-                        }; break;
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS: {
-                                I(ARAKOON_PROTOCOL_STRING_LEN(item->data.assert_exists.key_size));
-                        }; break;
-                        default: {
-                                _arakoon_log_fatal("Invalid sequence type");
-                                abort();
-                        }; break;
-                }
+        if(cache != NULL) {
+                _arakoon_cache_write_done(cache, ticket, rc, key_size, key,
+                        value_size, value);
         }
 
-#undef I
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        i = len;
-
-        /* NOTE This code builds the command back-to-front! */
-#define WRITE_UINT32(n)                   \
-        STMT_START                        \
-        i -= ARAKOON_PROTOCOL_UINT32_LEN; \
-        *((uint32_t *)&command[i]) = n;   \
-        STMT_END
-
-#define WRITE_STRING(s, l)         \
-        STMT_START                 \
-        i -= l;                    \
-        memcpy(&command[i], s, l); \
-        WRITE_UINT32(l);           \
-        STMT_END
-
-#define WRITE_STRING_OPTION(s, l)                                          \
-        STMT_START                                                         \
-        if(s == NULL) {                                                    \
-                if(l != 0) {                                               \
-                        _arakoon_log_error(                                \
-                                "String is NULL, but length is non-zero"); \
-                }                                                          \
-                i -= ARAKOON_PROTOCOL_BOOL_LEN;                            \
-                command[i] = ARAKOON_BOOL_FALSE;                           \
-        }                                                                  \
-        else {                                                             \
-                WRITE_STRING(s, l);                                        \
-                i -= ARAKOON_PROTOCOL_BOOL_LEN;                            \
-                command[i] = ARAKOON_BOOL_TRUE;                            \
-        }                                                                  \
-        STMT_END
-
-        for(item = sequence->item; item != NULL; item = item->next) {
-                count++;
-
-                switch(item->type) {
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_SET: {
-                                WRITE_STRING(item->data.set.value,
-                                        item->data.set.value_size);
-                                WRITE_STRING(item->data.set.key,
-                                        item->data.set.key_size);
-                                WRITE_UINT32(1);
-                        }; break;
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_DELETE: {
-                                WRITE_STRING(item->data.delete_.key,
-                                        item->data.delete_.key_size);
-                                WRITE_UINT32(2);
-                        }; break;
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT: {
-                                WRITE_STRING_OPTION(item->data.assert.value,
-                                        item->data.assert.value_size);
-                                WRITE_STRING(item->data.assert.key,
-                                        item->data.assert.key_size);
-                                WRITE_UINT32(8);
-                        }; break;
-                        case ARAKOON_SEQUENCE_ITEM_TYPE_ASSERT_EXISTS: {
-                                WRITE_STRING(item->data.assert_exists.key,
-                                        item->data.assert_exists.key_size);
-                                WRITE_UINT32(15);
-                        }; break;
-                        default: {
-                                _arakoon_log_fatal("Invalid sequence type");
-                                abort();
-                        }; break;
-                }
-        }
+        return rc;
+}
 
-        if(i != ARAKOON_PROTOCOL_COMMAND_LEN /* Command */
-                        + ARAKOON_PROTOCOL_UINT32_LEN /* String length */
-                        + ARAKOON_PROTOCOL_UINT32_LEN /* Outer sequence */
-                        + ARAKOON_PROTOCOL_UINT32_LEN /* Item count */
-          ) {
-                _arakoon_log_fatal("Incorrect count in sequence construction");
-                abort();
-        }
+arakoon_rc arakoon_replace(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value,
+    size_t *result_size, void **result) {
+        arakoon_rc rc = 0;
 
-        WRITE_UINT32(count);
-        WRITE_UINT32(5);
-        WRITE_UINT32(len - ARAKOON_PROTOCOL_UINT32_LEN - ARAKOON_PROTOCOL_COMMAND_LEN);
+        rc = _arakoon_replace(cluster, options, key_size, key,
+                value_size, value, result_size, result);
+        _arakoon_mux_end_call(rc);
 
-#undef WRITE_UINT32
-#undef WRITE_STRING
-#undef WRITE_STRING_OPTION
+        return rc;
+}
 
-        if(i != ARAKOON_PROTOCOL_COMMAND_LEN) {
-                _arakoon_log_fatal("Incorrect count in sequence construction");
-                abort();
-        }
+static arakoon_rc _arakoon_sequence_impl(ArakoonCommand command,
+    ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonSequence * const sequence) {
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        arakoon_rc rc = 0;
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(command, code, 0x00);
-        /* Macro changes our pointer... */
-        command -= ARAKOON_PROTOCOL_COMMAND_LEN;
+        FUNCTION_ENTER(_arakoon_sequence_impl);
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(sequence);
+
+        rc = _arakoon_command_call(cluster, options, &result_, command,
+                sequence);
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                _arakoon_sequence_invalidate(sequence, cache);
+        }
 
         return rc;
 }
@@ -1159,114 +1384,189 @@ static arakoon_rc _arakoon_sequence_impl(char code,
 arakoon_rc arakoon_sequence(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const ArakoonSequence * const sequence) {
+        arakoon_rc rc = 0;
+
         FUNCTION_ENTER(arakoon_sequence);
 
-        return _arakoon_sequence_impl(0x10, cluster, options, sequence);
+        rc = _arakoon_sequence_impl(ARAKOON_COMMAND_SEQUENCE, cluster,
+                options, sequence);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
 }
 
 arakoon_rc arakoon_synced_sequence(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const ArakoonSequence * const sequence) {
+        arakoon_rc rc = 0;
+
         FUNCTION_ENTER(arakoon_synced_sequence);
 
-        return _arakoon_sequence_impl(0x24, cluster, options, sequence);
+        rc = _arakoon_sequence_impl(ARAKOON_COMMAND_SYNCED_SEQUENCE, cluster,
+                options, sequence);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
 }
 
-arakoon_rc arakoon_assert(ArakoonCluster *cluster,
+arakoon_rc arakoon_multi_confirm(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
-    const size_t key_size, const void * const key,
-    const size_t value_size, const void * const value) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+    const ArakoonValueList * const keys,
+    const ArakoonValueList * const values) {
+        ArakoonValueList *current = NULL;
+        ArakoonSequence *sequence = NULL;
+        ArakoonClientCallOptions *consistent = NULL;
+        const ArakoonClientCallOptions *read_options = options;
+        ssize_t count = 0, i = 0;
+        size_t key_size = 0, value_size = 0, current_size = 0;
+        const void *key = NULL, *value = NULL, *current_value = NULL;
+        arakoon_bool changed = ARAKOON_BOOL_FALSE;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        FUNCTION_ENTER(arakoon_assert);
 
-        _arakoon_cluster_reset_last_error(cluster);
+        FUNCTION_ENTER(arakoon_multi_confirm);
 
         ASSERT_NON_NULL_RC(cluster);
-        ASSERT_NON_NULL_RC(key);
+        ASSERT_NON_NULL_RC(keys);
+        ASSERT_NON_NULL_RC(values);
 
         READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+        count = arakoon_value_list_size(keys);
+        if(count != arakoon_value_list_size(values)) {
+                return -EINVAL;
+        }
+        if(count == 0) {
+                return ARAKOON_RC_SUCCESS;
+        }
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size)
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(value, value_size);
+        /* The values are asserted below, so they're read from the master
+         * even if the caller allows dirty reads, which also keeps the read
+         * cache out of the way */
+        if(arakoon_client_call_options_get_allow_dirty(options_)) {
+                consistent = _arakoon_client_call_options_copy(options_);
+                RETURN_ENOMEM_IF_NULL(consistent);
+                (void) arakoon_client_call_options_set_allow_dirty(consistent,
+                        ARAKOON_BOOL_FALSE);
+                read_options = consistent;
+        }
+
+        rc = arakoon_multi_get_option(cluster, read_options, keys, &current);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        sequence = arakoon_sequence_new();
+        if(sequence == NULL) {
+                rc = -ENOMEM;
+                goto out;
+        }
 
-        c = command;
+        /* Every changed key is asserted to still hold the value read above,
+         * so a concurrent update fails the sequence instead of being
+         * overwritten based on stale data. */
+        for(i = 0; i < count; i++) {
+                rc = arakoon_value_list_get(keys, i, &key_size, &key);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+                rc = arakoon_value_list_get(values, i, &value_size, &value);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+                if(value == NULL) {
+                        rc = -EINVAL;
+                        goto out;
+                }
+                rc = arakoon_value_list_get(current, i, &current_size,
+                        &current_value);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x16, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, value, value_size);
+                if(current_value != NULL && current_size == value_size &&
+                    memcmp(current_value, value, value_size) == 0) {
+                        continue;
+                }
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+                rc = arakoon_sequence_add_assert_borrowed(sequence, key_size,
+                        key, current_size, current_value);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+                rc = arakoon_sequence_add_set_borrowed(sequence, key_size,
+                        key, value_size, value);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+                changed = ARAKOON_BOOL_TRUE;
+        }
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+        if(changed == ARAKOON_BOOL_TRUE) {
+                rc = arakoon_sequence(cluster, options, sequence);
+        }
 
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+out:
+        if(sequence != NULL) {
+                arakoon_sequence_free(sequence);
+        }
+        arakoon_value_list_free(current);
+        if(consistent != NULL) {
+                arakoon_client_call_options_free(consistent);
+        }
 
         return rc;
 }
 
-arakoon_rc arakoon_assert_exists(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_assert(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
-    const size_t key_size, const void * const key) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
-        arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-
-        FUNCTION_ENTER(arakoon_assert_exists);
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        ArakoonCommandResult result_;
 
-        _arakoon_cluster_reset_last_error(cluster);
+        FUNCTION_ENTER(arakoon_assert);
 
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(key);
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
+        return _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_ASSERT, key_size, key, value_size, value);
+}
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+arakoon_rc arakoon_assert(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value) {
+        arakoon_rc rc = 0;
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_BOOL_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(key_size);
+        rc = _arakoon_assert(cluster, options, key_size, key, value_size,
+                value);
+        _arakoon_mux_end_call(rc);
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        return rc;
+}
 
-        c = command;
+static arakoon_rc _arakoon_assert_exists(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key) {
+        ArakoonCommandResult result_;
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x29, 0x00);
-        ARAKOON_PROTOCOL_WRITE_BOOL(c,
-                arakoon_client_call_options_get_allow_dirty(options_));
-        ARAKOON_PROTOCOL_WRITE_STRING(c, key, key_size);
+        FUNCTION_ENTER(arakoon_assert_exists);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(key);
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        return _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_ASSERT_EXISTS, key_size, key);
+}
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+arakoon_rc arakoon_assert_exists(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key) {
+        arakoon_rc rc = 0;
 
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+        rc = _arakoon_assert_exists(cluster, options, key_size, key);
+        _arakoon_mux_end_call(rc);
 
         return rc;
 }
@@ -1279,74 +1579,65 @@ arakoon_rc arakoon_rev_range_entries(ArakoonCluster *cluster,
     const arakoon_bool end_key_included,
     const ssize_t max_elements,
     ArakoonKeyValueList **result) {
+        arakoon_rc rc = 0;
+
         FUNCTION_ENTER(arakoon_range_entries);
 
-        return _arakoon_range_helper(0x23, 0x00,
+        rc = _arakoon_range_helper(ARAKOON_COMMAND_REV_RANGE_ENTRIES,
                 cluster, options,
                 begin_key_size, begin_key, begin_key_included,
                 end_key_size, end_key, end_key_included,
                 max_elements,
                 result);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
 }
 
-arakoon_rc arakoon_delete_prefix(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_delete_prefix(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t prefix_size, const void * const prefix,
     uint32_t * result) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
         arakoon_rc rc = 0;
-        ArakoonClusterNode *master = NULL;
-        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
 
         FUNCTION_ENTER(arakoon_delete_prefix);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
         ASSERT_NON_NULL_RC(cluster);
         ASSERT_NON_NULL_RC(prefix);
         ASSERT_NON_NULL_RC(result);
 
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
-
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(prefix_size);
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_DELETE_PREFIX, prefix_size, prefix);
+        *result = result_.uint32;
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x27, 0x00);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, prefix, prefix_size);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                _arakoon_read_cache_invalidate_prefix(cache, prefix_size,
+                        prefix);
+        }
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        return rc;
+}
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
-        RETURN_IF_NOT_SUCCESS(rc);
+arakoon_rc arakoon_delete_prefix(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t prefix_size, const void * const prefix,
+    uint32_t * result) {
+        arakoon_rc rc = 0;
 
-        ARAKOON_PROTOCOL_READ_UINT32(master, *result, rc, &timeout);
-        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
-                *result = 0;
-        }
+        rc = _arakoon_delete_prefix(cluster, options, prefix_size, prefix,
+                result);
+        _arakoon_mux_end_call(rc);
 
         return rc;
 }
 
-arakoon_rc arakoon_version(ArakoonCluster *cluster,
+static arakoon_rc _arakoon_version(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     int32_t * major, int32_t * minor, int32_t * patch,
     char ** const version_info) {
-        size_t len = 0;
-        char *command = NULL, *c = NULL;
         arakoon_rc rc = 0;
         void *version_info_data = NULL;
         size_t version_info_size = 0;
@@ -1361,34 +1652,12 @@ arakoon_rc arakoon_version(ArakoonCluster *cluster,
         ASSERT_NON_NULL_RC(patch);
         ASSERT_NON_NULL_RC(version_info);
 
-        _arakoon_cluster_reset_last_error(cluster);
-
-        READ_OPTIONS;
-        timeout = arakoon_client_call_options_get_timeout(options_);
-
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
-
-        len = ARAKOON_PROTOCOL_COMMAND_LEN;
-
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
-
-        c = command;
-
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x28, 0x00);
-
-        ASSERT_ALL_WRITTEN(command, c, len);
-
-        rc = _arakoon_cluster_node_write_bytes(master, len, command, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+        *version_info = NULL;
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+        rc = _arakoon_command_request(cluster, options, &master, &timeout,
+                ARAKOON_COMMAND_VERSION);
         RETURN_IF_NOT_SUCCESS(rc);
 
-        *version_info = NULL;
-
         ARAKOON_PROTOCOL_READ_INT32(master, *major, rc, &timeout);
         RETURN_IF_NOT_SUCCESS(rc);
         ARAKOON_PROTOCOL_READ_INT32(master, *minor, rc, &timeout);
@@ -1406,61 +1675,655 @@ arakoon_rc arakoon_version(ArakoonCluster *cluster,
         return rc;
 }
 
+arakoon_rc arakoon_version(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    int32_t * major, int32_t * minor, int32_t * patch,
+    char ** const version_info) {
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_version(cluster, options, major, minor, patch,
+                version_info);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_user_function(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const user_function,
+    const size_t arg_size, const void * const arg,
+    size_t *result_size, void **result) {
+        ArakoonCommandResult result_;
+        ArakoonReadCache *cache = NULL;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_user_function);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(user_function);
+        ASSERT_NON_NULL_RC(result_size);
+        ASSERT_NON_NULL_RC(result);
+
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_USER_FUNCTION,
+                strlen(user_function), user_function, arg_size, arg);
+        *result_size = result_.size;
+        *result = result_.data;
+
+        /* User functions can write any key */
+        cache = _arakoon_cluster_get_read_cache(cluster);
+        if(cache != NULL) {
+                _arakoon_read_cache_invalidate_prefix(cache, 0, NULL);
+        }
+
+        return rc;
+}
+
 arakoon_rc arakoon_user_function(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const char * const user_function,
     const size_t arg_size, const void * const arg,
     size_t *result_size, void **result) {
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_user_function(cluster, options, user_function, arg_size,
+                arg, result_size, result);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_get_key_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options, uint64_t *result) {
+        ArakoonCommandResult result_;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_get_key_count);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(result);
+
+        rc = _arakoon_command_call(cluster, options, &result_,
+                ARAKOON_COMMAND_GET_KEY_COUNT);
+        *result = result_.uint64;
+
+        return rc;
+}
+
+arakoon_rc arakoon_get_key_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options, uint64_t *result) {
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_get_key_count(cluster, options, result);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+/* Number of keys requested per 'range' call when counting */
+#define ARAKOON_COUNT_PAGE_SIZE (10000)
+
+static arakoon_rc _arakoon_skip_bytes(ArakoonClusterNode *node, size_t size,
+    int *timeout) {
+        char buffer[1024];
         size_t len = 0;
-        char *command = NULL, *c = NULL;
         arakoon_rc rc = 0;
+
+        while(size > 0) {
+                len = size < sizeof(buffer) ? size : sizeof(buffer);
+
+                READ_BYTES(node, buffer, len, rc, timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                size -= len;
+        }
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* Count a page of keys using a 'range' call, without keeping them. Only the
+ * last key is returned in 'last', to continue from. */
+static arakoon_rc _arakoon_count_page(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    uint32_t *count, size_t *last_size, void **last) {
         ArakoonClusterNode *master = NULL;
         int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
-        size_t fun_size = 0;
+        uint32_t i = 0, size = 0;
+        arakoon_rc rc = 0;
 
-        FUNCTION_ENTER(arakoon_user_function);
+        *count = 0;
+        *last_size = 0;
+        *last = NULL;
+
+        rc = _arakoon_command_request(cluster, options, &master, &timeout,
+                ARAKOON_COMMAND_RANGE,
+                begin_key_size, begin_key, begin_key_included,
+                end_key_size, end_key, end_key_included,
+                (int32_t) ARAKOON_COUNT_PAGE_SIZE);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        ARAKOON_PROTOCOL_READ_UINT32(master, *count, rc, &timeout);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        for(i = 0; i < *count; i++) {
+                ARAKOON_PROTOCOL_READ_UINT32(master, size, rc, &timeout);
+                RETURN_IF_NOT_SUCCESS(rc);
+
+                /* Lists are sent back-to-front, so the last key comes first */
+                if(i != 0) {
+                        rc = _arakoon_skip_bytes(master, size, &timeout);
+                        RETURN_IF_NOT_SUCCESS(rc);
+
+                        continue;
+                }
+
+                *last = arakoon_mem_new(size == 0 ? 1 : size, char);
+                if(*last == NULL) {
+                        _arakoon_cluster_node_disconnect(master);
+                        return -ENOMEM;
+                }
+                *last_size = size;
+
+                READ_BYTES(master, *last, size, rc, &timeout);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        arakoon_mem_free(*last);
+                        *last = NULL;
+                        return rc;
+                }
+        }
+
+        return rc;
+}
+
+arakoon_rc arakoon_range_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    uint64_t *result) {
+        void *key = NULL, *next = NULL;
+        size_t key_size = 0, next_size = 0;
+        uint32_t count = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_range_count);
 
         ASSERT_NON_NULL_RC(cluster);
-        ASSERT_NON_NULL_RC(user_function);
-        ASSERT_NON_NULL_RC(result_size);
         ASSERT_NON_NULL_RC(result);
 
-        *result_size = 0;
-        *result = NULL;
+        *result = 0;
 
-        _arakoon_cluster_reset_last_error(cluster);
+        do {
+                /* Every page continues after the last key of the previous
+                 * one */
+                if(key == NULL) {
+                        rc = _arakoon_count_page(cluster, options,
+                                begin_key_size, begin_key, begin_key_included,
+                                end_key_size, end_key, end_key_included,
+                                &count, &next_size, &next);
+                }
+                else {
+                        rc = _arakoon_count_page(cluster, options,
+                                key_size, key, ARAKOON_BOOL_FALSE,
+                                end_key_size, end_key, end_key_included,
+                                &count, &next_size, &next);
+                }
+                _arakoon_mux_end_call(rc);
+
+                if(key != NULL) {
+                        arakoon_mem_free(key);
+                }
+                key = next;
+                key_size = next_size;
+
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        break;
+                }
+
+                *result += count;
+        } while(count == ARAKOON_COUNT_PAGE_SIZE);
+
+        if(key != NULL) {
+                arakoon_mem_free(key);
+        }
+
+        return rc;
+}
+
+arakoon_rc arakoon_prefix_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t prefix_size, const void * const prefix,
+    uint64_t *result) {
+        void *end = NULL;
+        size_t end_size = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_prefix_count);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(prefix);
+        ASSERT_NON_NULL_RC(result);
+
+        /* All keys matching the prefix sort before its successor, the
+         * smallest key which is larger than all of them */
+        rc = _arakoon_prefix_end(prefix_size, prefix, &end_size, &end);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        rc = arakoon_range_count(cluster, options,
+                prefix_size, prefix, ARAKOON_BOOL_TRUE,
+                end_size, end, ARAKOON_BOOL_FALSE,
+                result);
+
+        if(end != NULL) {
+                arakoon_mem_free(end);
+        }
+
+        return rc;
+}
+
+/* Streaming calls
+ *
+ * The response is decoded one entry at a time, into a buffer which is reused
+ * for all entries, so it only grows to the size of the largest one. Once
+ * the callback asks to stop, the remaining entries are skipped, which keeps
+ * the connection usable. */
+static arakoon_rc _arakoon_foreach_reserve(char **buffer, size_t *capacity,
+    size_t size) {
+        char *b = NULL;
+
+        if(size == 0) {
+                size = 1;
+        }
+
+        if(size <= *capacity) {
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        b = arakoon_mem_realloc(*buffer, size);
+        RETURN_ENOMEM_IF_NULL(b);
+
+        *buffer = b;
+        *capacity = size;
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+static arakoon_rc _arakoon_foreach_read(ArakoonClusterNode *node,
+    int *timeout, const arakoon_bool entries,
+    ArakoonRangeEntryCallback callback, void *data) {
+        char *buffer = NULL;
+        size_t capacity = 0;
+        uint32_t count = 0, i = 0, key_size = 0, value_size = 0;
+        arakoon_bool more = ARAKOON_BOOL_TRUE;
+        arakoon_rc rc = 0;
+
+        ARAKOON_PROTOCOL_READ_UINT32(node, count, rc, timeout);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        for(i = 0; i < count; i++) {
+                ARAKOON_PROTOCOL_READ_UINT32(node, key_size, rc, timeout);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        break;
+                }
+
+                if(!more) {
+                        rc = _arakoon_skip_bytes(node, key_size, timeout);
+                        if(ARAKOON_RC_IS_SUCCESS(rc) && entries) {
+                                ARAKOON_PROTOCOL_READ_UINT32(node,
+                                        value_size, rc, timeout);
+                                if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                                        rc = _arakoon_skip_bytes(node,
+                                                value_size, timeout);
+                                }
+                        }
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                break;
+                        }
+
+                        continue;
+                }
+
+                rc = _arakoon_foreach_reserve(&buffer, &capacity, key_size);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        _arakoon_cluster_node_disconnect(node);
+                        break;
+                }
+
+                READ_BYTES(node, buffer, key_size, rc, timeout);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        break;
+                }
+
+                value_size = 0;
+
+                if(entries) {
+                        ARAKOON_PROTOCOL_READ_UINT32(node, value_size, rc,
+                                timeout);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                break;
+                        }
+
+                        rc = _arakoon_foreach_reserve(&buffer, &capacity,
+                                (size_t) key_size + value_size);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                _arakoon_cluster_node_disconnect(node);
+                                break;
+                        }
+
+                        READ_BYTES(node, buffer + key_size, value_size, rc,
+                                timeout);
+                        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                                break;
+                        }
+                }
+
+                more = callback(key_size, buffer, value_size,
+                        entries ? buffer + key_size : NULL, data);
+        }
+
+        if(buffer != NULL) {
+                arakoon_mem_free(buffer);
+        }
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_foreach_helper(ArakoonCommand command,
+    ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data) {
+        ArakoonClusterNode *master = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(_arakoon_foreach_helper);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(callback);
+
+        rc = _arakoon_command_request(cluster, options, &master, &timeout,
+                command,
+                begin_key_size, begin_key, begin_key_included,
+                end_key_size, end_key, end_key_included,
+                (int32_t) max_elements);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        return _arakoon_foreach_read(master, &timeout,
+                command != ARAKOON_COMMAND_RANGE, callback, data);
+}
+
+arakoon_rc arakoon_range_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data) {
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_range_foreach);
+
+        rc = _arakoon_foreach_helper(ARAKOON_COMMAND_RANGE, cluster,
+                options, begin_key_size, begin_key, begin_key_included,
+                end_key_size, end_key, end_key_included, max_elements,
+                callback, data);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+arakoon_rc arakoon_range_entries_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data) {
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_range_entries_foreach);
+
+        rc = _arakoon_foreach_helper(ARAKOON_COMMAND_RANGE_ENTRIES, cluster,
+                options, begin_key_size, begin_key, begin_key_included,
+                end_key_size, end_key, end_key_included, max_elements,
+                callback, data);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+arakoon_rc arakoon_rev_range_entries_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data) {
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_rev_range_entries_foreach);
+
+        rc = _arakoon_foreach_helper(ARAKOON_COMMAND_REV_RANGE_ENTRIES,
+                cluster, options, begin_key_size, begin_key,
+                begin_key_included, end_key_size, end_key, end_key_included,
+                max_elements, callback, data);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_prefix_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data) {
+        ArakoonClusterNode *master = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_prefix_foreach);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(begin_key);
+        ASSERT_NON_NULL_RC(callback);
+
+        rc = _arakoon_command_request(cluster, options, &master, &timeout,
+                ARAKOON_COMMAND_PREFIX,
+                begin_key_size, begin_key, (int32_t) max_elements);
+        RETURN_IF_NOT_SUCCESS(rc);
+
+        return _arakoon_foreach_read(master, &timeout, ARAKOON_BOOL_FALSE,
+                callback, data);
+}
+
+arakoon_rc arakoon_prefix_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data) {
+        arakoon_rc rc = 0;
+
+        rc = _arakoon_prefix_foreach(cluster, options, begin_key_size,
+                begin_key, max_elements, callback, data);
+        _arakoon_mux_end_call(rc);
+
+        return rc;
+}
+
+/* Administrative calls
+ *
+ * These are sent to a given node over a private connection, set up by
+ * cloning the cluster, so the connections of the cluster itself are never
+ * held up by a long-running call. */
+static arakoon_rc _arakoon_admin_connect(const ArakoonCluster * const cluster,
+    const char * const node_name, int *timeout, ArakoonCluster **probe,
+    ArakoonClusterNode **node) {
+        ArakoonClusterNode *n = NULL;
+        arakoon_rc rc = 0;
+
+        *node = NULL;
+
+        *probe = _arakoon_cluster_clone(cluster);
+        RETURN_ENOMEM_IF_NULL(*probe);
+
+        for(n = _arakoon_cluster_get_first_node(*probe); n != NULL;
+            n = _arakoon_cluster_node_get_next(n)) {
+                if(strcmp(_arakoon_cluster_node_get_name(n), node_name) == 0) {
+                        break;
+                }
+        }
+
+        if(n == NULL) {
+                rc = ARAKOON_RC_CLIENT_UNKNOWN_NODE;
+        }
+        else {
+                rc = _arakoon_cluster_node_connect(n, timeout);
+        }
+
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                arakoon_cluster_free(*probe);
+                *probe = NULL;
+                return rc;
+        }
+
+        *node = n;
+
+        return rc;
+}
+
+static arakoon_rc _arakoon_admin_call(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name, ArakoonCommand command) {
+        ArakoonCluster *probe = NULL;
+        ArakoonClusterNode *node = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        arakoon_rc rc = 0;
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(node_name);
 
         READ_OPTIONS;
         timeout = arakoon_client_call_options_get_timeout(options_);
 
-        ARAKOON_CLUSTER_GET_MASTER(cluster, master);
+        _arakoon_cluster_reset_last_error(cluster);
 
-        fun_size = strlen(user_function);
+        rc = _arakoon_admin_connect(cluster, node_name, &timeout, &probe,
+                &node);
+        RETURN_IF_NOT_SUCCESS(rc);
 
-        len = ARAKOON_PROTOCOL_COMMAND_LEN
-                + ARAKOON_PROTOCOL_STRING_LEN(fun_size)
-                + ARAKOON_PROTOCOL_STRING_OPTION_LEN(arg, arg_size);
+        rc = _arakoon_command_node_send(node, options, &timeout, command);
+        if(ARAKOON_RC_IS_SUCCESS(rc)) {
+                rc = _arakoon_command_node_read_rc(node, cluster, &timeout);
+        }
 
-        command = arakoon_mem_new(len, char);
-        RETURN_ENOMEM_IF_NULL(command);
+        arakoon_cluster_free(probe);
 
-        c = command;
+        return rc;
+}
 
-        ARAKOON_PROTOCOL_WRITE_COMMAND(c, 0x15, 0x00);
-        ARAKOON_PROTOCOL_WRITE_STRING(c, user_function, fun_size);
-        ARAKOON_PROTOCOL_WRITE_STRING_OPTION(c, arg, arg_size);
+arakoon_rc arakoon_optimize_db(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name) {
+        FUNCTION_ENTER(arakoon_optimize_db);
 
-        ASSERT_ALL_WRITTEN(command, c, len);
+        return _arakoon_admin_call(cluster, options, node_name,
+                ARAKOON_COMMAND_OPTIMIZE_DB);
+}
 
-        WRITE_BYTES(master, command, len, rc, &timeout);
-        arakoon_mem_free(command);
-        RETURN_IF_NOT_SUCCESS(rc);
+arakoon_rc arakoon_defrag_db(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name) {
+        FUNCTION_ENTER(arakoon_defrag_db);
+
+        return _arakoon_admin_call(cluster, options, node_name,
+                ARAKOON_COMMAND_DEFRAG_DB);
+}
+
+arakoon_rc arakoon_drop_master(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name) {
+        FUNCTION_ENTER(arakoon_drop_master);
 
-        ARAKOON_PROTOCOL_READ_RC(master, rc, &timeout);
+        return _arakoon_admin_call(cluster, options, node_name,
+                ARAKOON_COMMAND_DROP_MASTER);
+}
+
+arakoon_rc arakoon_collapse_tlogs(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name, const int32_t count,
+    ArakoonCollapseTlogsCallback callback, void *data) {
+        ArakoonCluster *probe = NULL;
+        ArakoonClusterNode *node = NULL;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_DEFAULT_TIMEOUT;
+        int32_t total = 0, i = 0;
+        uint64_t took = 0;
+        arakoon_rc rc = 0;
+
+        FUNCTION_ENTER(arakoon_collapse_tlogs);
+
+        ASSERT_NON_NULL_RC(cluster);
+        ASSERT_NON_NULL_RC(node_name);
 
-        HANDLE_ERROR(rc, master, cluster, &timeout);
+        READ_OPTIONS;
+        timeout = arakoon_client_call_options_get_timeout(options_);
+
+        _arakoon_cluster_reset_last_error(cluster);
+
+        rc = _arakoon_admin_connect(cluster, node_name, &timeout, &probe,
+                &node);
         RETURN_IF_NOT_SUCCESS(rc);
 
-        ARAKOON_PROTOCOL_READ_STRING_OPTION(master, *result, *result_size, rc, &timeout);
+        rc = _arakoon_command_node_send(node, options, &timeout,
+                ARAKOON_COMMAND_COLLAPSE_TLOGS, count);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        rc = _arakoon_command_node_read_rc(node, cluster, &timeout);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        ARAKOON_PROTOCOL_READ_INT32(node, total, rc, &timeout);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                goto out;
+        }
+
+        /* Every tlog is reported separately, with a result code and the
+         * time it took */
+        for(i = 0; i < total; i++) {
+                timeout = arakoon_client_call_options_get_timeout(options_);
+
+                rc = _arakoon_command_node_read_rc(node, cluster, &timeout);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+
+                ARAKOON_PROTOCOL_READ_UINT64(node, took, rc, &timeout);
+                if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                        goto out;
+                }
+
+                if(callback != NULL) {
+                        callback(i + 1, total, (int64_t) took, data);
+                }
+        }
+
+out:
+        arakoon_cluster_free(probe);
+
         return rc;
 }
@@ -574,6 +574,23 @@ arakoon_rc arakoon_value_list_add(ArakoonValueList *list,
  */
 ssize_t arakoon_value_list_size(const ArakoonValueList * const list)
     ARAKOON_GNUC_NONNULL ARAKOON_GNUC_PURE;
+/**
+ * \brief Retrieve the item at the given position in the list
+ *
+ * This takes constant time. If `index` is out of range, `-ERANGE` is returned
+ * and `value` will point to `NULL`.
+ *
+ * For None entries, as returned by #arakoon_multi_get_option, `value` will
+ * point to `NULL` as well, but #ARAKOON_RC_SUCCESS is returned.
+ *
+ * \note `value` points into the list, and remains valid until the list is
+ * changed using #arakoon_value_list_add, or freed.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_value_list_get(const ArakoonValueList * const list,
+    const size_t index, size_t * const value_size, const void ** const value)
+    ARAKOON_GNUC_NONNULL;
 /**
  * \brief Free a value list
  *
@@ -616,6 +633,9 @@ void arakoon_value_list_iter_free(ArakoonValueListIter * const iter);
  *
  * `value` will point to `NULL` when the last item was reached.
  *
+ * \note `value` points into the list, and remains valid until the list is
+ * changed using #arakoon_value_list_add, or freed.
+ *
  * \since 1.0
  */
 arakoon_rc arakoon_value_list_iter_next(ArakoonValueListIter * const iter,
@@ -679,6 +699,32 @@ typedef struct ArakoonKeyValueList ArakoonKeyValueList;
  */
 ssize_t arakoon_key_value_list_size(const ArakoonKeyValueList * const list)
     ARAKOON_GNUC_NONNULL ARAKOON_GNUC_PURE;
+/**
+ * \brief Retrieve the (key, value) pair at the given position in the list
+ *
+ * This takes constant time. If `index` is out of range, `-ERANGE` is returned
+ * and `key` and `value` will point to `NULL`.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_key_value_list_get(const ArakoonKeyValueList * const list,
+    const size_t index, size_t * const key_size, const void ** const key,
+    size_t * const value_size, const void ** const value)
+    ARAKOON_GNUC_NONNULL;
+/**
+ * \brief Look up the position of a key in the list
+ *
+ * The list must be sorted on key, as returned by #arakoon_range_entries
+ * (ascending) or #arakoon_rev_range_entries (descending), so a binary search
+ * can be used. On success, `index` is set to the position of the key, which
+ * can be passed to #arakoon_key_value_list_get. If the key is not part of the
+ * list, #ARAKOON_RC_NOT_FOUND is returned.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_key_value_list_find(const ArakoonKeyValueList * const list,
+    const size_t key_size, const void * const key, size_t * const index)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /**
  * \brief Free a key-value list
  *
@@ -797,6 +843,62 @@ arakoon_rc arakoon_sequence_add_assert(ArakoonSequence *sequence,
 arakoon_rc arakoon_sequence_add_assert_exists(ArakoonSequence *sequence,
     const size_t key_size, const void * const key)
     ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Add a 'set' action to the sequence, without copying key and value
+ *
+ * Only references to key and value are kept, so they should remain valid and
+ * unchanged until the sequence is released, reset, or no longer used in
+ * #arakoon_sequence or #arakoon_synced_sequence calls.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_sequence_add_set_borrowed(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL3(1, 3, 5) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Add a 'delete' action to the sequence, without copying the key
+ *
+ * See #arakoon_sequence_add_set_borrowed.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_sequence_add_delete_borrowed(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Add an 'assert' action to the sequence, without copying key and
+ * value
+ *
+ * See #arakoon_sequence_add_set_borrowed.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_sequence_add_assert_borrowed(ArakoonSequence *sequence,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Add an 'assert_exists' action to the sequence, without copying the
+ * key
+ *
+ * See #arakoon_sequence_add_set_borrowed.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_sequence_add_assert_exists_borrowed(
+    ArakoonSequence *sequence, const size_t key_size, const void * const key)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Remove all actions from the sequence
+ *
+ * The memory used by the sequence is kept, so it can be refilled without
+ * allocations, e.g. to reuse a single sequence for a series of batches.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_sequence_reset(ArakoonSequence *sequence)
+    ARAKOON_GNUC_NONNULL;
 
 #endif /* ARAKOON_H_EXPORT_PROCEDURES */
 /** @} */
@@ -943,6 +1045,20 @@ typedef enum {
 /* ArakoonCluster */
 typedef struct ArakoonCluster ArakoonCluster;
 
+/**
+ * \brief Read cache statistics, see #arakoon_cluster_get_read_cache_stats
+ *
+ * \since 1.3
+ */
+typedef struct {
+    uint64_t hits; /**< Number of lookups answered from the cache */
+    uint64_t misses; /**< Number of lookups sent to the server */
+    uint64_t evictions; /**< Number of entries dropped to make room */
+    uint64_t expirations; /**< Number of entries dropped after their TTL */
+    size_t entries; /**< Number of entries in the cache */
+    size_t bytes; /**< Memory used by the entries */
+} ArakoonReadCacheStats;
+
 #endif /* ARAKOON_H_EXPORT_TYPES */
 
 #if ARAKOON_H_EXPORT_PROCEDURES
@@ -963,6 +1079,10 @@ void arakoon_cluster_free(ArakoonCluster *cluster);
  *
  * This should be called before performing any other operations, and whenever
  * ARAKOON_RC_NOT_MASTER is encountered.
+ *
+ * A cluster can be created before fork(2). The child process never uses the
+ * connections of the parent: they're closed on first use, without affecting
+ * the parent, and the master node found by the parent is reconnected.
  */
 arakoon_rc arakoon_cluster_connect_master(ArakoonCluster * const cluster,
     const ArakoonClientCallOptions * const options);
@@ -996,6 +1116,112 @@ arakoon_rc arakoon_cluster_add_node(ArakoonCluster *cluster,
     ArakoonClusterNode *node)
     ARAKOON_GNUC_NONNULL2(1, 2) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 
+/**
+ * \brief Create a cluster from an Arakoon configuration file
+ *
+ * The cluster name is read from the *cluster_id* setting in the *global*
+ * section, the list of nodes from the *cluster* setting. The addresses of
+ * every node are taken from the *ip* (a comma-separated list) and
+ * *client_port* settings in the section of the node. Other settings are
+ * ignored.
+ *
+ * The addresses of all nodes are resolved concurrently. On success, the
+ * resulting cluster should be released using #arakoon_cluster_free.
+ * -EINVAL is returned for invalid configuration files.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_cluster_new_from_config(const char * const path,
+    ArakoonCluster ** const cluster)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/**
+ * \brief Share the connection of a cluster between threads
+ *
+ * When enabled, any number of threads can perform operations on the cluster
+ * concurrently. Requests are pipelined on a single connection to the master
+ * node, and responses are handed to the right caller in order.
+ *
+ * This can only be changed while the cluster isn't connected. When
+ * multiplexed, #arakoon_cluster_get_last_error returns the last error
+ * received by the calling thread, and #arakoon_cluster_connect_master can be
+ * called by several threads at once. A call which fails with a client-side
+ * error closes the shared connection, so all threads should reconnect.
+ * This includes a call which times out while waiting for the responses of
+ * calls sent before it, after which all other calls in flight on the
+ * connection fail as well.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_cluster_set_multiplexed(ArakoonCluster * const cluster,
+    arakoon_bool multiplexed)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/**
+ * \brief Coalesce concurrent #arakoon_get calls on a multiplexed cluster
+ *
+ * When enabled, threads asking for a key which is about to be fetched
+ * wait for that fetch and share its result, instead of sending a call of
+ * their own. Different keys asked for within `window_usec` microseconds are
+ * fetched using a single 'multi_get_option' call. Every caller still owns
+ * the value it gets back, as with a plain #arakoon_get.
+ *
+ * A call which is already on its way to the server is only shared with
+ * calls which allow dirty reads, so a consistent read never returns a value
+ * older than a write which completed before it started. Only calls with
+ * the same 'allow_dirty' option and timeout are combined. Errors returned
+ * by the server are recorded as last error of the thread which sent the
+ * call only.
+ *
+ * This only has effect while the cluster is multiplexed, see
+ * #arakoon_cluster_set_multiplexed, and can only be changed while the
+ * cluster isn't connected.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_cluster_set_read_coalescing(
+    ArakoonCluster * const cluster, arakoon_bool coalesce,
+    const unsigned int window_usec)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+/**
+ * \brief Cache the results of 'allow_dirty' reads in the client
+ *
+ * When enabled, #arakoon_get, #arakoon_exists, #arakoon_multi_get and
+ * #arakoon_multi_get_option calls of which the options allow dirty reads
+ * are answered from an in-process cache when possible. Values, and the fact
+ * that a key doesn't exist, are kept for at most `ttl_msec` milliseconds,
+ * or until evicted to keep the cache within `max_bytes` bytes. Pass a
+ * `ttl_msec` of 0 to keep entries until evicted.
+ *
+ * Writes made through this cluster, including sequences, update or drop
+ * the entries of the keys they touch. Writes made by other clients, or
+ * through other #ArakoonCluster objects, are only seen once the entry
+ * expires. Reads which don't allow dirty reads never use the cache.
+ *
+ * A lookup which finds the key doesn't exist returns
+ * #ARAKOON_RC_NOT_FOUND without setting a last error message.
+ *
+ * Pass a `max_bytes` of 0 to disable the cache. This can only be changed
+ * while the cluster isn't connected.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_cluster_set_read_cache(ArakoonCluster * const cluster,
+    const size_t max_bytes, const unsigned int ttl_msec)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Retrieve statistics of the read cache of a cluster
+ *
+ * All counters are 0 if the cache isn't enabled.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_cluster_get_read_cache_stats(
+    const ArakoonCluster * const cluster,
+    ArakoonReadCacheStats * const stats)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
 /** @} */
 
 /** \defgroup ClientOperations Client operations
@@ -1058,12 +1284,35 @@ arakoon_rc arakoon_multi_get(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const ArakoonValueList * const keys, ArakoonValueList **result)
     ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'multi_get_option' call to the server
+ *
+ * Like arakoon_multi_get, but keys which don't exist don't fail the call.
+ * The result list holds one entry per key, in order. Entries for missing keys
+ * are None: arakoon_value_list_get returns a NULL value for them. Since
+ * iteration ends at the first NULL value, use arakoon_value_list_size and
+ * arakoon_value_list_get to walk the result.
+ */
+arakoon_rc arakoon_multi_get_option(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys, ArakoonValueList **result)
+    ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /* Send a 'set' call to the server */
 arakoon_rc arakoon_set(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const size_t key_size, const void * const key,
     const size_t value_size, const void * const value)
     ARAKOON_GNUC_NONNULL3(1, 4, 6) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'confirm' call to the server
+ *
+ * Like arakoon_set, but the server only performs the write if the stored
+ * value differs from 'value', so rewriting an unchanged value doesn't cost a
+ * consensus round.
+ */
+arakoon_rc arakoon_confirm(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL3(1, 4, 6) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /* Send a 'delete' call to the server */
 arakoon_rc arakoon_delete(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
@@ -1136,6 +1385,21 @@ arakoon_rc arakoon_test_and_set(ArakoonCluster *cluster,
     const size_t new_value_size, const void * const new_value,
     size_t *result_size, void **result)
     ARAKOON_GNUC_NONNULL4(1, 4, 9, 10) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'replace' call to the server
+ *
+ * The value of 'key' is set to 'value', or deleted if 'value' is NULL (in
+ * which case 'value_size' should be 0 as well), in a single round trip.
+ *
+ * The previous value will be stored at 'result', and should be released by
+ * the caller when no longer required. The result can be NULL, in which case
+ * the key did not exist.
+ */
+arakoon_rc arakoon_replace(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value,
+    size_t *result_size, void **result)
+    ARAKOON_GNUC_NONNULL4(1, 4, 7, 8) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /* Send a 'sequence' call to the server */
 arakoon_rc arakoon_sequence(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
@@ -1146,6 +1410,24 @@ arakoon_rc arakoon_synced_sequence(ArakoonCluster *cluster,
     const ArakoonClientCallOptions * const options,
     const ArakoonSequence * const sequence)
     ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Confirm a set of key/value pairs
+ *
+ * The sequence counterpart of arakoon_confirm: 'keys' and 'values' should
+ * have the same length, and every key will be set to the value at the same
+ * index. The current values are fetched from the master using a single
+ * 'multi_get_option' call, even if 'options' allow dirty reads, so the read
+ * cache is never used. Only the pairs which differ are written, in a single
+ * 'sequence' call. If nothing differs, no write is sent at all.
+ *
+ * Every write is guarded by an 'assert' on the value fetched before, so if
+ * one of the keys is changed concurrently, nothing is written and
+ * ARAKOON_RC_ASSERTION_FAILED is returned. The call can then be retried.
+ */
+arakoon_rc arakoon_multi_confirm(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const ArakoonValueList * const keys,
+    const ArakoonValueList * const values)
+    ARAKOON_GNUC_NONNULL3(1, 3, 4) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 /* Send an 'assert' call to the server
  *
  * 'value' can be NULL to denote 'None', in which case 'size' should be 0 as
@@ -1221,6 +1503,950 @@ arakoon_rc arakoon_user_function(ArakoonCluster *cluster,
     const size_t arg_size, const void * const arg,
     size_t *result_size, void **result)
     ARAKOON_GNUC_NONNULL4(1, 3, 6, 7) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Send a 'get_key_count' call to the server
+ *
+ * The number of keys in the store will be stored at 'result'.
+ */
+arakoon_rc arakoon_get_key_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    uint64_t *result) ARAKOON_GNUC_NONNULL2(1, 3)
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Count the keys in a range
+ *
+ * The range is given like for arakoon_range. Keys are retrieved in pages
+ * using 'range' calls, but only counted, not kept.
+ *
+ * The number of keys will be stored at 'result'.
+ */
+arakoon_rc arakoon_range_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    uint64_t *result) ARAKOON_GNUC_NONNULL2(1, 9)
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/* Count the keys matching a prefix
+ *
+ * See arakoon_range_count. The number of keys will be stored at 'result'.
+ */
+arakoon_rc arakoon_prefix_count(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t prefix_size, const void * const prefix,
+    uint64_t *result) ARAKOON_GNUC_NONNULL3(1, 4, 5)
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup StreamingOperations Streaming range operations
+ *
+ * \brief Range calls which pass every entry to a callback
+ *
+ * These calls behave like their counterparts in \ref ClientOperations, but
+ * instead of building a list holding the whole result, every entry is
+ * passed to a callback as soon as it's read from the connection. Only a
+ * single entry is kept in memory at any time, so memory use is bounded by
+ * the size of the largest entry, not by the size of the response.
+ *
+ * Entries are passed in the order the server sends them, which is the
+ * reverse of the order of the list returned by the non-streaming call:
+ * #arakoon_range_entries_foreach yields keys in descending order, and
+ * #arakoon_rev_range_entries_foreach in ascending order.
+ *
+ * The callback should not send calls over the same cluster, since the
+ * response is still being read. On a multiplexed cluster, other threads
+ * wait for the callback to complete before reading their own responses.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Callback of the streaming range calls
+ *
+ * `key` and `value` are only valid during the call. For calls returning
+ * keys only, `value` is `NULL`. Returning #ARAKOON_BOOL_FALSE stops the
+ * iteration: the remainder of the response is skipped.
+ *
+ * \since 1.3
+ */
+typedef arakoon_bool (*ArakoonRangeEntryCallback)(size_t key_size,
+    const void *key, size_t value_size, const void *value, void *data);
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Send a 'range' call, passing every key to `callback`
+ *
+ * See #arakoon_range.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_range_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data)
+    ARAKOON_GNUC_NONNULL2(1, 10) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Send a 'range_entries' call, passing every entry to `callback`
+ *
+ * See #arakoon_range_entries.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_range_entries_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data)
+    ARAKOON_GNUC_NONNULL2(1, 10) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Send a 'rev_range_entries' call, passing every entry to
+ *        `callback`
+ *
+ * See #arakoon_rev_range_entries.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_rev_range_entries_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data)
+    ARAKOON_GNUC_NONNULL2(1, 10) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Send a 'prefix' call, passing every key to `callback`
+ *
+ * See #arakoon_prefix.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_prefix_foreach(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const ssize_t max_elements,
+    ArakoonRangeEntryCallback callback, void *data)
+    ARAKOON_GNUC_NONNULL3(1, 4, 6) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup AdminOperations Administrative operations
+ *
+ * \brief Maintenance calls sent to a given node instead of the master
+ *
+ * These calls are sent to the node called `node_name`, over a connection
+ * which is set up for the call only. The connections of the cluster aren't
+ * used, so a long-running call doesn't hold up other requests, even on a
+ * multiplexed cluster. This allows e.g. compacting the database of one node
+ * after the other, while serving requests through the master.
+ *
+ * Some of these calls can take a long time, which should be taken into
+ * account when setting the timeout in `options`. Errors returned by the
+ * node are recorded as last error of the cluster.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Progress callback of #arakoon_collapse_tlogs
+ *
+ * Invoked after each of `total` tlogs is collapsed, with `done` set to the
+ * number of tlogs collapsed so far, and the time the node reports for the
+ * step in `took`.
+ *
+ * \since 1.3
+ */
+typedef void (*ArakoonCollapseTlogsCallback)(int32_t done, int32_t total,
+    int64_t took, void *data);
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Send an 'optimize_db' call to a node
+ *
+ * The node rewrites its database to reclaim space and restore read
+ * performance. It is unavailable for requests in the meantime.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_optimize_db(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Send a 'defrag_db' call to a node
+ *
+ * The node defragments its database in place. This is refused by the
+ * master.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_defrag_db(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Send a 'collapse_tlogs' call to a node
+ *
+ * The node collapses all but the last `count` tlogs into its database. If
+ * `callback` isn't NULL, it's invoked with `data` after every collapsed
+ * tlog.
+ *
+ * The timeout set in `options` applies to the start of the call, and to
+ * every tlog separately, so large collapses don't need an infinite
+ * timeout.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_collapse_tlogs(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name, const int32_t count,
+    ArakoonCollapseTlogsCallback callback, void *data)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Send a 'drop_master' call to a node
+ *
+ * If the node is master, it gives up its mastership, so another node can
+ * take over, e.g. before it's taken down for maintenance. Fails with
+ * #ARAKOON_RC_NOT_MASTER if the node isn't master.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_drop_master(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup ConnectionPool Connection pools
+ *
+ * \brief Share a bounded set of master connections between threads
+ *
+ * An #ArakoonCluster is not thread-safe: a single connection can only carry
+ * one request at a time. A connection pool hands out private connections to
+ * the master node of a cluster, which can be used with all client operations
+ * and should be given back to the pool afterwards.
+ *
+ * All connections are set up using the nodes of the cluster passed to
+ * #arakoon_connection_pool_new, which should outlive the pool. The pool
+ * itself can be used from multiple threads concurrently.
+ *
+ * Example usage:
+ *
+ * \code
+ * ArakoonCluster *conn = NULL;
+ *
+ * rc = arakoon_connection_pool_checkout(pool, options, &conn);
+ * if(ARAKOON_RC_IS_SUCCESS(rc)) {
+ *     rc = arakoon_set(conn, options, 3, "key", 5, "value");
+ *     arakoon_connection_pool_return(pool, conn);
+ * }
+ * \endcode
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Abstract representation of a connection pool
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonConnectionPool ArakoonConnectionPool;
+
+/**
+ * \brief Connection pool statistics, see #arakoon_connection_pool_get_stats
+ *
+ * \since 1.3
+ */
+typedef struct {
+    uint64_t checkouts; /**< Number of successful checkouts */
+    uint64_t connects; /**< Number of connections set up */
+    uint64_t evictions; /**< Number of broken connections dropped */
+    uint64_t reaped; /**< Number of idle connections closed */
+    uint64_t timeouts; /**< Number of checkouts which timed out */
+    uint64_t wait_total_usec; /**< Total time spent in checkout (us) */
+    uint64_t wait_max_usec; /**< Longest time spent in a checkout (us) */
+    unsigned int idle; /**< Number of idle connections */
+    unsigned int in_use; /**< Number of connections checked out */
+} ArakoonConnectionPoolStats;
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Create a new #ArakoonConnectionPool
+ *
+ * At most `max_connections` connections will be checked out at any time.
+ * Connections which stay idle in the pool for longer than `idle_timeout`
+ * milliseconds are closed. Pass a negative `idle_timeout` to keep idle
+ * connections forever.
+ *
+ * The pool should be released using #arakoon_connection_pool_free when no
+ * longer needed.
+ *
+ * \since 1.3
+ */
+ArakoonConnectionPool * arakoon_connection_pool_new(
+    const ArakoonCluster * const cluster, unsigned int max_connections,
+    int idle_timeout)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Release an #ArakoonConnectionPool
+ *
+ * All connections should have been returned to the pool before calling this.
+ *
+ * \since 1.3
+ */
+void arakoon_connection_pool_free(ArakoonConnectionPool *pool);
+/**
+ * \brief Check out a connection to the master node
+ *
+ * An idle connection is used if available, otherwise a new one is set up.
+ * When `max_connections` connections are checked out already, this blocks
+ * until one is returned, or the timeout set in `options` expires, in which
+ * case #ARAKOON_RC_CLIENT_TIMEOUT is returned.
+ *
+ * The connection should be returned using #arakoon_connection_pool_return,
+ * and must not be freed by the caller.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_connection_pool_checkout(ArakoonConnectionPool * const pool,
+    const ArakoonClientCallOptions * const options,
+    ArakoonCluster ** const connection)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Return a connection to the pool
+ *
+ * Connections which were broken by a network error during usage are closed
+ * instead of being put back in the pool.
+ *
+ * \since 1.3
+ */
+void arakoon_connection_pool_return(ArakoonConnectionPool * const pool,
+    ArakoonCluster * const connection);
+/**
+ * \brief Close all connections which exceeded the idle timeout
+ *
+ * This is done during checkout and return as well, but can be called
+ * periodically to release connections of a pool which isn't used.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_connection_pool_reap(ArakoonConnectionPool * const pool)
+    ARAKOON_GNUC_NONNULL;
+/**
+ * \brief Retrieve a snapshot of the pool statistics
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_connection_pool_get_stats(
+    ArakoonConnectionPool * const pool,
+    ArakoonConnectionPoolStats * const stats)
+    ARAKOON_GNUC_NONNULL;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup MasterWatcher Master watchers
+ *
+ * \brief Detect master failover before client operations run into it
+ *
+ * A master watcher periodically asks all nodes of a cluster which node is
+ * master, and checks whether that node can make progress. When leadership
+ * moved, the cluster switches to the new master on its next operation,
+ * instead of failing with #ARAKOON_RC_NOT_MASTER first.
+ *
+ * The watcher uses connections of its own, so it never interferes with
+ * requests sent through the cluster. It can either run in a background
+ * thread (see #arakoon_master_watcher_start), or be driven by calling
+ * #arakoon_master_watcher_step from an event loop, but not both.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Abstract representation of a master watcher
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonMasterWatcher ArakoonMasterWatcher;
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Create a new #ArakoonMasterWatcher for a cluster
+ *
+ * The cluster should outlive the watcher, which should be released using
+ * #arakoon_master_watcher_free.
+ *
+ * \since 1.3
+ */
+ArakoonMasterWatcher * arakoon_master_watcher_new(
+    ArakoonCluster * const cluster)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Stop and release an #ArakoonMasterWatcher
+ *
+ * \since 1.3
+ */
+void arakoon_master_watcher_free(ArakoonMasterWatcher *watcher);
+/**
+ * \brief Check the master of the cluster once
+ *
+ * All nodes are asked at the same time, the timeout set in `options`
+ * applies to every node separately. Nodes which can't be reached don't
+ * vote, so asking them takes a single timeout at most. Returns
+ * #ARAKOON_RC_CLIENT_MASTER_NOT_FOUND unless a strict majority of the
+ * configured nodes agrees on a master which can make progress.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_master_watcher_step(ArakoonMasterWatcher * const watcher,
+    const ArakoonClientCallOptions * const options)
+    ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Check the master in a background thread, every `interval` ms
+ *
+ * Every node is asked using `interval` as its timeout. The thread is
+ * stopped by #arakoon_master_watcher_free.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_master_watcher_start(ArakoonMasterWatcher * const watcher,
+    int interval)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup Statistics Server statistics
+ *
+ * \brief Retrieve the statistics kept by Arakoon nodes
+ *
+ * Nodes keep statistics like operation counters, average value sizes and
+ * memory usage. These are returned as a tree of named fields, rooted at a
+ * list named `arakoon_stats`. The set of fields depends on the server
+ * version, so fields should be looked up by name, e.g.
+ *
+ * \code
+ * const ArakoonStatisticsField *field = NULL;
+ *
+ * field = arakoon_statistics_field_find(
+ *     arakoon_statistics_get_root(statistics), "n_sets");
+ * if(field != NULL && field->type == ARAKOON_STATISTICS_FIELD_INT64) {
+ *     printf("%lld sets\n", (long long) field->value.int_);
+ * }
+ * \endcode
+ *
+ * A statistics sampler collects the statistics of all nodes of a cluster
+ * periodically, using connections of its own, like #ArakoonMasterWatcher.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Type of an #ArakoonStatisticsField
+ *
+ * \since 1.3
+ */
+typedef enum {
+    ARAKOON_STATISTICS_FIELD_INT32 = 1, /**< Integer, stored in `int_` */
+    ARAKOON_STATISTICS_FIELD_INT64 = 2, /**< Integer, stored in `int_` */
+    ARAKOON_STATISTICS_FIELD_FLOAT = 3, /**< Floating point, stored in `float_` */
+    ARAKOON_STATISTICS_FIELD_STRING = 4, /**< String, stored in `string` */
+    ARAKOON_STATISTICS_FIELD_LIST = 5 /**< List of fields, stored in `list` */
+} ArakoonStatisticsFieldType;
+
+/**
+ * \brief A single named statistics value
+ *
+ * All strings are NUL-terminated. Fields are owned by the #ArakoonStatistics
+ * they belong to.
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonStatisticsField ArakoonStatisticsField;
+struct ArakoonStatisticsField {
+    ArakoonStatisticsFieldType type; /**< Type of the value */
+    const char *name; /**< Name of the field */
+    union {
+        int64_t int_;
+        double float_;
+        struct {
+            size_t size;
+            const char *data;
+        } string;
+        struct {
+            size_t count;
+            const ArakoonStatisticsField *fields;
+        } list;
+    } value; /**< Value of the field, according to `type` */
+};
+
+/**
+ * \brief Statistics of a node, see #arakoon_statistics
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonStatistics ArakoonStatistics;
+
+/**
+ * \brief Abstract representation of a statistics sampler
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonStatisticsSampler ArakoonStatisticsSampler;
+
+/**
+ * \brief Callback invoked by a statistics sampler for every node
+ *
+ * If the statistics of the node couldn't be retrieved, `rc` is set and
+ * `statistics` is NULL. The statistics are released when the callback
+ * returns.
+ *
+ * \since 1.3
+ */
+typedef void (*ArakoonStatisticsSamplerCallback)(const char *node_name,
+    arakoon_rc rc, const ArakoonStatistics *statistics, void *data);
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Send a 'statistics' call to the master node
+ *
+ * The result should be released using #arakoon_statistics_free.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_statistics(ArakoonCluster *cluster,
+    const ArakoonClientCallOptions * const options,
+    ArakoonStatistics **result)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Release an #ArakoonStatistics
+ *
+ * \since 1.3
+ */
+void arakoon_statistics_free(ArakoonStatistics *statistics);
+/**
+ * \brief Retrieve the root field of the statistics
+ *
+ * \since 1.3
+ */
+const ArakoonStatisticsField * arakoon_statistics_get_root(
+    const ArakoonStatistics * const statistics)
+    ARAKOON_GNUC_NONNULL;
+/**
+ * \brief Look up a field of a list by name
+ *
+ * Returns NULL if `list` is not a list, or has no field called `name`.
+ *
+ * \since 1.3
+ */
+const ArakoonStatisticsField * arakoon_statistics_field_find(
+    const ArakoonStatisticsField * const list, const char * const name)
+    ARAKOON_GNUC_NONNULL;
+
+/**
+ * \brief Create a new #ArakoonStatisticsSampler for a cluster
+ *
+ * `callback` is invoked with `data` for every node of the cluster on every
+ * sample. The cluster should outlive the sampler, which should be released
+ * using #arakoon_statistics_sampler_free.
+ *
+ * \since 1.3
+ */
+ArakoonStatisticsSampler * arakoon_statistics_sampler_new(
+    const ArakoonCluster * const cluster,
+    ArakoonStatisticsSamplerCallback callback, void *data)
+    ARAKOON_GNUC_NONNULL2(1, 2) ARAKOON_GNUC_MALLOC
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Stop and release an #ArakoonStatisticsSampler
+ *
+ * \since 1.3
+ */
+void arakoon_statistics_sampler_free(ArakoonStatisticsSampler *sampler);
+/**
+ * \brief Sample the statistics of all nodes once
+ *
+ * The timeout set in `options` applies to every node separately. Failures
+ * to reach a node, including timeouts, are only passed to the callback for
+ * that node, the remaining nodes are still sampled.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_statistics_sampler_step(
+    ArakoonStatisticsSampler * const sampler,
+    const ArakoonClientCallOptions * const options)
+    ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Sample in a background thread, every `interval` ms
+ *
+ * Every node is sampled using `interval` as its timeout, and the callback
+ * is invoked from the background thread. The thread is stopped by
+ * #arakoon_statistics_sampler_free.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_statistics_sampler_start(
+    ArakoonStatisticsSampler * const sampler, int interval)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup HealthChecker Health checkers
+ *
+ * \brief Track reachability and round-trip times of all nodes of a cluster
+ *
+ * A health checker pings every node of a cluster over a private, persistent
+ * connection, and keeps the result, round-trip time and number of
+ * consecutive failures of every node. A ping is an
+ * 'expect_progress_possible' call, which every node answers locally, and
+ * which doesn't allocate memory once the connection is set up.
+ *
+ * Like #ArakoonMasterWatcher, a checker can either run in a background
+ * thread (see #arakoon_health_checker_start), or be driven by calling
+ * #arakoon_health_checker_step or #arakoon_health_checker_ping, but not
+ * both. #arakoon_health_checker_get_health can be called from any thread
+ * at any time, so health endpoints can report the last known state without
+ * sending any request.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Abstract representation of a health checker
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonHealthChecker ArakoonHealthChecker;
+
+/**
+ * \brief Health of a single node, see #arakoon_health_checker_get_health
+ *
+ * \since 1.3
+ */
+typedef struct {
+    const char *name; /**< Name of the node, owned by the checker */
+    uint64_t pings; /**< Number of pings sent */
+    unsigned int failures; /**< Number of consecutive failed pings */
+    arakoon_rc last_rc; /**< Result of the last ping */
+    arakoon_bool progress_possible; /**< Answer to the last successful ping */
+    uint64_t rtt_usec; /**< Round-trip time of the last successful ping (us) */
+    uint64_t srtt_usec; /**< Smoothed round-trip time (us) */
+} ArakoonNodeHealth;
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Create a new #ArakoonHealthChecker for a cluster
+ *
+ * The cluster should outlive the checker, which should be released using
+ * #arakoon_health_checker_free.
+ *
+ * \since 1.3
+ */
+ArakoonHealthChecker * arakoon_health_checker_new(
+    const ArakoonCluster * const cluster)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_MALLOC ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Stop and release an #ArakoonHealthChecker
+ *
+ * \since 1.3
+ */
+void arakoon_health_checker_free(ArakoonHealthChecker *checker);
+/**
+ * \brief Ping a single node
+ *
+ * The round-trip time is stored at `rtt_usec`, which can be NULL. Setting
+ * up the connection, if needed, is not included. Returns
+ * #ARAKOON_RC_CLIENT_UNKNOWN_NODE if the cluster has no node called
+ * `node_name`.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_health_checker_ping(ArakoonHealthChecker * const checker,
+    const ArakoonClientCallOptions * const options,
+    const char * const node_name, uint64_t * const rtt_usec)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Ping all nodes once
+ *
+ * The timeout set in `options` applies to every node separately, so an
+ * unreachable node doesn't hide the state of the others. Failures are only
+ * recorded in the node health.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_health_checker_step(ArakoonHealthChecker * const checker,
+    const ArakoonClientCallOptions * const options)
+    ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Ping all nodes in a background thread, every `interval` ms
+ *
+ * Every ping uses `interval` as its timeout. The thread is stopped by
+ * #arakoon_health_checker_free.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_health_checker_start(ArakoonHealthChecker * const checker,
+    int interval)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Retrieve a snapshot of the health of all nodes
+ *
+ * At most `count` entries are stored in `health`, ordered from the best
+ * node to pick to the worst: nodes which answered their last ping and
+ * expect progress to be possible come first, followed by nodes which
+ * answered but don't expect progress, nodes which weren't pinged yet, and
+ * failing nodes. Within each class, nodes are ordered by consecutive
+ * failures, then by smoothed round-trip time.
+ *
+ * Returns the number of nodes of the cluster, which can be larger than
+ * `count`.
+ *
+ * \since 1.3
+ */
+size_t arakoon_health_checker_get_health(
+    ArakoonHealthChecker * const checker,
+    ArakoonNodeHealth * const health, size_t count)
+    ARAKOON_GNUC_NONNULL1(1);
+/**
+ * \brief Ask the healthiest nodes of a cluster for its master first
+ *
+ * When a cluster looks up its master node, it asks the nodes in the order
+ * of #arakoon_health_checker_get_health instead of the order in which they
+ * were added, so nodes which are down or slow are only tried last. Pass
+ * NULL to go back to the order of the cluster.
+ *
+ * The checker can be created for the cluster itself. It's only used while
+ * attached: detach it before releasing it, while no other thread uses the
+ * cluster.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_cluster_set_health_checker(
+    ArakoonCluster * const cluster, ArakoonHealthChecker * const checker)
+    ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup RangeCursor Range cursors
+ *
+ * \brief Iterate over all entries of a range, one page at a time
+ *
+ * #arakoon_range_entries and #arakoon_rev_range_entries return at most
+ * `max_elements` entries. A cursor walks an arbitrarily large range by
+ * sending as many of these calls as needed, each continuing right after the
+ * last key of the previous one.
+ *
+ * Pages are fetched by a background thread over a private connection to the
+ * master, one page ahead of the caller: while the caller consumes a page,
+ * the next one is requested. The number of entries per page is adapted to
+ * the size of the entries received so far, to keep responses at about 1MB.
+ *
+ * Since every page is a separate call, a cursor doesn't provide a
+ * consistent snapshot of the range when it's updated concurrently.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Abstract representation of a range cursor
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonRangeCursor ArakoonRangeCursor;
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Create a new #ArakoonRangeCursor
+ *
+ * The range is given like for #arakoon_range_entries, or, if `reverse` is
+ * set, like for #arakoon_rev_range_entries, in which case `begin_key` is the
+ * upper bound and entries are returned in descending key order.
+ *
+ * The first page is requested right away. The timeout set in `options`
+ * applies to every page separately. The cluster should outlive the cursor,
+ * which should be released using #arakoon_range_cursor_free.
+ *
+ * \since 1.3
+ */
+ArakoonRangeCursor * arakoon_range_cursor_new(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t begin_key_size, const void * const begin_key,
+    const arakoon_bool begin_key_included,
+    const size_t end_key_size, const void * const end_key,
+    const arakoon_bool end_key_included,
+    const arakoon_bool reverse)
+    ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_MALLOC
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Create a new #ArakoonRangeCursor over all keys matching a prefix
+ *
+ * See #arakoon_range_cursor_new.
+ *
+ * \since 1.3
+ */
+ArakoonRangeCursor * arakoon_range_cursor_new_prefix(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const size_t prefix_size, const void * const prefix,
+    const arakoon_bool reverse)
+    ARAKOON_GNUC_NONNULL2(1, 4) ARAKOON_GNUC_MALLOC
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Release an #ArakoonRangeCursor
+ *
+ * This waits for a page request in progress to complete, if any.
+ *
+ * \since 1.3
+ */
+void arakoon_range_cursor_free(ArakoonRangeCursor *cursor);
+/**
+ * \brief Retrieve the next entry
+ *
+ * `key` and `value` will point to `NULL` when the end of the range was
+ * reached. If a page request failed, its result is returned, after all
+ * entries of the pages before it.
+ *
+ * \note `key` and `value` point into the current page, and remain valid
+ * until the next call.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_range_cursor_next(ArakoonRangeCursor * const cursor,
+    size_t * const key_size, const void ** const key,
+    size_t * const value_size, const void ** const value)
+    ARAKOON_GNUC_NONNULL ARAKOON_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* ARAKOON_H_EXPORT_PROCEDURES */
+
+/** @} */
+
+/** \defgroup WriteBatcher Write batchers
+ *
+ * \brief Combine independent writes of several threads into sequences
+ *
+ * Every 'set' or 'delete' call is a separate round of consensus on the
+ * server. A write batcher collects the writes of all threads using it, and
+ * sends them as a single 'sequence' call, which commits all of them in a
+ * single round (group commit).
+ *
+ * Every thread blocks until the batch holding its write completes, and
+ * gets the result of its own write. Writes are applied in the order they
+ * were submitted, so writes to the same key are never reordered.
+ *
+ * A sequence is applied atomically: if one of its writes fails, e.g. a
+ * 'delete' of a key which doesn't exist, none of them is applied. The
+ * batch is then split up and resent, until the failing write is isolated,
+ * so every write gets the same result as when sent on its own. Any other
+ * failure, e.g. a timeout, is returned for all writes of the batch.
+ *
+ * Batches are sent by a background thread, over a private connection to
+ * the master.
+ *
+ * @{
+ */
+#if ARAKOON_H_EXPORT_TYPES
+/**
+ * \brief Abstract representation of a write batcher
+ *
+ * \since 1.3
+ */
+typedef struct ArakoonWriteBatcher ArakoonWriteBatcher;
+
+#endif /* ARAKOON_H_EXPORT_TYPES */
+
+#if ARAKOON_H_EXPORT_PROCEDURES
+/**
+ * \brief Create a new #ArakoonWriteBatcher for a cluster
+ *
+ * Once a write is submitted, the batcher waits up to `delay_usec`
+ * microseconds for more writes to join the batch, unless the keys and values
+ * in the batch add up to `max_bytes`. A batch only grows beyond `max_bytes`
+ * when it holds a single write, writes which don't fit are left for the
+ * next batch. Writes submitted while a batch is being sent are collected
+ * for the next one, so a `delay_usec` of 0 still batches writes under load.
+ *
+ * Keys written by the batcher are dropped from the read cache of the
+ * cluster, see #arakoon_cluster_set_read_cache.
+ *
+ * The timeout set in `options` applies to every call sent by the batcher.
+ * The cluster should outlive the batcher, which should be released using
+ * #arakoon_write_batcher_free.
+ *
+ * \since 1.3
+ */
+ArakoonWriteBatcher * arakoon_write_batcher_new(
+    const ArakoonCluster * const cluster,
+    const ArakoonClientCallOptions * const options,
+    const unsigned int delay_usec, const size_t max_bytes)
+    ARAKOON_GNUC_NONNULL1(1) ARAKOON_GNUC_MALLOC
+    ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Release an #ArakoonWriteBatcher
+ *
+ * Writes which were already submitted are sent first. No writes should be
+ * submitted once this is called.
+ *
+ * \since 1.3
+ */
+void arakoon_write_batcher_free(ArakoonWriteBatcher *batcher);
+/**
+ * \brief Set `key` to `value` as part of the next batch
+ *
+ * Blocks until the batch completes, and returns the result of the write.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_write_batcher_set(ArakoonWriteBatcher * const batcher,
+    const size_t key_size, const void * const key,
+    const size_t value_size, const void * const value)
+    ARAKOON_GNUC_NONNULL3(1, 3, 5) ARAKOON_GNUC_WARN_UNUSED_RESULT;
+/**
+ * \brief Delete `key` as part of the next batch
+ *
+ * Blocks until the batch completes, and returns the result of the write,
+ * which is #ARAKOON_RC_NOT_FOUND if the key doesn't exist.
+ *
+ * \since 1.3
+ */
+arakoon_rc arakoon_write_batcher_delete(ArakoonWriteBatcher * const batcher,
+    const size_t key_size, const void * const key)
+    ARAKOON_GNUC_NONNULL2(1, 3) ARAKOON_GNUC_WARN_UNUSED_RESULT;
 
 #endif /* ARAKOON_H_EXPORT_PROCEDURES */
 
@@ -33,6 +33,24 @@
 
 namespace arakoon {
 
+namespace {
+
+// A buffer pointing into a result list, sharing ownership of the list so the
+// data stays valid for as long as the buffer is referenced
+template <typename T>
+buffer_const_ptr
+make_view(
+    void const * const data,
+    std::size_t const size,
+    std::shared_ptr<T> const & owner)
+{
+    return buffer_const_ptr(
+        new buffer((void *) data, size, false),
+        [owner](buffer const * b) { delete b; });
+}
+
+} // namespace
+
 //// error
 
 error::error()
@@ -221,8 +239,10 @@ buffer::size() const
 //// value_list_iterator
 
 value_list_iterator::value_list_iterator(
-    ArakoonValueListIter * const iter)
+    ArakoonValueListIter * const iter,
+    std::shared_ptr<void const> const & owner)
     :   iter_(iter),
+        owner_(owner),
         value_()
 {
     if (iter == NULL)
@@ -273,9 +293,8 @@ value_list_iterator::value() const
 //// value_list
 
 value_list::value_list()
-    :   list_(NULL)
+    :   list_(arakoon_value_list_new(), arakoon_value_list_free)
 {
-    list_ = arakoon_value_list_new();
     if (list_ == NULL)
     {
         throw std::bad_alloc();
@@ -284,7 +303,7 @@ value_list::value_list()
 
 value_list::value_list(
     ArakoonValueList * const list)
-    :   list_(list)
+    :   list_(list, arakoon_value_list_free)
 {
     if (list == NULL)
     {
@@ -294,24 +313,19 @@ value_list::value_list(
 
 value_list::~value_list()
 {
-    if (list_)
-    {
-        arakoon_value_list_free(list_);
-        list_ = NULL;
-    }
 }
 
 void
 value_list::add(
     buffer const & value)
 {
-    rc_to_error(arakoon_value_list_add(list_, value.size(), value.data()));
+    rc_to_error(arakoon_value_list_add(list_.get(), value.size(), value.data()));
 }
 
 value_list_iterator_ptr
 value_list::begin() const
 {
-    ArakoonValueListIter * iter = arakoon_value_list_create_iter(list_);
+    ArakoonValueListIter * iter = arakoon_value_list_create_iter(list_.get());
     if (iter == NULL)
     {
         throw std::bad_alloc();
@@ -319,7 +333,7 @@ value_list::begin() const
 
     try
     {
-        return value_list_iterator_ptr(new value_list_iterator(iter));
+        return value_list_iterator_ptr(new value_list_iterator(iter, list_));
     }
     catch (...)
     {
@@ -331,13 +345,13 @@ value_list::begin() const
 ArakoonValueList const *
 value_list::get() const
 {
-    return list_;
+    return list_.get();
 }
 
 size_t
 value_list::size() const
 {
-    ssize_t size = arakoon_value_list_size(list_);
+    ssize_t size = arakoon_value_list_size(list_.get());
     if (size < 0)
     {
         throw std::system_error(errno, std::system_category());
@@ -346,11 +360,29 @@ value_list::size() const
     return (size_t) size;
 }
 
+buffer_const_ptr
+value_list::at(size_t const index) const
+{
+    void const * value_data = NULL;
+    size_t value_size = 0;
+
+    rc rc = arakoon_value_list_get(list_.get(), index, &value_size, &value_data);
+    if (rc == -ERANGE)
+    {
+        throw std::out_of_range("value_list::at");
+    }
+    rc_to_error(rc);
+
+    return make_view(value_data, value_size, list_);
+}
+
 //// key_value_list_iterator
 
 key_value_list_iterator::key_value_list_iterator(
-    ArakoonKeyValueListIter * const iter)
+    ArakoonKeyValueListIter * const iter,
+    std::shared_ptr<void const> const & owner)
     :   iter_(iter),
+        owner_(owner),
         key_(),
         value_()
 {
@@ -413,7 +445,7 @@ key_value_list_iterator::value() const
 
 key_value_list::key_value_list(
     ArakoonKeyValueList * const list)
-    :   list_(list)
+    :   list_(list, arakoon_key_value_list_free)
 {
     if (list == NULL)
     {
@@ -423,17 +455,12 @@ key_value_list::key_value_list(
 
 key_value_list::~key_value_list()
 {
-    if (list_)
-    {
-        arakoon_key_value_list_free(list_);
-        list_ = NULL;
-    }
 }
 
 key_value_list_iterator_ptr
 key_value_list::begin() const
 {
-    ArakoonKeyValueListIter * iter = arakoon_key_value_list_create_iter(list_);
+    ArakoonKeyValueListIter * iter = arakoon_key_value_list_create_iter(list_.get());
     if (iter == NULL)
     {
         throw std::bad_alloc();
@@ -441,7 +468,7 @@ key_value_list::begin() const
 
     try
     {
-        return key_value_list_iterator_ptr(new key_value_list_iterator(iter));
+        return key_value_list_iterator_ptr(new key_value_list_iterator(iter, list_));
     }
     catch (...)
     {
@@ -453,13 +480,13 @@ key_value_list::begin() const
 ArakoonKeyValueList const *
 key_value_list::get() const
 {
-    return list_;
+    return list_.get();
 }
 
 size_t
 key_value_list::size() const
 {
-    ssize_t size = arakoon_key_value_list_size(list_);
+    ssize_t size = arakoon_key_value_list_size(list_.get());
     if (size < 0)
     {
         throw std::system_error(errno, std::system_category());
@@ -468,6 +495,41 @@ key_value_list::size() const
     return (size_t) size;
 }
 
+std::pair<buffer_const_ptr, buffer_const_ptr>
+key_value_list::at(size_t const index) const
+{
+    void const * key_data = NULL;
+    size_t key_size = 0;
+    void const * value_data = NULL;
+    size_t value_size = 0;
+
+    rc rc = arakoon_key_value_list_get(list_.get(), index, &key_size, &key_data, &value_size, &value_data);
+    if (rc == -ERANGE)
+    {
+        throw std::out_of_range("key_value_list::at");
+    }
+    rc_to_error(rc);
+
+    return std::make_pair(
+        make_view(key_data, key_size, list_),
+        make_view(value_data, value_size, list_));
+}
+
+bool
+key_value_list::find(
+    buffer const & key,
+    size_t & index) const
+{
+    rc rc = arakoon_key_value_list_find(list_.get(), key.size(), key.data(), &index);
+    if (rc == ARAKOON_RC_NOT_FOUND)
+    {
+        return false;
+    }
+    rc_to_error(rc);
+
+    return true;
+}
+
 //// sequence
 
 sequence::sequence()
@@ -508,12 +570,90 @@ sequence::add_assert(
     rc_to_error(arakoon_sequence_add_assert(sequence_, key.size(), key.data(), value.size(), value.data()));
 }
 
+void
+sequence::add_assert_exists(
+    buffer const & key)
+{
+    rc_to_error(arakoon_sequence_add_assert_exists(sequence_, key.size(), key.data()));
+}
+
+void
+sequence::add_set_borrowed(
+    buffer const & key,
+    buffer const & value)
+{
+    rc_to_error(arakoon_sequence_add_set_borrowed(sequence_, key.size(), key.data(), value.size(), value.data()));
+}
+
+void
+sequence::add_delete_borrowed(
+    buffer const & key)
+{
+    rc_to_error(arakoon_sequence_add_delete_borrowed(sequence_, key.size(), key.data()));
+}
+
+void
+sequence::add_assert_borrowed(
+    buffer const & key,
+    buffer const & value)
+{
+    rc_to_error(arakoon_sequence_add_assert_borrowed(sequence_, key.size(), key.data(), value.size(), value.data()));
+}
+
+void
+sequence::add_assert_exists_borrowed(
+    buffer const & key)
+{
+    rc_to_error(arakoon_sequence_add_assert_exists_borrowed(sequence_, key.size(), key.data()));
+}
+
+void
+sequence::reset()
+{
+    rc_to_error(arakoon_sequence_reset(sequence_));
+}
+
 ArakoonSequence const *
 sequence::get() const
 {
     return sequence_;
 }
 
+//// statistics
+
+statistics::statistics(
+    ArakoonStatistics * const statistics)
+    :   statistics_(statistics)
+{
+    if (statistics == NULL)
+    {
+        throw std::invalid_argument("statistics::statistics");
+    }
+}
+
+statistics::~statistics()
+{
+    arakoon_statistics_free(statistics_);
+}
+
+ArakoonStatisticsField const &
+statistics::root() const
+{
+    return *arakoon_statistics_get_root(statistics_);
+}
+
+ArakoonStatisticsField const *
+statistics::find(std::string const & name) const
+{
+    return arakoon_statistics_field_find(arakoon_statistics_get_root(statistics_), name.c_str());
+}
+
+ArakoonStatistics const *
+statistics::get() const
+{
+    return statistics_;
+}
+
 //// client_call_options
 
 client_call_options::client_call_options()
@@ -835,6 +975,18 @@ cluster::multi_get(
     return value_list_const_ptr(new value_list(result));
 }
 
+value_list_const_ptr
+cluster::multi_get_option(
+    client_call_options const * const options,
+    value_list const & keys)
+{
+    ArakoonValueList * result = NULL;
+
+    rc_to_error(arakoon_multi_get_option(cluster_, (options ? options->get() : NULL), keys.get(), &result));
+
+    return value_list_const_ptr(new value_list(result));
+}
+
 void
 cluster::set(
     client_call_options const * const options,
@@ -844,6 +996,15 @@ cluster::set(
     rc_to_error(arakoon_set(cluster_, (options ? options->get() : NULL), key.size(), key.data(), value.size(), value.data()));
 }
 
+void
+cluster::confirm(
+    client_call_options const * const options,
+    buffer const & key,
+    buffer const & value)
+{
+    rc_to_error(arakoon_confirm(cluster_, (options ? options->get() : NULL), key.size(), key.data(), value.size(), value.data()));
+}
+
 void
 cluster::remove(
     client_call_options const * const options,
@@ -931,6 +1092,144 @@ cluster::prefix(
     return value_list_const_ptr(new value_list(result));
 }
 
+uint64_t
+cluster::get_key_count(
+    client_call_options const * const options)
+{
+    uint64_t result = 0;
+
+    rc_to_error(arakoon_get_key_count(cluster_, (options ? options->get() : NULL), &result));
+
+    return result;
+}
+
+uint64_t
+cluster::range_count(
+    client_call_options const * const options,
+    buffer const & begin_key,
+    bool const begin_key_included,
+    buffer const & end_key,
+    bool const end_key_included)
+{
+    uint64_t result = 0;
+
+    rc_to_error(arakoon_range_count(cluster_, (options ? options->get() : NULL),
+        begin_key.size(), begin_key.data(),
+        (begin_key_included ? ARAKOON_BOOL_TRUE : ARAKOON_BOOL_FALSE),
+        end_key.size(), end_key.data(),
+        (end_key_included ? ARAKOON_BOOL_TRUE : ARAKOON_BOOL_FALSE),
+        &result));
+
+    return result;
+}
+
+uint64_t
+cluster::prefix_count(
+    client_call_options const * const options,
+    buffer const & prefix)
+{
+    uint64_t result = 0;
+
+    rc_to_error(arakoon_prefix_count(cluster_, (options ? options->get() : NULL), prefix.size(), prefix.data(), &result));
+
+    return result;
+}
+
+statistics_const_ptr
+cluster::statistics(
+    client_call_options const * const options)
+{
+    ArakoonStatistics * result = NULL;
+
+    rc_to_error(arakoon_statistics(cluster_, (options ? options->get() : NULL), &result));
+
+    try
+    {
+        return statistics_const_ptr(new arakoon::statistics(result));
+    }
+    catch (...)
+    {
+        arakoon_statistics_free(result);
+        throw;
+    }
+}
+
+void
+cluster::optimize_db(
+    client_call_options const * const options,
+    std::string const & node_name)
+{
+    rc_to_error(arakoon_optimize_db(cluster_, (options ? options->get() : NULL), node_name.c_str()));
+}
+
+void
+cluster::defrag_db(
+    client_call_options const * const options,
+    std::string const & node_name)
+{
+    rc_to_error(arakoon_defrag_db(cluster_, (options ? options->get() : NULL), node_name.c_str()));
+}
+
+namespace {
+
+struct collapse_tlogs_context
+{
+    cluster::collapse_tlogs_progress const & progress;
+    std::exception_ptr error;
+};
+
+void
+collapse_tlogs_callback(
+    int32_t const done,
+    int32_t const total,
+    int64_t const took,
+    void * data)
+{
+    collapse_tlogs_context * context = static_cast<collapse_tlogs_context *>(data);
+
+    // Exceptions can't be propagated through the C library
+    if (context->error)
+    {
+        return;
+    }
+
+    try
+    {
+        context->progress(done, total, took);
+    }
+    catch (...)
+    {
+        context->error = std::current_exception();
+    }
+}
+
+} // namespace
+
+void
+cluster::collapse_tlogs(
+    client_call_options const * const options,
+    std::string const & node_name,
+    int32_t const count,
+    collapse_tlogs_progress const & progress)
+{
+    collapse_tlogs_context context = { progress, std::exception_ptr() };
+
+    rc_to_error(arakoon_collapse_tlogs(cluster_, (options ? options->get() : NULL), node_name.c_str(), count, (progress ? collapse_tlogs_callback : NULL), &context));
+
+    if (context.error)
+    {
+        std::rethrow_exception(context.error);
+    }
+}
+
+void
+cluster::drop_master(
+    client_call_options const * const options,
+    std::string const & node_name)
+{
+    rc_to_error(arakoon_drop_master(cluster_, (options ? options->get() : NULL), node_name.c_str()));
+}
+
 buffer_ptr
 cluster::test_and_set(
     client_call_options const * const options,
@@ -950,6 +1249,22 @@ cluster::test_and_set(
     return buffer_ptr(new buffer(result_value_data, result_value_size, true));
 }
 
+buffer_ptr
+cluster::replace(
+    client_call_options const * const options,
+    buffer const & key,
+    buffer const & value)
+{
+    void const * const value_data = value.data();
+    size_t const value_size = value_data ? value.size() : 0;
+    size_t result_value_size = 0;
+    void * result_value_data = NULL;
+
+    rc_to_error(arakoon_replace(cluster_, (options ? options->get() : NULL), key.size(), key.data(), value_size, value_data, &result_value_size, &result_value_data));
+
+    return buffer_ptr(new buffer(result_value_data, result_value_size, true));
+}
+
 void
 cluster::sequence(
     client_call_options const * const options,
@@ -982,4 +1297,13 @@ cluster::synced_sequence_no_exc(
     return rc_to_error_no_exc(arakoon_synced_sequence(cluster_, (options ? options->get() : NULL), sequence.get()));
 }
 
+void
+cluster::multi_confirm(
+    client_call_options const * const options,
+    value_list const & keys,
+    value_list const & values)
+{
+    rc_to_error(arakoon_multi_confirm(cluster_, (options ? options->get() : NULL), keys.get(), values.get()));
+}
+
 } // namespace arakoon
@@ -36,6 +36,7 @@
 #include <memory>
 #include <string>
 #include <exception>
+#include <functional>
 #include <utility>
 
 /**
@@ -291,7 +292,13 @@ void rc_to_error(
 class value_list_iterator
 {
   public:
-    value_list_iterator(ArakoonValueListIter * const iter);
+    /** \brief Construct an iterator. If given, the iterator shares
+     *         ownership of owner, which should keep the data iterated over
+     *         alive.
+     */
+    value_list_iterator(
+        ArakoonValueListIter * const iter,
+        std::shared_ptr<void const> const & owner = std::shared_ptr<void const>());
 
     ~value_list_iterator();
 
@@ -315,6 +322,7 @@ class value_list_iterator
     value_list_iterator & operator=(value_list_iterator const &) = delete;
 
     ArakoonValueListIter * iter_;
+    std::shared_ptr<void const> owner_;
     buffer value_;
 };
 
@@ -324,6 +332,11 @@ typedef std::shared_ptr<value_list_iterator> value_list_iterator_ptr;
  * \class value_list
  *
  * A list of arakoon values, also usable as a list of arakoon keys.
+ *
+ * Values are not copied out of the list: iterators and the buffers returned by
+ * at() point into the list data, and share ownership of it, so they remain
+ * valid after the value_list itself is released. Adding values to the list
+ * may move its data, invalidating such buffers.
  */
 class value_list
 {
@@ -348,11 +361,17 @@ class value_list
     /** \brief Return the number of items in the value_list. */
     size_t size() const;
 
+    /** \brief Return the value at the given position in the list, in
+     *         constant time. Throws std::out_of_range if the index is out of
+     *         range.
+     */
+    buffer_const_ptr at(size_t const index) const;
+
   private:
     value_list(value_list const &) = delete;
     value_list & operator=(value_list const &) = delete;
 
-    ArakoonValueList * list_;
+    std::shared_ptr<ArakoonValueList> list_;
 };
 
 typedef std::shared_ptr<value_list const> value_list_const_ptr;
@@ -369,7 +388,13 @@ typedef std::shared_ptr<value_list const> value_list_const_ptr;
 class key_value_list_iterator
 {
   public:
-    key_value_list_iterator(ArakoonKeyValueListIter * const iter);
+    /** \brief Construct an iterator. If given, the iterator shares
+     *         ownership of owner, which should keep the data iterated over
+     *         alive.
+     */
+    key_value_list_iterator(
+        ArakoonKeyValueListIter * const iter,
+        std::shared_ptr<void const> const & owner = std::shared_ptr<void const>());
 
     ~key_value_list_iterator();
 
@@ -399,6 +424,7 @@ class key_value_list_iterator
     key_value_list_iterator & operator=(key_value_list_iterator const &) = delete;
 
     ArakoonKeyValueListIter * iter_;
+    std::shared_ptr<void const> owner_;
     buffer key_;
     buffer value_;
 };
@@ -409,6 +435,9 @@ typedef std::shared_ptr<key_value_list_iterator> key_value_list_iterator_ptr;
  * \class key_value_list
  *
  * A list of (key, value) pairs.
+ *
+ * Like value_list, iterators and the buffers returned by at() point into the
+ * list data without copying, and keep it alive until they are released.
  */
 class key_value_list
 {
@@ -427,11 +456,24 @@ class key_value_list
     /** \brief Return the number of items in the value_list. */
     size_t size() const;
 
+    /** \brief Return the (key, value) pair at the given position in the
+     *         list, in constant time. Throws std::out_of_range if the index
+     *         is out of range.
+     */
+    std::pair<buffer_const_ptr, buffer_const_ptr> at(size_t const index) const;
+
+    /** \brief Look up a key using binary search. The list must be sorted on
+     *         key, like the results of range_entries and rev_range_entries.
+     *         Returns false if the key is not part of the list, otherwise
+     *         sets index to its position.
+     */
+    bool find(buffer const & key, size_t & index) const;
+
   private:
     key_value_list(key_value_list const &) = delete;
     key_value_list & operator=(key_value_list const &) = delete;
 
-    ArakoonKeyValueList * list_;
+    std::shared_ptr<ArakoonKeyValueList> list_;
 };
 
 typedef std::shared_ptr<key_value_list const> key_value_list_const_ptr;
@@ -477,6 +519,49 @@ class sequence
         buffer const & key,
         buffer const & value);
 
+    /**
+     * \brief Add an 'assert_exists' action to the sequence. Key will be
+     *        copied and released on destruction of the sequence.
+     */
+    void add_assert_exists(
+        buffer const & key);
+
+    /**
+     * \brief Add a 'set' action to the sequence, without copying key and
+     *        value. Their data should outlive any use of the sequence.
+     */
+    void add_set_borrowed(
+        buffer const & key,
+        buffer const & value);
+
+    /**
+     * \brief Add a 'delete' action to the sequence, without copying the key.
+     *        Its data should outlive any use of the sequence.
+     */
+    void add_delete_borrowed(
+        buffer const & key);
+
+    /**
+     * \brief Add an 'assert' action to the sequence, without copying key and
+     *        value. Their data should outlive any use of the sequence.
+     */
+    void add_assert_borrowed(
+        buffer const & key,
+        buffer const & value);
+
+    /**
+     * \brief Add an 'assert_exists' action to the sequence, without copying
+     *        the key. Its data should outlive any use of the sequence.
+     */
+    void add_assert_exists_borrowed(
+        buffer const & key);
+
+    /**
+     * \brief Remove all actions from the sequence, keeping the memory it
+     *        uses for reuse.
+     */
+    void reset();
+
     ArakoonSequence const * get() const;
 
   private:
@@ -489,6 +574,42 @@ class sequence
 typedef std::shared_ptr<sequence> sequence_ptr;
 /** @} */ // sequence_group
 
+/** \defgroup statistics_group Statistics
+ * @{
+ */
+/**
+ * \class statistics
+ *
+ * Statistics of an arakoon node, as a tree of named fields. See the
+ * Statistics group in arakoon.h.
+ */
+class statistics
+{
+  public:
+    statistics(ArakoonStatistics * const statistics);
+
+    ~statistics();
+
+    /** \brief Return the root field, a list named 'arakoon_stats'. */
+    ArakoonStatisticsField const & root() const;
+
+    /** \brief Look up a field of the root list by name. Returns NULL if
+     *         there's no such field.
+     */
+    ArakoonStatisticsField const * find(std::string const & name) const;
+
+    ArakoonStatistics const * get() const;
+
+  private:
+    statistics(statistics const &) = delete;
+    statistics & operator=(statistics const &) = delete;
+
+    ArakoonStatistics * statistics_;
+};
+
+typedef std::shared_ptr<statistics const> statistics_const_ptr;
+/** @} */ // statistics_group
+
 /** \defgroup client_call_options_group Client call options
  * @{
  */
@@ -658,6 +779,17 @@ class cluster
         client_call_options const * const options,
         value_list const & keys);
 
+    /**
+     * \brief Send a 'multi-get-option' call to the server. Missing keys don't
+     *        fail the call: value_list::at returns a buffer with data NULL
+     *        (the value 'None') for them. Iteration stops at the first None,
+     *        so use value_list::size and value_list::at to access the result.
+     * \param options Options, or NULL for default options.
+     */
+    value_list_const_ptr multi_get_option(
+        client_call_options const * const options,
+        value_list const & keys);
+
     /**
      * \brief Send a 'set' call to the server.
      * \param options Options, or NULL for default options.
@@ -667,6 +799,16 @@ class cluster
         buffer const & key,
         buffer const & value);
 
+    /**
+     * \brief Send a 'confirm' call to the server.
+     *        The value is only written if it differs from the stored one.
+     * \param options Options, or NULL for default options.
+     */
+    void confirm(
+        client_call_options const * const options,
+        buffer const & key,
+        buffer const & value);
+
     /**
      * \brief Send a 'delete' call to the server.
      * \param options Options, or NULL for default options.
@@ -727,6 +869,95 @@ class cluster
         buffer const & begin_key,
         ssize_t const max_elements);
 
+    /**
+     * \brief Send a 'get_key_count' call to the server
+     * \param options Options, or NULL for default options.
+     * \return The number of keys in the store.
+     */
+    uint64_t get_key_count(
+        client_call_options const * const options);
+
+    /**
+     * \brief Count the keys in a range, like 'range' would return them,
+     *        without retrieving them all at once.
+     * \param options Options, or NULL for default options.
+     */
+    uint64_t range_count(
+        client_call_options const * const options,
+        buffer const & begin_key,
+        bool const begin_key_included,
+        buffer const & end_key,
+        bool const end_key_included);
+
+    /**
+     * \brief Count the keys matching a prefix, without retrieving them all at
+     *        once.
+     * \param options Options, or NULL for default options.
+     */
+    uint64_t prefix_count(
+        client_call_options const * const options,
+        buffer const & prefix);
+
+    /**
+     * \brief Send a 'statistics' call to the server
+     * \param options Options, or NULL for default options.
+     * \return The statistics of the master node.
+     */
+    statistics_const_ptr statistics(
+        client_call_options const * const options);
+
+    /**
+     * \brief Send an 'optimize_db' call to a given node, over a private
+     *        connection. See arakoon_optimize_db.
+     * \param options Options, or NULL for default options.
+     * \param node_name The name of the node.
+     */
+    void optimize_db(
+        client_call_options const * const options,
+        std::string const & node_name);
+
+    /**
+     * \brief Send a 'defrag_db' call to a given node, over a private
+     *        connection. See arakoon_defrag_db.
+     * \param options Options, or NULL for default options.
+     * \param node_name The name of the node.
+     */
+    void defrag_db(
+        client_call_options const * const options,
+        std::string const & node_name);
+
+    /**
+     * \brief Progress callback of collapse_tlogs, called with the number of
+     *        tlogs collapsed so far, the total number, and the time the node
+     *        reports for the last one.
+     */
+    typedef std::function<void(int32_t, int32_t, int64_t)> collapse_tlogs_progress;
+
+    /**
+     * \brief Send a 'collapse_tlogs' call to a given node, over a private
+     *        connection. See arakoon_collapse_tlogs.
+     * \param options Options, or NULL for default options.
+     * \param node_name The name of the node.
+     * \param count The number of tlogs to keep.
+     * \param progress Progress callback, can be empty. Exceptions it throws
+     *        are rethrown once the call completed.
+     */
+    void collapse_tlogs(
+        client_call_options const * const options,
+        std::string const & node_name,
+        int32_t const count,
+        collapse_tlogs_progress const & progress = collapse_tlogs_progress());
+
+    /**
+     * \brief Send a 'drop_master' call to a given node, over a private
+     *        connection. See arakoon_drop_master.
+     * \param options Options, or NULL for default options.
+     * \param node_name The name of the node.
+     */
+    void drop_master(
+        client_call_options const * const options,
+        std::string const & node_name);
+
     /**
      * \brief Send a 'test_and_set' call to the server
      *        'old_value' and 'new_value' can be (NULL, 0) to denote 'None'.
@@ -743,6 +974,20 @@ class cluster
         buffer const & old_value,
         buffer const & new_value);
 
+    /**
+     * \brief Send a 'replace' call to the server
+     *        'value' can be (NULL, 0) to delete the key.
+     *        A result of (NULL, 0) indicates that the key did not exist.
+     * \param options Options, or NULL for default options.
+     * \param key The key.
+     * \param value The new value, or None.
+     * \return The previous value.
+     */
+    buffer_ptr replace(
+        client_call_options const * const options,
+        buffer const & key,
+        buffer const & value);
+
     /**
      * \brief Send a 'sequence' call to the server.
      * \param options Options, or NULL for default options.
@@ -781,6 +1026,18 @@ class cluster
         client_call_options const * const options,
         arakoon::sequence const & sequence);
 
+    /**
+     * \brief Confirm a set of key/value pairs, writing only those which
+     *        differ in a single sequence. See arakoon_multi_confirm.
+     * \param options Options, or NULL for default options.
+     * \param keys The keys.
+     * \param values The values, one for every key.
+     */
+    void multi_confirm(
+        client_call_options const * const options,
+        value_list const & keys,
+        value_list const & values);
+
   private:
     void rc_to_error(rc const rc);
     std::pair<rc, buffer_ptr> rc_to_error_no_exc(rc const rc);
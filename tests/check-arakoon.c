@@ -23,11 +23,31 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include <check.h>
 
 #include "arakoon.h"
+#include "arakoon-mux.h"
+#include "arakoon-command.h"
+#include "arakoon-cluster.h"
+#include "arakoon-cluster-node.h"
+#include "arakoon-networking.h"
+#include "arakoon-nursery-routing.h"
+#include "arakoon-statistics.h"
+#include "arakoon-read-cache.h"
+#include "arakoon-utils.h"
 #include "memory.h"
+#include "server.h"
 
 #define SENTINEL (0xdeadbeef)
 
@@ -112,6 +132,3008 @@ START_TEST(test_arakoon_memory_set_hooks_usage) {
 
 } END_TEST
 
+static char * write_config(const char * const data) {
+        char *path = NULL;
+        int fd = -1;
+
+        path = strdup("/tmp/check-arakoon-XXXXXX");
+        fail_if(path == NULL, NULL);
+
+        fd = mkstemp(path);
+        fail_if(fd < 0, NULL);
+
+        fail_unless(write(fd, data, strlen(data)) == (ssize_t) strlen(data),
+                NULL);
+        close(fd);
+
+        return path;
+}
+
+/* Check the name and addresses of a node loaded from a configuration, and
+ * return the next node of the cluster */
+static ArakoonClusterNode * check_config_node(const ArakoonClusterNode *node,
+    const char * const name, const char * const * const ips,
+    const unsigned short port) {
+        const struct addrinfo *address = NULL;
+        const void *ip = NULL;
+        char buffer[INET6_ADDRSTRLEN];
+        unsigned short port_ = 0;
+        size_t i = 0;
+
+        fail_if(node == NULL, NULL);
+        fail_unless(strcmp(_arakoon_cluster_node_get_name(node), name) == 0,
+                NULL);
+
+        for(address = _arakoon_cluster_node_get_address(node);
+            address != NULL; address = address->ai_next) {
+                fail_if(ips[i] == NULL, NULL);
+
+                if(address->ai_family == AF_INET) {
+                        ip = &((const struct sockaddr_in *)
+                                address->ai_addr)->sin_addr;
+                        port_ = ntohs(((const struct sockaddr_in *)
+                                address->ai_addr)->sin_port);
+                }
+                else {
+                        fail_unless(address->ai_family == AF_INET6, NULL);
+                        ip = &((const struct sockaddr_in6 *)
+                                address->ai_addr)->sin6_addr;
+                        port_ = ntohs(((const struct sockaddr_in6 *)
+                                address->ai_addr)->sin6_port);
+                }
+
+                fail_if(inet_ntop(address->ai_family, ip, buffer,
+                        sizeof(buffer)) == NULL, NULL);
+                fail_unless(strcmp(buffer, ips[i]) == 0, NULL);
+                fail_unless(port_ == port, NULL);
+                fail_unless(address->ai_socktype == SOCK_STREAM, NULL);
+
+                i++;
+        }
+
+        fail_unless(ips[i] == NULL, NULL);
+
+        return _arakoon_cluster_node_get_next(node);
+}
+
+START_TEST(test_arakoon_cluster_new_from_config) {
+        const char *data =
+                "; Arakoon configuration\n"
+                "[global]\n"
+                "cluster_id = check\n"
+                "cluster = arakoon_0, arakoon_1 ,arakoon_2\n"
+                "\n"
+                "[arakoon_0]\n"
+                "ip = 127.0.0.1\n"
+                "client_port = 4000\n"
+                "messaging_port = 4010\n"
+                "[arakoon_1]\n"
+                "ip = 127.0.0.1, ::1\n"
+                "client_port = 4001\n"
+                "[arakoon_2]\n"
+                "ip=127.0.0.1\n"
+                "client_port=4002\n";
+        const char * const ips_0[] = {"127.0.0.1", NULL};
+        const char * const ips_1[] = {"127.0.0.1", "::1", NULL};
+        const char * const ips_2[] = {"127.0.0.1", NULL};
+        char *path = NULL;
+        ArakoonCluster *c = NULL;
+        ArakoonClusterNode *node = NULL;
+        arakoon_rc rc = 0;
+
+        path = write_config(data);
+
+        rc = arakoon_cluster_new_from_config(path, &c);
+        fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(c != NULL, NULL);
+        fail_unless(strcmp(arakoon_cluster_get_name(c), "check") == 0, NULL);
+
+        /* Nodes are kept in the order of the configuration, using the
+         * client port, not the messaging port */
+        node = _arakoon_cluster_get_first_node(c);
+        node = check_config_node(node, "arakoon_0", ips_0, 4000);
+        node = check_config_node(node, "arakoon_1", ips_1, 4001);
+        node = check_config_node(node, "arakoon_2", ips_2, 4002);
+        fail_unless(node == NULL, NULL);
+
+        arakoon_cluster_free(c);
+
+        unlink(path);
+        free(path);
+} END_TEST
+
+START_TEST(test_arakoon_cluster_new_from_config_invalid) {
+        const char *missing_node =
+                "[global]\n"
+                "cluster_id = check\n"
+                "cluster = arakoon_0, arakoon_1\n"
+                "[arakoon_0]\n"
+                "ip = 127.0.0.1\n"
+                "client_port = 4000\n";
+        const char *no_section = "cluster_id = check\n";
+        char *path = NULL;
+        ArakoonCluster *c = NULL;
+        arakoon_rc rc = 0;
+
+        path = write_config(missing_node);
+        rc = arakoon_cluster_new_from_config(path, &c);
+        fail_unless(rc == -EINVAL, NULL);
+        fail_unless(c == NULL, NULL);
+        unlink(path);
+        free(path);
+
+        path = write_config(no_section);
+        rc = arakoon_cluster_new_from_config(path, &c);
+        fail_unless(rc == -EINVAL, NULL);
+        fail_unless(c == NULL, NULL);
+        unlink(path);
+        free(path);
+
+        rc = arakoon_cluster_new_from_config("/nonexistent/arakoon.ini", &c);
+        fail_unless(rc == -ENOENT, NULL);
+        fail_unless(c == NULL, NULL);
+} END_TEST
+
+/* Data as sent by a node */
+typedef struct {
+        char data[1024];
+        size_t size;
+} CheckBuffer;
+
+static void check_buffer_put(CheckBuffer *buffer, const void *data,
+    const size_t len) {
+        fail_unless(buffer->size + len <= sizeof(buffer->data), NULL);
+
+        memcpy(buffer->data + buffer->size, data, len);
+        buffer->size += len;
+}
+
+static void check_buffer_put_uint32(CheckBuffer *buffer,
+    const uint32_t value) {
+        check_buffer_put(buffer, &value, sizeof(value));
+}
+
+static void check_buffer_put_string(CheckBuffer *buffer,
+    const char * const data) {
+        check_buffer_put_uint32(buffer, strlen(data));
+        check_buffer_put(buffer, data, strlen(data));
+}
+
+/* Encoding of the statistics returned by a node, see arakoon-statistics.c */
+
+static void check_statistics_put_field(CheckBuffer *buffer,
+    const ArakoonStatisticsFieldType type, const char *name) {
+        check_buffer_put_uint32(buffer, type);
+        check_buffer_put_string(buffer, name);
+}
+
+static void check_statistics_put_sample(CheckBuffer *buffer) {
+        const int32_t i32 = -7;
+        const int64_t i64 = INT64_C(1) << 40;
+        const double f = 1.5;
+
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_LIST,
+                "root");
+        check_buffer_put_uint32(buffer, 5);
+
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_INT32,
+                "i32");
+        check_buffer_put(buffer, &i32, sizeof(i32));
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_INT64,
+                "i64");
+        check_buffer_put(buffer, &i64, sizeof(i64));
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_FLOAT,
+                "float");
+        check_buffer_put(buffer, &f, sizeof(f));
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_STRING,
+                "string");
+        check_buffer_put_string(buffer, "hello");
+
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_LIST,
+                "list");
+        check_buffer_put_uint32(buffer, 1);
+        check_statistics_put_field(buffer, ARAKOON_STATISTICS_FIELD_INT32,
+                "nested");
+        check_buffer_put(buffer, &i32, sizeof(i32));
+}
+
+START_TEST(test_arakoon_statistics_parse) {
+        CheckBuffer buffer;
+        ArakoonStatistics *statistics = NULL;
+        const ArakoonStatisticsField *root = NULL, *field = NULL;
+        arakoon_rc rc = 0;
+
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_statistics_put_sample(&buffer);
+
+        rc = _arakoon_statistics_parse(buffer.size, buffer.data, &statistics);
+        fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_if(statistics == NULL, NULL);
+
+        root = arakoon_statistics_get_root(statistics);
+        fail_unless(root->type == ARAKOON_STATISTICS_FIELD_LIST, NULL);
+        fail_unless(strcmp(root->name, "root") == 0, NULL);
+        fail_unless(root->value.list.count == 5, NULL);
+
+        field = arakoon_statistics_field_find(root, "i32");
+        fail_unless(field != NULL, NULL);
+        fail_unless(field->type == ARAKOON_STATISTICS_FIELD_INT32, NULL);
+        fail_unless(field->value.int_ == -7, NULL);
+
+        field = arakoon_statistics_field_find(root, "i64");
+        fail_unless(field != NULL, NULL);
+        fail_unless(field->type == ARAKOON_STATISTICS_FIELD_INT64, NULL);
+        fail_unless(field->value.int_ == INT64_C(1) << 40, NULL);
+
+        field = arakoon_statistics_field_find(root, "float");
+        fail_unless(field != NULL, NULL);
+        fail_unless(field->type == ARAKOON_STATISTICS_FIELD_FLOAT, NULL);
+        fail_unless(field->value.float_ == 1.5, NULL);
+
+        field = arakoon_statistics_field_find(root, "string");
+        fail_unless(field != NULL, NULL);
+        fail_unless(field->type == ARAKOON_STATISTICS_FIELD_STRING, NULL);
+        fail_unless(field->value.string.size == 5, NULL);
+        fail_unless(strcmp(field->value.string.data, "hello") == 0, NULL);
+
+        field = arakoon_statistics_field_find(root, "list");
+        fail_unless(field != NULL, NULL);
+        fail_unless(field->value.list.count == 1, NULL);
+        field = arakoon_statistics_field_find(field, "nested");
+        fail_unless(field != NULL, NULL);
+        fail_unless(field->value.int_ == -7, NULL);
+
+        fail_unless(arakoon_statistics_field_find(root, "missing") == NULL,
+                NULL);
+
+        arakoon_statistics_free(statistics);
+} END_TEST
+
+START_TEST(test_arakoon_statistics_parse_truncated) {
+        CheckBuffer buffer;
+        ArakoonStatistics *statistics = NULL;
+        size_t size = 0;
+        arakoon_rc rc = 0;
+
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_statistics_put_sample(&buffer);
+
+        for(size = 0; size < buffer.size; size++) {
+                rc = _arakoon_statistics_parse(size, buffer.data,
+                        &statistics);
+                fail_unless(rc == -EPROTO, NULL);
+                fail_unless(statistics == NULL, NULL);
+        }
+} END_TEST
+
+START_TEST(test_arakoon_statistics_parse_oversized) {
+        CheckBuffer buffer;
+        ArakoonStatistics *statistics = NULL;
+        const int32_t i32 = 0;
+        int i = 0;
+        arakoon_rc rc = 0;
+
+        /* A list claiming more fields than the data can hold */
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_statistics_put_field(&buffer, ARAKOON_STATISTICS_FIELD_LIST,
+                "root");
+        check_buffer_put_uint32(&buffer, UINT32_MAX);
+        check_statistics_put_field(&buffer, ARAKOON_STATISTICS_FIELD_INT32,
+                "i32");
+        check_buffer_put(&buffer, &i32, sizeof(i32));
+
+        rc = _arakoon_statistics_parse(buffer.size, buffer.data, &statistics);
+        fail_unless(rc == -EPROTO, NULL);
+        fail_unless(statistics == NULL, NULL);
+
+        /* A string longer than the data */
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_statistics_put_field(&buffer, ARAKOON_STATISTICS_FIELD_STRING,
+                "string");
+        check_buffer_put_uint32(&buffer, UINT32_MAX);
+        check_buffer_put(&buffer, "hello", 5);
+
+        rc = _arakoon_statistics_parse(buffer.size, buffer.data, &statistics);
+        fail_unless(rc == -EPROTO, NULL);
+        fail_unless(statistics == NULL, NULL);
+
+        /* Lists nested too deeply */
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        for(i = 0; i < 32; i++) {
+                check_statistics_put_field(&buffer,
+                        ARAKOON_STATISTICS_FIELD_LIST, "l");
+                check_buffer_put_uint32(&buffer, 1);
+        }
+        check_statistics_put_field(&buffer, ARAKOON_STATISTICS_FIELD_INT32,
+                "i32");
+        check_buffer_put(&buffer, &i32, sizeof(i32));
+
+        rc = _arakoon_statistics_parse(buffer.size, buffer.data, &statistics);
+        fail_unless(rc == -EPROTO, NULL);
+        fail_unless(statistics == NULL, NULL);
+
+        /* An unknown field type */
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_buffer_put_uint32(&buffer, 42);
+        check_buffer_put_uint32(&buffer, 0);
+        check_buffer_put(&buffer, &i32, sizeof(i32));
+
+        rc = _arakoon_statistics_parse(buffer.size, buffer.data, &statistics);
+        fail_unless(rc == -EPROTO, NULL);
+        fail_unless(statistics == NULL, NULL);
+} END_TEST
+
+/* The sampler thread keeps sampling every node until it's released */
+static void check_statistics_sampled(const char *node_name, arakoon_rc rc,
+    const ArakoonStatistics *statistics, void *data) {
+        fail_unless(strcmp(node_name, "check_0") == 0, NULL);
+        /* Statistics aren't served by the check server */
+        fail_unless(rc == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(statistics == NULL, NULL);
+
+        __atomic_add_fetch((int *) data, 1, __ATOMIC_SEQ_CST);
+}
+
+START_TEST(test_arakoon_statistics_sampler_start) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonStatisticsSampler *sampler = NULL;
+        int samples = 0, i = 0;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+
+        sampler = arakoon_statistics_sampler_new(cluster,
+                check_statistics_sampled, &samples);
+        fail_if(sampler == NULL, NULL);
+
+        fail_unless(arakoon_statistics_sampler_start(sampler, 0) == -EINVAL,
+                NULL);
+        fail_unless(arakoon_statistics_sampler_start(sampler, 10) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_statistics_sampler_start(sampler, 10) == -EINVAL,
+                NULL);
+
+        for(i = 0; i < 200 && __atomic_load_n(&samples,
+                __ATOMIC_SEQ_CST) < 3; i++) {
+                usleep(10 * 1000);
+        }
+        fail_unless(__atomic_load_n(&samples, __ATOMIC_SEQ_CST) >= 3, NULL);
+
+        arakoon_statistics_sampler_free(sampler);
+
+        /* Nothing is sampled after the sampler is released */
+        i = __atomic_load_n(&samples, __ATOMIC_SEQ_CST);
+        usleep(50 * 1000);
+        fail_unless(__atomic_load_n(&samples, __ATOMIC_SEQ_CST) == i, NULL);
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+#define CHECK_MUX_THREADS (8)
+#define CHECK_MUX_CALLS (8)
+#define CHECK_MUX_SIZE (256 * 1024)
+#define CHECK_MUX_SOCKET_BUFFER (16 * 1024)
+
+static void check_mux_io(int fd, void *data, size_t len, arakoon_bool write_) {
+        ssize_t cnt = 0;
+
+        while(len > 0) {
+                cnt = write_ ? write(fd, data, len) : read(fd, data, len);
+                fail_unless(cnt > 0, NULL);
+
+                data = (char *) data + cnt;
+                len -= cnt;
+        }
+}
+
+/* Echo every request, only reading the next one once the response is sent,
+ * like a server does once its send buffer is full */
+static void * check_mux_server(void *data) {
+        const int fd = *(int *) data;
+        char *buffer = NULL;
+        uint32_t len = 0;
+        int i = 0;
+
+        buffer = malloc(CHECK_MUX_SIZE);
+        fail_if(buffer == NULL, NULL);
+
+        for(i = 0; i < CHECK_MUX_THREADS * CHECK_MUX_CALLS; i++) {
+                check_mux_io(fd, &len, sizeof(len), ARAKOON_BOOL_FALSE);
+                fail_unless(len <= CHECK_MUX_SIZE, NULL);
+                check_mux_io(fd, buffer, len, ARAKOON_BOOL_FALSE);
+
+                check_mux_io(fd, &len, sizeof(len), ARAKOON_BOOL_TRUE);
+                check_mux_io(fd, buffer, len, ARAKOON_BOOL_TRUE);
+        }
+
+        free(buffer);
+
+        return NULL;
+}
+
+typedef struct {
+        ArakoonMux *mux;
+        int id;
+} CheckMuxClient;
+
+static void * check_mux_client(void *data) {
+        const CheckMuxClient *client = (CheckMuxClient *) data;
+        const uint32_t size = CHECK_MUX_SIZE;
+        char *request = NULL, *response = NULL;
+        uint32_t len = 0;
+        int timeout = ARAKOON_CLIENT_CALL_OPTIONS_INFINITE_TIMEOUT, i = 0;
+        arakoon_rc rc = 0;
+
+        request = malloc(sizeof(size) + size);
+        response = malloc(size);
+        fail_if(request == NULL || response == NULL, NULL);
+
+        memcpy(request, &size, sizeof(size));
+
+        for(i = 0; i < CHECK_MUX_CALLS; i++) {
+                memset(request + sizeof(size),
+                        client->id * CHECK_MUX_CALLS + i, size);
+
+                rc = _arakoon_mux_begin(client->mux, client->mux);
+                fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+
+                rc = _arakoon_mux_submit(request, sizeof(size) + size,
+                        &timeout);
+                fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+
+                rc = _arakoon_networking_poll_read(
+                        _arakoon_mux_get_fd(client->mux), &len, sizeof(len),
+                        &timeout);
+                fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+                fail_unless(len == size, NULL);
+
+                rc = _arakoon_networking_poll_read(
+                        _arakoon_mux_get_fd(client->mux), response, len,
+                        &timeout);
+                fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+                fail_unless(memcmp(request + sizeof(size), response, len) == 0,
+                        NULL);
+
+                _arakoon_mux_end_call(rc);
+        }
+
+        free(request);
+        free(response);
+
+        return NULL;
+}
+
+/* Requests and responses much larger than the socket buffers: a thread can
+ * only finish writing once earlier responses are read */
+START_TEST(test_arakoon_mux_pipeline_large) {
+        CheckMuxClient clients[CHECK_MUX_THREADS];
+        pthread_t threads[CHECK_MUX_THREADS], server;
+        const int buffer_size = CHECK_MUX_SOCKET_BUFFER;
+        ArakoonMux *mux = NULL;
+        int fds[2] = {-1, -1}, i = 0;
+
+        fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, NULL);
+        for(i = 0; i < 2; i++) {
+                setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &buffer_size,
+                        sizeof(buffer_size));
+                setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &buffer_size,
+                        sizeof(buffer_size));
+        }
+
+        mux = _arakoon_mux_new(fds[0]);
+        fail_if(mux == NULL, NULL);
+
+        fail_unless(pthread_create(&server, NULL, check_mux_server,
+                &fds[1]) == 0, NULL);
+
+        for(i = 0; i < CHECK_MUX_THREADS; i++) {
+                clients[i].mux = mux;
+                clients[i].id = i;
+                fail_unless(pthread_create(&threads[i], NULL,
+                        check_mux_client, &clients[i]) == 0, NULL);
+        }
+
+        for(i = 0; i < CHECK_MUX_THREADS; i++) {
+                pthread_join(threads[i], NULL);
+        }
+        pthread_join(server, NULL);
+
+        _arakoon_mux_unref(mux);
+        close(fds[1]);
+} END_TEST
+
+/* A thread beginning a call while its previous one was never released can't
+ * tell whether that response was read, so the connection is given up */
+START_TEST(test_arakoon_mux_begin_unreleased) {
+        const char request[] = "request";
+        int fds[2] = {-1, -1}, timeout = 1000;
+        ArakoonMux *mux = NULL;
+
+        fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, NULL);
+
+        mux = _arakoon_mux_new(fds[0]);
+        fail_if(mux == NULL, NULL);
+
+        fail_unless(_arakoon_mux_begin(mux, mux) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(_arakoon_mux_submit(request, sizeof(request), &timeout) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        /* No response is read */
+        fail_unless(_arakoon_mux_begin(mux, mux) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(_arakoon_mux_submit(request, sizeof(request), &timeout) ==
+                ARAKOON_RC_CLIENT_NETWORK_ERROR, NULL);
+        _arakoon_mux_end_call(ARAKOON_RC_CLIENT_NETWORK_ERROR);
+
+        _arakoon_mux_unref(mux);
+        close(fds[1]);
+} END_TEST
+
+/* A who_master call which fails releases its request, so calls of other
+ * threads queued behind it get their turn */
+typedef struct {
+        ArakoonCluster *cluster;
+        arakoon_rc rc;
+} CheckMuxGet;
+
+static void * check_mux_get(void *data) {
+        CheckMuxGet *get = (CheckMuxGet *) data;
+        ArakoonClientCallOptions *options = NULL;
+        size_t value_size = 0;
+        void *value = NULL;
+
+        options = arakoon_client_call_options_new();
+        fail_if(options == NULL, NULL);
+        fail_unless(arakoon_client_call_options_set_timeout(options, 1000) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        get->rc = arakoon_get(get->cluster, options, 3, "key", &value_size,
+                &value);
+        if(get->rc == ARAKOON_RC_SUCCESS) {
+                fail_unless(value_size == 5 &&
+                        memcmp(value, "value", 5) == 0, NULL);
+                arakoon_mem_free(value);
+        }
+
+        arakoon_client_call_options_free(options);
+
+        return NULL;
+}
+
+START_TEST(test_arakoon_mux_who_master_failure) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        CheckMuxGet get;
+        pthread_t thread;
+        char *master = NULL;
+
+        server = check_server_new("check_0");
+        check_server_put(server, "key", "value");
+
+        cluster = check_server_cluster_new(&server, 1);
+        fail_unless(arakoon_cluster_set_multiplexed(cluster,
+                ARAKOON_BOOL_TRUE) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_cluster_connect_master(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        check_server_fail(server, 0x02, ARAKOON_RC_UNKNOWN_FAILURE, 1);
+        fail_unless(arakoon_who_master(cluster, NULL, &master) ==
+                ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(master == NULL, NULL);
+
+        get.cluster = cluster;
+        get.rc = ARAKOON_RC_UNKNOWN_FAILURE;
+        fail_unless(pthread_create(&thread, NULL, check_mux_get, &get) == 0,
+                NULL);
+        pthread_join(thread, NULL);
+
+        fail_unless(get.rc == ARAKOON_RC_SUCCESS, NULL);
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* Switching master doesn't break calls still waiting for the former one */
+START_TEST(test_arakoon_mux_master_hint_detach) {
+        CheckServer *servers[2] = { NULL, NULL };
+        ArakoonCluster *cluster = NULL;
+        CheckMuxGet get;
+        pthread_t thread;
+        size_t value_size = 0;
+        void *value = NULL;
+        int timeout = 1000;
+
+        servers[0] = check_server_new("check_0");
+        servers[1] = check_server_new("check_1");
+        check_server_put(servers[0], "key", "value");
+        check_server_put(servers[1], "key", "value");
+
+        cluster = check_server_cluster_new(servers, 2);
+        fail_unless(arakoon_cluster_set_multiplexed(cluster,
+                ARAKOON_BOOL_TRUE) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(_arakoon_cluster_connect_master_by_name(cluster,
+                "check_0", &timeout) == ARAKOON_RC_SUCCESS, NULL);
+
+        check_server_set_delay(servers[0], 300 * US_PER_MS);
+
+        get.cluster = cluster;
+        get.rc = ARAKOON_RC_UNKNOWN_FAILURE;
+        fail_unless(pthread_create(&thread, NULL, check_mux_get, &get) == 0,
+                NULL);
+
+        /* Requests are only logged once answered, so give this one time
+         * to reach the former master */
+        usleep(100 * US_PER_MS);
+
+        _arakoon_cluster_set_master_hint(cluster, "check_1");
+
+        fail_unless(arakoon_get(cluster, NULL, 3, "key", &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        arakoon_mem_free(value);
+
+        /* Breaking the connection would have made the other call retry */
+        pthread_join(thread, NULL);
+        fail_unless(get.rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(check_server_count_requests(servers[0], 0x08) == 1, NULL);
+        fail_unless(check_server_count_requests(servers[1], 0x08) == 1, NULL);
+
+        arakoon_cluster_free(cluster);
+        check_server_free(servers[0]);
+        check_server_free(servers[1]);
+} END_TEST
+
+START_TEST(test_arakoon_master_watcher_step) {
+        CheckServer *servers[3] = { NULL, NULL, NULL };
+        ArakoonCluster *cluster = NULL;
+        ArakoonMasterWatcher *watcher = NULL;
+        ArakoonClientCallOptions *options = NULL;
+        uint64_t start = 0;
+        size_t i = 0, value_size = 0;
+        void *value = NULL;
+
+        servers[0] = check_server_new("check_0");
+        servers[1] = check_server_new("check_1");
+        servers[2] = check_server_new("check_2");
+
+        for(i = 0; i < 3; i++) {
+                check_server_set_master(servers[i], "check_1");
+                check_server_put(servers[i], "key", "value");
+                check_server_set_delay(servers[i], 300 * US_PER_MS);
+        }
+
+        cluster = check_server_cluster_new(servers, 3);
+        watcher = arakoon_master_watcher_new(cluster);
+        fail_if(watcher == NULL, NULL);
+
+        options = arakoon_client_call_options_new();
+        fail_if(options == NULL, NULL);
+        fail_unless(arakoon_client_call_options_set_timeout(options, 2000) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        /* Asking the nodes one after the other would take 900ms, on top of
+         * 300ms to check the master can make progress */
+        start = _arakoon_networking_monotonic_usec();
+        fail_unless(arakoon_master_watcher_step(watcher, options) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(_arakoon_networking_monotonic_usec() - start <
+                1000 * US_PER_MS, NULL);
+
+        for(i = 0; i < 3; i++) {
+                check_server_set_delay(servers[i], 0);
+        }
+
+        /* The cluster follows the hint on its next call */
+        fail_unless(arakoon_get(cluster, NULL, 3, "key", &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        arakoon_mem_free(value);
+        fail_unless(check_server_count_requests(servers[1], 0x08) == 1, NULL);
+
+        /* A single vote isn't a majority */
+        check_server_set_master(servers[0], NULL);
+        check_server_set_master(servers[2], NULL);
+        fail_unless(arakoon_master_watcher_step(watcher, options) ==
+                ARAKOON_RC_CLIENT_MASTER_NOT_FOUND, NULL);
+
+        arakoon_client_call_options_free(options);
+        arakoon_master_watcher_free(watcher);
+        arakoon_cluster_free(cluster);
+        for(i = 0; i < 3; i++) {
+                check_server_free(servers[i]);
+        }
+} END_TEST
+
+static ArakoonNodeHealth check_health_get(ArakoonHealthChecker *checker,
+    const char *name) {
+        ArakoonNodeHealth health[8];
+        size_t count = 0, i = 0;
+
+        count = arakoon_health_checker_get_health(checker, health, 8);
+        for(i = 0; i < count; i++) {
+                if(strcmp(health[i].name, name) == 0) {
+                        return health[i];
+                }
+        }
+
+        fail_unless(0, "unknown node");
+        return health[0];
+}
+
+START_TEST(test_arakoon_health_checker_ping) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonHealthChecker *checker = NULL;
+        ArakoonNodeHealth health;
+        uint64_t rtt = 0;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+        checker = arakoon_health_checker_new(cluster);
+        fail_if(checker == NULL, NULL);
+
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_1",
+                &rtt) == ARAKOON_RC_CLIENT_UNKNOWN_NODE, NULL);
+
+        check_server_set_delay(server, 5 * US_PER_MS);
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                &rtt) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(rtt >= 5 * US_PER_MS, NULL);
+
+        health = check_health_get(checker, "check_0");
+        fail_unless(health.pings == 1, NULL);
+        fail_unless(health.failures == 0, NULL);
+        fail_unless(health.last_rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(health.progress_possible, NULL);
+        fail_unless(health.rtt_usec == rtt, NULL);
+        fail_unless(health.srtt_usec == rtt, NULL);
+
+        /* Failures are counted until the next successful ping */
+        check_server_fail(server, 0x12, ARAKOON_RC_UNKNOWN_FAILURE, 2);
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                NULL) == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                NULL) == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+
+        health = check_health_get(checker, "check_0");
+        fail_unless(health.pings == 3, NULL);
+        fail_unless(health.failures == 2, NULL);
+        fail_unless(health.last_rc == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(health.srtt_usec == rtt, NULL);
+
+        check_server_set_master(server, NULL);
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                NULL) == ARAKOON_RC_SUCCESS, NULL);
+
+        health = check_health_get(checker, "check_0");
+        fail_unless(health.failures == 0, NULL);
+        fail_unless(!health.progress_possible, NULL);
+
+        /* A single connection is used for all pings */
+        fail_unless(check_server_get_connections(server) == 1, NULL);
+
+        arakoon_health_checker_free(checker);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_health_checker_srtt) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonHealthChecker *checker = NULL;
+        ArakoonNodeHealth health;
+        uint64_t first = 0, second = 0;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+        checker = arakoon_health_checker_new(cluster);
+        fail_if(checker == NULL, NULL);
+
+        check_server_set_delay(server, 2 * US_PER_MS);
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                &first) == ARAKOON_RC_SUCCESS, NULL);
+
+        check_server_set_delay(server, 20 * US_PER_MS);
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                &second) == ARAKOON_RC_SUCCESS, NULL);
+
+        /* Every new sample weighs 1/8, as in TCP */
+        health = check_health_get(checker, "check_0");
+        fail_unless(health.rtt_usec == second, NULL);
+        fail_unless(health.srtt_usec == first - (first >> 3) + (second >> 3),
+                NULL);
+        fail_unless(health.srtt_usec > first &&
+                health.srtt_usec < second, NULL);
+
+        arakoon_health_checker_free(checker);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_health_checker_get_health) {
+        static const char * const names[5] = {
+                "check_0", "check_1", "check_2", "check_3", "check_4"
+        };
+        CheckServer *servers[5];
+        ArakoonCluster *cluster = NULL;
+        ArakoonHealthChecker *checker = NULL;
+        ArakoonNodeHealth health[5];
+        size_t i = 0;
+
+        for(i = 0; i < 5; i++) {
+                servers[i] = check_server_new(names[i]);
+        }
+
+        cluster = check_server_cluster_new(servers, 5);
+        checker = arakoon_health_checker_new(cluster);
+        fail_if(checker == NULL, NULL);
+
+        /* check_0 fails, check_1 can't make progress, check_2 isn't
+         * pinged, check_3 is faster than check_4 */
+        check_server_fail(servers[0], 0x12, ARAKOON_RC_UNKNOWN_FAILURE, 1);
+        check_server_set_master(servers[1], NULL);
+        check_server_set_delay(servers[4], 10 * US_PER_MS);
+
+        fail_unless(arakoon_health_checker_ping(checker, NULL, "check_0",
+                NULL) == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        for(i = 1; i < 5; i++) {
+                if(i != 2) {
+                        fail_unless(arakoon_health_checker_ping(checker, NULL,
+                                names[i], NULL) == ARAKOON_RC_SUCCESS, NULL);
+                }
+        }
+
+        fail_unless(arakoon_health_checker_get_health(checker, health, 5) ==
+                5, NULL);
+        fail_unless(strcmp(health[0].name, "check_3") == 0, NULL);
+        fail_unless(strcmp(health[1].name, "check_4") == 0, NULL);
+        fail_unless(strcmp(health[2].name, "check_1") == 0, NULL);
+        fail_unless(strcmp(health[3].name, "check_2") == 0, NULL);
+        fail_unless(strcmp(health[4].name, "check_0") == 0, NULL);
+        fail_unless(health[3].pings == 0, NULL);
+
+        /* Only the best nodes are returned */
+        memset(health, 0, sizeof(health));
+        fail_unless(arakoon_health_checker_get_health(checker, health, 2) ==
+                5, NULL);
+        fail_unless(strcmp(health[0].name, "check_3") == 0, NULL);
+        fail_unless(strcmp(health[1].name, "check_4") == 0, NULL);
+        fail_unless(health[2].name == NULL, NULL);
+
+        fail_unless(arakoon_health_checker_get_health(checker, NULL, 0) == 5,
+                NULL);
+
+        arakoon_health_checker_free(checker);
+        arakoon_cluster_free(cluster);
+        for(i = 0; i < 5; i++) {
+                check_server_free(servers[i]);
+        }
+} END_TEST
+
+/* Master lookups skip nodes which are known to be down */
+START_TEST(test_arakoon_health_checker_master_lookup) {
+        CheckServer *servers[3];
+        ArakoonCluster *cluster = NULL;
+        ArakoonHealthChecker *checker = NULL;
+        size_t i = 0;
+
+        servers[0] = check_server_new("check_0");
+        servers[1] = check_server_new("check_1");
+        servers[2] = check_server_new("check_2");
+
+        for(i = 0; i < 3; i++) {
+                check_server_set_master(servers[i], "check_0");
+        }
+
+        cluster = check_server_cluster_new(servers, 3);
+        checker = arakoon_health_checker_new(cluster);
+        fail_if(checker == NULL, NULL);
+
+        check_server_fail(servers[2], 0x12, ARAKOON_RC_UNKNOWN_FAILURE, 1);
+        check_server_set_delay(servers[1], 10 * US_PER_MS);
+        fail_unless(arakoon_health_checker_step(checker, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        check_server_set_delay(servers[1], 0);
+
+        fail_unless(arakoon_cluster_set_health_checker(cluster, checker) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_cluster_connect_master(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        /* check_0 was asked, and turned out to be master itself */
+        fail_unless(check_server_count_requests(servers[0], 0x02) == 1, NULL);
+        fail_unless(check_server_count_requests(servers[1], 0x02) == 0, NULL);
+        fail_unless(check_server_count_requests(servers[2], 0x02) == 0, NULL);
+
+        fail_unless(arakoon_cluster_set_health_checker(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        arakoon_health_checker_free(checker);
+
+        /* Without a checker, the node added last is asked first */
+        arakoon_cluster_free(cluster);
+        cluster = check_server_cluster_new(servers, 3);
+        fail_unless(arakoon_cluster_connect_master(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(check_server_count_requests(servers[2], 0x02) == 1, NULL);
+
+        arakoon_cluster_free(cluster);
+        for(i = 0; i < 3; i++) {
+                check_server_free(servers[i]);
+        }
+} END_TEST
+
+#define CHECK_LIST_CLUSTER "check"
+
+/* A node connected to a socket of the test itself, which plays the server.
+ * The prologue sent by the node is skipped. */
+static ArakoonClusterNode * check_list_connect(ArakoonCluster **cluster,
+    int *server) {
+        struct sockaddr_in address;
+        socklen_t len = sizeof(address);
+        ArakoonClusterNode *node = NULL;
+        char port[16], prologue[64];
+        int listener = -1, timeout = 1000;
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        fail_if(listener < 0, NULL);
+        fail_unless(bind(listener, (struct sockaddr *) &address,
+                sizeof(address)) == 0, NULL);
+        fail_unless(listen(listener, 1) == 0, NULL);
+        fail_unless(getsockname(listener, (struct sockaddr *) &address,
+                &len) == 0, NULL);
+        snprintf(port, sizeof(port), "%d", ntohs(address.sin_port));
+
+        *cluster = arakoon_cluster_new(ARAKOON_PROTOCOL_VERSION_1,
+                CHECK_LIST_CLUSTER);
+        fail_if(*cluster == NULL, NULL);
+        node = arakoon_cluster_node_new("check_0");
+        fail_if(node == NULL, NULL);
+        fail_unless(arakoon_cluster_node_add_address_tcp(node, "127.0.0.1",
+                port) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_cluster_add_node(*cluster, node) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        fail_unless(_arakoon_cluster_node_connect(node, &timeout) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        *server = accept(listener, NULL, NULL);
+        fail_if(*server < 0, NULL);
+        close(listener);
+
+        /* Magic, version and cluster name */
+        check_mux_io(*server, prologue,
+                3 * sizeof(uint32_t) + strlen(CHECK_LIST_CLUSTER),
+                ARAKOON_BOOL_FALSE);
+
+        return node;
+}
+
+/* Send 'buffer' from the server side, and decode it as a result */
+static void check_list_read(ArakoonClusterNode *node, int server,
+    CheckBuffer *buffer, ArakoonCommandResultType type,
+    ArakoonCommandResult *result) {
+        int timeout = 1000;
+
+        check_mux_io(server, buffer->data, buffer->size, ARAKOON_BOOL_TRUE);
+
+        fail_unless(_arakoon_command_node_read_result(node, type, &timeout,
+                result) == ARAKOON_RC_SUCCESS, NULL);
+}
+
+static void check_key_value_list_entry(const ArakoonKeyValueList * const list,
+    const size_t index, const char * const key, const char * const value) {
+        size_t key_size = 0, value_size = 0;
+        const void *key_ = NULL, *value_ = NULL;
+
+        fail_unless(arakoon_key_value_list_get(list, index, &key_size, &key_,
+                &value_size, &value_) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(key_size == strlen(key), NULL);
+        fail_unless(memcmp(key_, key, key_size) == 0, NULL);
+        fail_unless(value_size == strlen(value), NULL);
+        fail_unless(memcmp(value_, value, value_size) == 0, NULL);
+}
+
+static void check_key_value_list_find(const ArakoonKeyValueList * const list,
+    const char * const key, const arakoon_rc expected_rc,
+    const size_t expected_index) {
+        size_t index = SENTINEL;
+
+        fail_unless(arakoon_key_value_list_find(list, strlen(key), key,
+                &index) == expected_rc, NULL);
+        if(expected_rc == ARAKOON_RC_SUCCESS) {
+                fail_unless(index == expected_index, NULL);
+        }
+}
+
+START_TEST(test_arakoon_value_list_get) {
+        ArakoonValueList *list = NULL;
+        size_t value_size = SENTINEL;
+        const void *value = NULL;
+
+        list = arakoon_value_list_new();
+        fail_if(list == NULL, NULL);
+
+        fail_unless(arakoon_value_list_add(list, 3, "abc") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_value_list_add(list, 0, "") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_value_list_add(list, 2, "de") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_value_list_size(list) == 3, NULL);
+
+        fail_unless(arakoon_value_list_get(list, 0, &value_size, &value) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 3 && memcmp(value, "abc", 3) == 0, NULL);
+
+        fail_unless(arakoon_value_list_get(list, 1, &value_size, &value) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 0 && value != NULL, NULL);
+
+        fail_unless(arakoon_value_list_get(list, 2, &value_size, &value) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 2 && memcmp(value, "de", 2) == 0, NULL);
+
+        fail_unless(arakoon_value_list_get(list, 3, &value_size, &value) ==
+                -ERANGE, NULL);
+        fail_unless(value_size == 0 && value == NULL, NULL);
+
+        fail_unless(arakoon_value_list_get(list, SIZE_MAX, &value_size,
+                &value) == -ERANGE, NULL);
+
+        arakoon_value_list_free(list);
+} END_TEST
+
+/* Lists are sent last-to-first, and None entries have no data */
+START_TEST(test_arakoon_value_list_decode) {
+        ArakoonCluster *cluster = NULL;
+        ArakoonClusterNode *node = NULL;
+        ArakoonCommandResult result;
+        CheckBuffer buffer;
+        size_t value_size = 0;
+        const void *value = NULL;
+        int server = -1;
+
+        node = check_list_connect(&cluster, &server);
+
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_buffer_put_uint32(&buffer, 3);
+        check_buffer_put_string(&buffer, "c");
+        check_buffer_put_string(&buffer, "b");
+        check_buffer_put_string(&buffer, "a");
+
+        check_list_read(node, server, &buffer,
+                ARAKOON_COMMAND_RESULT_STRING_LIST, &result);
+
+        fail_unless(arakoon_value_list_size(result.value_list) == 3, NULL);
+        fail_unless(arakoon_value_list_get(result.value_list, 0, &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 1 && memcmp(value, "a", 1) == 0, NULL);
+        fail_unless(arakoon_value_list_get(result.value_list, 2, &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 1 && memcmp(value, "c", 1) == 0, NULL);
+        fail_unless(arakoon_value_list_get(result.value_list, 3, &value_size,
+                &value) == -ERANGE, NULL);
+
+        arakoon_value_list_free(result.value_list);
+
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_buffer_put_uint32(&buffer, 3);
+        check_buffer_put(&buffer, "\1", 1);
+        check_buffer_put_string(&buffer, "c");
+        check_buffer_put(&buffer, "\0", 1);
+        check_buffer_put(&buffer, "\1", 1);
+        check_buffer_put_string(&buffer, "a");
+
+        check_list_read(node, server, &buffer,
+                ARAKOON_COMMAND_RESULT_STRING_OPTION_LIST, &result);
+
+        fail_unless(arakoon_value_list_size(result.value_list) == 3, NULL);
+        fail_unless(arakoon_value_list_get(result.value_list, 0, &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 1 && memcmp(value, "a", 1) == 0, NULL);
+        fail_unless(arakoon_value_list_get(result.value_list, 1, &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 0 && value == NULL, NULL);
+        fail_unless(arakoon_value_list_get(result.value_list, 2, &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 1 && memcmp(value, "c", 1) == 0, NULL);
+
+        arakoon_value_list_free(result.value_list);
+
+        close(server);
+        arakoon_cluster_free(cluster);
+} END_TEST
+
+/* As returned by range_entries: sent last-to-first, ascending in the list */
+START_TEST(test_arakoon_key_value_list_range_entries) {
+        ArakoonCluster *cluster = NULL;
+        ArakoonClusterNode *node = NULL;
+        ArakoonCommandResult result;
+        CheckBuffer buffer;
+        size_t key_size = SENTINEL, value_size = SENTINEL;
+        const void *key = NULL, *value = NULL;
+        int server = -1;
+
+        node = check_list_connect(&cluster, &server);
+
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_buffer_put_uint32(&buffer, 4);
+        check_buffer_put_string(&buffer, "key_3");
+        check_buffer_put_string(&buffer, "value_3");
+        check_buffer_put_string(&buffer, "key_2");
+        check_buffer_put_string(&buffer, "value_2");
+        check_buffer_put_string(&buffer, "key_1");
+        check_buffer_put_string(&buffer, "");
+        check_buffer_put_string(&buffer, "key");
+        check_buffer_put_string(&buffer, "value");
+
+        check_list_read(node, server, &buffer,
+                ARAKOON_COMMAND_RESULT_STRING_STRING_LIST, &result);
+
+        fail_unless(arakoon_key_value_list_size(result.key_value_list) == 4,
+                NULL);
+        check_key_value_list_entry(result.key_value_list, 0, "key", "value");
+        check_key_value_list_entry(result.key_value_list, 1, "key_1", "");
+        check_key_value_list_entry(result.key_value_list, 2, "key_2",
+                "value_2");
+        check_key_value_list_entry(result.key_value_list, 3, "key_3",
+                "value_3");
+
+        fail_unless(arakoon_key_value_list_get(result.key_value_list, 4,
+                &key_size, &key, &value_size, &value) == -ERANGE, NULL);
+        fail_unless(key == NULL && value == NULL, NULL);
+        fail_unless(key_size == 0 && value_size == 0, NULL);
+
+        check_key_value_list_find(result.key_value_list, "key",
+                ARAKOON_RC_SUCCESS, 0);
+        check_key_value_list_find(result.key_value_list, "key_1",
+                ARAKOON_RC_SUCCESS, 1);
+        check_key_value_list_find(result.key_value_list, "key_2",
+                ARAKOON_RC_SUCCESS, 2);
+        check_key_value_list_find(result.key_value_list, "key_3",
+                ARAKOON_RC_SUCCESS, 3);
+
+        check_key_value_list_find(result.key_value_list, "",
+                ARAKOON_RC_NOT_FOUND, 0);
+        check_key_value_list_find(result.key_value_list, "ke",
+                ARAKOON_RC_NOT_FOUND, 0);
+        check_key_value_list_find(result.key_value_list, "key_",
+                ARAKOON_RC_NOT_FOUND, 0);
+        check_key_value_list_find(result.key_value_list, "key_15",
+                ARAKOON_RC_NOT_FOUND, 0);
+        check_key_value_list_find(result.key_value_list, "key_4",
+                ARAKOON_RC_NOT_FOUND, 0);
+
+        arakoon_key_value_list_free(result.key_value_list);
+
+        close(server);
+        arakoon_cluster_free(cluster);
+} END_TEST
+
+/* As returned by rev_range_entries: descending in the list */
+START_TEST(test_arakoon_key_value_list_rev_range_entries) {
+        ArakoonCluster *cluster = NULL;
+        ArakoonClusterNode *node = NULL;
+        ArakoonCommandResult result;
+        CheckBuffer buffer;
+        int server = -1;
+
+        node = check_list_connect(&cluster, &server);
+
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_buffer_put_uint32(&buffer, 3);
+        check_buffer_put_string(&buffer, "key_1");
+        check_buffer_put_string(&buffer, "value_1");
+        check_buffer_put_string(&buffer, "key_2");
+        check_buffer_put_string(&buffer, "value_2");
+        check_buffer_put_string(&buffer, "key_3");
+        check_buffer_put_string(&buffer, "value_3");
+
+        check_list_read(node, server, &buffer,
+                ARAKOON_COMMAND_RESULT_STRING_STRING_LIST, &result);
+
+        fail_unless(arakoon_key_value_list_size(result.key_value_list) == 3,
+                NULL);
+        check_key_value_list_entry(result.key_value_list, 0, "key_3",
+                "value_3");
+        check_key_value_list_entry(result.key_value_list, 1, "key_2",
+                "value_2");
+        check_key_value_list_entry(result.key_value_list, 2, "key_1",
+                "value_1");
+
+        check_key_value_list_find(result.key_value_list, "key_3",
+                ARAKOON_RC_SUCCESS, 0);
+        check_key_value_list_find(result.key_value_list, "key_2",
+                ARAKOON_RC_SUCCESS, 1);
+        check_key_value_list_find(result.key_value_list, "key_1",
+                ARAKOON_RC_SUCCESS, 2);
+
+        check_key_value_list_find(result.key_value_list, "key_0",
+                ARAKOON_RC_NOT_FOUND, 0);
+        check_key_value_list_find(result.key_value_list, "key_25",
+                ARAKOON_RC_NOT_FOUND, 0);
+        check_key_value_list_find(result.key_value_list, "key_4",
+                ARAKOON_RC_NOT_FOUND, 0);
+
+        arakoon_key_value_list_free(result.key_value_list);
+
+        /* Nothing to find in an empty list */
+        memset(&buffer, 0, sizeof(CheckBuffer));
+        check_buffer_put_uint32(&buffer, 0);
+
+        check_list_read(node, server, &buffer,
+                ARAKOON_COMMAND_RESULT_STRING_STRING_LIST, &result);
+
+        fail_unless(arakoon_key_value_list_size(result.key_value_list) == 0,
+                NULL);
+        check_key_value_list_find(result.key_value_list, "key_1",
+                ARAKOON_RC_NOT_FOUND, 0);
+
+        arakoon_key_value_list_free(result.key_value_list);
+
+        close(server);
+        arakoon_cluster_free(cluster);
+} END_TEST
+
+/* Reference encoding of a sequence, as done by the per-item encoder the
+ * slab-based one replaced: a string holding the outer sequence type, the
+ * item count, and every item as its type followed by its arguments */
+typedef struct {
+        uint32_t type;
+        size_t key_size;
+        const char *key;
+        size_t value_size;
+        const char *value;
+        arakoon_bool borrowed;
+} CheckSequenceItem;
+
+static char * check_sequence_put_uint32(char *c, uint32_t n) {
+        memcpy(c, &n, sizeof(uint32_t));
+        return c + sizeof(uint32_t);
+}
+
+static char * check_sequence_put_string(char *c, size_t size,
+    const char * const data) {
+        c = check_sequence_put_uint32(c, size);
+        memcpy(c, data, size);
+        return c + size;
+}
+
+static size_t check_sequence_reference(const CheckSequenceItem * const items,
+    size_t count, char **encoded) {
+        size_t i = 0, size = 3 * sizeof(uint32_t);
+        char *c = NULL;
+
+        for(i = 0; i < count; i++) {
+                size += 2 * sizeof(uint32_t) + items[i].key_size;
+                if(items[i].type == 1) {
+                        size += sizeof(uint32_t) + items[i].value_size;
+                }
+                else if(items[i].type == 8) {
+                        size += 1 + (items[i].value == NULL ? 0 :
+                                sizeof(uint32_t) + items[i].value_size);
+                }
+        }
+
+        *encoded = malloc(size);
+        fail_if(*encoded == NULL, NULL);
+
+        c = check_sequence_put_uint32(*encoded, size - sizeof(uint32_t));
+        c = check_sequence_put_uint32(c, 5);
+        c = check_sequence_put_uint32(c, count);
+
+        for(i = 0; i < count; i++) {
+                c = check_sequence_put_uint32(c, items[i].type);
+                c = check_sequence_put_string(c, items[i].key_size,
+                        items[i].key);
+                if(items[i].type == 1) {
+                        c = check_sequence_put_string(c, items[i].value_size,
+                                items[i].value);
+                }
+                else if(items[i].type == 8) {
+                        *c++ = items[i].value == NULL ? 0 : 1;
+                        if(items[i].value != NULL) {
+                                c = check_sequence_put_string(c,
+                                        items[i].value_size, items[i].value);
+                        }
+                }
+        }
+
+        fail_unless((size_t) (c - *encoded) == size, NULL);
+
+        return size;
+}
+
+static void check_sequence_add(ArakoonSequence *sequence,
+    const CheckSequenceItem * const items, size_t count) {
+        size_t i = 0;
+        arakoon_rc rc = 0;
+
+        for(i = 0; i < count; i++) {
+                const CheckSequenceItem *item = &items[i];
+
+                switch(item->type) {
+                        case 1: {
+                                rc = item->borrowed ?
+                                        arakoon_sequence_add_set_borrowed(
+                                                sequence, item->key_size,
+                                                item->key, item->value_size,
+                                                item->value) :
+                                        arakoon_sequence_add_set(sequence,
+                                                item->key_size, item->key,
+                                                item->value_size, item->value);
+                        }; break;
+                        case 2: {
+                                rc = item->borrowed ?
+                                        arakoon_sequence_add_delete_borrowed(
+                                                sequence, item->key_size,
+                                                item->key) :
+                                        arakoon_sequence_add_delete(sequence,
+                                                item->key_size, item->key);
+                        }; break;
+                        case 8: {
+                                rc = item->borrowed ?
+                                        arakoon_sequence_add_assert_borrowed(
+                                                sequence, item->key_size,
+                                                item->key, item->value_size,
+                                                item->value) :
+                                        arakoon_sequence_add_assert(sequence,
+                                                item->key_size, item->key,
+                                                item->value_size, item->value);
+                        }; break;
+                        case 15: {
+                                rc = item->borrowed ?
+                                        arakoon_sequence_add_assert_exists_borrowed(
+                                                sequence, item->key_size,
+                                                item->key) :
+                                        arakoon_sequence_add_assert_exists(
+                                                sequence, item->key_size,
+                                                item->key);
+                        }; break;
+                        default: {
+                                fail_unless(0, "Unknown sequence item type");
+                        }; break;
+                }
+
+                fail_unless(rc == ARAKOON_RC_SUCCESS, NULL);
+        }
+}
+
+static void check_sequence_encode(const ArakoonSequence * const sequence,
+    const CheckSequenceItem * const items, size_t count) {
+        char *expected = NULL, *encoded = NULL, *end = NULL;
+        size_t expected_size = 0, size = 0;
+
+        expected_size = check_sequence_reference(items, count, &expected);
+
+        size = _arakoon_sequence_get_encoded_size(sequence);
+        fail_unless(size == expected_size, NULL);
+
+        encoded = malloc(size);
+        fail_if(encoded == NULL, NULL);
+
+        end = _arakoon_sequence_encode(sequence, encoded);
+        fail_unless((size_t) (end - encoded) == size, NULL);
+        fail_unless(memcmp(encoded, expected, size) == 0, NULL);
+
+        free(encoded);
+        free(expected);
+}
+
+static size_t check_sequence_strlen(const char * const s) {
+        return s == NULL ? 0 : strlen(s);
+}
+
+#define CHECK_SEQUENCE_ITEM(t, k, v, b) \
+        { t, strlen(k), k, check_sequence_strlen(v), v, b }
+
+START_TEST(test_arakoon_sequence_encode_mixed) {
+        ArakoonSequence *sequence = NULL;
+        const CheckSequenceItem items[] = {
+                CHECK_SEQUENCE_ITEM(1, "key_0", "value_0", ARAKOON_BOOL_FALSE),
+                CHECK_SEQUENCE_ITEM(1, "key_1", "value_1", ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(2, "key_2", NULL, ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(8, "key_3", "value_3", ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(8, "key_4", NULL, ARAKOON_BOOL_FALSE),
+                CHECK_SEQUENCE_ITEM(8, "key_5", NULL, ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(15, "key_6", NULL, ARAKOON_BOOL_FALSE),
+                CHECK_SEQUENCE_ITEM(15, "key_7", NULL, ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(2, "key_8", NULL, ARAKOON_BOOL_FALSE),
+                CHECK_SEQUENCE_ITEM(1, "", "", ARAKOON_BOOL_TRUE)
+        };
+        const size_t count = sizeof(items) / sizeof(items[0]);
+
+        sequence = arakoon_sequence_new();
+        fail_if(sequence == NULL, NULL);
+
+        check_sequence_encode(sequence, items, 0);
+
+        check_sequence_add(sequence, items, count);
+        check_sequence_encode(sequence, items, count);
+
+        arakoon_sequence_free(sequence);
+} END_TEST
+
+/* Both copied and borrowed data well over 64 KiB, so the slab has to grow */
+START_TEST(test_arakoon_sequence_encode_large) {
+        ArakoonSequence *sequence = NULL;
+        CheckSequenceItem items[6];
+        const size_t value_size = 40 * 1024;
+        char *values = NULL;
+        size_t i = 0;
+        const size_t count = sizeof(items) / sizeof(items[0]);
+
+        values = malloc(count * value_size);
+        fail_if(values == NULL, NULL);
+
+        for(i = 0; i < count * value_size; i++) {
+                values[i] = (char) (i * 7 + i / 251);
+        }
+
+        for(i = 0; i < count; i++) {
+                items[i].type = (i % 3 == 2) ? 8 : 1;
+                items[i].key_size = value_size / 2;
+                items[i].key = &values[i * value_size + 1];
+                items[i].value_size = value_size;
+                items[i].value = &values[i * value_size];
+                items[i].borrowed = (i % 2 == 0) ? ARAKOON_BOOL_FALSE :
+                        ARAKOON_BOOL_TRUE;
+        }
+
+        sequence = arakoon_sequence_new();
+        fail_if(sequence == NULL, NULL);
+
+        check_sequence_add(sequence, items, count);
+        check_sequence_encode(sequence, items, count);
+
+        arakoon_sequence_free(sequence);
+        free(values);
+} END_TEST
+
+/* A reset sequence encodes only what was added after the reset */
+START_TEST(test_arakoon_sequence_encode_reset) {
+        ArakoonSequence *sequence = NULL;
+        const CheckSequenceItem first[] = {
+                CHECK_SEQUENCE_ITEM(1, "key_0", "value_0", ARAKOON_BOOL_FALSE),
+                CHECK_SEQUENCE_ITEM(1, "key_1", "value_1", ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(8, "key_2", "value_2", ARAKOON_BOOL_FALSE)
+        };
+        const CheckSequenceItem second[] = {
+                CHECK_SEQUENCE_ITEM(2, "key_3", NULL, ARAKOON_BOOL_TRUE),
+                CHECK_SEQUENCE_ITEM(15, "key_4", NULL, ARAKOON_BOOL_FALSE)
+        };
+
+        sequence = arakoon_sequence_new();
+        fail_if(sequence == NULL, NULL);
+
+        check_sequence_add(sequence, first, 3);
+        check_sequence_encode(sequence, first, 3);
+
+        fail_unless(arakoon_sequence_reset(sequence) == ARAKOON_RC_SUCCESS,
+                NULL);
+        check_sequence_encode(sequence, second, 0);
+
+        check_sequence_add(sequence, second, 2);
+        check_sequence_encode(sequence, second, 2);
+
+        fail_unless(arakoon_sequence_reset(sequence) == ARAKOON_RC_SUCCESS,
+                NULL);
+        check_sequence_add(sequence, first, 3);
+        check_sequence_encode(sequence, first, 3);
+
+        arakoon_sequence_free(sequence);
+} END_TEST
+
+/* Read cache */
+#define CHECK_READ_CACHE_SHARDS (16)
+
+typedef struct {
+        char data[64];
+        size_t size;
+        unsigned int calls;
+} CheckReadCacheValue;
+
+static void * check_read_cache_alloc(const size_t size, void *data) {
+        CheckReadCacheValue *value = (CheckReadCacheValue *) data;
+
+        fail_unless(size <= sizeof(value->data), NULL);
+
+        value->size = size;
+        value->calls++;
+
+        return value->data;
+}
+
+static arakoon_rc check_read_cache_get(ArakoonReadCache *cache,
+    const char * const key, uint64_t *ticket, CheckReadCacheValue *value) {
+        memset(value, 0, sizeof(CheckReadCacheValue));
+
+        return _arakoon_read_cache_get(cache, strlen(key), key, ticket,
+                check_read_cache_alloc, value);
+}
+
+static void check_read_cache_hit(ArakoonReadCache *cache,
+    const char * const key, const char * const expected) {
+        CheckReadCacheValue value;
+        uint64_t ticket = 0;
+
+        fail_unless(check_read_cache_get(cache, key, &ticket, &value) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value.calls == 1, NULL);
+        fail_unless(value.size == strlen(expected), NULL);
+        fail_unless(memcmp(value.data, expected, value.size) == 0, NULL);
+}
+
+static uint64_t check_read_cache_miss(ArakoonReadCache *cache,
+    const char * const key) {
+        CheckReadCacheValue value;
+        uint64_t ticket = SENTINEL;
+
+        fail_unless(check_read_cache_get(cache, key, &ticket, &value) ==
+                -ENOENT, NULL);
+        fail_unless(value.calls == 0, NULL);
+        fail_if(ticket == SENTINEL, NULL);
+
+        return ticket;
+}
+
+static void check_read_cache_fill(ArakoonReadCache *cache, uint64_t ticket,
+    const char * const key, const char * const value) {
+        _arakoon_read_cache_fill(cache, ticket, strlen(key), key,
+                value == NULL ? 0 : strlen(value), value);
+}
+
+/* A read which missed must not store its result once a write happened
+ * between the miss and the fill */
+START_TEST(test_arakoon_read_cache_ticket) {
+        ArakoonReadCache *cache = NULL;
+        uint64_t ticket = 0, stale = 0;
+
+        cache = _arakoon_read_cache_new(64 * 1024, 0);
+        fail_if(cache == NULL, NULL);
+
+        stale = check_read_cache_miss(cache, "key");
+        _arakoon_read_cache_invalidate(cache, 3, "key");
+        check_read_cache_fill(cache, stale, "key", "old");
+        check_read_cache_miss(cache, "key");
+
+        stale = check_read_cache_miss(cache, "key");
+        ticket = _arakoon_read_cache_ticket(cache, 3, "key");
+        _arakoon_read_cache_update(cache, ticket, 3, "key", 3, "new");
+        check_read_cache_fill(cache, stale, "key", "old");
+        check_read_cache_hit(cache, "key", "new");
+
+        /* A write which raced with another one drops the entry */
+        ticket = _arakoon_read_cache_ticket(cache, 3, "key");
+        _arakoon_read_cache_invalidate(cache, 3, "key");
+        _arakoon_read_cache_update(cache, ticket, 3, "key", 5, "newer");
+        check_read_cache_miss(cache, "key");
+
+        stale = check_read_cache_miss(cache, "key");
+        _arakoon_read_cache_invalidate_prefix(cache, 0, NULL);
+        check_read_cache_fill(cache, stale, "key", "old");
+        ticket = check_read_cache_miss(cache, "key");
+
+        check_read_cache_fill(cache, ticket, "key", "value");
+        check_read_cache_hit(cache, "key", "value");
+
+        _arakoon_read_cache_free(cache);
+} END_TEST
+
+/* Keys of which the entries end up in the same shard */
+static void check_read_cache_same_shard(char keys[][16], size_t count) {
+        uint32_t shard = 0;
+        size_t found = 0;
+        unsigned int i = 0;
+        char key[16];
+
+        for(i = 0; found < count; i++) {
+                snprintf(key, sizeof(key), "key_%u", i);
+                if(i == 0) {
+                        shard = _arakoon_hash(strlen(key), key) >> 28;
+                }
+
+                if((_arakoon_hash(strlen(key), key) >> 28) == shard) {
+                        strcpy(keys[found++], key);
+                }
+        }
+}
+
+START_TEST(test_arakoon_read_cache_lru) {
+        ArakoonReadCache *cache = NULL;
+        ArakoonReadCacheStats stats;
+        char keys[4][16];
+        char value[1025];
+        uint64_t ticket = 0;
+        size_t i = 0;
+
+        memset(value, 'v', sizeof(value) - 1);
+        value[sizeof(value) - 1] = '\0';
+
+        /* Room for three of the values in every shard, not four */
+        cache = _arakoon_read_cache_new(
+                CHECK_READ_CACHE_SHARDS * (3 * sizeof(value) + 512), 0);
+        fail_if(cache == NULL, NULL);
+
+        check_read_cache_same_shard(keys, 4);
+
+        for(i = 0; i < 3; i++) {
+                ticket = check_read_cache_miss(cache, keys[i]);
+                check_read_cache_fill(cache, ticket, keys[i], value);
+        }
+
+        /* Make the first entry the most recently used one */
+        fail_unless(_arakoon_read_cache_get(cache, strlen(keys[0]), keys[0],
+                &ticket, NULL, NULL) == ARAKOON_RC_SUCCESS, NULL);
+
+        ticket = check_read_cache_miss(cache, keys[3]);
+        check_read_cache_fill(cache, ticket, keys[3], value);
+
+        _arakoon_read_cache_get_stats(cache, &stats);
+        fail_unless(stats.evictions == 1, NULL);
+        fail_unless(stats.entries == 3, NULL);
+
+        check_read_cache_miss(cache, keys[1]);
+        fail_unless(_arakoon_read_cache_get(cache, strlen(keys[0]), keys[0],
+                &ticket, NULL, NULL) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(_arakoon_read_cache_get(cache, strlen(keys[2]), keys[2],
+                &ticket, NULL, NULL) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(_arakoon_read_cache_get(cache, strlen(keys[3]), keys[3],
+                &ticket, NULL, NULL) == ARAKOON_RC_SUCCESS, NULL);
+
+        _arakoon_read_cache_free(cache);
+
+        /* Entries larger than the budget of a shard aren't stored */
+        cache = _arakoon_read_cache_new(
+                CHECK_READ_CACHE_SHARDS * sizeof(value) / 2, 0);
+        fail_if(cache == NULL, NULL);
+
+        ticket = check_read_cache_miss(cache, keys[0]);
+        check_read_cache_fill(cache, ticket, keys[0], value);
+        check_read_cache_miss(cache, keys[0]);
+
+        _arakoon_read_cache_get_stats(cache, &stats);
+        fail_unless(stats.entries == 0 && stats.bytes == 0, NULL);
+
+        _arakoon_read_cache_free(cache);
+} END_TEST
+
+START_TEST(test_arakoon_read_cache_ttl) {
+        ArakoonReadCache *cache = NULL;
+        ArakoonReadCacheStats stats;
+        uint64_t ticket = 0;
+
+        cache = _arakoon_read_cache_new(64 * 1024, 50);
+        fail_if(cache == NULL, NULL);
+
+        ticket = check_read_cache_miss(cache, "key");
+        check_read_cache_fill(cache, ticket, "key", "value");
+        ticket = check_read_cache_miss(cache, "absent");
+        check_read_cache_fill(cache, ticket, "absent", NULL);
+
+        check_read_cache_hit(cache, "key", "value");
+
+        usleep(100 * 1000);
+
+        check_read_cache_miss(cache, "key");
+        check_read_cache_miss(cache, "absent");
+
+        _arakoon_read_cache_get_stats(cache, &stats);
+        fail_unless(stats.expirations == 2, NULL);
+        fail_unless(stats.entries == 0, NULL);
+
+        _arakoon_read_cache_free(cache);
+
+        /* Without a TTL, entries never expire */
+        cache = _arakoon_read_cache_new(64 * 1024, 0);
+        fail_if(cache == NULL, NULL);
+
+        ticket = check_read_cache_miss(cache, "key");
+        check_read_cache_fill(cache, ticket, "key", "value");
+
+        usleep(100 * 1000);
+
+        check_read_cache_hit(cache, "key", "value");
+
+        _arakoon_read_cache_free(cache);
+} END_TEST
+
+/* 'exists' only fills the cache with the absence of keys: such entries
+ * answer without a value, and are replaced by the value of a later write */
+START_TEST(test_arakoon_read_cache_absent) {
+        ArakoonReadCache *cache = NULL;
+        ArakoonReadCacheStats stats;
+        CheckReadCacheValue value;
+        uint64_t ticket = 0;
+
+        cache = _arakoon_read_cache_new(64 * 1024, 0);
+        fail_if(cache == NULL, NULL);
+
+        ticket = check_read_cache_miss(cache, "key");
+        check_read_cache_fill(cache, ticket, "key", NULL);
+
+        fail_unless(check_read_cache_get(cache, "key", &ticket, &value) ==
+                ARAKOON_RC_NOT_FOUND, NULL);
+        fail_unless(value.calls == 0, NULL);
+        fail_unless(_arakoon_read_cache_get(cache, 3, "key", &ticket, NULL,
+                NULL) == ARAKOON_RC_NOT_FOUND, NULL);
+
+        _arakoon_read_cache_get_stats(cache, &stats);
+        fail_unless(stats.entries == 1, NULL);
+        fail_unless(stats.hits == 2 && stats.misses == 1, NULL);
+
+        /* Only the key is kept, even if a value size is passed */
+        _arakoon_read_cache_fill(cache, ticket, 3, "key", 5, NULL);
+        _arakoon_read_cache_get_stats(cache, &stats);
+        fail_unless(stats.entries == 1, NULL);
+        fail_unless(_arakoon_read_cache_get(cache, 3, "key", &ticket, NULL,
+                NULL) == ARAKOON_RC_NOT_FOUND, NULL);
+
+        ticket = _arakoon_read_cache_ticket(cache, 3, "key");
+        _arakoon_read_cache_update(cache, ticket, 3, "key", 5, "value");
+        check_read_cache_hit(cache, "key", "value");
+        fail_unless(_arakoon_read_cache_get(cache, 3, "key", &ticket, NULL,
+                NULL) == ARAKOON_RC_SUCCESS, NULL);
+
+        ticket = _arakoon_read_cache_ticket(cache, 3, "key");
+        _arakoon_read_cache_update(cache, ticket, 3, "key", 0, NULL);
+        fail_unless(check_read_cache_get(cache, "key", &ticket, &value) ==
+                ARAKOON_RC_NOT_FOUND, NULL);
+        fail_unless(value.calls == 0, NULL);
+
+        _arakoon_read_cache_get_stats(cache, &stats);
+        fail_unless(stats.entries == 1, NULL);
+
+        _arakoon_read_cache_free(cache);
+} END_TEST
+
+/* Calls answered from the cache don't report the error of an earlier call */
+START_TEST(test_arakoon_read_cache_resets_last_error) {
+        ArakoonCluster *cluster = NULL;
+        ArakoonClientCallOptions *options = NULL;
+        ArakoonValueList *keys = NULL, *values = NULL;
+        arakoon_bool exists = ARAKOON_BOOL_FALSE;
+        size_t len = 0, value_size = 0;
+        const void *error = NULL;
+        void *value = NULL;
+        char *message = NULL;
+
+        cluster = arakoon_cluster_new(ARAKOON_PROTOCOL_VERSION_1, "check");
+        fail_if(cluster == NULL, NULL);
+        fail_unless(arakoon_cluster_set_read_cache(cluster, 64 * 1024, 0) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        options = arakoon_client_call_options_new();
+        fail_if(options == NULL, NULL);
+        fail_unless(arakoon_client_call_options_set_allow_dirty(options,
+                ARAKOON_BOOL_TRUE) == ARAKOON_RC_SUCCESS, NULL);
+
+        _arakoon_read_cache_fill(_arakoon_cluster_get_read_cache(cluster),
+                0, 3, "key", 5, "value");
+
+        keys = arakoon_value_list_new();
+        fail_if(keys == NULL, NULL);
+        fail_unless(arakoon_value_list_add(keys, 3, "key") ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+#define CHECK_LAST_ERROR_RESET(call)                                        \
+        STMT_START                                                          \
+        message = arakoon_mem_new(5, char);                                 \
+        fail_if(message == NULL, NULL);                                     \
+        memcpy(message, "stale", 5);                                        \
+        _arakoon_cluster_set_last_error(cluster, 5, message);               \
+        fail_unless((call) == ARAKOON_RC_SUCCESS, NULL);                    \
+        fail_unless(arakoon_cluster_get_last_error(cluster, &len, &error) == \
+                ARAKOON_RC_SUCCESS, NULL);                                  \
+        fail_unless(len == 0 && error == NULL, NULL);                       \
+        STMT_END
+
+        CHECK_LAST_ERROR_RESET(arakoon_get(cluster, options, 3, "key",
+                &value_size, &value));
+        fail_unless(value_size == 5 && memcmp(value, "value", 5) == 0, NULL);
+        arakoon_mem_free(value);
+
+        CHECK_LAST_ERROR_RESET(arakoon_exists(cluster, options, 3, "key",
+                &exists));
+        fail_unless(exists == ARAKOON_BOOL_TRUE, NULL);
+
+        CHECK_LAST_ERROR_RESET(arakoon_multi_get(cluster, options, keys,
+                &values));
+        fail_unless(arakoon_value_list_size(values) == 1, NULL);
+        arakoon_value_list_free(values);
+
+        CHECK_LAST_ERROR_RESET(arakoon_multi_get_option(cluster, options,
+                keys, &values));
+        fail_unless(arakoon_value_list_size(values) == 1, NULL);
+        arakoon_value_list_free(values);
+
+#undef CHECK_LAST_ERROR_RESET
+
+        arakoon_value_list_free(keys);
+        arakoon_client_call_options_free(options);
+        arakoon_cluster_free(cluster);
+} END_TEST
+
+/* Confirmations can't be decided on cached values, since the write is
+ * skipped when the value read matches */
+START_TEST(test_arakoon_multi_confirm_skips_cache) {
+        CheckServer *server = NULL;
+        CheckServerRequest requests[4];
+        ArakoonCluster *cluster = NULL;
+        ArakoonClientCallOptions *options = NULL;
+        ArakoonValueList *keys = NULL, *values = NULL;
+        char value[16];
+
+        server = check_server_new("check_0");
+        check_server_put(server, "key", "old");
+
+        cluster = check_server_cluster_new(&server, 1);
+        fail_unless(arakoon_cluster_set_read_cache(cluster, 64 * 1024, 0) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_cluster_connect_master(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        _arakoon_read_cache_fill(_arakoon_cluster_get_read_cache(cluster),
+                0, 3, "key", 3, "new");
+
+        options = arakoon_client_call_options_new();
+        fail_if(options == NULL, NULL);
+        fail_unless(arakoon_client_call_options_set_allow_dirty(options,
+                ARAKOON_BOOL_TRUE) == ARAKOON_RC_SUCCESS, NULL);
+
+        keys = arakoon_value_list_new();
+        values = arakoon_value_list_new();
+        fail_if(keys == NULL || values == NULL, NULL);
+        fail_unless(arakoon_value_list_add(keys, 3, "key") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_value_list_add(values, 3, "new") ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        check_server_clear_requests(server);
+
+        fail_unless(arakoon_multi_confirm(cluster, options, keys, values) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        fail_unless(check_server_get(server, "key", value, sizeof(value)),
+                NULL);
+        fail_unless(strcmp(value, "new") == 0, NULL);
+
+        /* A consistent read, followed by the write */
+        fail_unless(check_server_get_requests(server, requests, 4) == 2,
+                NULL);
+        fail_unless(requests[0].command == 0x31, NULL);
+        fail_unless(requests[0].dirty == ARAKOON_BOOL_FALSE, NULL);
+        fail_unless(requests[1].command == 0x10, NULL);
+
+        /* The options of the caller are left alone */
+        fail_unless(arakoon_client_call_options_get_allow_dirty(options) ==
+                ARAKOON_BOOL_TRUE, NULL);
+
+        arakoon_value_list_free(values);
+        arakoon_value_list_free(keys);
+        arakoon_client_call_options_free(options);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* Nursery routing */
+static void check_routing_put_cluster(CheckBuffer *buffer,
+    const char * const name, const uint32_t port) {
+        char node[16];
+
+        snprintf(node, sizeof(node), "%s_0", name);
+
+        check_buffer_put_string(buffer, name);
+        check_buffer_put_uint32(buffer, 1);
+        check_buffer_put_string(buffer, node);
+        check_buffer_put_string(buffer, "127.0.0.1");
+        check_buffer_put_uint32(buffer, port);
+}
+
+static void check_routing_lookup(const ArakoonNurseryRouting * const routing,
+    const char * const key, const char * const expected) {
+        const ArakoonCluster *cluster = NULL;
+
+        cluster = _arakoon_nursery_routing_lookup(routing, strlen(key), key);
+        fail_if(cluster == NULL, NULL);
+        fail_unless(strcmp(arakoon_cluster_get_name(cluster), expected) == 0,
+                NULL);
+}
+
+/* Keys below the boundary go left, others go right. A key which is a
+ * prefix of the boundary sorts before it. */
+START_TEST(test_arakoon_nursery_routing_lookup) {
+        CheckBuffer buffer;
+        ArakoonNurseryRouting *routing = NULL;
+        const char is_leaf = ARAKOON_BOOL_TRUE;
+        const char is_internal = ARAKOON_BOOL_FALSE;
+
+        memset(&buffer, 0, sizeof(buffer));
+
+        check_buffer_put(&buffer, &is_internal, 1);
+        check_buffer_put_string(&buffer, "mm");
+        check_buffer_put(&buffer, &is_leaf, 1);
+        check_buffer_put_string(&buffer, "left");
+        check_buffer_put(&buffer, &is_leaf, 1);
+        check_buffer_put_string(&buffer, "right");
+
+        check_buffer_put_uint32(&buffer, 2);
+        check_routing_put_cluster(&buffer, "left", 4000);
+        check_routing_put_cluster(&buffer, "right", 4001);
+
+        fail_unless(_arakoon_nursery_routing_parse(ARAKOON_PROTOCOL_VERSION_1,
+                NULL, buffer.size, buffer.data, &routing) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_if(routing == NULL, NULL);
+
+        /* Shorter than the boundary */
+        check_routing_lookup(routing, "", "left");
+        check_routing_lookup(routing, "a", "left");
+        check_routing_lookup(routing, "m", "left");
+        check_routing_lookup(routing, "z", "right");
+
+        /* As long as the boundary */
+        check_routing_lookup(routing, "ml", "left");
+        check_routing_lookup(routing, "mm", "right");
+        check_routing_lookup(routing, "mn", "right");
+
+        /* Extending the boundary */
+        check_routing_lookup(routing, "mlzzz", "left");
+        check_routing_lookup(routing, "mmzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz",
+                "right");
+        check_routing_lookup(routing, "naaa", "right");
+
+        _arakoon_nursery_routing_free(routing);
+} END_TEST
+
+/* A single write submitted to a batcher from a thread of its own */
+typedef struct {
+        ArakoonWriteBatcher *batcher;
+        const char *key;
+        /* NULL for a delete */
+        const char *value;
+        pthread_t thread;
+        arakoon_rc rc;
+} CheckBatcherWrite;
+
+static void * check_batcher_write(void *data) {
+        CheckBatcherWrite *write = (CheckBatcherWrite *) data;
+
+        if(write->value == NULL) {
+                write->rc = arakoon_write_batcher_delete(write->batcher,
+                        strlen(write->key), write->key);
+        }
+        else {
+                write->rc = arakoon_write_batcher_set(write->batcher,
+                        strlen(write->key), write->key,
+                        strlen(write->value), write->value);
+        }
+
+        return NULL;
+}
+
+/* Submit all writes, in order and a few ms apart, and wait for them */
+static void check_batcher_run(ArakoonWriteBatcher *batcher,
+    CheckBatcherWrite * const writes, const size_t count) {
+        size_t i = 0;
+
+        for(i = 0; i < count; i++) {
+                writes[i].batcher = batcher;
+                writes[i].rc = ARAKOON_RC_UNKNOWN_FAILURE;
+                fail_unless(pthread_create(&writes[i].thread, NULL,
+                        check_batcher_write, &writes[i]) == 0, NULL);
+                usleep(10 * US_PER_MS);
+        }
+
+        for(i = 0; i < count; i++) {
+                pthread_join(writes[i].thread, NULL);
+        }
+}
+
+static ArakoonWriteBatcher * check_batcher_new(CheckServer *server,
+    ArakoonCluster **cluster, const size_t max_bytes) {
+        ArakoonWriteBatcher *batcher = NULL;
+
+        *cluster = check_server_cluster_new(&server, 1);
+
+        /* Long enough for all writes of a test to join a single batch */
+        batcher = arakoon_write_batcher_new(*cluster, NULL,
+                500 * US_PER_MS, max_bytes);
+        fail_if(batcher == NULL, NULL);
+
+        return batcher;
+}
+
+static void check_server_value(CheckServer *server, const char *key,
+    const char *expected) {
+        char value[16];
+
+        if(expected == NULL) {
+                fail_if(check_server_get(server, key, value, sizeof(value)),
+                        NULL);
+        }
+        else {
+                fail_unless(check_server_get(server, key, value,
+                        sizeof(value)), NULL);
+                fail_unless(strcmp(value, expected) == 0, NULL);
+        }
+}
+
+START_TEST(test_arakoon_write_batcher_order) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonWriteBatcher *batcher = NULL;
+        CheckBatcherWrite writes[4] = {
+                { NULL, "a", "1", 0, 0 },
+                { NULL, "b", NULL, 0, 0 },
+                { NULL, "a", "2", 0, 0 },
+                { NULL, "b", "3", 0, 0 }
+        };
+        CheckServerRequest requests[4];
+        size_t i = 0;
+
+        server = check_server_new("check_0");
+        check_server_put(server, "b", "0");
+        batcher = check_batcher_new(server, &cluster, 4096);
+
+        check_batcher_run(batcher, writes, 4);
+
+        for(i = 0; i < 4; i++) {
+                fail_unless(writes[i].rc == ARAKOON_RC_SUCCESS, NULL);
+        }
+
+        /* A single sequence, applied in submission order */
+        fail_unless(check_server_get_requests(server, requests, 4) == 2,
+                NULL);
+        fail_unless(requests[0].command == 0x02, NULL);
+        fail_unless(requests[1].command == 0x10, NULL);
+        fail_unless(requests[1].count == 4, NULL);
+        fail_unless(strcmp(requests[1].first, "a") == 0, NULL);
+
+        check_server_value(server, "a", "2");
+        check_server_value(server, "b", "3");
+
+        arakoon_write_batcher_free(batcher);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* A batch of a single write is sent as a plain set or delete */
+START_TEST(test_arakoon_write_batcher_single) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonWriteBatcher *batcher = NULL;
+        CheckServerRequest requests[4];
+
+        server = check_server_new("check_0");
+        check_server_put(server, "b", "0");
+        batcher = check_batcher_new(server, &cluster, 4096);
+
+        fail_unless(arakoon_write_batcher_set(batcher, 1, "a", 1, "1") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_write_batcher_delete(batcher, 1, "b") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_write_batcher_delete(batcher, 1, "c") ==
+                ARAKOON_RC_NOT_FOUND, NULL);
+
+        fail_unless(check_server_get_requests(server, requests, 4) == 4,
+                NULL);
+        fail_unless(requests[1].command == 0x09, NULL);
+        fail_unless(requests[2].command == 0x0a, NULL);
+        fail_unless(requests[3].command == 0x0a, NULL);
+
+        check_server_value(server, "a", "1");
+        check_server_value(server, "b", NULL);
+
+        arakoon_write_batcher_free(batcher);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_write_batcher_max_bytes) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonWriteBatcher *batcher = NULL;
+        CheckBatcherWrite writes[3] = {
+                { NULL, "a", "1", 0, 0 },
+                { NULL, "b", "2", 0, 0 },
+                { NULL, "c", "3", 0, 0 }
+        };
+        CheckServerRequest requests[4];
+        uint64_t start = 0;
+        size_t i = 0;
+
+        server = check_server_new("check_0");
+
+        /* Two writes of a single byte key and value, with some overhead */
+        batcher = check_batcher_new(server, &cluster, 2 * (2 + 16));
+
+        start = _arakoon_networking_monotonic_usec();
+        check_batcher_run(batcher, writes, 2);
+        /* A full batch doesn't wait for the delay */
+        fail_unless(_arakoon_networking_monotonic_usec() - start <
+                400 * US_PER_MS, NULL);
+
+        for(i = 0; i < 2; i++) {
+                fail_unless(writes[i].rc == ARAKOON_RC_SUCCESS, NULL);
+        }
+
+        /* Whatever doesn't fit is left for the next batch */
+        check_server_clear_requests(server);
+        check_batcher_run(batcher, writes, 3);
+
+        for(i = 0; i < 3; i++) {
+                fail_unless(writes[i].rc == ARAKOON_RC_SUCCESS, NULL);
+        }
+
+        fail_unless(check_server_get_requests(server, requests, 4) == 2,
+                NULL);
+        fail_unless(requests[0].command == 0x10, NULL);
+        fail_unless(requests[0].count == 2, NULL);
+        fail_unless(requests[1].command == 0x09, NULL);
+        fail_unless(strcmp(requests[1].first, "c") == 0, NULL);
+
+        check_server_value(server, "c", "3");
+
+        arakoon_write_batcher_free(batcher);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* A failing write is isolated, all others are applied */
+START_TEST(test_arakoon_write_batcher_split) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonWriteBatcher *batcher = NULL;
+        CheckBatcherWrite writes[4] = {
+                { NULL, "a", "1", 0, 0 },
+                { NULL, "x", NULL, 0, 0 },
+                { NULL, "b", "2", 0, 0 },
+                { NULL, "c", "3", 0, 0 }
+        };
+        CheckServerRequest requests[8];
+
+        server = check_server_new("check_0");
+        batcher = check_batcher_new(server, &cluster, 4096);
+
+        check_batcher_run(batcher, writes, 4);
+
+        fail_unless(writes[0].rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(writes[1].rc == ARAKOON_RC_NOT_FOUND, NULL);
+        fail_unless(writes[2].rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(writes[3].rc == ARAKOON_RC_SUCCESS, NULL);
+
+        check_server_value(server, "a", "1");
+        check_server_value(server, "b", "2");
+        check_server_value(server, "c", "3");
+
+        /* Halves are sent in order, until the delete is on its own */
+        fail_unless(check_server_get_requests(server, requests, 8) == 6,
+                NULL);
+        fail_unless(requests[1].command == 0x10 && requests[1].count == 4,
+                NULL);
+        fail_unless(requests[2].command == 0x10 && requests[2].count == 2,
+                NULL);
+        fail_unless(requests[3].command == 0x09, NULL);
+        fail_unless(requests[4].command == 0x0a, NULL);
+        fail_unless(requests[5].command == 0x10 && requests[5].count == 2,
+                NULL);
+        fail_unless(strcmp(requests[5].first, "b") == 0, NULL);
+
+        /* Same for a failed assertion */
+        check_server_clear_requests(server);
+        check_server_fail(server, 0x10, ARAKOON_RC_ASSERTION_FAILED, 1);
+        check_batcher_run(batcher, &writes[2], 2);
+
+        fail_unless(writes[2].rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(writes[3].rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(check_server_count_requests(server, 0x09) == 2, NULL);
+
+        /* Other failures apply to the batch as a whole */
+        check_server_clear_requests(server);
+        check_server_fail(server, 0x10, ARAKOON_RC_UNKNOWN_FAILURE, 1);
+        check_batcher_run(batcher, &writes[2], 2);
+
+        fail_unless(writes[2].rc == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(writes[3].rc == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(check_server_count_requests(server, 0x10) == 1, NULL);
+        fail_unless(check_server_count_requests(server, 0x09) == 0, NULL);
+
+        arakoon_write_batcher_free(batcher);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* A single 'get' on a coalescing cluster, from a thread of its own */
+typedef struct {
+        ArakoonCluster *cluster;
+        char key[16];
+        arakoon_bool allow_dirty;
+        pthread_t thread;
+        arakoon_rc rc;
+        size_t value_size;
+        void *value;
+} CheckCoalescedGet;
+
+static void * check_coalesced_get(void *data) {
+        CheckCoalescedGet *get = (CheckCoalescedGet *) data;
+        ArakoonClientCallOptions *options = NULL;
+
+        /* Only calls with the same options are coalesced */
+        options = arakoon_client_call_options_new();
+        fail_if(options == NULL, NULL);
+        fail_unless(arakoon_client_call_options_set_timeout(options, 5000) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_client_call_options_set_allow_dirty(options,
+                get->allow_dirty) == ARAKOON_RC_SUCCESS, NULL);
+
+        get->rc = arakoon_get(get->cluster, options, strlen(get->key),
+                get->key, &get->value_size, &get->value);
+
+        arakoon_client_call_options_free(options);
+
+        return NULL;
+}
+
+static void check_coalesced_get_start(CheckCoalescedGet * const get,
+    ArakoonCluster *cluster, const char * const key,
+    const arakoon_bool allow_dirty) {
+        memset(get, 0, sizeof(CheckCoalescedGet));
+        get->cluster = cluster;
+        strncpy(get->key, key, sizeof(get->key) - 1);
+        get->allow_dirty = allow_dirty;
+        get->rc = ARAKOON_RC_UNKNOWN_FAILURE;
+
+        fail_unless(pthread_create(&get->thread, NULL, check_coalesced_get,
+                get) == 0, NULL);
+}
+
+static ArakoonCluster * check_coalescing_cluster_new(CheckServer *server,
+    const unsigned int window_usec) {
+        ArakoonCluster *cluster = NULL;
+
+        cluster = check_server_cluster_new(&server, 1);
+        fail_unless(arakoon_cluster_set_multiplexed(cluster,
+                ARAKOON_BOOL_TRUE) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_cluster_set_read_coalescing(cluster,
+                ARAKOON_BOOL_TRUE, window_usec) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_cluster_connect_master(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        return cluster;
+}
+
+/* Callers asking for the same key share a fetch, but own their value */
+START_TEST(test_arakoon_read_coalescer_followers) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        CheckCoalescedGet gets[3];
+        CheckServerRequest request;
+        size_t i = 0;
+
+        server = check_server_new("check_0");
+        check_server_put(server, "key", "value");
+        cluster = check_coalescing_cluster_new(server, 200 * US_PER_MS);
+        check_server_clear_requests(server);
+
+        for(i = 0; i < 3; i++) {
+                check_coalesced_get_start(&gets[i], cluster, "key",
+                        ARAKOON_BOOL_FALSE);
+        }
+        for(i = 0; i < 3; i++) {
+                pthread_join(gets[i].thread, NULL);
+                fail_unless(gets[i].rc == ARAKOON_RC_SUCCESS, NULL);
+                fail_unless(gets[i].value_size == 5 &&
+                        memcmp(gets[i].value, "value", 5) == 0, NULL);
+        }
+
+        fail_unless(gets[0].value != gets[1].value &&
+                gets[0].value != gets[2].value &&
+                gets[1].value != gets[2].value, NULL);
+
+        fail_unless(check_server_get_requests(server, &request, 1) == 1,
+                NULL);
+        fail_unless(request.command == 0x31 && request.count == 1, NULL);
+
+        for(i = 0; i < 3; i++) {
+                arakoon_mem_free(gets[i].value);
+        }
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* A fetch in flight may have been sent before a write which completed
+ * already, so only dirty reads wait for it */
+START_TEST(test_arakoon_read_coalescer_in_flight) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        CheckCoalescedGet gets[2];
+        arakoon_bool dirty = ARAKOON_BOOL_FALSE;
+        size_t i = 0;
+
+        server = check_server_new("check_0");
+        check_server_put(server, "key", "value");
+        cluster = check_coalescing_cluster_new(server, 1 * US_PER_MS);
+        check_server_set_delay(server, 200 * US_PER_MS);
+
+        for(dirty = ARAKOON_BOOL_FALSE; dirty <= ARAKOON_BOOL_TRUE; dirty++) {
+                check_server_clear_requests(server);
+
+                check_coalesced_get_start(&gets[0], cluster, "key", dirty);
+                usleep(50 * US_PER_MS);
+                check_coalesced_get_start(&gets[1], cluster, "key", dirty);
+
+                for(i = 0; i < 2; i++) {
+                        pthread_join(gets[i].thread, NULL);
+                        fail_unless(gets[i].rc == ARAKOON_RC_SUCCESS, NULL);
+                        arakoon_mem_free(gets[i].value);
+                }
+
+                fail_unless(check_server_count_requests(server, 0x31) ==
+                        (dirty ? 1 : 2), NULL);
+        }
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* A batch is sent as soon as it's full, without waiting for the window */
+START_TEST(test_arakoon_read_coalescer_max_keys) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        CheckCoalescedGet *gets = NULL;
+        CheckServerRequest request;
+        char key[16];
+        uint64_t start = 0;
+        size_t i = 0;
+
+        gets = calloc(256, sizeof(CheckCoalescedGet));
+        fail_if(gets == NULL, NULL);
+
+        server = check_server_new("check_0");
+        cluster = check_coalescing_cluster_new(server, 5000 * US_PER_MS);
+        check_server_clear_requests(server);
+
+        start = _arakoon_networking_monotonic_usec();
+
+        for(i = 0; i < 256; i++) {
+                snprintf(key, sizeof(key), "key_%zu", i);
+                check_coalesced_get_start(&gets[i], cluster, key,
+                        ARAKOON_BOOL_FALSE);
+        }
+        for(i = 0; i < 256; i++) {
+                pthread_join(gets[i].thread, NULL);
+                fail_unless(gets[i].rc == ARAKOON_RC_NOT_FOUND, NULL);
+        }
+
+        fail_unless(_arakoon_networking_monotonic_usec() - start <
+                2500 * US_PER_MS, NULL);
+
+        fail_unless(check_server_get_requests(server, &request, 1) == 1,
+                NULL);
+        fail_unless(request.command == 0x31 && request.count == 256, NULL);
+
+        free(gets);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_read_coalescer_error) {
+        static const char * const keys[4] = { "a", "b", "a", "c" };
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        CheckCoalescedGet gets[4];
+        size_t i = 0;
+
+        server = check_server_new("check_0");
+        check_server_put(server, "a", "1");
+        cluster = check_coalescing_cluster_new(server, 200 * US_PER_MS);
+        check_server_clear_requests(server);
+
+        check_server_fail(server, 0x31, ARAKOON_RC_UNKNOWN_FAILURE, 1);
+
+        for(i = 0; i < 4; i++) {
+                check_coalesced_get_start(&gets[i], cluster, keys[i],
+                        ARAKOON_BOOL_FALSE);
+        }
+        for(i = 0; i < 4; i++) {
+                pthread_join(gets[i].thread, NULL);
+                fail_unless(gets[i].rc == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+                fail_unless(gets[i].value == NULL, NULL);
+        }
+
+        fail_unless(check_server_count_requests(server, 0x31) == 1, NULL);
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* Entries of 10 KiB make the cursor pick pages of 102 entries after its
+ * first page of 256, so 460 entries fill exactly 3 pages */
+#define CHECK_CURSOR_ENTRIES (256 + 2 * 102)
+#define CHECK_CURSOR_VALUE_SIZE (10 * 1024)
+
+static CheckServer * check_cursor_server_new(void) {
+        CheckServer *server = NULL;
+        char key[16], *value = NULL;
+        size_t i = 0;
+
+        value = malloc(CHECK_CURSOR_VALUE_SIZE + 1);
+        fail_if(value == NULL, NULL);
+        memset(value, 'v', CHECK_CURSOR_VALUE_SIZE);
+        value[CHECK_CURSOR_VALUE_SIZE] = 0;
+
+        server = check_server_new("check_0");
+
+        for(i = 0; i < CHECK_CURSOR_ENTRIES; i++) {
+                snprintf(key, sizeof(key), "key_%04zu", i);
+                check_server_put(server, key, value);
+        }
+
+        /* Around the prefix of all keys above */
+        check_server_put(server, "kex", "x");
+        check_server_put(server, "key", "x");
+        check_server_put(server, "key`", "x");
+        check_server_put(server, "kez", "x");
+
+        free(value);
+
+        return server;
+}
+
+/* Walk the whole cursor, expecting all keys of check_cursor_server_new */
+static void check_cursor_walk(ArakoonRangeCursor *cursor,
+    const arakoon_bool reverse) {
+        size_t key_size = 0, value_size = 0, i = 0;
+        const void *key = NULL, *value = NULL;
+        char expected[16];
+
+        for(i = 0; i < CHECK_CURSOR_ENTRIES; i++) {
+                snprintf(expected, sizeof(expected), "key_%04zu",
+                        reverse ? CHECK_CURSOR_ENTRIES - 1 - i : i);
+
+                fail_unless(arakoon_range_cursor_next(cursor, &key_size, &key,
+                        &value_size, &value) == ARAKOON_RC_SUCCESS, NULL);
+                fail_unless(key_size == strlen(expected) &&
+                        memcmp(key, expected, key_size) == 0, NULL);
+                fail_unless(value_size == CHECK_CURSOR_VALUE_SIZE, NULL);
+        }
+
+        /* The end of the range is reported again on every call */
+        for(i = 0; i < 2; i++) {
+                fail_unless(arakoon_range_cursor_next(cursor, &key_size, &key,
+                        &value_size, &value) == ARAKOON_RC_SUCCESS, NULL);
+                fail_unless(key == NULL && value == NULL, NULL);
+        }
+}
+
+/* Check the page requests of a walk by check_cursor_walk */
+static void check_cursor_pages(CheckServer *server, const uint32_t command,
+    const arakoon_bool reverse) {
+        static const int32_t sizes[4] = { 256, 102, 102, 102 };
+        static const size_t ends[3] = { 255, 357, 459 };
+        CheckServerRequest requests[8];
+        char expected[16];
+        size_t i = 0;
+
+        /* The last page came back full, so one more is asked for */
+        fail_unless(check_server_get_requests(server, requests, 8) == 5,
+                NULL);
+        fail_unless(requests[0].command == 0x02, NULL);
+
+        for(i = 0; i < 4; i++) {
+                fail_unless(requests[i + 1].command == command, NULL);
+                fail_unless(requests[i + 1].max == sizes[i], NULL);
+
+                if(i == 0) {
+                        continue;
+                }
+
+                /* Every page continues right after the last key of the
+                 * one before */
+                snprintf(expected, sizeof(expected), "key_%04zu",
+                        reverse ? CHECK_CURSOR_ENTRIES - 1 - ends[i - 1] :
+                        ends[i - 1]);
+                fail_unless(requests[i + 1].first_set, NULL);
+                fail_unless(strcmp(requests[i + 1].first, expected) == 0,
+                        NULL);
+                fail_unless(!requests[i + 1].first_included, NULL);
+        }
+}
+
+START_TEST(test_arakoon_range_cursor_pages) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonRangeCursor *cursor = NULL;
+        arakoon_bool reverse = ARAKOON_BOOL_FALSE;
+
+        server = check_cursor_server_new();
+        cluster = check_server_cluster_new(&server, 1);
+
+        for(reverse = ARAKOON_BOOL_FALSE; reverse <= ARAKOON_BOOL_TRUE;
+            reverse++) {
+                check_server_clear_requests(server);
+
+                /* Between "key" and "key`", both excluded */
+                cursor = arakoon_range_cursor_new(cluster, NULL,
+                        reverse ? 4 : 3, reverse ? "key`" : "key",
+                        ARAKOON_BOOL_FALSE,
+                        reverse ? 3 : 4, reverse ? "key" : "key`",
+                        ARAKOON_BOOL_FALSE, reverse);
+                fail_if(cursor == NULL, NULL);
+
+                check_cursor_walk(cursor, reverse);
+                arakoon_range_cursor_free(cursor);
+
+                check_cursor_pages(server, reverse ? 0x23 : 0x0f, reverse);
+        }
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_range_cursor_prefix) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonRangeCursor *cursor = NULL;
+        CheckServerRequest requests[2];
+        arakoon_bool reverse = ARAKOON_BOOL_FALSE;
+
+        server = check_cursor_server_new();
+        cluster = check_server_cluster_new(&server, 1);
+
+        for(reverse = ARAKOON_BOOL_FALSE; reverse <= ARAKOON_BOOL_TRUE;
+            reverse++) {
+                check_server_clear_requests(server);
+
+                cursor = arakoon_range_cursor_new_prefix(cluster, NULL, 4,
+                        "key_", reverse);
+                fail_if(cursor == NULL, NULL);
+
+                check_cursor_walk(cursor, reverse);
+                arakoon_range_cursor_free(cursor);
+
+                check_cursor_pages(server, reverse ? 0x23 : 0x0f, reverse);
+
+                /* The prefix is included, the first key past it isn't */
+                fail_unless(check_server_get_requests(server, requests, 2) ==
+                        5, NULL);
+                fail_unless(strcmp(requests[1].first,
+                        reverse ? "key`" : "key_") == 0, NULL);
+                fail_unless(requests[1].first_included == !reverse, NULL);
+                fail_unless(requests[1].last_set, NULL);
+                fail_unless(strcmp(requests[1].last,
+                        reverse ? "key_" : "key`") == 0, NULL);
+                fail_unless(requests[1].last_included == reverse, NULL);
+        }
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_range_cursor_prefetch) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonRangeCursor *cursor = NULL;
+        size_t key_size = 0, value_size = 0, i = 0;
+        const void *key = NULL, *value = NULL;
+
+        server = check_cursor_server_new();
+        cluster = check_server_cluster_new(&server, 1);
+
+        cursor = arakoon_range_cursor_new_prefix(cluster, NULL, 4, "key_",
+                ARAKOON_BOOL_FALSE);
+        fail_if(cursor == NULL, NULL);
+
+        /* The first page is asked for before the first entry is */
+        for(i = 0; i < 200 && check_server_count_requests(server, 0x0f) == 0;
+            i++) {
+                usleep(10 * US_PER_MS);
+        }
+        fail_unless(check_server_count_requests(server, 0x0f) == 1, NULL);
+
+        /* Taking the first page lets the next one be fetched, but only a
+         * single page ahead */
+        fail_unless(arakoon_range_cursor_next(cursor, &key_size, &key,
+                &value_size, &value) == ARAKOON_RC_SUCCESS, NULL);
+        for(i = 0; i < 200 && check_server_count_requests(server, 0x0f) < 2;
+            i++) {
+                usleep(10 * US_PER_MS);
+        }
+        usleep(50 * US_PER_MS);
+        fail_unless(check_server_count_requests(server, 0x0f) == 2, NULL);
+
+        /* Releasing the cursor waits for a page being fetched, and stops the
+         * prefetching after it */
+        check_server_set_delay(server, 100 * US_PER_MS);
+        for(i = 1; i <= 256; i++) {
+                fail_unless(arakoon_range_cursor_next(cursor, &key_size, &key,
+                        &value_size, &value) == ARAKOON_RC_SUCCESS, NULL);
+        }
+        usleep(20 * US_PER_MS);
+        arakoon_range_cursor_free(cursor);
+        fail_unless(check_server_count_requests(server, 0x0f) == 3, NULL);
+
+        usleep(200 * US_PER_MS);
+        fail_unless(check_server_count_requests(server, 0x0f) == 3, NULL);
+
+        /* A failing page is reported after the entries before it */
+        check_server_set_delay(server, 0);
+        check_server_fail(server, 0x0f, ARAKOON_RC_UNKNOWN_FAILURE, 1);
+        cursor = arakoon_range_cursor_new_prefix(cluster, NULL, 4, "key_",
+                ARAKOON_BOOL_FALSE);
+        fail_if(cursor == NULL, NULL);
+        fail_unless(arakoon_range_cursor_next(cursor, &key_size, &key,
+                &value_size, &value) == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        fail_unless(arakoon_range_cursor_next(cursor, &key_size, &key,
+                &value_size, &value) == ARAKOON_RC_UNKNOWN_FAILURE, NULL);
+        arakoon_range_cursor_free(cursor);
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+static ArakoonConnectionPoolStats check_pool_stats(
+    ArakoonConnectionPool *pool) {
+        ArakoonConnectionPoolStats stats;
+
+        fail_unless(arakoon_connection_pool_get_stats(pool, &stats) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        return stats;
+}
+
+START_TEST(test_arakoon_connection_pool_checkout) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonConnectionPool *pool = NULL;
+        ArakoonCluster *a = NULL, *b = NULL, *c = NULL;
+        ArakoonConnectionPoolStats stats;
+        char value[16];
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+
+        pool = arakoon_connection_pool_new(cluster, 2, -1);
+        fail_if(pool == NULL, NULL);
+
+        /* A checked out connection talks to the master */
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_set(a, NULL, 3, "key", 5, "value") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(check_server_get(server, "key", value, sizeof(value)),
+                NULL);
+        fail_unless(strcmp(value, "value") == 0, NULL);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.checkouts == 1 && stats.connects == 1, NULL);
+        fail_unless(stats.idle == 0 && stats.in_use == 1, NULL);
+
+        /* Once returned, it's handed out again */
+        arakoon_connection_pool_return(pool, a);
+        stats = check_pool_stats(pool);
+        fail_unless(stats.idle == 1 && stats.in_use == 0, NULL);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &b) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(b == a, NULL);
+
+        /* The most recently returned connection is reused first */
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &c) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(c != a, NULL);
+
+        arakoon_connection_pool_return(pool, a);
+        arakoon_connection_pool_return(pool, c);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &b) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(b == c, NULL);
+        arakoon_connection_pool_return(pool, b);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &b) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(b == c, NULL);
+        arakoon_connection_pool_return(pool, b);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.checkouts == 5 && stats.connects == 2, NULL);
+        fail_unless(stats.idle == 2 && stats.in_use == 0, NULL);
+        fail_unless(check_server_get_connections(server) == 2, NULL);
+
+        arakoon_connection_pool_free(pool);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_connection_pool_evict) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonConnectionPool *pool = NULL;
+        ArakoonCluster *a = NULL, *b = NULL;
+        ArakoonConnectionPoolStats stats;
+        arakoon_rc rc = 0;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+
+        pool = arakoon_connection_pool_new(cluster, 2, -1);
+        fail_if(pool == NULL, NULL);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &b) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        arakoon_connection_pool_return(pool, a);
+        arakoon_connection_pool_return(pool, b);
+
+        /* Idle connections closed by the server are no longer idle on our
+         * end, they're dropped on checkout */
+        check_server_drop_connections(server);
+        usleep(50 * US_PER_MS);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_set(a, NULL, 3, "key", 5, "value") ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.evictions == 2 && stats.connects == 3, NULL);
+        fail_unless(stats.idle == 0 && stats.in_use == 1, NULL);
+
+        /* A connection broken while checked out isn't put back */
+        check_server_drop_connections(server);
+        usleep(50 * US_PER_MS);
+
+        rc = arakoon_set(a, NULL, 3, "key", 5, "value");
+        fail_if(ARAKOON_RC_IS_SUCCESS(rc), NULL);
+        arakoon_connection_pool_return(pool, a);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.evictions == 3, NULL);
+        fail_unless(stats.idle == 0 && stats.in_use == 0, NULL);
+
+        /* The slot it took can be used again */
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &b) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        arakoon_connection_pool_return(pool, a);
+        arakoon_connection_pool_return(pool, b);
+
+        arakoon_connection_pool_free(pool);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+typedef struct {
+        ArakoonConnectionPool *pool;
+        ArakoonClientCallOptions *options;
+        ArakoonCluster *connection;
+        arakoon_rc rc;
+} CheckPoolCheckout;
+
+static void * check_pool_checkout(void *data) {
+        CheckPoolCheckout *checkout = (CheckPoolCheckout *) data;
+
+        checkout->rc = arakoon_connection_pool_checkout(checkout->pool,
+                checkout->options, &checkout->connection);
+
+        return NULL;
+}
+
+START_TEST(test_arakoon_connection_pool_wait) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonConnectionPool *pool = NULL;
+        ArakoonClientCallOptions *options = NULL;
+        ArakoonCluster *a = NULL, *b = NULL;
+        ArakoonConnectionPoolStats stats;
+        CheckPoolCheckout checkout;
+        pthread_t thread;
+        uint64_t start = 0;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+
+        pool = arakoon_connection_pool_new(cluster, 1, -1);
+        fail_if(pool == NULL, NULL);
+
+        options = arakoon_client_call_options_new();
+        fail_if(options == NULL, NULL);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        /* With every connection checked out, a checkout times out */
+        fail_unless(arakoon_client_call_options_set_timeout(options, 100) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        start = _arakoon_networking_monotonic_usec();
+        fail_unless(arakoon_connection_pool_checkout(pool, options, &b) ==
+                ARAKOON_RC_CLIENT_TIMEOUT, NULL);
+        fail_unless(b == NULL, NULL);
+        fail_unless(_arakoon_networking_monotonic_usec() - start >=
+                100 * US_PER_MS, NULL);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.timeouts == 1 && stats.checkouts == 1, NULL);
+
+        /* ... or gets the connection which is returned meanwhile */
+        fail_unless(arakoon_client_call_options_set_timeout(options, 5000) ==
+                ARAKOON_RC_SUCCESS, NULL);
+
+        memset(&checkout, 0, sizeof(CheckPoolCheckout));
+        checkout.pool = pool;
+        checkout.options = options;
+
+        fail_unless(pthread_create(&thread, NULL, check_pool_checkout,
+                &checkout) == 0, NULL);
+
+        usleep(100 * US_PER_MS);
+        stats = check_pool_stats(pool);
+        fail_unless(stats.checkouts == 1 && stats.in_use == 1, NULL);
+
+        arakoon_connection_pool_return(pool, a);
+        fail_unless(pthread_join(thread, NULL) == 0, NULL);
+
+        fail_unless(checkout.rc == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(checkout.connection == a, NULL);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.checkouts == 2 && stats.connects == 1, NULL);
+        fail_unless(stats.wait_max_usec > 0, NULL);
+
+        arakoon_connection_pool_return(pool, a);
+
+        arakoon_client_call_options_free(options);
+        arakoon_connection_pool_free(pool);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+START_TEST(test_arakoon_connection_pool_reap) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonConnectionPool *pool = NULL;
+        ArakoonCluster *a = NULL, *b = NULL;
+        ArakoonConnectionPoolStats stats;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+
+        pool = arakoon_connection_pool_new(cluster, 2, 100);
+        fail_if(pool == NULL, NULL);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &b) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        arakoon_connection_pool_return(pool, a);
+
+        /* Connections idle for less than the timeout are kept */
+        fail_unless(arakoon_connection_pool_reap(pool) == ARAKOON_RC_SUCCESS,
+                NULL);
+        stats = check_pool_stats(pool);
+        fail_unless(stats.idle == 1 && stats.reaped == 0, NULL);
+
+        usleep(150 * US_PER_MS);
+        arakoon_connection_pool_return(pool, b);
+
+        /* Only the oldest one expired */
+        fail_unless(arakoon_connection_pool_reap(pool) == ARAKOON_RC_SUCCESS,
+                NULL);
+        stats = check_pool_stats(pool);
+        fail_unless(stats.idle == 1 && stats.reaped == 1, NULL);
+
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(a == b, NULL);
+        arakoon_connection_pool_return(pool, a);
+
+        usleep(150 * US_PER_MS);
+        fail_unless(arakoon_connection_pool_reap(pool) == ARAKOON_RC_SUCCESS,
+                NULL);
+        stats = check_pool_stats(pool);
+        fail_unless(stats.idle == 0 && stats.reaped == 2, NULL);
+
+        /* An empty pool sets up a new connection */
+        fail_unless(arakoon_connection_pool_checkout(pool, NULL, &a) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        arakoon_connection_pool_return(pool, a);
+
+        stats = check_pool_stats(pool);
+        fail_unless(stats.connects == 3, NULL);
+        fail_unless(check_server_get_connections(server) == 3, NULL);
+
+        arakoon_connection_pool_free(pool);
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
+/* Runs in a forked child, so report through the exit status only */
+static int check_fork_child(ArakoonCluster *cluster) {
+        void *value = NULL;
+        size_t value_size = 0;
+        arakoon_rc rc = 0;
+
+        rc = arakoon_get(cluster, NULL, 3, "key", &value_size, &value);
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                return 1;
+        }
+
+        if(value_size != 5 || memcmp(value, "value", 5) != 0) {
+                return 2;
+        }
+        arakoon_mem_free(value);
+
+        rc = arakoon_set(cluster, NULL, 3, "key", 5, "child");
+        if(!ARAKOON_RC_IS_SUCCESS(rc)) {
+                return 3;
+        }
+
+        return 0;
+}
+
+START_TEST(test_arakoon_cluster_fork) {
+        CheckServer *server = NULL;
+        ArakoonCluster *cluster = NULL;
+        ArakoonClusterNode *master = NULL;
+        void *value = NULL;
+        size_t value_size = 0;
+        int fd = -1, status = 0;
+        pid_t pid = 0;
+
+        server = check_server_new("check_0");
+        cluster = check_server_cluster_new(&server, 1);
+
+        fail_unless(arakoon_cluster_connect_master(cluster, NULL) ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(arakoon_set(cluster, NULL, 3, "key", 5, "value") ==
+                ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(check_server_get_connections(server) == 1, NULL);
+
+        master = _arakoon_cluster_get_master(cluster, NULL);
+        fail_if(master == NULL, NULL);
+        fd = _arakoon_cluster_node_get_fd(master);
+        fail_unless(fd >= 0, NULL);
+
+        pid = fork();
+        fail_unless(pid >= 0, NULL);
+
+        if(pid == 0) {
+                _exit(check_fork_child(cluster));
+        }
+
+        fail_unless(waitpid(pid, &status, 0) == pid, NULL);
+        fail_unless(WIFEXITED(status) && WEXITSTATUS(status) == 0, NULL);
+
+        /* The child set up a connection of its own */
+        fail_unless(check_server_get_connections(server) == 2, NULL);
+
+        /* The parent keeps using its connection, which the child left
+         * alone */
+        fail_unless(_arakoon_cluster_get_master(cluster, NULL) == master,
+                NULL);
+        fail_unless(_arakoon_cluster_node_get_fd(master) == fd, NULL);
+
+        fail_unless(arakoon_get(cluster, NULL, 3, "key", &value_size,
+                &value) == ARAKOON_RC_SUCCESS, NULL);
+        fail_unless(value_size == 5 && memcmp(value, "child", 5) == 0, NULL);
+        arakoon_mem_free(value);
+
+        fail_unless(check_server_get_connections(server) == 2, NULL);
+
+        arakoon_cluster_free(cluster);
+        check_server_free(server);
+} END_TEST
+
 static Suite * arakoon_suite() {
         TCase *c = NULL;
         Suite *s = NULL;
@@ -128,6 +3150,99 @@ static Suite * arakoon_suite() {
         tcase_add_test(c, test_arakoon_utils_make_string_frees_on_realloc_error);
         suite_add_tcase(s, c);
 
+        c = tcase_create("arakoon_config");
+        tcase_add_test(c, test_arakoon_cluster_new_from_config);
+        tcase_add_test(c, test_arakoon_cluster_new_from_config_invalid);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_lists");
+        tcase_add_test(c, test_arakoon_value_list_get);
+        tcase_add_test(c, test_arakoon_value_list_decode);
+        tcase_add_test(c, test_arakoon_key_value_list_range_entries);
+        tcase_add_test(c, test_arakoon_key_value_list_rev_range_entries);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_sequence");
+        tcase_add_test(c, test_arakoon_sequence_encode_mixed);
+        tcase_add_test(c, test_arakoon_sequence_encode_large);
+        tcase_add_test(c, test_arakoon_sequence_encode_reset);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_read_cache");
+        tcase_add_test(c, test_arakoon_read_cache_ticket);
+        tcase_add_test(c, test_arakoon_read_cache_lru);
+        tcase_add_test(c, test_arakoon_read_cache_ttl);
+        tcase_add_test(c, test_arakoon_read_cache_absent);
+        tcase_add_test(c, test_arakoon_read_cache_resets_last_error);
+        tcase_add_test(c, test_arakoon_multi_confirm_skips_cache);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_nursery_routing");
+        tcase_add_test(c, test_arakoon_nursery_routing_lookup);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_statistics");
+        tcase_add_test(c, test_arakoon_statistics_parse);
+        tcase_add_test(c, test_arakoon_statistics_parse_truncated);
+        tcase_add_test(c, test_arakoon_statistics_parse_oversized);
+        tcase_add_test(c, test_arakoon_statistics_sampler_start);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_health_checker");
+        tcase_add_test(c, test_arakoon_health_checker_ping);
+        tcase_add_test(c, test_arakoon_health_checker_srtt);
+        tcase_add_test(c, test_arakoon_health_checker_get_health);
+        tcase_add_test(c, test_arakoon_health_checker_master_lookup);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_write_batcher");
+        tcase_add_test(c, test_arakoon_write_batcher_order);
+        tcase_add_test(c, test_arakoon_write_batcher_single);
+        tcase_add_test(c, test_arakoon_write_batcher_max_bytes);
+        tcase_add_test(c, test_arakoon_write_batcher_split);
+        tcase_set_timeout(c, 30);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_read_coalescer");
+        tcase_add_test(c, test_arakoon_read_coalescer_followers);
+        tcase_add_test(c, test_arakoon_read_coalescer_in_flight);
+        tcase_add_test(c, test_arakoon_read_coalescer_max_keys);
+        tcase_add_test(c, test_arakoon_read_coalescer_error);
+        tcase_set_timeout(c, 30);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_range_cursor");
+        tcase_add_test(c, test_arakoon_range_cursor_pages);
+        tcase_add_test(c, test_arakoon_range_cursor_prefix);
+        tcase_add_test(c, test_arakoon_range_cursor_prefetch);
+        tcase_set_timeout(c, 30);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_connection_pool");
+        tcase_add_test(c, test_arakoon_connection_pool_checkout);
+        tcase_add_test(c, test_arakoon_connection_pool_evict);
+        tcase_add_test(c, test_arakoon_connection_pool_wait);
+        tcase_add_test(c, test_arakoon_connection_pool_reap);
+        tcase_set_timeout(c, 30);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_fork");
+        tcase_add_test(c, test_arakoon_cluster_fork);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_master_watcher");
+        tcase_add_test(c, test_arakoon_master_watcher_step);
+        tcase_set_timeout(c, 30);
+        suite_add_tcase(s, c);
+
+        c = tcase_create("arakoon_mux");
+        tcase_add_test(c, test_arakoon_mux_pipeline_large);
+        tcase_add_test(c, test_arakoon_mux_begin_unreleased);
+        tcase_add_test(c, test_arakoon_mux_who_master_failure);
+        tcase_add_test(c, test_arakoon_mux_master_hint_detach);
+        tcase_set_timeout(c, 30);
+        suite_add_tcase(s, c);
+
         return s;
 }
 
@@ -0,0 +1,1292 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "arakoon.h"
+#include "arakoon-command.h"
+#include "server.h"
+
+#define CHECK_SERVER_CLUSTER "check"
+#define CHECK_SERVER_CONNECTIONS (64)
+#define CHECK_SERVER_REQUESTS (4096)
+#define CHECK_SERVER_ARGUMENTS (8)
+
+#define CHECK_SERVER_MAGIC (0xb1ff0000)
+#define CHECK_SERVER_MAGIC_MASK (0xffff0000)
+
+#define CHECK_SERVER_ITEM_SET (1)
+#define CHECK_SERVER_ITEM_DELETE (2)
+#define CHECK_SERVER_ITEM_SEQUENCE (5)
+#define CHECK_SERVER_ITEM_ASSERT (8)
+#define CHECK_SERVER_ITEM_ASSERT_EXISTS (15)
+
+typedef struct {
+        char *key;
+        size_t key_size;
+        char *value;
+        size_t value_size;
+} CheckServerEntry;
+
+/* Entries sorted by key */
+typedef struct {
+        CheckServerEntry *entries;
+        size_t count;
+        size_t capacity;
+} CheckServerStore;
+
+typedef struct {
+        char *data;
+        size_t size;
+        size_t capacity;
+} CheckServerBuffer;
+
+/* A decoded request argument, see ARAKOON_COMMANDS */
+typedef struct {
+        arakoon_bool set;
+        char *data;
+        size_t size;
+        int32_t number;
+        char **items;
+        size_t *item_sizes;
+        uint32_t item_count;
+} CheckServerArgument;
+
+typedef struct {
+        CheckServer *server;
+        int fd;
+} CheckServerConnection;
+
+struct CheckServer {
+        char name[CHECK_SERVER_KEY_SIZE];
+        char port[16];
+        int listener;
+        pthread_t acceptor;
+
+        pthread_mutex_t lock;
+        char master[CHECK_SERVER_KEY_SIZE];
+        arakoon_bool has_master;
+        unsigned int delay;
+        uint32_t fail_command;
+        arakoon_rc fail_rc;
+        unsigned int fail_count;
+
+        CheckServerStore store;
+
+        CheckServerRequest *requests;
+        size_t request_count;
+
+        CheckServerConnection connections[CHECK_SERVER_CONNECTIONS];
+        pthread_t threads[CHECK_SERVER_CONNECTIONS];
+        unsigned int connection_count;
+};
+
+static void * check_server_alloc(size_t size) {
+        void *ret = calloc(1, size > 0 ? size : 1);
+
+        if(ret == NULL) {
+                fprintf(stderr, "server: calloc returned NULL");
+                fflush(stderr);
+                abort();
+        }
+
+        return ret;
+}
+
+static char * check_server_copy(const void *data, size_t size) {
+        char *ret = check_server_alloc(size + 1);
+
+        memcpy(ret, data, size);
+
+        return ret;
+}
+
+static void check_server_die(const char * const what) {
+        perror(what);
+        abort();
+}
+
+/* Store */
+static int check_server_compare(const char *a, size_t a_size, const char *b,
+    size_t b_size) {
+        int r = memcmp(a, b, a_size < b_size ? a_size : b_size);
+
+        if(r != 0) {
+                return r;
+        }
+
+        return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+/* Index of 'key', or of the entry it would be inserted before */
+static arakoon_bool check_server_store_find(const CheckServerStore *store,
+    const char *key, size_t key_size, size_t *position) {
+        size_t i = 0;
+        int r = 0;
+
+        for(i = 0; i < store->count; i++) {
+                r = check_server_compare(store->entries[i].key,
+                        store->entries[i].key_size, key, key_size);
+                if(r >= 0) {
+                        break;
+                }
+        }
+
+        *position = i;
+
+        return (i < store->count && r == 0) ?
+                ARAKOON_BOOL_TRUE : ARAKOON_BOOL_FALSE;
+}
+
+static const CheckServerEntry * check_server_store_get(
+    const CheckServerStore *store, const char *key, size_t key_size) {
+        size_t i = 0;
+
+        if(!check_server_store_find(store, key, key_size, &i)) {
+                return NULL;
+        }
+
+        return &store->entries[i];
+}
+
+static void check_server_store_set(CheckServerStore *store, const char *key,
+    size_t key_size, const char *value, size_t value_size) {
+        CheckServerEntry *entries = NULL;
+        size_t i = 0;
+
+        if(check_server_store_find(store, key, key_size, &i)) {
+                free(store->entries[i].value);
+                store->entries[i].value = check_server_copy(value,
+                        value_size);
+                store->entries[i].value_size = value_size;
+                return;
+        }
+
+        if(store->count == store->capacity) {
+                store->capacity = store->capacity == 0 ?
+                        16 : 2 * store->capacity;
+                entries = check_server_alloc(store->capacity *
+                        sizeof(CheckServerEntry));
+                if(store->count > 0) {
+                        memcpy(entries, store->entries,
+                                store->count * sizeof(CheckServerEntry));
+                }
+                free(store->entries);
+                store->entries = entries;
+        }
+
+        memmove(&store->entries[i + 1], &store->entries[i],
+                (store->count - i) * sizeof(CheckServerEntry));
+        store->entries[i].key = check_server_copy(key, key_size);
+        store->entries[i].key_size = key_size;
+        store->entries[i].value = check_server_copy(value, value_size);
+        store->entries[i].value_size = value_size;
+        store->count++;
+}
+
+static arakoon_bool check_server_store_delete(CheckServerStore *store,
+    const char *key, size_t key_size) {
+        size_t i = 0;
+
+        if(!check_server_store_find(store, key, key_size, &i)) {
+                return ARAKOON_BOOL_FALSE;
+        }
+
+        free(store->entries[i].key);
+        free(store->entries[i].value);
+        memmove(&store->entries[i], &store->entries[i + 1],
+                (store->count - i - 1) * sizeof(CheckServerEntry));
+        store->count--;
+
+        return ARAKOON_BOOL_TRUE;
+}
+
+static void check_server_store_clear(CheckServerStore *store) {
+        size_t i = 0;
+
+        for(i = 0; i < store->count; i++) {
+                free(store->entries[i].key);
+                free(store->entries[i].value);
+        }
+
+        free(store->entries);
+        memset(store, 0, sizeof(CheckServerStore));
+}
+
+static void check_server_store_copy(const CheckServerStore *from,
+    CheckServerStore *to) {
+        size_t i = 0;
+
+        memset(to, 0, sizeof(CheckServerStore));
+
+        for(i = 0; i < from->count; i++) {
+                check_server_store_set(to, from->entries[i].key,
+                        from->entries[i].key_size, from->entries[i].value,
+                        from->entries[i].value_size);
+        }
+}
+
+/* Responses */
+static void check_server_buffer_put(CheckServerBuffer *buffer,
+    const void *data, size_t size) {
+        char *grown = NULL;
+
+        if(buffer->size + size > buffer->capacity) {
+                buffer->capacity = 2 * (buffer->size + size) + 64;
+                grown = check_server_alloc(buffer->capacity);
+                if(buffer->size > 0) {
+                        memcpy(grown, buffer->data, buffer->size);
+                }
+                free(buffer->data);
+                buffer->data = grown;
+        }
+
+        if(size > 0) {
+                memcpy(buffer->data + buffer->size, data, size);
+        }
+        buffer->size += size;
+}
+
+static void check_server_buffer_put_uint32(CheckServerBuffer *buffer,
+    uint32_t n) {
+        check_server_buffer_put(buffer, &n, sizeof(uint32_t));
+}
+
+static void check_server_buffer_put_uint64(CheckServerBuffer *buffer,
+    uint64_t n) {
+        check_server_buffer_put(buffer, &n, sizeof(uint64_t));
+}
+
+static void check_server_buffer_put_bool(CheckServerBuffer *buffer,
+    arakoon_bool b) {
+        const char c = b ? 1 : 0;
+
+        check_server_buffer_put(buffer, &c, 1);
+}
+
+static void check_server_buffer_put_string(CheckServerBuffer *buffer,
+    const void *data, size_t size) {
+        check_server_buffer_put_uint32(buffer, size);
+        check_server_buffer_put(buffer, data, size);
+}
+
+static void check_server_buffer_put_option(CheckServerBuffer *buffer,
+    const void *data, size_t size) {
+        check_server_buffer_put_bool(buffer, data != NULL);
+        if(data != NULL) {
+                check_server_buffer_put_string(buffer, data, size);
+        }
+}
+
+static void check_server_buffer_error(CheckServerBuffer *buffer,
+    arakoon_rc rc, const char *message, size_t size) {
+        buffer->size = 0;
+        check_server_buffer_put_uint32(buffer, rc);
+        check_server_buffer_put_string(buffer, message, size);
+}
+
+/* Requests */
+static int check_server_read(int fd, void *data, size_t size) {
+        char *p = data;
+        ssize_t r = 0;
+
+        while(size > 0) {
+                r = read(fd, p, size);
+                if(r < 0 && errno == EINTR) {
+                        continue;
+                }
+                if(r <= 0) {
+                        return -1;
+                }
+                p += r;
+                size -= r;
+        }
+
+        return 0;
+}
+
+static int check_server_write(int fd, const void *data, size_t size) {
+        const char *p = data;
+        ssize_t r = 0;
+
+        while(size > 0) {
+                r = send(fd, p, size, MSG_NOSIGNAL);
+                if(r < 0 && errno == EINTR) {
+                        continue;
+                }
+                if(r <= 0) {
+                        return -1;
+                }
+                p += r;
+                size -= r;
+        }
+
+        return 0;
+}
+
+static int check_server_read_string(int fd, char **data, size_t *size) {
+        uint32_t n = 0;
+
+        if(check_server_read(fd, &n, sizeof(uint32_t)) != 0) {
+                return -1;
+        }
+
+        *data = check_server_alloc(n + 1);
+        *size = n;
+
+        return check_server_read(fd, *data, n);
+}
+
+static void check_server_argument_free(CheckServerArgument *argument) {
+        uint32_t i = 0;
+
+        free(argument->data);
+        for(i = 0; i < argument->item_count; i++) {
+                free(argument->items[i]);
+        }
+        free(argument->items);
+        free(argument->item_sizes);
+
+        memset(argument, 0, sizeof(CheckServerArgument));
+}
+
+/* Read the arguments of 'command' following its layout. Sequences are
+ * read as the string they're encoded in. */
+static int check_server_read_arguments(int fd,
+    const ArakoonCommandDescriptor *descriptor,
+    CheckServerArgument *arguments) {
+        const char *a = NULL;
+        CheckServerArgument *argument = arguments;
+        char c = 0;
+        uint32_t i = 0;
+
+        for(a = descriptor->arguments; *a != '\0'; a++, argument++) {
+                switch(*a) {
+                        case 'd':
+                        case 'b': {
+                                if(check_server_read(fd, &c, 1) != 0) {
+                                        return -1;
+                                }
+                                argument->set = c ?
+                                        ARAKOON_BOOL_TRUE : ARAKOON_BOOL_FALSE;
+                        } break;
+                        case 'i': {
+                                if(check_server_read(fd, &argument->number,
+                                        sizeof(int32_t)) != 0) {
+                                        return -1;
+                                }
+                        } break;
+                        case 'o': {
+                                if(check_server_read(fd, &c, 1) != 0) {
+                                        return -1;
+                                }
+                                if(c == 0) {
+                                        break;
+                                }
+                        }
+                        /* Fall through */
+                        case 's':
+                        case 'q': {
+                                argument->set = ARAKOON_BOOL_TRUE;
+                                if(check_server_read_string(fd,
+                                        &argument->data,
+                                        &argument->size) != 0) {
+                                        return -1;
+                                }
+                        } break;
+                        case 'l': {
+                                if(check_server_read(fd,
+                                        &argument->item_count,
+                                        sizeof(uint32_t)) != 0) {
+                                        return -1;
+                                }
+                                argument->items = check_server_alloc(
+                                        argument->item_count *
+                                        sizeof(char *));
+                                argument->item_sizes = check_server_alloc(
+                                        argument->item_count *
+                                        sizeof(size_t));
+                                for(i = 0; i < argument->item_count; i++) {
+                                        if(check_server_read_string(fd,
+                                                &argument->items[i],
+                                                &argument->item_sizes[i]) !=
+                                                0) {
+                                                return -1;
+                                        }
+                                }
+                        } break;
+                        default: {
+                                return -1;
+                        }
+                }
+        }
+
+        return 0;
+}
+
+static void check_server_log_key(char *to, const char *key, size_t size) {
+        if(size >= CHECK_SERVER_KEY_SIZE) {
+                size = CHECK_SERVER_KEY_SIZE - 1;
+        }
+
+        memcpy(to, key, size);
+        to[size] = 0;
+}
+
+/* Sequences, applied to a copy of the store so they're atomic */
+typedef struct {
+        const char *data;
+        size_t size;
+        size_t offset;
+} CheckServerCursor;
+
+static int check_server_cursor_uint32(CheckServerCursor *cursor,
+    uint32_t *n) {
+        if(cursor->size - cursor->offset < sizeof(uint32_t)) {
+                return -1;
+        }
+
+        memcpy(n, cursor->data + cursor->offset, sizeof(uint32_t));
+        cursor->offset += sizeof(uint32_t);
+
+        return 0;
+}
+
+static int check_server_cursor_string(CheckServerCursor *cursor,
+    const char **data, size_t *size) {
+        uint32_t n = 0;
+
+        if(check_server_cursor_uint32(cursor, &n) != 0 ||
+                cursor->size - cursor->offset < n) {
+                return -1;
+        }
+
+        *data = cursor->data + cursor->offset;
+        *size = n;
+        cursor->offset += n;
+
+        return 0;
+}
+
+static arakoon_rc check_server_apply(CheckServerStore *store,
+    CheckServerCursor *cursor, CheckServerRequest *request) {
+        const CheckServerEntry *entry = NULL;
+        const char *key = NULL, *value = NULL;
+        size_t key_size = 0, value_size = 0;
+        uint32_t type = 0, count = 0, i = 0;
+        char set = 0;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+
+        if(check_server_cursor_uint32(cursor, &type) != 0) {
+                return ARAKOON_RC_UNKNOWN_FAILURE;
+        }
+
+        if(type == CHECK_SERVER_ITEM_SEQUENCE) {
+                if(check_server_cursor_uint32(cursor, &count) != 0) {
+                        return ARAKOON_RC_UNKNOWN_FAILURE;
+                }
+                if(request->count == 0) {
+                        request->count = count;
+                }
+                for(i = 0; i < count; i++) {
+                        rc = check_server_apply(store, cursor, request);
+                        if(rc != ARAKOON_RC_SUCCESS) {
+                                return rc;
+                        }
+                }
+
+                return ARAKOON_RC_SUCCESS;
+        }
+
+        if(check_server_cursor_string(cursor, &key, &key_size) != 0) {
+                return ARAKOON_RC_UNKNOWN_FAILURE;
+        }
+
+        if(request->first[0] == 0) {
+                check_server_log_key(request->first, key, key_size);
+        }
+
+        switch(type) {
+                case CHECK_SERVER_ITEM_SET: {
+                        if(check_server_cursor_string(cursor, &value,
+                                &value_size) != 0) {
+                                return ARAKOON_RC_UNKNOWN_FAILURE;
+                        }
+                        check_server_store_set(store, key, key_size, value,
+                                value_size);
+                } break;
+                case CHECK_SERVER_ITEM_DELETE: {
+                        if(!check_server_store_delete(store, key, key_size)) {
+                                return ARAKOON_RC_NOT_FOUND;
+                        }
+                } break;
+                case CHECK_SERVER_ITEM_ASSERT: {
+                        if(cursor->offset == cursor->size) {
+                                return ARAKOON_RC_UNKNOWN_FAILURE;
+                        }
+                        set = cursor->data[cursor->offset++];
+                        if(set && check_server_cursor_string(cursor, &value,
+                                &value_size) != 0) {
+                                return ARAKOON_RC_UNKNOWN_FAILURE;
+                        }
+                        entry = check_server_store_get(store, key, key_size);
+                        if(!set ? entry != NULL : (entry == NULL ||
+                                check_server_compare(entry->value,
+                                        entry->value_size, value,
+                                        value_size) != 0)) {
+                                return ARAKOON_RC_ASSERTION_FAILED;
+                        }
+                } break;
+                case CHECK_SERVER_ITEM_ASSERT_EXISTS: {
+                        if(check_server_store_get(store, key, key_size) ==
+                                NULL) {
+                                return ARAKOON_RC_ASSERTION_FAILED;
+                        }
+                } break;
+                default: {
+                        return ARAKOON_RC_UNKNOWN_FAILURE;
+                }
+        }
+
+        return ARAKOON_RC_SUCCESS;
+}
+
+/* Range queries, the result is a list so it's built in reverse */
+static arakoon_bool check_server_in_range(const CheckServerEntry *entry,
+    const CheckServerArgument *low, arakoon_bool low_included,
+    const CheckServerArgument *high, arakoon_bool high_included) {
+        int r = 0;
+
+        if(low->set) {
+                r = check_server_compare(entry->key, entry->key_size,
+                        low->data, low->size);
+                if(r < 0 || (r == 0 && !low_included)) {
+                        return ARAKOON_BOOL_FALSE;
+                }
+        }
+
+        if(high->set) {
+                r = check_server_compare(entry->key, entry->key_size,
+                        high->data, high->size);
+                if(r > 0 || (r == 0 && !high_included)) {
+                        return ARAKOON_BOOL_FALSE;
+                }
+        }
+
+        return ARAKOON_BOOL_TRUE;
+}
+
+static void check_server_range(const CheckServerStore *store,
+    const CheckServerArgument *arguments, arakoon_bool reverse,
+    arakoon_bool values, CheckServerBuffer *out) {
+        const CheckServerArgument *first = &arguments[1],
+                *last = &arguments[3];
+        const CheckServerEntry **matches = NULL;
+        const CheckServerEntry *entry = NULL;
+        const int32_t max = arguments[5].number;
+        size_t i = 0, count = 0;
+
+        matches = check_server_alloc(store->count * sizeof(void *));
+
+        for(i = 0; i < store->count; i++) {
+                entry = &store->entries[reverse ? store->count - 1 - i : i];
+
+                if(max >= 0 && count == (size_t) max) {
+                        break;
+                }
+
+                if(reverse ? check_server_in_range(entry, last,
+                        arguments[4].set, first, arguments[2].set) :
+                        check_server_in_range(entry, first,
+                                arguments[2].set, last, arguments[4].set)) {
+                        matches[count++] = entry;
+                }
+        }
+
+        check_server_buffer_put_uint32(out, count);
+        while(count-- > 0) {
+                check_server_buffer_put_string(out, matches[count]->key,
+                        matches[count]->key_size);
+                if(values) {
+                        check_server_buffer_put_string(out,
+                                matches[count]->value,
+                                matches[count]->value_size);
+                }
+        }
+
+        free(matches);
+}
+
+static void check_server_prefix(const CheckServerStore *store,
+    const CheckServerArgument *arguments, CheckServerBuffer *out) {
+        const CheckServerArgument *prefix = &arguments[1];
+        const CheckServerEntry **matches = NULL;
+        const int32_t max = arguments[2].number;
+        size_t i = 0, count = 0;
+
+        matches = check_server_alloc(store->count * sizeof(void *));
+
+        for(i = 0; i < store->count; i++) {
+                if(max >= 0 && count == (size_t) max) {
+                        break;
+                }
+
+                if(store->entries[i].key_size >= prefix->size &&
+                        memcmp(store->entries[i].key, prefix->data,
+                                prefix->size) == 0) {
+                        matches[count++] = &store->entries[i];
+                }
+        }
+
+        check_server_buffer_put_uint32(out, count);
+        while(count-- > 0) {
+                check_server_buffer_put_string(out, matches[count]->key,
+                        matches[count]->key_size);
+        }
+
+        free(matches);
+}
+
+static arakoon_bool check_server_needs_master(uint32_t code) {
+        switch(code) {
+                case 0x01:
+                case 0x02:
+                case 0x12:
+                case 0x13:
+                case 0x14:
+                case 0x25:
+                case 0x26:
+                case 0x28:
+                        return ARAKOON_BOOL_FALSE;
+                default:
+                        return ARAKOON_BOOL_TRUE;
+        }
+}
+
+/* Build the response to a request, with the server lock held */
+static void check_server_handle(CheckServer *server,
+    const ArakoonCommandDescriptor *descriptor,
+    CheckServerArgument *arguments, CheckServerRequest *request,
+    CheckServerBuffer *out) {
+        CheckServerStore copy;
+        CheckServerCursor cursor;
+        const CheckServerEntry *entry = NULL;
+        const CheckServerArgument *key = &arguments[1];
+        const uint32_t code = (unsigned char) descriptor->code;
+        const arakoon_bool dirty = descriptor->arguments[0] == 'd' &&
+                arguments[0].set;
+        arakoon_rc rc = ARAKOON_RC_SUCCESS;
+        uint32_t n = 0;
+
+        check_server_buffer_put_uint32(out, ARAKOON_RC_SUCCESS);
+
+        if(server->fail_count > 0 && server->fail_command == code) {
+                server->fail_count--;
+                check_server_buffer_error(out, server->fail_rc, "injected",
+                        8);
+                return;
+        }
+
+        if(check_server_needs_master(code) && !dirty &&
+                (!server->has_master ||
+                        strcmp(server->master, server->name) != 0)) {
+                check_server_buffer_error(out, ARAKOON_RC_NOT_MASTER,
+                        "not master", 10);
+                return;
+        }
+
+        switch(code) {
+                case 0x01: {
+                        check_server_buffer_put_string(out,
+                                CHECK_SERVER_CLUSTER,
+                                strlen(CHECK_SERVER_CLUSTER));
+                } break;
+                case 0x02: {
+                        check_server_buffer_put_option(out,
+                                server->has_master ? server->master : NULL,
+                                strlen(server->master));
+                } break;
+                case 0x07: {
+                        check_server_buffer_put_bool(out,
+                                check_server_store_get(&server->store,
+                                        key->data, key->size) != NULL);
+                } break;
+                case 0x08: {
+                        entry = check_server_store_get(&server->store,
+                                key->data, key->size);
+                        if(entry == NULL) {
+                                check_server_buffer_error(out,
+                                        ARAKOON_RC_NOT_FOUND, key->data,
+                                        key->size);
+                                break;
+                        }
+                        check_server_buffer_put_string(out, entry->value,
+                                entry->value_size);
+                } break;
+                case 0x09:
+                case 0x1c: {
+                        check_server_store_set(&server->store,
+                                arguments[0].data, arguments[0].size,
+                                arguments[1].data, arguments[1].size);
+                } break;
+                case 0x0a: {
+                        if(!check_server_store_delete(&server->store,
+                                arguments[0].data, arguments[0].size)) {
+                                check_server_buffer_error(out,
+                                        ARAKOON_RC_NOT_FOUND,
+                                        arguments[0].data,
+                                        arguments[0].size);
+                        }
+                } break;
+                case 0x0b: {
+                        check_server_range(&server->store, arguments,
+                                ARAKOON_BOOL_FALSE, ARAKOON_BOOL_FALSE, out);
+                } break;
+                case 0x0c: {
+                        check_server_prefix(&server->store, arguments, out);
+                } break;
+                case 0x0f:
+                case 0x23: {
+                        check_server_range(&server->store, arguments,
+                                code == 0x23, ARAKOON_BOOL_TRUE, out);
+                } break;
+                case 0x10:
+                case 0x24: {
+                        cursor.data = arguments[0].data;
+                        cursor.size = arguments[0].size;
+                        cursor.offset = 0;
+                        check_server_store_copy(&server->store, &copy);
+                        rc = check_server_apply(&copy, &cursor, request);
+                        if(rc != ARAKOON_RC_SUCCESS) {
+                                check_server_store_clear(&copy);
+                                check_server_buffer_error(out, rc, "sequence",
+                                        8);
+                                break;
+                        }
+                        check_server_store_clear(&server->store);
+                        server->store = copy;
+                } break;
+                case 0x11:
+                case 0x31: {
+                        /* Lists are sent in reverse */
+                        n = arguments[1].item_count;
+                        check_server_buffer_put_uint32(out, n);
+                        while(n-- > 0) {
+                                entry = check_server_store_get(&server->store,
+                                        arguments[1].items[n],
+                                        arguments[1].item_sizes[n]);
+                                if(code == 0x31) {
+                                        check_server_buffer_put_option(out,
+                                                entry ? entry->value : NULL,
+                                                entry ? entry->value_size : 0);
+                                } else if(entry == NULL) {
+                                        check_server_buffer_error(out,
+                                                ARAKOON_RC_NOT_FOUND,
+                                                arguments[1].items[n],
+                                                arguments[1].item_sizes[n]);
+                                        break;
+                                } else {
+                                        check_server_buffer_put_string(out,
+                                                entry->value,
+                                                entry->value_size);
+                                }
+                        }
+                } break;
+                case 0x12: {
+                        check_server_buffer_put_bool(out, server->has_master);
+                } break;
+                case 0x16: {
+                        entry = check_server_store_get(&server->store,
+                                key->data, key->size);
+                        if(!arguments[2].set ? entry != NULL :
+                                (entry == NULL || check_server_compare(
+                                        entry->value, entry->value_size,
+                                        arguments[2].data,
+                                        arguments[2].size) != 0)) {
+                                check_server_buffer_error(out,
+                                        ARAKOON_RC_ASSERTION_FAILED,
+                                        key->data, key->size);
+                        }
+                } break;
+                case 0x1a: {
+                        check_server_buffer_put_uint64(out,
+                                server->store.count);
+                } break;
+                case 0x29: {
+                        if(check_server_store_get(&server->store, key->data,
+                                key->size) == NULL) {
+                                check_server_buffer_error(out,
+                                        ARAKOON_RC_ASSERTION_FAILED,
+                                        key->data, key->size);
+                        }
+                } break;
+                case 0x33: {
+                        entry = check_server_store_get(&server->store,
+                                arguments[0].data, arguments[0].size);
+                        check_server_buffer_put_option(out,
+                                entry ? entry->value : NULL,
+                                entry ? entry->value_size : 0);
+                        if(arguments[1].set) {
+                                check_server_store_set(&server->store,
+                                        arguments[0].data, arguments[0].size,
+                                        arguments[1].data, arguments[1].size);
+                        } else {
+                                (void) check_server_store_delete(
+                                        &server->store, arguments[0].data,
+                                        arguments[0].size);
+                        }
+                } break;
+                default: {
+                        check_server_buffer_error(out,
+                                ARAKOON_RC_UNKNOWN_FAILURE, "unsupported",
+                                11);
+                }
+        }
+}
+
+static void check_server_log(CheckServer *server,
+    const ArakoonCommandDescriptor *descriptor,
+    const CheckServerArgument *arguments, CheckServerRequest *request) {
+        const char *a = NULL;
+        const CheckServerArgument *argument = arguments;
+        arakoon_bool range = ARAKOON_BOOL_FALSE;
+
+        range = strcmp(descriptor->arguments, "dobobi") == 0;
+
+        for(a = descriptor->arguments; *a != '\0'; a++, argument++) {
+                switch(*a) {
+                        case 'd': {
+                                request->dirty = argument->set;
+                        } break;
+                        case 'i': {
+                                request->max = argument->number;
+                        } break;
+                        case 'l': {
+                                request->count = argument->item_count;
+                                if(argument->item_count > 0 &&
+                                        request->first[0] == 0) {
+                                        check_server_log_key(request->first,
+                                                argument->items[0],
+                                                argument->item_sizes[0]);
+                                }
+                        } break;
+                        case 's':
+                        case 'o': {
+                                if(request->first[0] == 0 &&
+                                        argument->set && !range) {
+                                        check_server_log_key(request->first,
+                                                argument->data,
+                                                argument->size);
+                                }
+                        } break;
+                        default:
+                                break;
+                }
+        }
+
+        if(range) {
+                request->first_set = arguments[1].set;
+                if(arguments[1].set) {
+                        check_server_log_key(request->first,
+                                arguments[1].data, arguments[1].size);
+                }
+                request->first_included = arguments[2].set;
+                request->last_set = arguments[3].set;
+                if(arguments[3].set) {
+                        check_server_log_key(request->last,
+                                arguments[3].data, arguments[3].size);
+                }
+                request->last_included = arguments[4].set;
+        }
+
+        if(server->request_count < CHECK_SERVER_REQUESTS) {
+                server->requests[server->request_count] = *request;
+        }
+        server->request_count++;
+}
+
+static const ArakoonCommandDescriptor * check_server_lookup(uint32_t code) {
+        const ArakoonCommandDescriptor *descriptor = NULL;
+        int i = 0;
+
+        for(i = 0; i < ARAKOON_COMMAND_COUNT; i++) {
+                descriptor = _arakoon_command_get_descriptor(i);
+                if((uint32_t) (unsigned char) descriptor->code == code) {
+                        return descriptor;
+                }
+        }
+
+        return NULL;
+}
+
+static void * check_server_serve(void *data) {
+        CheckServerConnection *connection = data;
+        CheckServer *server = connection->server;
+        CheckServerArgument arguments[CHECK_SERVER_ARGUMENTS];
+        CheckServerBuffer out;
+        CheckServerRequest request;
+        const ArakoonCommandDescriptor *descriptor = NULL;
+        const int fd = connection->fd;
+        uint32_t prologue[2], command = 0;
+        char *cluster = NULL;
+        size_t cluster_size = 0, i = 0;
+        unsigned int delay = 0;
+        int r = 0;
+
+        memset(arguments, 0, sizeof(arguments));
+        memset(&out, 0, sizeof(out));
+
+        /* Magic, version and cluster name */
+        if(check_server_read(fd, prologue, sizeof(prologue)) != 0 ||
+                check_server_read_string(fd, &cluster, &cluster_size) != 0) {
+                goto out;
+        }
+
+        while(check_server_read(fd, &command, sizeof(uint32_t)) == 0) {
+                if((command & CHECK_SERVER_MAGIC_MASK) != CHECK_SERVER_MAGIC) {
+                        break;
+                }
+
+                command &= ~CHECK_SERVER_MAGIC_MASK;
+                descriptor = check_server_lookup(command);
+                if(descriptor == NULL) {
+                        break;
+                }
+
+                r = check_server_read_arguments(fd, descriptor, arguments);
+                if(r != 0) {
+                        break;
+                }
+
+                memset(&request, 0, sizeof(request));
+                request.command = command;
+                request.max = -1;
+
+                pthread_mutex_lock(&server->lock);
+                delay = server->delay;
+                pthread_mutex_unlock(&server->lock);
+
+                if(delay > 0) {
+                        usleep(delay);
+                }
+
+                out.size = 0;
+
+                pthread_mutex_lock(&server->lock);
+                check_server_handle(server, descriptor, arguments, &request,
+                        &out);
+                check_server_log(server, descriptor, arguments, &request);
+                pthread_mutex_unlock(&server->lock);
+
+                for(i = 0; i < CHECK_SERVER_ARGUMENTS; i++) {
+                        check_server_argument_free(&arguments[i]);
+                }
+
+                if(check_server_write(fd, out.data, out.size) != 0) {
+                        break;
+                }
+        }
+
+out:
+        for(i = 0; i < CHECK_SERVER_ARGUMENTS; i++) {
+                check_server_argument_free(&arguments[i]);
+        }
+        free(out.data);
+        free(cluster);
+
+        /* The descriptor is closed by check_server_free, so a dropped
+         * connection can't have its number reused underneath us */
+        shutdown(fd, SHUT_RDWR);
+
+        return NULL;
+}
+
+static void * check_server_accept(void *data) {
+        CheckServer *server = data;
+        CheckServerConnection *connection = NULL;
+        int fd = -1;
+
+        while(1) {
+                fd = accept(server->listener, NULL, NULL);
+                if(fd < 0) {
+                        if(errno == EINTR || errno == ECONNABORTED) {
+                                continue;
+                        }
+                        break;
+                }
+
+                pthread_mutex_lock(&server->lock);
+
+                if(server->connection_count == CHECK_SERVER_CONNECTIONS) {
+                        pthread_mutex_unlock(&server->lock);
+                        close(fd);
+                        continue;
+                }
+
+                connection = &server->connections[server->connection_count];
+                connection->server = server;
+                connection->fd = fd;
+
+                if(pthread_create(&server->threads[server->connection_count],
+                        NULL, check_server_serve, connection) != 0) {
+                        check_server_die("pthread_create");
+                }
+
+                server->connection_count++;
+
+                pthread_mutex_unlock(&server->lock);
+        }
+
+        return NULL;
+}
+
+CheckServer * check_server_new(const char * const name) {
+        CheckServer *server = NULL;
+        struct sockaddr_in address;
+        socklen_t len = sizeof(address);
+
+        server = check_server_alloc(sizeof(CheckServer));
+        server->requests = check_server_alloc(CHECK_SERVER_REQUESTS *
+                sizeof(CheckServerRequest));
+
+        snprintf(server->name, sizeof(server->name), "%s", name);
+        snprintf(server->master, sizeof(server->master), "%s", name);
+        server->has_master = ARAKOON_BOOL_TRUE;
+
+        if(pthread_mutex_init(&server->lock, NULL) != 0) {
+                check_server_die("pthread_mutex_init");
+        }
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+
+        server->listener = socket(AF_INET, SOCK_STREAM, 0);
+        if(server->listener < 0) {
+                check_server_die("socket");
+        }
+
+        if(bind(server->listener, (struct sockaddr *) &address,
+                sizeof(address)) != 0 ||
+                listen(server->listener, CHECK_SERVER_CONNECTIONS) != 0 ||
+                getsockname(server->listener, (struct sockaddr *) &address,
+                        &len) != 0) {
+                check_server_die("listen");
+        }
+
+        snprintf(server->port, sizeof(server->port), "%d",
+                ntohs(address.sin_port));
+
+        if(pthread_create(&server->acceptor, NULL, check_server_accept,
+                server) != 0) {
+                check_server_die("pthread_create");
+        }
+
+        return server;
+}
+
+void check_server_free(CheckServer *server) {
+        unsigned int i = 0;
+
+        if(server == NULL) {
+                return;
+        }
+
+        shutdown(server->listener, SHUT_RDWR);
+        pthread_join(server->acceptor, NULL);
+
+        check_server_drop_connections(server);
+
+        for(i = 0; i < server->connection_count; i++) {
+                pthread_join(server->threads[i], NULL);
+                close(server->connections[i].fd);
+        }
+
+        close(server->listener);
+
+        check_server_store_clear(&server->store);
+        pthread_mutex_destroy(&server->lock);
+        free(server->requests);
+        free(server);
+}
+
+const char * check_server_get_name(const CheckServer * const server) {
+        return server->name;
+}
+
+const char * check_server_get_port(const CheckServer * const server) {
+        return server->port;
+}
+
+void check_server_set_master(CheckServer * const server,
+    const char * const master) {
+        pthread_mutex_lock(&server->lock);
+        server->has_master = master != NULL;
+        snprintf(server->master, sizeof(server->master), "%s",
+                master ? master : "");
+        pthread_mutex_unlock(&server->lock);
+}
+
+void check_server_set_delay(CheckServer * const server,
+    const unsigned int usec) {
+        pthread_mutex_lock(&server->lock);
+        server->delay = usec;
+        pthread_mutex_unlock(&server->lock);
+}
+
+void check_server_fail(CheckServer * const server, const uint32_t command,
+    const arakoon_rc rc, const unsigned int count) {
+        pthread_mutex_lock(&server->lock);
+        server->fail_command = command;
+        server->fail_rc = rc;
+        server->fail_count = count;
+        pthread_mutex_unlock(&server->lock);
+}
+
+void check_server_put(CheckServer * const server, const char * const key,
+    const char * const value) {
+        pthread_mutex_lock(&server->lock);
+        check_server_store_set(&server->store, key, strlen(key), value,
+                strlen(value));
+        pthread_mutex_unlock(&server->lock);
+}
+
+arakoon_bool check_server_get(CheckServer * const server,
+    const char * const key, char * const value, const size_t size) {
+        const CheckServerEntry *entry = NULL;
+        size_t n = 0;
+
+        pthread_mutex_lock(&server->lock);
+
+        entry = check_server_store_get(&server->store, key, strlen(key));
+        if(entry != NULL && size > 0) {
+                n = entry->value_size < size - 1 ?
+                        entry->value_size : size - 1;
+                memcpy(value, entry->value, n);
+                value[n] = 0;
+        }
+
+        pthread_mutex_unlock(&server->lock);
+
+        return entry != NULL;
+}
+
+size_t check_server_get_requests(CheckServer * const server,
+    CheckServerRequest * const requests, const size_t max) {
+        size_t count = 0;
+
+        pthread_mutex_lock(&server->lock);
+
+        count = server->request_count;
+        if(requests != NULL) {
+                memcpy(requests, server->requests,
+                        (count < max ? count : max) *
+                        sizeof(CheckServerRequest));
+        }
+
+        pthread_mutex_unlock(&server->lock);
+
+        return count;
+}
+
+size_t check_server_count_requests(CheckServer * const server,
+    const uint32_t command) {
+        size_t i = 0, count = 0;
+
+        pthread_mutex_lock(&server->lock);
+
+        for(i = 0; i < server->request_count &&
+                i < CHECK_SERVER_REQUESTS; i++) {
+                if(server->requests[i].command == command) {
+                        count++;
+                }
+        }
+
+        pthread_mutex_unlock(&server->lock);
+
+        return count;
+}
+
+void check_server_clear_requests(CheckServer * const server) {
+        pthread_mutex_lock(&server->lock);
+        server->request_count = 0;
+        pthread_mutex_unlock(&server->lock);
+}
+
+unsigned int check_server_get_connections(CheckServer * const server) {
+        unsigned int count = 0;
+
+        pthread_mutex_lock(&server->lock);
+        count = server->connection_count;
+        pthread_mutex_unlock(&server->lock);
+
+        return count;
+}
+
+void check_server_drop_connections(CheckServer * const server) {
+        unsigned int i = 0;
+
+        pthread_mutex_lock(&server->lock);
+
+        for(i = 0; i < server->connection_count; i++) {
+                shutdown(server->connections[i].fd, SHUT_RDWR);
+        }
+
+        pthread_mutex_unlock(&server->lock);
+}
+
+ArakoonCluster * check_server_cluster_new(CheckServer ** const servers,
+    const size_t count) {
+        ArakoonCluster *cluster = NULL;
+        ArakoonClusterNode *node = NULL;
+        size_t i = 0;
+
+        cluster = arakoon_cluster_new(ARAKOON_PROTOCOL_VERSION_1,
+                CHECK_SERVER_CLUSTER);
+        if(cluster == NULL) {
+                check_server_die("arakoon_cluster_new");
+        }
+
+        for(i = 0; i < count; i++) {
+                node = arakoon_cluster_node_new(servers[i]->name);
+                if(node == NULL ||
+                        arakoon_cluster_node_add_address_tcp(node,
+                                "127.0.0.1", servers[i]->port) !=
+                                ARAKOON_RC_SUCCESS ||
+                        arakoon_cluster_add_node(cluster, node) !=
+                                ARAKOON_RC_SUCCESS) {
+                        check_server_die("arakoon_cluster_add_node");
+                }
+        }
+
+        return cluster;
+}
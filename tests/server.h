@@ -0,0 +1,92 @@
+/*
+ * This file is part of Arakoon, a distributed key-value store.
+ *
+ * Copyright (C) 2010 Incubaid BVBA
+ *
+ * Licensees holding a valid Incubaid license may use this file in
+ * accordance with Incubaid's Arakoon commercial license agreement. For
+ * more information on how to enter into this agreement, please contact
+ * Incubaid (contact details can be found on http://www.arakoon.org/licensing).
+ *
+ * Alternatively, this file may be redistributed and/or modified under
+ * the terms of the GNU Affero General Public License version 3, as
+ * published by the Free Software Foundation. Under this license, this
+ * file is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU Affero General Public License for more details.
+ * You should have received a copy of the
+ * GNU Affero General Public License along with this program (file "COPYING").
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arakoon.h"
+
+/* An in-process Arakoon node for the check suite. It listens on an
+ * ephemeral port of the loopback interface, serves every connection from
+ * a thread of its own and keeps its keys in memory. Every request it
+ * reads is logged, so tests can check what went over the wire. */
+typedef struct CheckServer CheckServer;
+
+#define CHECK_SERVER_KEY_SIZE (64)
+
+typedef struct {
+        uint32_t command;
+        arakoon_bool dirty;
+        /* Keys of a multi-get, items of a sequence */
+        uint32_t count;
+        /* Page size of a range or prefix query */
+        int32_t max;
+        /* Key, prefix or start of a range, truncated */
+        char first[CHECK_SERVER_KEY_SIZE];
+        arakoon_bool first_set;
+        arakoon_bool first_included;
+        char last[CHECK_SERVER_KEY_SIZE];
+        arakoon_bool last_set;
+        arakoon_bool last_included;
+} CheckServerRequest;
+
+CheckServer * check_server_new(const char * const name);
+void check_server_free(CheckServer *server);
+
+const char * check_server_get_name(const CheckServer * const server);
+const char * check_server_get_port(const CheckServer * const server);
+
+/* Name returned by who_master, NULL for none. Defaults to the server. */
+void check_server_set_master(CheckServer * const server,
+    const char * const master);
+/* Sleep before answering every request */
+void check_server_set_delay(CheckServer * const server,
+    const unsigned int usec);
+/* Fail the next 'count' requests for 'command' with 'rc' */
+void check_server_fail(CheckServer * const server, const uint32_t command,
+    const arakoon_rc rc, const unsigned int count);
+
+void check_server_put(CheckServer * const server, const char * const key,
+    const char * const value);
+/* Copy the value of 'key', NUL-terminated, into 'value' */
+arakoon_bool check_server_get(CheckServer * const server,
+    const char * const key, char * const value, const size_t size);
+
+/* Copy up to 'max' logged requests, and return how many were logged */
+size_t check_server_get_requests(CheckServer * const server,
+    CheckServerRequest * const requests, const size_t max);
+size_t check_server_count_requests(CheckServer * const server,
+    const uint32_t command);
+void check_server_clear_requests(CheckServer * const server);
+
+unsigned int check_server_get_connections(CheckServer * const server);
+/* Shut down every connection accepted so far */
+void check_server_drop_connections(CheckServer * const server);
+
+/* A cluster of the given servers, named "check", with nothing connected */
+ArakoonCluster * check_server_cluster_new(CheckServer ** const servers,
+    const size_t count);
+#endif
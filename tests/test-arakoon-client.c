@@ -42,6 +42,60 @@ static void client_error_handler(arakoon_rc rc, size_t len, const void *msg) {
                 len < INT_MAX ? (int) len : INT_MAX, (const char *) msg);
 }
 
+typedef struct {
+        unsigned int count;
+        unsigned int stop_after;
+        arakoon_bool with_values;
+        int order;
+        size_t last_size;
+        char last[16];
+} ForeachState;
+
+/* Count the entries passed by the *_foreach calls, checking whether they
+ * carry a value and are in ascending ('order' 1) or descending ('order' -1)
+ * order, and stop after 'stop_after' entries unless it's 0 */
+static arakoon_bool foreach_callback(size_t key_size, const void *key,
+    size_t value_size, const void *value, void *data) {
+        ForeachState *state = (ForeachState *) data;
+        int cmp = 0;
+
+        if((value != NULL) != (state->with_values == ARAKOON_BOOL_TRUE)) {
+                fprintf(stderr, "Unexpected foreach value: %p (%zu)\n",
+                        value, value_size);
+                abort();
+        }
+
+        if(key_size > sizeof(state->last)) {
+                fprintf(stderr, "Unexpected foreach key length: %zu\n",
+                        key_size);
+                abort();
+        }
+
+        if(state->count > 0 && state->order != 0) {
+                cmp = memcmp(state->last, key, state->last_size < key_size ?
+                        state->last_size : key_size);
+                if(cmp == 0) {
+                        cmp = state->last_size < key_size ? -1 : 1;
+                }
+
+                if((cmp < 0 ? 1 : -1) != state->order) {
+                        fprintf(stderr, "Unexpected foreach order: %.*s\n",
+                                (int) key_size, (const char *) key);
+                        abort();
+                }
+        }
+
+        memcpy(state->last, key, key_size);
+        state->last_size = key_size;
+        state->count++;
+
+        if(state->stop_after != 0 && state->count == state->stop_after) {
+                return ARAKOON_BOOL_FALSE;
+        }
+
+        return ARAKOON_BOOL_TRUE;
+}
+
 int main(int argc, char **argv) {
         ArakoonCluster *c = NULL;
         arakoon_rc rc = 0;
@@ -58,6 +112,8 @@ int main(int argc, char **argv) {
         int i = 0;
         uint32_t uint32 = 0;
         int32_t major = 0, minor = 0, patch = 0;
+        uint64_t count0 = 0, count1 = 0;
+        ForeachState foreach_state;
         char *version_info = NULL;
 
         Node *fst = NULL, *n = NULL, *the_node = NULL;
@@ -486,6 +542,219 @@ int main(int argc, char **argv) {
         arakoon_key_value_list_iter_free(iter1);
         arakoon_key_value_list_free(r1);
 
+        /* multi_get_option: missing keys yield None entries */
+        rc = arakoon_set(c, NULL, 4, "mgo1", 1, "a");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_set");
+
+        r0 = arakoon_value_list_new();
+        ABORT_IF_NULL(r0, "arakoon_value_list_new");
+        rc = arakoon_value_list_add(r0, 4, "mgo1");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_add");
+        rc = arakoon_value_list_add(r0, 4, "mgo2");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_add");
+        rc = arakoon_multi_get_option(c, options, r0, &r2);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_multi_get_option");
+        arakoon_value_list_free(r0);
+
+        if(arakoon_value_list_size(r2) != 2) {
+                fprintf(stderr, "Unexpected result size: %zu, expected 2\n",
+                        arakoon_value_list_size(r2));
+                abort();
+        }
+        rc = arakoon_value_list_get(r2, 0, &l0, &v0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_get");
+        if(v0 == NULL || l0 != 1 || strncmp(v0, "a", 1) != 0) {
+                fprintf(stderr, "Unexpected multi_get_option value\n");
+                abort();
+        }
+        rc = arakoon_value_list_get(r2, 1, &l0, &v0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_get");
+        if(v0 != NULL) {
+                fprintf(stderr, "Unexpected multi_get_option value for "
+                        "missing key\n");
+                abort();
+        }
+        arakoon_value_list_free(r2);
+
+        /* Key counts */
+        for(i = 1; i <= 5; i++) {
+                s0 = (char *)check_arakoon_malloc(10);
+                ABORT_IF_NULL(s0, "check_arakoon_malloc");
+                l0 = snprintf(s0, 10, "cnt%d", i);
+                rc = arakoon_set(c, NULL, l0, s0, 5, "value");
+                check_arakoon_free(s0);
+                ABORT_IF_NOT_SUCCESS(rc, "arakoon_set");
+        }
+
+        rc = arakoon_prefix_count(c, options, 3, "cnt", &count0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_prefix_count");
+        if(count0 != 5) {
+                fprintf(stderr, "Unexpected prefix count: %llu\n",
+                        (unsigned long long) count0);
+                abort();
+        }
+
+        rc = arakoon_range_count(c, options, 4, "cnt2", ARAKOON_BOOL_TRUE,
+                4, "cnt5", ARAKOON_BOOL_FALSE, &count0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_range_count");
+        if(count0 != 3) {
+                fprintf(stderr, "Unexpected range count: %llu\n",
+                        (unsigned long long) count0);
+                abort();
+        }
+
+        rc = arakoon_get_key_count(c, options, &count0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_get_key_count");
+        rc = arakoon_range_count(c, options, 0, NULL, ARAKOON_BOOL_TRUE,
+                0, NULL, ARAKOON_BOOL_TRUE, &count1);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_range_count");
+        if(count0 != count1 || count0 < 5) {
+                fprintf(stderr, "Unexpected key count: %llu, range count "
+                        "%llu\n", (unsigned long long) count0,
+                        (unsigned long long) count1);
+                abort();
+        }
+
+        /* replace returns the previous value, or NULL */
+        rc = arakoon_replace(c, NULL, 3, "rpl", 3, "one", &l0, &d0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_replace");
+        if(d0 != NULL) {
+                fprintf(stderr, "Unexpected previous value for 'rpl'\n");
+                abort();
+        }
+        rc = arakoon_replace(c, NULL, 3, "rpl", 3, "two", &l0, &d0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_replace");
+        if(d0 == NULL || l0 != 3 || strncmp(d0, "one", 3) != 0) {
+                fprintf(stderr, "Unexpected previous value for 'rpl'\n");
+                abort();
+        }
+        check_arakoon_free(d0);
+        rc = arakoon_replace(c, NULL, 3, "rpl", 0, NULL, &l0, &d0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_replace");
+        if(d0 == NULL || l0 != 3 || strncmp(d0, "two", 3) != 0) {
+                fprintf(stderr, "Unexpected previous value for 'rpl'\n");
+                abort();
+        }
+        check_arakoon_free(d0);
+        rc = arakoon_get(c, NULL, 3, "rpl", &l0, &d0);
+        if(rc != ARAKOON_RC_NOT_FOUND) {
+                fprintf(stderr, "Unexpected value for key 'rpl' found\n");
+                abort();
+        }
+
+        /* confirm and multi_confirm */
+        rc = arakoon_confirm(c, NULL, 3, "cnf", 5, "value");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_confirm");
+        rc = arakoon_confirm(c, NULL, 3, "cnf", 5, "value");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_confirm");
+        rc = arakoon_get(c, NULL, 3, "cnf", &l0, &d0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_get");
+        if(l0 != 5 || strncmp(d0, "value", 5) != 0) {
+                fprintf(stderr, "Unexpected value for key 'cnf'\n");
+                abort();
+        }
+        check_arakoon_free(d0);
+
+        rc = arakoon_set(c, NULL, 3, "mc1", 1, "x");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_set");
+
+        r0 = arakoon_value_list_new();
+        ABORT_IF_NULL(r0, "arakoon_value_list_new");
+        r2 = arakoon_value_list_new();
+        ABORT_IF_NULL(r2, "arakoon_value_list_new");
+        rc = arakoon_value_list_add(r0, 3, "mc1");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_add");
+        rc = arakoon_value_list_add(r2, 1, "x");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_add");
+        rc = arakoon_value_list_add(r0, 3, "mc2");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_add");
+        rc = arakoon_value_list_add(r2, 1, "y");
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_value_list_add");
+        rc = arakoon_multi_confirm(c, NULL, r0, r2);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_multi_confirm");
+        arakoon_value_list_free(r0);
+        arakoon_value_list_free(r2);
+
+        rc = arakoon_get(c, NULL, 3, "mc2", &l0, &d0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_get");
+        if(l0 != 1 || strncmp(d0, "y", 1) != 0) {
+                fprintf(stderr, "Unexpected value for key 'mc2'\n");
+                abort();
+        }
+        check_arakoon_free(d0);
+
+        /* Streaming range calls, entries come in the order the server sends
+         * them */
+        memset(&foreach_state, 0, sizeof(foreach_state));
+        rc = arakoon_prefix_foreach(c, options, 3, "cnt", -1,
+                foreach_callback, &foreach_state);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_prefix_foreach");
+        if(foreach_state.count != 5) {
+                fprintf(stderr, "Unexpected prefix_foreach count: %u\n",
+                        foreach_state.count);
+                abort();
+        }
+
+        memset(&foreach_state, 0, sizeof(foreach_state));
+        rc = arakoon_range_foreach(c, options, 4, "cnt2", ARAKOON_BOOL_TRUE,
+                4, "cnt5", ARAKOON_BOOL_FALSE, -1, foreach_callback,
+                &foreach_state);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_range_foreach");
+        if(foreach_state.count != 3) {
+                fprintf(stderr, "Unexpected range_foreach count: %u\n",
+                        foreach_state.count);
+                abort();
+        }
+
+        memset(&foreach_state, 0, sizeof(foreach_state));
+        foreach_state.with_values = ARAKOON_BOOL_TRUE;
+        foreach_state.order = -1;
+        rc = arakoon_range_entries_foreach(c, options,
+                3, "cnt", ARAKOON_BOOL_TRUE, 3, "cnu", ARAKOON_BOOL_FALSE,
+                -1, foreach_callback, &foreach_state);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_range_entries_foreach");
+        if(foreach_state.count != 5) {
+                fprintf(stderr, "Unexpected range_entries_foreach count: "
+                        "%u\n", foreach_state.count);
+                abort();
+        }
+
+        memset(&foreach_state, 0, sizeof(foreach_state));
+        foreach_state.with_values = ARAKOON_BOOL_TRUE;
+        foreach_state.order = 1;
+        rc = arakoon_rev_range_entries_foreach(c, options,
+                3, "cnu", ARAKOON_BOOL_FALSE, 3, "cnt", ARAKOON_BOOL_TRUE,
+                -1, foreach_callback, &foreach_state);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_rev_range_entries_foreach");
+        if(foreach_state.count != 5) {
+                fprintf(stderr, "Unexpected rev_range_entries_foreach count: "
+                        "%u\n", foreach_state.count);
+                abort();
+        }
+
+        /* Stopping early skips the remainder of the response, so the
+         * connection can be used for the next call */
+        memset(&foreach_state, 0, sizeof(foreach_state));
+        foreach_state.with_values = ARAKOON_BOOL_TRUE;
+        foreach_state.stop_after = 2;
+        rc = arakoon_range_entries_foreach(c, options,
+                3, "cnt", ARAKOON_BOOL_TRUE, 3, "cnu", ARAKOON_BOOL_FALSE,
+                -1, foreach_callback, &foreach_state);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_range_entries_foreach");
+        if(foreach_state.count != 2) {
+                fprintf(stderr, "Unexpected range_entries_foreach count "
+                        "after stop: %u\n", foreach_state.count);
+                abort();
+        }
+
+        rc = arakoon_get(c, NULL, 4, "cnt1", &l0, &d0);
+        ABORT_IF_NOT_SUCCESS(rc, "arakoon_get after foreach stop");
+        if(l0 != 5 || strncmp(d0, "value", 5) != 0) {
+                fprintf(stderr, "Unexpected value for key 'cnt1'\n");
+                abort();
+        }
+        check_arakoon_free(d0);
+
         arakoon_client_call_options_free(options);
         arakoon_cluster_free(c);
 